@@ -13,6 +13,10 @@
 
 #include "libs/globals.h"
 #include "libs/globals_qt.h"
+#include "tlibs/math/math.h"
+
+#include <vector>
+#include <cmath>
 
 #include "ui/ui_deadangles.h"
 
@@ -29,6 +33,61 @@ struct DeadAngle
 };
 
 
+/**
+ * checks if the beam passes through one of the dead angles,
+ * using the same geometry as the real-space tas layout
+ * @param dMonoTT, dSampleTh, dSampleTT, dAnaTT spectrometer angles in rad
+ */
+template<class T = double>
+bool is_beam_obstructed(const std::vector<DeadAngle<T>>& vecDeadAngles,
+	T dMonoTT, T dSampleTh, T dSampleTT, T dAnaTT)
+{
+	auto norm_angle = [](T dAngle) -> T
+	{
+		dAngle = std::fmod(dAngle, T(360));
+		if(dAngle < T(0)) dAngle += T(360);
+		return dAngle;
+	};
+
+	// directions of source->mono, mono->sample, sample->ana and ana->detector in deg
+	const T dLines[] =
+	{
+		T(0),
+		tl::r2d(dMonoTT),
+		tl::r2d(dMonoTT + dSampleTT),
+		tl::r2d(dMonoTT + dSampleTT + dAnaTT),
+	};
+	const T dCrystalTheta[] = { tl::r2d(dMonoTT/T(2)), tl::r2d(dSampleTh), tl::r2d(dAnaTT/T(2)) };
+
+	for(const DeadAngle<T>& angle : vecDeadAngles)
+	{
+		const int iCentre = (angle.iCentreOn >= 0 && angle.iCentreOn <= 2) ? angle.iCentreOn : 1;
+		const T dLineIn = dLines[iCentre];
+		const T dLineOut = dLines[iCentre + 1];
+
+		T dAbsOffs = T(0);
+		switch(angle.iRelativeTo)
+		{
+			case 0: dAbsOffs = dLineIn + dCrystalTheta[iCentre]; break;
+			case 1: dAbsOffs = dLineIn; break;
+			case 2: dAbsOffs = dLineOut; break;
+		}
+
+		const T dStart = angle.dAngleStart + angle.dAngleOffs + dAbsOffs;
+		const T dRange = angle.dAngleEnd - angle.dAngleStart;
+
+		for(T dLine : { dLineIn + T(180), dLineOut })
+		{
+			if(tl::is_in_angular_range(tl::d2r(norm_angle(dStart)), tl::d2r(dRange),
+				tl::d2r(norm_angle(dLine))))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+
 class DeadAnglesDlg : public QDialog, Ui::DeadAnglesDlg
 { Q_OBJECT
 protected:
@@ -12,6 +12,7 @@
 
 #include <QFileDialog>
 #include <QMessageBox>
+#include <fstream>
 
 using t_real = t_real_glob;
 static const tl::t_length_si<t_real> angs = tl::get_one_angstrom<t_real>();
@@ -44,6 +45,8 @@ GotoDlg::GotoDlg(QWidget* pParent, QSettings* pSett) : QDialog(pParent), m_pSett
 	QObject::connect(btnDel, &QAbstractButton::clicked, this, &GotoDlg::RemPosFromList);
 	QObject::connect(btnLoad, &QAbstractButton::clicked, this, &GotoDlg::LoadList);
 	QObject::connect(btnSave, &QAbstractButton::clicked, this, &GotoDlg::SaveList);
+	QObject::connect(btnImport, &QAbstractButton::clicked, this, &GotoDlg::ImportList);
+	QObject::connect(btnPlan, &QAbstractButton::clicked, this, &GotoDlg::PlanList);
 	QObject::connect(listSeq, &QListWidget::itemSelectionChanged, this, &GotoDlg::ListItemSelected);
 	QObject::connect(listSeq, &QListWidget::itemDoubleClicked, this, &GotoDlg::ListItemDoubleClicked);
 
@@ -63,6 +66,8 @@ GotoDlg::GotoDlg(QWidget* pParent, QSettings* pSett) : QDialog(pParent), m_pSett
 	QObject::connect(btnDel, SIGNAL(clicked()), this, SLOT(RemPosFromList()));
 	QObject::connect(btnLoad, SIGNAL(clicked()), this, SLOT(LoadList()));
 	QObject::connect(btnSave, SIGNAL(clicked()), this, SLOT(SaveList()));
+	QObject::connect(btnImport, SIGNAL(clicked()), this, SLOT(ImportList()));
+	QObject::connect(btnPlan, SIGNAL(clicked()), this, SLOT(PlanList()));
 	QObject::connect(listSeq, SIGNAL(itemSelectionChanged()), this, SLOT(ListItemSelected()));
 	QObject::connect(listSeq, SIGNAL(itemDoubleClicked(QListWidgetItem*)),
 		this, SLOT(ListItemDoubleClicked(QListWidgetItem*)));
@@ -95,6 +100,7 @@ GotoDlg::GotoDlg(QWidget* pParent, QSettings* pSett) : QDialog(pParent), m_pSett
 
 GotoDlg::~GotoDlg()
 {
+	CancelPlanJob(1);
 	ClearList();
 }
 
@@ -439,13 +445,6 @@ void GotoDlg::showEvent(QShowEvent *pEvt)
 
 //------------------------------------------------------------------------------
 
-struct HklPos
-{
-	t_real dh, dk, dl;
-	t_real dki, dkf;
-	t_real dE;
-};
-
 bool GotoDlg::ApplyCurPos()
 {
 	if(!m_bMonoAnaOk || !m_bSampleOk)
@@ -522,6 +521,7 @@ void GotoDlg::ListItemDoubleClicked(QListWidgetItem* pItem)
 
 void GotoDlg::AddPosToList(t_real dh, t_real dk, t_real dl, t_real dki, t_real dkf)
 {
+	CancelPlanJob();
 	HklPos *pPos = new HklPos;
 
 	pPos->dh = dh;
@@ -565,6 +565,7 @@ void GotoDlg::AddPosToList()
 
 void GotoDlg::RemPosFromList()
 {
+	CancelPlanJob();
 	QListWidgetItem *pItem = listSeq->currentItem();
 	if(pItem)
 	{
@@ -576,6 +577,7 @@ void GotoDlg::RemPosFromList()
 
 void GotoDlg::ClearList()
 {
+	CancelPlanJob();
 	while(listSeq->count())
 	{
 		QListWidgetItem *pItem = listSeq->item(0);
@@ -659,6 +661,277 @@ void GotoDlg::SaveList()
 		m_pSettings->setValue("goto_pos/last_dir", QString(strDir.c_str()));
 }
 
+/**
+ * adds positions from a text file with the columns "h k l E" or "h k l ki kf",
+ * columns given as "start:end:step" are expanded to a grid
+ */
+void GotoDlg::ImportList()
+{
+	QFileDialog::Option fileopt = QFileDialog::Option(0);
+	if(m_pSettings && !m_pSettings->value("main/native_dialogs", 1).toBool())
+		fileopt = QFileDialog::DontUseNativeDialog;
+
+	QString strDirLast = ".";
+	if(m_pSettings)
+		strDirLast = m_pSettings->value("goto_pos/last_dir", ".").toString();
+	QString qstrFile = QFileDialog::getOpenFileName(this,
+		"Import Positions", strDirLast,
+		"Data files (*.dat *.txt *.DAT *.TXT);;All files (*)", nullptr,
+		fileopt);
+	if(qstrFile == "")
+		return;
+
+	std::string strFile = qstrFile.toStdString();
+	std::string strDir = tl::get_dir(strFile);
+
+	std::ifstream ifstr(strFile);
+	if(!ifstr)
+	{
+		QMessageBox::critical(this, "Error", "Could not open position file.");
+		return;
+	}
+
+	// fixed ki or kf for positions given by their energy transfer
+	const bool bFixedKi = radioFixedKi->isChecked();
+	const t_real dFixedK = tl::str_to_var_parse<t_real>(
+		(bFixedKi ? editKi : editKf)->text().toStdString());
+
+	std::vector<HklPos> vecPos;
+	std::string strErr;
+	if(!plan_load_positions(ifstr, vecPos, dFixedK, bFixedKi, &strErr))
+	{
+		QMessageBox::critical(this, "Error", strErr.c_str());
+		return;
+	}
+
+	if(listSeq->count() + vecPos.size() > PLAN_MAX_POSITIONS)
+	{
+		std::ostringstream ostrErr;
+		ostrErr << "The list can hold at most " << PLAN_MAX_POSITIONS << " positions.";
+		QMessageBox::critical(this, "Error", ostrErr.str().c_str());
+		return;
+	}
+
+	listSeq->setUpdatesEnabled(0);
+	for(const HklPos& pos : vecPos)
+		AddPosToList(pos.dh, pos.dk, pos.dl, pos.dki, pos.dkf);
+	listSeq->setUpdatesEnabled(1);
+
+	labelStatus->setText(QString("Imported %1 positions.").arg(vecPos.size()));
+	if(m_pSettings)
+		m_pSettings->setValue("goto_pos/last_dir", QString(strDir.c_str()));
+}
+
+PlannerParams GotoDlg::GetPlannerParams() const
+{
+	PlannerParams params;
+	params.lattice = m_lattice;
+	params.vec1 = m_vec1;
+	params.vec2 = m_vec2;
+	params.dMono = m_dMono;
+	params.dAna = m_dAna;
+	params.bSenseM = m_bSenseM;
+	params.bSenseS = m_bSenseS;
+	params.bSenseA = m_bSenseA;
+	if(m_pvecDeadAngles)
+		params.vecDeadAngles = *m_pvecDeadAngles;
+
+	// motor speeds in deg/s
+	const char* pcSpeeds[] = { "goto_pos/speed_m2theta", "goto_pos/speed_stheta",
+		"goto_pos/speed_s2theta", "goto_pos/speed_a2theta" };
+	for(int iMotor=0; iMotor<4; ++iMotor)
+	{
+		if(m_pSettings && m_pSettings->contains(pcSpeeds[iMotor]))
+			params.dSpeed[iMotor] = m_pSettings->value(pcSpeeds[iMotor]).toDouble();
+	}
+
+	return params;
+}
+
+/**
+ * is a planning job running?
+ */
+bool GotoDlg::IsPlanning() const
+{
+	return m_futPlanJob.valid() &&
+		m_futPlanJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+/**
+ * stops a running planning job and starts a new job id;
+ * bWait: also wait until it has finished
+ */
+void GotoDlg::CancelPlanJob(bool bWait)
+{
+	const bool bPlanning = IsPlanning();
+
+	if(m_pStopPlanJob)
+		m_pStopPlanJob->store(true);
+	m_pStopPlanJob = std::make_shared<std::atomic<bool>>(false);
+	++m_iPlanJob;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtxPlanJob);
+		m_pPlanResult.reset();
+		m_iPlanResult = 0;
+	}
+
+	if(bWait && m_futPlanJob.valid())
+		m_futPlanJob.wait();
+
+	if(bPlanning)
+	{
+		btnPlan->setText("Plan");
+		labelStatus->setText("Planning cancelled.");
+	}
+}
+
+/**
+ * calculates the angles of all positions in the list in the background;
+ * the result is applied in PlanCalculated, clicking again cancels the job
+ */
+void GotoDlg::PlanList()
+{
+	if(IsPlanning())
+	{
+		CancelPlanJob();
+		return;
+	}
+
+	const int iNumItems = listSeq->count();
+	if(!iNumItems)
+		return;
+	if(iNumItems > PLAN_MAX_POSITIONS)
+	{
+		std::ostringstream ostrErr;
+		ostrErr << "At most " << PLAN_MAX_POSITIONS << " positions can be planned.";
+		QMessageBox::critical(this, "Error", ostrErr.str().c_str());
+		return;
+	}
+
+	CancelPlanJob();
+
+	std::shared_ptr<PlanResult> pResult = std::make_shared<PlanResult>();
+	pResult->vecPos.resize(iNumItems);
+	for(int iItem=0; iItem<iNumItems; ++iItem)
+	{
+		const HklPos* pPos = (HklPos*)listSeq->item(iItem)->data(Qt::UserRole).value<void*>();
+		if(pPos)
+			pResult->vecPos[iItem].pos = *pPos;
+	}
+
+	// start from the position currently shown in the dialog
+	PlannedPos posCur;
+	posCur.dMono2Theta = m_dMono2Theta;
+	posCur.dAna2Theta = m_dAna2Theta;
+	posCur.dSampleTheta = m_dSampleTheta;
+	posCur.dSample2Theta = m_dSample2Theta;
+	const bool bHasCur = m_bMonoAnaOk && m_bSampleOk;
+
+	const PlannerParams params = GetPlannerParams();
+	const unsigned int iJob = m_iPlanJob;
+	std::shared_ptr<std::atomic<bool>> pStop = m_pStopPlanJob;
+
+	m_futPlanJob = get_task_pool().Submit([this, iJob, pStop, pResult, params, posCur, bHasCur]()
+	{
+		if(pStop->load())
+			return;
+
+		TaskPool& pool = get_task_pool();
+		plan_calc_angles(params, pResult->vecPos, &pool, pStop.get());
+		if(pStop->load())
+			return;
+
+		pResult->vecOrder = plan_order(params, pResult->vecPos,
+			bHasCur ? &posCur : nullptr, &pResult->dTime, &pool, pStop.get());
+		if(pStop->load())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mtxPlanJob);
+			m_pPlanResult = pResult;
+			m_iPlanResult = iJob;
+		}
+		QMetaObject::invokeMethod(this, "PlanCalculated", Qt::QueuedConnection);
+	});
+
+	btnPlan->setText("Stop");
+	labelStatus->setText(QString("Planning %1 positions...").arg(iNumItems));
+}
+
+/**
+ * marks the unusable positions and sorts the list to minimise
+ * the motor travel time from the current position
+ */
+void GotoDlg::PlanCalculated()
+{
+	std::shared_ptr<PlanResult> pResult;
+	{
+		std::lock_guard<std::mutex> lock(m_mtxPlanJob);
+		if(m_iPlanResult != m_iPlanJob)
+			return;
+
+		pResult = m_pPlanResult;
+		m_pPlanResult.reset();
+		m_iPlanResult = 0;
+	}
+
+	btnPlan->setText("Plan");
+
+	const int iNumItems = listSeq->count();
+	if(!pResult || int(pResult->vecPos.size()) != iNumItems)
+		return;
+
+	const std::vector<PlannedPos>& vecPos = pResult->vecPos;
+
+
+	// re-insert the list items in the new order
+	listSeq->blockSignals(1);
+	listSeq->setUpdatesEnabled(0);
+
+	std::vector<QListWidgetItem*> vecItems(iNumItems);
+	for(int iItem=iNumItems-1; iItem>=0; --iItem)
+		vecItems[iItem] = listSeq->takeItem(iItem);
+
+	std::size_t iNumUnreachable = 0, iNumObstructed = 0;
+	for(std::size_t iIdx : pResult->vecOrder)
+	{
+		QListWidgetItem* pItem = vecItems[iIdx];
+		const PlannedPos& pos = vecPos[iIdx];
+
+		if(pos.IsOk())
+		{
+			pItem->setData(Qt::ForegroundRole, QVariant());
+			pItem->setToolTip("");
+		}
+		else
+		{
+			pItem->setForeground(QBrush(Qt::red));
+			pItem->setToolTip(pos.strErr.c_str());
+
+			if(!pos.bReachable)
+				++iNumUnreachable;
+			else
+				++iNumObstructed;
+		}
+
+		listSeq->addItem(pItem);
+	}
+
+	listSeq->setUpdatesEnabled(1);
+	listSeq->blockSignals(0);
+
+
+	std::ostringstream ostrStatus;
+	ostrStatus.precision(g_iPrecGfx);
+	ostrStatus << "Planned " << iNumItems << " positions, travel time: " << pResult->dTime << " s.";
+	if(iNumUnreachable)
+		ostrStatus << " " << iNumUnreachable << " unreachable.";
+	if(iNumObstructed)
+		ostrStatus << " " << iNumObstructed << " in dead angles.";
+	labelStatus->setText(ostrStatus.str().c_str());
+}
+
 void GotoDlg::Save(std::map<std::string, std::string>& mapConf, const std::string& strXmlRoot)
 {
 	mapConf[strXmlRoot + "goto_pos/h"] = editH->text().toStdString();
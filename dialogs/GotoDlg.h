@@ -12,6 +12,11 @@
 #include <QSettings>
 #include "ui/ui_goto.h"
 
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <memory>
+
 #include "tlibs/phys/lattice.h"
 #include "tlibs/math/linalg.h"
 #include "tlibs/file/prop.h"
@@ -19,6 +24,7 @@
 #include "libs/globals_qt.h"
 #include "tools/taz/tasoptions.h"
 #include "RecipParamDlg.h"
+#include "GotoPlanner.h"
 
 
 class GotoDlg : public QDialog, Ui::GotoDlg
@@ -49,12 +55,25 @@ class GotoDlg : public QDialog, Ui::GotoDlg
 
 		bool m_bSenseM=0, m_bSenseS=1, m_bSenseA=0;
 
+		const std::vector<DeadAngle<t_real_glob>> *m_pvecDeadAngles = nullptr;
+
+		// background planning job
+		unsigned int m_iPlanJob = 0;
+		std::shared_ptr<std::atomic<bool>> m_pStopPlanJob;
+		std::future<void> m_futPlanJob;
+		std::mutex m_mtxPlanJob;
+		std::shared_ptr<PlanResult> m_pPlanResult;
+		unsigned int m_iPlanResult = 0;
+
 	public:
 		void ClearList();
 
 	protected:
 		bool GotoPos(QListWidgetItem* pItem, bool bApply);
 		bool ApplyCurPos();
+		PlannerParams GetPlannerParams() const;
+		bool IsPlanning() const;
+		void CancelPlanJob(bool bWait=0);
 
 	protected slots:
 		void EditedKiKf();
@@ -67,6 +86,9 @@ class GotoDlg : public QDialog, Ui::GotoDlg
 		void RemPosFromList();
 		void LoadList();
 		void SaveList();
+		void ImportList();
+		void PlanList();
+		void PlanCalculated();
 		void ListItemSelected();
 		void ListItemDoubleClicked(QListWidgetItem*);
 
@@ -89,6 +111,9 @@ class GotoDlg : public QDialog, Ui::GotoDlg
 		void SetSampleSense(bool bSense) { m_bSenseS = bSense; }
 		void SetAnaSense(bool bSense) { m_bSenseA = bSense; }
 
+		void SetDeadAngles(const std::vector<DeadAngle<t_real_glob>> *pvecDeadAngles)
+		{ m_pvecDeadAngles = pvecDeadAngles; }
+
 		bool GotoPos(unsigned int iItem);
 
 	protected slots:
@@ -0,0 +1,629 @@
+/**
+ * batch calculation and ordering of spectrometer positions
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#include "GotoPlanner.h"
+#include "tlibs/phys/neutrons.h"
+#include "tlibs/string/string.h"
+#include "tlibs/log/log.h"
+
+#include <map>
+#include <array>
+#include <future>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using t_real = t_real_glob;
+static const tl::t_length_si<t_real> angs = tl::get_one_angstrom<t_real>();
+static const tl::t_energy_si<t_real> meV = tl::get_one_meV<t_real>();
+static const tl::t_angle_si<t_real> rads = tl::get_one_radian<t_real>();
+
+
+// number of positions per task in plan_calc_angles
+#define PLAN_CHUNK_SIZE		256
+
+// maximum number of improvement passes in plan_order
+#define PLAN_MAX_PASSES		32
+
+// number of nearest neighbours considered for each position in plan_order
+#define PLAN_NEIGHBOURS		8
+
+// time budget for the improvement passes in plan_order, in s
+#define PLAN_MAX_SECONDS	10
+
+
+/**
+ * parses a column which is either a value or a range "start:end:step"
+ */
+static bool get_column_values(const std::string& strCol, std::vector<t_real>& vecVals)
+{
+	std::vector<std::string> vecRange;
+	tl::get_tokens<std::string>(strCol, std::string(":"), vecRange);
+
+	if(vecRange.size() == 1)
+	{
+		vecVals.push_back(tl::str_to_var_parse<t_real>(vecRange[0]));
+		return true;
+	}
+	else if(vecRange.size() == 3)
+	{
+		const t_real dStart = tl::str_to_var_parse<t_real>(vecRange[0]);
+		const t_real dEnd = tl::str_to_var_parse<t_real>(vecRange[1]);
+		const t_real dStep = tl::str_to_var_parse<t_real>(vecRange[2]);
+
+		if(tl::float_equal<t_real>(dStep, 0., g_dEps) || (dEnd-dStart)/dStep < t_real(0))
+			return false;
+
+		const t_real dNum = std::floor((dEnd-dStart)/dStep + g_dEps) + 1;
+		if(dNum > t_real(PLAN_MAX_POSITIONS))
+			return false;
+		const std::size_t iNum = std::size_t(dNum);
+
+		for(std::size_t i=0; i<iNum; ++i)
+			vecVals.push_back(dStart + t_real(i)*dStep);
+		return true;
+	}
+
+	return false;
+}
+
+
+/**
+ * reads positions from columns "h k l E" (using the fixed ki or kf) or "h k l ki kf",
+ * a column can also be a range "start:end:step", in which case the grid of all combinations is added
+ */
+bool plan_load_positions(std::istream& istr, std::vector<HklPos>& vecPos,
+	t_real dFixedK, bool bFixedKi, std::string* pstrErr)
+{
+	std::size_t iLine = 0;
+	std::string strLine;
+
+	while(std::getline(istr, strLine))
+	{
+		++iLine;
+		tl::trim(strLine);
+		if(strLine == "" || strLine[0] == '#')
+			continue;
+
+		std::vector<std::string> vecCols;
+		tl::get_tokens<std::string>(strLine, std::string(" \t,;"), vecCols);
+
+		std::vector<std::vector<t_real>> vecColVals(vecCols.size());
+		std::size_t iNumGrid = 1;
+		bool bOk = (vecCols.size() == 4 || vecCols.size() == 5);
+		bool bTooMany = 0;
+		for(std::size_t iCol=0; bOk && iCol<vecCols.size(); ++iCol)
+		{
+			bOk = get_column_values(vecCols[iCol], vecColVals[iCol]);
+			iNumGrid *= vecColVals[iCol].size();
+			if(vecPos.size() + iNumGrid > PLAN_MAX_POSITIONS)
+			{
+				bOk = 0;
+				bTooMany = 1;
+			}
+		}
+
+		if(!bOk)
+		{
+			std::ostringstream ostrErr;
+			if(bTooMany)
+				ostrErr << "Line " << iLine << " exceeds the maximum of " << PLAN_MAX_POSITIONS << " positions.";
+			else
+				ostrErr << "Invalid position in line " << iLine << ": \"" << strLine << "\".";
+			tl::log_err(ostrErr.str());
+			if(pstrErr) *pstrErr = ostrErr.str();
+			return false;
+		}
+
+		// all combinations of the column values
+		std::vector<std::size_t> vecIdx(vecCols.size(), 0);
+		for(std::size_t iGrid=0; iGrid<iNumGrid; ++iGrid)
+		{
+			HklPos pos;
+			pos.dh = vecColVals[0][vecIdx[0]];
+			pos.dk = vecColVals[1][vecIdx[1]];
+			pos.dl = vecColVals[2][vecIdx[2]];
+
+			if(vecCols.size() == 5)
+			{
+				pos.dki = vecColVals[3][vecIdx[3]];
+				pos.dkf = vecColVals[4][vecIdx[4]];
+				pos.dE = (tl::k2E(pos.dki/angs) - tl::k2E(pos.dkf/angs))/meV;
+			}
+			else
+			{
+				pos.dE = vecColVals[3][vecIdx[3]];
+
+				bool bImag = 0;
+				tl::t_wavenumber_si<t_real> k_E = tl::E2k(pos.dE*meV, bImag);
+				const t_real dSign = bImag ? t_real(-1) : t_real(1);
+				const tl::t_wavenumber_si<t_real> k = dFixedK / angs;
+
+				if(bFixedKi)
+				{
+					pos.dki = dFixedK;
+					pos.dkf = tl::my_units_sqrt<tl::t_wavenumber_si<t_real>>(k*k - dSign*k_E*k_E) * angs;
+				}
+				else
+				{
+					pos.dkf = dFixedK;
+					pos.dki = tl::my_units_sqrt<tl::t_wavenumber_si<t_real>>(k*k + dSign*k_E*k_E) * angs;
+				}
+			}
+
+			// energy transfer not reachable with the fixed k
+			if(tl::is_nan_or_inf<t_real>(pos.dki) || tl::is_nan_or_inf<t_real>(pos.dkf) ||
+				tl::is_nan_or_inf<t_real>(pos.dE))
+			{
+				std::ostringstream ostrErr;
+				ostrErr << "Invalid ki or kf for E = " << pos.dE << " meV in line " << iLine << ".";
+				tl::log_err(ostrErr.str());
+				if(pstrErr) *pstrErr = ostrErr.str();
+				return false;
+			}
+
+			for(t_real* d : {&pos.dh, &pos.dk, &pos.dl, &pos.dki, &pos.dkf, &pos.dE})
+				tl::set_eps_0(*d, g_dEps);
+			vecPos.push_back(pos);
+
+			// next combination, last column varies fastest
+			for(std::size_t iCol=vecCols.size(); iCol>0; --iCol)
+			{
+				if(++vecIdx[iCol-1] < vecColVals[iCol-1].size())
+					break;
+				vecIdx[iCol-1] = 0;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * calculates the angles of all positions:
+ * the mono and ana angles are only calculated once for each distinct ki and kf,
+ * the sample angles are calculated in parallel if a pool is given
+ */
+void plan_calc_angles(const PlannerParams& params, std::vector<PlannedPos>& vecPos, TaskPool* pPool,
+	const std::atomic<bool>* pbStop)
+{
+	const t_real dNaN = std::numeric_limits<t_real>::quiet_NaN();
+
+	// look-up tables for the mono and ana angles,
+	// non-finite keys would break the ordering of the maps
+	auto is_finite_k = [](const PlannedPos& pos) -> bool
+	{
+		return !tl::is_nan_or_inf<t_real>(pos.pos.dki) && !tl::is_nan_or_inf<t_real>(pos.pos.dkf);
+	};
+
+	std::map<t_real, t_real> mapMono, mapAna;
+	for(const PlannedPos& pos : vecPos)
+	{
+		if(!is_finite_k(pos))
+			continue;
+		mapMono.insert(std::make_pair(pos.pos.dki, dNaN));
+		mapAna.insert(std::make_pair(pos.pos.dkf, dNaN));
+	}
+
+	for(auto* pMap : {&mapMono, &mapAna})
+	{
+		const bool bMono = (pMap == &mapMono);
+		for(auto& pair : *pMap)
+		{
+			try
+			{
+				pair.second = tl::get_mono_twotheta(pair.first/angs,
+					(bMono ? params.dMono : params.dAna)*angs,
+					bMono ? params.bSenseM : params.bSenseA) / rads;
+				tl::set_eps_0(pair.second, g_dEps);
+			}
+			catch(const std::exception&)
+			{
+				pair.second = dNaN;
+			}
+		}
+	}
+
+
+	auto calc_chunk = [&params, &vecPos, &mapMono, &mapAna, &is_finite_k, pbStop](std::size_t iBegin, std::size_t iEnd)
+	{
+		for(std::size_t iPos=iBegin; iPos<iEnd; ++iPos)
+		{
+			if(pbStop && pbStop->load())
+				return;
+
+			PlannedPos& pos = vecPos[iPos];
+			pos.bReachable = 0;
+			pos.bObstructed = 0;
+			pos.strErr = "";
+
+			if(!is_finite_k(pos))
+			{
+				pos.strErr = "Invalid ki or kf.";
+				continue;
+			}
+
+			pos.dMono2Theta = mapMono.find(pos.pos.dki)->second;
+			pos.dAna2Theta = mapAna.find(pos.pos.dkf)->second;
+
+			if(tl::is_nan_or_inf<t_real>(pos.dMono2Theta))
+			{
+				pos.strErr = "Invalid monochromator angle.";
+				continue;
+			}
+			if(tl::is_nan_or_inf<t_real>(pos.dAna2Theta))
+			{
+				pos.strErr = "Invalid analyser angle.";
+				continue;
+			}
+
+			try
+			{
+				tl::get_tas_angles(params.lattice,
+					params.vec1, params.vec2,
+					pos.pos.dki, pos.pos.dkf,
+					pos.pos.dh, pos.pos.dk, pos.pos.dl,
+					params.bSenseS,
+					&pos.dSampleTheta, &pos.dSample2Theta);
+
+				if(tl::is_nan_or_inf<t_real>(pos.dSample2Theta))
+					throw tl::Err("Invalid sample 2theta.");
+				if(tl::is_nan_or_inf<t_real>(pos.dSampleTheta))
+					throw tl::Err("Invalid sample theta.");
+			}
+			catch(const std::exception& ex)
+			{
+				pos.strErr = ex.what();
+				continue;
+			}
+
+			tl::set_eps_0(pos.dSample2Theta, g_dEps);
+			tl::set_eps_0(pos.dSampleTheta, g_dEps);
+			pos.bReachable = 1;
+
+			if(params.vecDeadAngles.size() && is_beam_obstructed<t_real>(params.vecDeadAngles,
+				pos.dMono2Theta, pos.dSampleTheta, pos.dSample2Theta, pos.dAna2Theta))
+			{
+				pos.bObstructed = 1;
+				pos.strErr = "Beam passes through a dead angle.";
+			}
+		}
+	};
+
+	const std::size_t iNumChunks = (vecPos.size() + PLAN_CHUNK_SIZE - 1) / PLAN_CHUNK_SIZE;
+	const std::size_t iNumTasks = pPool ? std::min<std::size_t>(iNumChunks, pPool->GetNumActive()) : 1;
+
+	if(iNumTasks > 1)
+	{
+		std::vector<std::future<void>> vecFuts;
+		vecFuts.reserve(iNumTasks);
+
+		for(std::size_t iTask=0; iTask<iNumTasks; ++iTask)
+		{
+			const std::size_t iBegin = vecPos.size() * iTask / iNumTasks;
+			const std::size_t iEnd = vecPos.size() * (iTask+1) / iNumTasks;
+			vecFuts.emplace_back(pPool->Submit([&calc_chunk, iBegin, iEnd]
+				{ calc_chunk(iBegin, iEnd); }));
+		}
+
+		for(std::future<void>& fut : vecFuts)
+			pPool->Wait(fut);
+	}
+	else
+	{
+		calc_chunk(0, vecPos.size());
+	}
+}
+
+
+/**
+ * time to move from one position to another, with all motors moving at the same time
+ */
+t_real plan_travel_time(const PlannerParams& params, const PlannedPos& pos1, const PlannedPos& pos2)
+{
+	const t_real dDeltas[] =
+	{
+		pos2.dMono2Theta - pos1.dMono2Theta,
+		pos2.dSampleTheta - pos1.dSampleTheta,
+		pos2.dSample2Theta - pos1.dSample2Theta,
+		pos2.dAna2Theta - pos1.dAna2Theta,
+	};
+
+	t_real dTime = 0.;
+	for(int iMotor=0; iMotor<4; ++iMotor)
+	{
+		const t_real dSpeed = params.dSpeed[iMotor] > t_real(0) ? params.dSpeed[iMotor] : t_real(1);
+		dTime = std::max(dTime, std::abs(tl::r2d(dDeltas[iMotor])) / dSpeed);
+	}
+
+	return dTime;
+}
+
+
+/**
+ * motor positions scaled by the motor speeds, the travel time is the
+ * maximum distance along one of the coordinates
+ */
+static std::array<t_real, 4> get_time_coords(const PlannerParams& params, const PlannedPos& pos)
+{
+	const t_real dAngles[] = { pos.dMono2Theta, pos.dSampleTheta, pos.dSample2Theta, pos.dAna2Theta };
+
+	std::array<t_real, 4> arr;
+	for(int iMotor=0; iMotor<4; ++iMotor)
+	{
+		const t_real dSpeed = params.dSpeed[iMotor] > t_real(0) ? params.dSpeed[iMotor] : t_real(1);
+		arr[iMotor] = tl::r2d(dAngles[iMotor]) / dSpeed;
+	}
+	return arr;
+}
+
+
+/**
+ * orders the usable positions by nearest neighbours and improves the path by 2-opt moves,
+ * the path starts at pStart if given and does not return to it;
+ * only the PLAN_NEIGHBOURS nearest positions of each position are considered as
+ * candidates for the moves and the improvement stops after PLAN_MAX_SECONDS
+ * @return indices into vecPos, unusable positions are at the end in their original order
+ */
+std::vector<std::size_t> plan_order(const PlannerParams& params,
+	const std::vector<PlannedPos>& vecPos, const PlannedPos* pStart, t_real* pdTime,
+	TaskPool* pPool, const std::atomic<bool>* pbStop)
+{
+	std::vector<std::size_t> vecUsable, vecUnusable;
+	for(std::size_t iPos=0; iPos<vecPos.size(); ++iPos)
+	{
+		if(vecPos[iPos].IsOk())
+			vecUsable.push_back(iPos);
+		else
+			vecUnusable.push_back(iPos);
+	}
+
+	// the path and the neighbour lists refer to indices into vecUsable,
+	// the start position is the last coordinate entry
+	const std::size_t iNum = vecUsable.size();
+	const std::size_t NONE = std::numeric_limits<std::size_t>::max();
+	const std::size_t START = iNum;
+
+	std::vector<std::array<t_real, 4>> vecCoords;
+	vecCoords.reserve(iNum + 1);
+	for(std::size_t iPos : vecUsable)
+		vecCoords.push_back(get_time_coords(params, vecPos[iPos]));
+	vecCoords.push_back(pStart ? get_time_coords(params, *pStart) : std::array<t_real, 4>{});
+
+	auto dist = [&vecCoords, NONE](std::size_t i1, std::size_t i2) -> t_real
+	{
+		if(i1 == NONE || i2 == NONE)
+			return t_real(0);
+
+		t_real dTime = 0.;
+		for(int iMotor=0; iMotor<4; ++iMotor)
+			dTime = std::max(dTime, std::abs(vecCoords[i1][iMotor] - vecCoords[i2][iMotor]));
+		return dTime;
+	};
+
+	auto is_stopped = [pbStop]() -> bool { return pbStop && pbStop->load(); };
+
+
+	// nearest neighbours of each position
+	const std::size_t iNumNeighbours = std::min<std::size_t>(PLAN_NEIGHBOURS, iNum ? iNum-1 : 0);
+	std::vector<std::size_t> vecNeighbours(iNum * iNumNeighbours);
+
+	auto calc_neighbours = [&](std::size_t iBegin, std::size_t iEnd)
+	{
+		std::vector<std::pair<t_real, std::size_t>> vecDists;
+		vecDists.reserve(iNum);
+
+		for(std::size_t iCur=iBegin; iCur<iEnd; ++iCur)
+		{
+			if(is_stopped())
+				return;
+
+			vecDists.clear();
+			for(std::size_t iOther=0; iOther<iNum; ++iOther)
+			{
+				if(iOther != iCur)
+					vecDists.emplace_back(dist(iCur, iOther), iOther);
+			}
+
+			std::partial_sort(vecDists.begin(), vecDists.begin()+iNumNeighbours, vecDists.end());
+			for(std::size_t iNeighbour=0; iNeighbour<iNumNeighbours; ++iNeighbour)
+				vecNeighbours[iCur*iNumNeighbours + iNeighbour] = vecDists[iNeighbour].second;
+		}
+	};
+
+	const std::size_t iNumChunks = (iNum + PLAN_CHUNK_SIZE - 1) / PLAN_CHUNK_SIZE;
+	const std::size_t iNumTasks = pPool ? std::min<std::size_t>(iNumChunks, pPool->GetNumActive()) : 1;
+	if(iNumTasks > 1)
+	{
+		std::vector<std::future<void>> vecFuts;
+		vecFuts.reserve(iNumTasks);
+
+		for(std::size_t iTask=0; iTask<iNumTasks; ++iTask)
+		{
+			const std::size_t iBegin = iNum * iTask / iNumTasks;
+			const std::size_t iEnd = iNum * (iTask+1) / iNumTasks;
+			vecFuts.emplace_back(pPool->Submit([&calc_neighbours, iBegin, iEnd]
+				{ calc_neighbours(iBegin, iEnd); }));
+		}
+
+		for(std::future<void>& fut : vecFuts)
+			pPool->Wait(fut);
+	}
+	else
+	{
+		calc_neighbours(0, iNum);
+	}
+
+
+	// nearest neighbours path: take the nearest unvisited candidate,
+	// only search all remaining positions if all candidates have been visited
+	std::vector<std::size_t> vecPath;
+	vecPath.reserve(iNum);
+	std::vector<std::size_t> vecRemaining(iNum), vecRemainingIdx(iNum);
+	for(std::size_t i=0; i<iNum; ++i)
+		vecRemaining[i] = vecRemainingIdx[i] = i;
+
+	auto visit = [&vecPath, &vecRemaining, &vecRemainingIdx, NONE](std::size_t iPos)
+	{
+		vecPath.push_back(iPos);
+
+		// remove from the unvisited positions by swapping with the last one
+		const std::size_t iIdx = vecRemainingIdx[iPos];
+		vecRemaining[iIdx] = vecRemaining.back();
+		vecRemainingIdx[vecRemaining[iIdx]] = iIdx;
+		vecRemaining.pop_back();
+		vecRemainingIdx[iPos] = NONE;
+	};
+
+	while(vecRemaining.size() && !is_stopped())
+	{
+		const std::size_t iPrev = vecPath.size() ? vecPath.back() : (pStart ? START : NONE);
+		std::size_t iBest = NONE;
+		t_real dBest = std::numeric_limits<t_real>::max();
+
+		if(iPrev == NONE)
+		{
+			iBest = vecRemaining.front();
+		}
+		else
+		{
+			if(iPrev != START)
+			{
+				for(std::size_t iNeighbour=0; iNeighbour<iNumNeighbours; ++iNeighbour)
+				{
+					const std::size_t iCand = vecNeighbours[iPrev*iNumNeighbours + iNeighbour];
+					if(vecRemainingIdx[iCand] == NONE)
+						continue;
+
+					// the neighbours are ordered by distance
+					iBest = iCand;
+					break;
+				}
+			}
+
+			if(iBest == NONE)
+			{
+				for(std::size_t iCand : vecRemaining)
+				{
+					const t_real dTime = dist(iPrev, iCand);
+					if(dTime < dBest)
+					{
+						dBest = dTime;
+						iBest = iCand;
+					}
+				}
+			}
+		}
+
+		visit(iBest);
+	}
+
+
+	// 2-opt: reverse sub-paths as long as this shortens the total time,
+	// a position is only moved next to one of its nearest neighbours
+	if(vecPath.size() == iNum)
+	{
+		std::vector<std::size_t> vecPathIdx(iNum);
+		for(std::size_t i=0; i<iNum; ++i)
+			vecPathIdx[vecPath[i]] = i;
+
+		auto path_at = [&vecPath, iNum, pStart, NONE, START](std::size_t i) -> std::size_t
+		{
+			// i is shifted by one to allow the entry before the path
+			if(i == 0)
+				return pStart ? START : NONE;
+			if(i > iNum)
+				return NONE;
+			return vecPath[i-1];
+		};
+
+		auto reverse = [&vecPath, &vecPathIdx](std::size_t iBegin, std::size_t iEnd)
+		{
+			std::reverse(vecPath.begin()+iBegin, vecPath.begin()+iEnd+1);
+			for(std::size_t i=iBegin; i<=iEnd; ++i)
+				vecPathIdx[vecPath[i]] = i;
+		};
+
+		const auto timeStart = std::chrono::steady_clock::now();
+		const auto timeMax = std::chrono::seconds(PLAN_MAX_SECONDS);
+		auto is_over = [&is_stopped, &timeStart, &timeMax]() -> bool
+		{
+			return is_stopped() || std::chrono::steady_clock::now()-timeStart > timeMax;
+		};
+
+		bool bImproved = 1, bOver = 0;
+		for(int iPass=0; bImproved && !bOver && iPass<PLAN_MAX_PASSES; ++iPass)
+		{
+			bImproved = 0;
+
+			for(std::size_t iPos=0; iPos<iNum; ++iPos)
+			{
+				// a single pass can take long, so also check within it
+				if(iPos % PLAN_CHUNK_SIZE == 0 && is_over())
+				{
+					bOver = 1;
+					break;
+				}
+
+				for(std::size_t iNeighbour=0; iNeighbour<iNumNeighbours; ++iNeighbour)
+				{
+					const std::size_t iCand = vecNeighbours[iPos*iNumNeighbours + iNeighbour];
+					const std::size_t i = vecPathIdx[iPos];
+					const std::size_t j = vecPathIdx[iCand];
+
+					// reverse the sub-path between the two positions to make them adjacent
+					std::size_t iBegin = 0, iEnd = 0;
+					if(j > i+1)
+					{
+						iBegin = i+1;
+						iEnd = j;
+					}
+					else if(i > j+1)
+					{
+						iBegin = j;
+						iEnd = i-1;
+					}
+					else
+					{
+						continue;
+					}
+
+					const std::size_t iPrev = path_at(iBegin), iNext = path_at(iEnd+2);
+					const t_real dOld = dist(iPrev, vecPath[iBegin]) + dist(vecPath[iEnd], iNext);
+					const t_real dNew = dist(iPrev, vecPath[iEnd]) + dist(vecPath[iBegin], iNext);
+					if(dNew < dOld - g_dEps)
+					{
+						reverse(iBegin, iEnd);
+						bImproved = 1;
+					}
+				}
+			}
+		}
+	}
+
+
+	if(pdTime)
+	{
+		*pdTime = t_real(0);
+		for(std::size_t iCur=0; iCur<vecPath.size(); ++iCur)
+			*pdTime += dist(iCur ? vecPath[iCur-1] : (pStart ? START : NONE), vecPath[iCur]);
+	}
+
+	// cancelled: append the positions which have not been visited
+	if(vecPath.size() != iNum)
+		vecPath.insert(vecPath.end(), vecRemaining.begin(), vecRemaining.end());
+
+	std::vector<std::size_t> vecOrder;
+	vecOrder.reserve(vecPos.size());
+	for(std::size_t iPos : vecPath)
+		vecOrder.push_back(vecUsable[iPos]);
+	vecOrder.insert(vecOrder.end(), vecUnusable.begin(), vecUnusable.end());
+	return vecOrder;
+}
@@ -0,0 +1,109 @@
+/**
+ * batch calculation and ordering of spectrometer positions
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __GOTO_PLANNER_H__
+#define __GOTO_PLANNER_H__
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <atomic>
+
+#include "tlibs/phys/lattice.h"
+#include "tlibs/math/linalg.h"
+#include "libs/globals.h"
+#include "libs/taskpool.h"
+#include "DeadAnglesDlg.h"
+
+
+// maximum number of positions in a list to be planned
+#define PLAN_MAX_POSITIONS	10000
+
+
+/**
+ * position in the goto list
+ */
+struct HklPos
+{
+	t_real_glob dh = 0, dk = 0, dl = 0;
+	t_real_glob dki = 0, dkf = 0;
+	t_real_glob dE = 0;
+};
+
+
+/**
+ * position with its spectrometer angles
+ */
+struct PlannedPos
+{
+	HklPos pos;
+
+	// angles in rad
+	t_real_glob dMono2Theta = 0, dAna2Theta = 0;
+	t_real_glob dSampleTheta = 0, dSample2Theta = 0;
+
+	// angles could be calculated
+	bool bReachable = 0;
+	// beam passes through a dead angle
+	bool bObstructed = 0;
+
+	std::string strErr;
+
+	bool IsOk() const { return bReachable && !bObstructed; }
+};
+
+
+/**
+ * result of a planning job
+ */
+struct PlanResult
+{
+	std::vector<PlannedPos> vecPos;
+	std::vector<std::size_t> vecOrder;
+	t_real_glob dTime = 0;
+};
+
+
+/**
+ * instrument settings for the planner
+ */
+struct PlannerParams
+{
+	tl::Lattice<t_real_glob> lattice;
+	ublas::vector<t_real_glob> vec1, vec2;
+
+	t_real_glob dMono = 3.355, dAna = 3.355;
+	bool bSenseM = 0, bSenseS = 1, bSenseA = 0;
+
+	// copy of the dead angles, the planning job must not access the dialog's ones
+	std::vector<DeadAngle<t_real_glob>> vecDeadAngles;
+
+	// motor speeds in deg/s: mono 2theta, sample theta, sample 2theta, ana 2theta
+	t_real_glob dSpeed[4] = { 1., 1., 1., 1. };
+};
+
+
+// reads positions from columns "h k l E" or "h k l ki kf", columns can be ranges "start:end:step"
+extern bool plan_load_positions(std::istream& istr, std::vector<HklPos>& vecPos,
+	t_real_glob dFixedK, bool bFixedKi, std::string* pstrErr = nullptr);
+
+// calculates the angles of all positions
+extern void plan_calc_angles(const PlannerParams& params, std::vector<PlannedPos>& vecPos,
+	TaskPool* pPool = nullptr, const std::atomic<bool>* pbStop = nullptr);
+
+// time to move from one position to another, with all motors moving at the same time
+extern t_real_glob plan_travel_time(const PlannerParams& params,
+	const PlannedPos& pos1, const PlannedPos& pos2);
+
+// order of the positions with short total travel time, unusable positions are put at the end
+extern std::vector<std::size_t> plan_order(const PlannerParams& params,
+	const std::vector<PlannedPos>& vecPos, const PlannedPos* pStart = nullptr,
+	t_real_glob* pdTime = nullptr, TaskPool* pPool = nullptr,
+	const std::atomic<bool>* pbStop = nullptr);
+
+
+#endif
@@ -13,6 +13,7 @@
 #include "libs/qt/qthelper.h"
 #include <chrono>
 #include <iostream>
+#include <sstream>
 
 using t_real = t_real_glob;
 
@@ -178,6 +179,22 @@ void NetCacheDlg::UpdateAge(int iRow)
 	tableCache->setSortingEnabled(1);
 }
 
+/**
+ * shows how many instrument updates were merged before being applied
+ */
+void NetCacheDlg::UpdateStats(unsigned iReceived, unsigned iApplied, unsigned iSuperseded)
+{
+	std::ostringstream ostr;
+	ostr << "Updates: " << iReceived << " received, " << iApplied << " applied";
+	if(iReceived > iApplied)
+		ostr << ", " << (iReceived - iApplied) << " merged";
+	if(iSuperseded)
+		ostr << ", " << iSuperseded << " values dropped";
+	ostr << ".";
+
+	labelStats->setText(ostr.str().c_str());
+}
+
 void NetCacheDlg::ClearAll()
 {
 	tableCache->clearContents();
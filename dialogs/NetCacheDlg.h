@@ -64,6 +64,7 @@ public slots:
 	void ClearAll();
 	void UpdateValue(const std::string& strKey, const CacheVal& val);
 	void UpdateAll(const t_mapCacheVal& map);
+	void UpdateStats(unsigned iReceived, unsigned iApplied, unsigned iSuperseded);
 
 //signals:
 //	void UpdatedValue(const std::string& strKey, const CacheVal& val);
@@ -135,6 +135,7 @@ SettingsDlg::SettingsDlg(QWidget* pParent, QSettings* pSett)
 		t_tupCheck("main/native_dialogs", 0, checkNativeDlg),
 		t_tupCheck("net/flip_orient2", 1, checkFlipOrient2),
 		t_tupCheck("net/sth_stt_corr", 0, checkSthSttCorr),
+		t_tupCheck("net/sics_interest", 1, checkSicsInterest),
 		t_tupCheck("main/ignore_xtal_restrictions", 0, checkIgnoreXtalRestrictions),
 	};
 
@@ -148,6 +149,8 @@ SettingsDlg::SettingsDlg(QWidget* pParent, QSettings* pSett)
 		t_tupSpin("main/max_threads", g_iMaxThreads, spinThreads),
 		t_tupSpin("gl/font_size", 24, spinGLFont),
 		t_tupSpin("net/poll", 750, spinNetPoll),
+		t_tupSpin("net/poll_max_interval", 16, spinNetPollMax),
+		t_tupSpin("net/update_window", 100, spinNetUpdateWindow),
 	};
 
 	m_vecCombos =
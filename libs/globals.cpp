@@ -6,10 +6,12 @@
  */
 
 #include "globals.h"
+#include "taskpool.h"
 #include "tlibs/log/log.h"
 #include "tlibs/file/file.h"
 #include "tlibs/string/string.h"
 #include "tlibs/helper/proc.h"
+#include "tlibs/math/rand.h"
 
 #include <thread>
 
@@ -47,12 +49,26 @@ t_real_glob g_dFontSize = 10.;
 
 unsigned int g_iMaxThreads = std::thread::hardware_concurrency();
 
+// number of processes for external (py, jl) S(q,w) models
+unsigned int g_iSqwProcs = 1;
+
 unsigned int get_max_threads()
 {
 	unsigned int iMaxThreads = std::thread::hardware_concurrency();
 	return std::min(iMaxThreads, g_iMaxThreads);
 }
 
+/**
+ * process-wide pool of worker threads, created on first use;
+ * the number of working threads follows the g_iMaxThreads setting
+ */
+TaskPool& get_task_pool()
+{
+	static TaskPool pool(std::thread::hardware_concurrency(), []{ tl::init_rand(); });
+	pool.SetNumActive(get_max_threads());
+	return pool;
+}
+
 // -----------------------------------------------------------------------------
 
 
@@ -23,6 +23,7 @@ extern t_real_glob g_dEps;
 extern t_real_glob g_dEpsGfx;
 
 extern unsigned int g_iMaxThreads;
+extern unsigned int g_iSqwProcs;
 
 extern std::size_t GFX_NUM_POINTS;
 extern std::size_t g_iMaxNN;
@@ -55,6 +56,9 @@ extern std::string find_file_in_global_paths(const std::string& strFile, bool bA
 
 extern unsigned int get_max_threads();
 
+class TaskPool;
+extern TaskPool& get_task_pool();
+
 extern std::string get_gpltool_version();
 
 #endif
@@ -0,0 +1,274 @@
+/**
+ * persistent work-stealing task pool
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __TAKIN_TASKPOOL_H__
+#define __TAKIN_TASKPOOL_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+/**
+ * pool of worker threads which are created once and live as long as the pool.
+ * each worker has its own task queue: tasks submitted from within a task are
+ * put into the worker's own queue, idle workers steal tasks from the others.
+ * waiting for a nested task with Wait() executes the worker's own queued tasks in the meantime.
+ */
+class TaskPool
+{
+public:
+	using t_task = std::function<void()>;
+	using t_startfunc = void(*)();
+
+protected:
+	struct Worker
+	{
+		std::deque<t_task> lstTasks;
+		std::mutex mtx;
+	};
+
+	std::vector<std::unique_ptr<Worker>> m_vecWorkers;
+	std::vector<std::thread> m_vecThreads;
+
+	// tasks submitted from threads not belonging to the pool
+	std::deque<t_task> m_lstInjected;
+	std::mutex m_mtx;
+	std::condition_variable m_cond;
+
+	std::atomic<std::size_t> m_iPending{0};
+	std::atomic<unsigned int> m_iNumActive{0};
+	bool m_bStop = false;
+
+protected:
+	/**
+	 * pool and worker index of the current thread
+	 */
+	static std::pair<const TaskPool*, std::size_t>& GetThreadWorker()
+	{
+		static thread_local std::pair<const TaskPool*, std::size_t> worker{nullptr, 0};
+		return worker;
+	}
+
+	/**
+	 * get the newest task from the worker's own queue
+	 */
+	bool TryPopOwn(std::size_t iSelf, t_task& task)
+	{
+		Worker& worker = *m_vecWorkers[iSelf];
+		std::lock_guard<std::mutex> lock(worker.mtx);
+		if(worker.lstTasks.empty())
+			return false;
+
+		task = std::move(worker.lstTasks.back());
+		worker.lstTasks.pop_back();
+		--m_iPending;
+		return true;
+	}
+
+	/**
+	 * get a task from the own queue (newest first), the injected queue or
+	 * steal one from another worker (oldest first)
+	 */
+	bool TryPop(const std::size_t* pSelf, t_task& task)
+	{
+		const std::size_t iNumWorkers = m_vecWorkers.size();
+
+		if(pSelf && TryPopOwn(*pSelf, task))
+			return true;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if(!m_lstInjected.empty())
+			{
+				task = std::move(m_lstInjected.front());
+				m_lstInjected.pop_front();
+				--m_iPending;
+				return true;
+			}
+		}
+
+		const std::size_t iStart = pSelf ? *pSelf+1 : 0;
+		for(std::size_t iOther=0; iOther<iNumWorkers; ++iOther)
+		{
+			Worker& victim = *m_vecWorkers[(iStart + iOther) % iNumWorkers];
+			std::lock_guard<std::mutex> lock(victim.mtx);
+			if(!victim.lstTasks.empty())
+			{
+				task = std::move(victim.lstTasks.front());
+				victim.lstTasks.pop_front();
+				--m_iPending;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void WorkerLoop(std::size_t iSelf, t_startfunc pStartFunc)
+	{
+		GetThreadWorker() = std::make_pair(this, iSelf);
+		if(pStartFunc)
+			(*pStartFunc)();
+
+		while(1)
+		{
+			t_task task;
+			if(iSelf < m_iNumActive.load() && TryPop(&iSelf, task))
+			{
+				task();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_cond.wait(lock, [this, iSelf]
+			{
+				return m_bStop || (m_iPending.load() && iSelf < m_iNumActive.load());
+			});
+
+			if(m_bStop && !m_iPending.load())
+				return;
+		}
+	}
+
+public:
+	TaskPool(unsigned int iNumThreads, t_startfunc pStartFunc = nullptr)
+	{
+		if(iNumThreads == 0)
+			iNumThreads = 1;
+		m_iNumActive = iNumThreads;
+
+		m_vecWorkers.reserve(iNumThreads);
+		for(unsigned int iThread=0; iThread<iNumThreads; ++iThread)
+			m_vecWorkers.emplace_back(new Worker());
+
+		m_vecThreads.reserve(iNumThreads);
+		for(unsigned int iThread=0; iThread<iNumThreads; ++iThread)
+			m_vecThreads.emplace_back(&TaskPool::WorkerLoop, this, std::size_t(iThread), pStartFunc);
+	}
+
+	~TaskPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_bStop = true;
+			m_iNumActive = m_vecThreads.size();
+		}
+		m_cond.notify_all();
+
+		for(std::thread& th : m_vecThreads)
+			th.join();
+	}
+
+	TaskPool(const TaskPool&) = delete;
+	const TaskPool& operator=(const TaskPool&) = delete;
+
+	unsigned int GetNumThreads() const { return m_vecThreads.size(); }
+	unsigned int GetNumActive() const { return m_iNumActive.load(); }
+
+	/**
+	 * limit the number of workers which execute tasks, the others stay idle
+	 */
+	void SetNumActive(unsigned int iNum)
+	{
+		if(iNum == 0)
+			iNum = 1;
+		if(iNum > m_vecThreads.size())
+			iNum = m_vecThreads.size();
+		if(iNum == m_iNumActive.load())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_iNumActive = iNum;
+		}
+		m_cond.notify_all();
+	}
+
+	/**
+	 * is the current thread one of the pool's workers?
+	 */
+	bool IsWorkerThread() const { return GetThreadWorker().first == this; }
+
+	/**
+	 * queue a function for execution, the result is returned via the future
+	 */
+	template<class t_func>
+	std::future<typename std::result_of<t_func()>::type> Submit(t_func&& func)
+	{
+		using t_ret = typename std::result_of<t_func()>::type;
+
+		auto pTask = std::make_shared<std::packaged_task<t_ret()>>(std::forward<t_func>(func));
+		std::future<t_ret> fut = pTask->get_future();
+		t_task task = [pTask]{ (*pTask)(); };
+
+		const std::pair<const TaskPool*, std::size_t>& worker = GetThreadWorker();
+		++m_iPending;
+		if(worker.first == this)
+		{
+			// nested task: put into the worker's own queue
+			Worker& self = *m_vecWorkers[worker.second];
+			{
+				std::lock_guard<std::mutex> lock(self.mtx);
+				self.lstTasks.emplace_back(std::move(task));
+			}
+
+			// synchronise with sleeping workers
+			std::lock_guard<std::mutex> lock(m_mtx);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_lstInjected.emplace_back(std::move(task));
+		}
+
+		// notify_one could wake an inactive worker whose wait predicate stays
+		// false, in which case the wakeup would get lost
+		m_cond.notify_all();
+
+		return fut;
+	}
+
+	/**
+	 * wait for a task's result; inside a worker thread, the tasks in the worker's
+	 * own queue are executed while waiting to prevent the pool from deadlocking.
+	 * these were submitted by the waiting task (or its callers) itself, tasks of
+	 * other jobs are not picked up, so a nested wait does not get stuck behind them.
+	 * fut has to belong to a task submitted from the same thread: once the own queue
+	 * is empty, the awaited task is already being run by another worker.
+	 */
+	template<class T>
+	T Wait(std::future<T>& fut)
+	{
+		std::pair<const TaskPool*, std::size_t> worker = GetThreadWorker();
+		if(worker.first == this)
+		{
+			while(fut.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+			{
+				t_task task;
+				if(!TryPopOwn(worker.second, task))
+					break;
+				task();
+			}
+		}
+
+		// block until the task has finished
+		return fut.get();
+	}
+};
+
+
+#endif
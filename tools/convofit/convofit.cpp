@@ -24,6 +24,7 @@ namespace fs = boost::filesystem;
 #include "model.h"
 #include "../monteconvo/sqwfactory.h"
 #include "../res/defs.h"
+#include "libs/globals.h"
 
 
 //using t_real = tl::t_real_min;
@@ -141,9 +142,6 @@ bool Convofit::run_job(const std::string& _strJob)
 	}
 
 
-	const unsigned iSeed = tl::get_rand_seed();
-	tl::init_rand_seed(iSeed);
-
 	// Parameters
 	tl::Prop<std::string> prop;
 	if(!prop.Load(strJob.c_str(), tl::PropType::INFO))
@@ -152,6 +150,11 @@ bool Convofit::run_job(const std::string& _strJob)
 		return 0;
 	}
 
+	// a given seed reproduces the fit
+	const unsigned iSeed = prop.Query<unsigned>("montecarlo/seed", tl::get_rand_seed());
+	tl::init_rand_seed(iSeed);
+	tl::log_info("Random seed: ", iSeed, ".");
+
 	std::string strScFile = prop.Query<std::string>("input/scan_file");
 	if(strScFile == "")	// "scan_file_0" is synonymous to "scan_file"
 		strScFile = prop.Query<std::string>("input/scan_file_0");
@@ -175,6 +178,7 @@ bool Convofit::run_job(const std::string& _strJob)
 	std::string strSetParams = prop.Query<std::string>("input/sqw_set_params", "");
 	bool bNormToMon = prop.Query<bool>("input/norm_to_monitor", 1);
 	bool bFlipCoords = prop.Query<bool>("input/flip_lhs_rhs", 0);
+	unsigned int iSqwProcs = prop.Query<unsigned>("input/sqw_processes", 1);
 	bool bUseFirstAndLastScanPt = prop.Query<bool>("input/use_first_last_pt", 0);
 	unsigned iScanAxis = prop.Query<unsigned>("input/scan_axis", 0);
 
@@ -249,11 +253,31 @@ bool Convofit::run_job(const std::string& _strJob)
 	unsigned iNumNeutrons = prop.Query<unsigned>("montecarlo/neutrons", 1000);
 	unsigned iNumSample = prop.Query<unsigned>("montecarlo/sample_positions", 1);
 	bool bRecycleMC = prop.Query<bool>("montecarlo/recycle_neutrons", 1);
+	bool bFrozenSample = prop.Query<bool>("montecarlo/frozen_sample", 0);
+	unsigned iMaxFrozen = prop.Query<unsigned>("montecarlo/frozen_sample_max", 256);
+	bool bParallelScans = prop.Query<bool>("montecarlo/parallel_scans", 0);
+	std::string strSampler = prop.Query<std::string>("montecarlo/sampler", "pseudo");
+	bool bRandStreams = prop.Query<bool>("montecarlo/rand_streams", 0);
 
 	if(g_iNumNeutrons > 0)
 		iNumNeutrons = g_iNumNeutrons;
 
+	// adaptive mode: "neutrons" is the batch size, which is repeated until the target error is reached
+	bool bAdaptiveMC = prop.Query<bool>("montecarlo/adaptive", 0);
+	AdaptiveConvoOpts adaptiveOpts;
+	adaptiveOpts.iBatch = iNumNeutrons;
+	adaptiveOpts.iMaxNeutrons = prop.Query<unsigned>("montecarlo/max_neutrons", 10*iNumNeutrons);
+	adaptiveOpts.dTargetErr = prop.Query<t_real>("montecarlo/target_error", 0.01);
+	adaptiveOpts.dImportanceFrac = prop.Query<t_real>("montecarlo/importance_fraction", 0.5);
+	adaptiveOpts.dImportanceWidth = prop.Query<t_real>("montecarlo/importance_width", 0.2);
+
+	// gauss-hermite quadrature instead of MC for models providing their dispersion
+	bool bQuadrature = prop.Query<bool>("montecarlo/quadrature", 0);
+	unsigned iQuadOrder = prop.Query<unsigned>("montecarlo/quadrature_order", 5);
+	t_real dQuadTol = prop.Query<t_real>("montecarlo/quadrature_tolerance", 0.05);
+
 	std::string strResAlgo = prop.Query<std::string>("resolution/algorithm", "pop");
+	bool bCacheReso = prop.Query<bool>("resolution/cache", 1);
 
 	// -1: unchanged (use curvature value from reso file), 0: flat, 1: optimal
 	int iResFocMonoV = prop.Query<int>("resolution/focus_mono_v", -1);
@@ -491,6 +515,16 @@ bool Convofit::run_job(const std::string& _strJob)
 			reso.SetOptimalFocus(ResoFocus(ifocMode));
 		}
 
+		if(strSampler == "pseudo")
+			reso.SetSampler(McSampler::PSEUDO);
+		else if(strSampler == "sobol")
+			reso.SetSampler(McSampler::SOBOL);
+		else
+		{
+			tl::log_err("Invalid MC sampler selected: \"", strSampler, "\".");
+			return 0;
+		}
+
 		reso.SetRandomSamplePos(iNumSample);
 		vecResos.emplace_back(std::move(reso));
 	}
@@ -504,6 +538,7 @@ bool Convofit::run_job(const std::string& _strJob)
 	// --------------------------------------------------------------------
 	// Model file
 	tl::log_info("Loading S(q,w) file \"", strSqwFile, "\".");
+	g_iSqwProcs = iSqwProcs;
 	std::shared_ptr<SqwBase> pSqw = construct_sqw(strSqwMod, strSqwFile);
 
 	if(!pSqw)
@@ -543,7 +578,7 @@ bool Convofit::run_job(const std::string& _strJob)
 		}
 	});
 	mod.AddParamsChangedSlot(
-	[&vecModTmpX, &vecModTmpY, bPlotIntermediate, iSeed, bRecycleMC](const std::string& strDescr)
+	[&vecModTmpX, &vecModTmpY, bPlotIntermediate, iSeed, bRecycleMC, bRandStreams](const std::string& strDescr)
 	{
 		tl::log_info("Changed model parameters: ", strDescr);
 
@@ -554,7 +589,8 @@ bool Convofit::run_job(const std::string& _strJob)
 		}
 
 		// do we use the same MC neutrons again?
-		if(bRecycleMC)
+		// (the random streams are seeded per scan point instead)
+		if(bRecycleMC && !bRandStreams)
 		{
 			tl::init_rand_seed(iSeed);
 			tl::log_debug("Resetting random seed to ", iSeed, ".");
@@ -565,11 +601,48 @@ bool Convofit::run_job(const std::string& _strJob)
 	// only needed for multi-fits
 	if(vecSc.size() > 1)
 		mod.SetScans(&vecSc);
+	mod.SetEvalScans(&vecSc);
 
 	tl::log_info("Number of neutrons: ", iNumNeutrons, ".");
 	mod.SetNumNeutrons(iNumNeutrons);
-	// execution has to be in a determined order to recycle the same neutrons
-	mod.SetUseThreads(!bRecycleMC);
+	// execution has to be in a determined order to recycle the same neutrons,
+	// frozen samples and random streams are independent of the order
+	mod.SetUseThreads(!bRecycleMC || bFrozenSample || bRandStreams);
+	if(bRandStreams)
+		tl::log_info("Using per-point random streams, independent of the number of threads.");
+	mod.SetRandStreams(bRandStreams, iSeed, bRecycleMC);
+	if(strSampler == "sobol")
+		tl::log_info("Using scrambled Sobol quasi-random numbers.");
+	if(bFrozenSample)
+		tl::log_info("Using frozen MC samples (common random numbers).");
+	mod.SetFrozenSample(bFrozenSample, iMaxFrozen);
+	if(bAdaptiveMC)
+	{
+		tl::log_info("Using adaptive MC with a target relative error of ", adaptiveOpts.dTargetErr,
+			" and at most ", adaptiveOpts.iMaxNeutrons, " neutrons.");
+		if(bFrozenSample)
+			tl::log_warn("Frozen MC samples are not used in adaptive mode.");
+	}
+	mod.SetAdaptive(bAdaptiveMC, adaptiveOpts);
+	if(bQuadrature)
+	{
+		iQuadOrder = std::min<unsigned>(std::max<unsigned>(iQuadOrder, 1), RESO_QUAD_MAX_ORDER);
+		tl::log_info("Using Gauss-Hermite quadrature of order ", iQuadOrder,
+			" (", iQuadOrder*iQuadOrder*iQuadOrder*iQuadOrder, " nodes) where possible.");
+	}
+	mod.SetQuadrature(bQuadrature, iQuadOrder, dQuadTol);
+	mod.SetParallelScans(bParallelScans);
+	if(bParallelScans && (!bRecycleMC || bFrozenSample || bRandStreams))
+		tl::log_info("Evaluating all scan points in parallel using ", get_max_threads(), " threads.");
+	// a cached resolution would keep the randomly drawn sample positions of each
+	// scan point, so only use the cache for them if they are explicitly frozen
+	if(bCacheReso && iNumSample > 1 && !bFrozenSample)
+	{
+		tl::log_info("Not caching the resolution because of the random sample positions, ",
+			"set \"montecarlo/frozen_sample\" to cache them.");
+		bCacheReso = 0;
+	}
+	mod.SetCacheReso(bCacheReso);
 
 	if(bTempOverride)
 	{
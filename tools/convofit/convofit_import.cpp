@@ -8,6 +8,7 @@
 #include "convofit_import.h"
 #include "tlibs/file/tmp.h"
 #include "../res/defs.h"
+#include "../monteconvo/convo_adaptive.h"
 
 #include <map>
 #include <boost/filesystem.hpp>
@@ -102,6 +103,14 @@ std::string convert_monteconvo(
 		propMC.Query<std::string>("taz/monteconvo/sample_step_count", "1");
 	mapJob["montecarlo/recycle_neutrons"] =
 		propMC.Query<std::string>("taz/convofit/recycle_neutrons", "1");
+	mapJob["montecarlo/adaptive"] =
+		propMC.Query<std::string>("taz/monteconvo/adaptive", "0");
+	mapJob["montecarlo/target_error"] =
+		tl::var_to_str(propMC.Query<t_real>("taz/monteconvo/target_error", 1.) / t_real(100.));
+	mapJob["montecarlo/max_neutrons"] =
+		tl::var_to_str(propMC.Query<unsigned>("taz/monteconvo/neutron_count", 1000) * CONVO_ADAPTIVE_MAX_BATCHES);
+	mapJob["montecarlo/sampler"] =
+		propMC.Query<bool>("taz/monteconvo/sobol", 0) ? "sobol" : "pseudo";
 
 	// fitting
 	std::string strMin = "simplex";
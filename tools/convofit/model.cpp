@@ -6,6 +6,8 @@
  */
 
 #include <fstream>
+#include <algorithm>
+#include <future>
 
 #include "model.h"
 #include "tlibs/math/math.h"
@@ -15,6 +17,8 @@
 #include "tlibs/helper/array.h"
 #include "../res/defs.h"
 #include "../res/helper.h"
+#include "libs/globals.h"
+#include "libs/taskpool.h"
 #include "convofit.h"
 
 using t_real = t_real_mod;
@@ -23,11 +27,17 @@ using t_real = t_real_mod;
 
 SqwFuncModel::SqwFuncModel(std::shared_ptr<SqwBase> pSqw, const TASReso& reso)
 	: m_pSqw(pSqw)/*, m_reso(reso)*/, m_vecResos({reso})
-{}
+{
+	ClearResoCache();
+	ClearEvalCache();
+}
 
 SqwFuncModel::SqwFuncModel(std::shared_ptr<SqwBase> pSqw, const std::vector<TASReso>& vecResos)
 	: m_pSqw(pSqw), m_vecResos(vecResos)
-{}
+{
+	ClearResoCache();
+	ClearEvalCache();
+}
 
 
 TASReso* SqwFuncModel::GetTASReso()
@@ -48,7 +58,7 @@ const TASReso* SqwFuncModel::GetTASReso() const
 }
 
 
-bool SqwFuncModel::SetTASPos(t_real dPrincipalX, TASReso& reso) const
+bool SqwFuncModel::SetTASPos(t_real dPrincipalX, TASReso& reso, const PhiloxStream* pStream) const
 {
 	const t_real xrange = t_real(m_dPrincipalAxisMax - m_dPrincipalAxisMin);
 	const t_real xscale = (t_real(dPrincipalX) - t_real(m_dPrincipalAxisMin)) / xrange;
@@ -56,7 +66,7 @@ bool SqwFuncModel::SetTASPos(t_real dPrincipalX, TASReso& reso) const
 	const ublas::vector<t_real> vecScanPos = m_vecScanOrigin + xscale*m_vecScanDir;
 	//tl::log_debug("Scan pos: ", vecScanPos, "(origin: ", m_vecScanOrigin, ", dir: ", m_vecScanDir, "), run param: ", dPrincipalX);
 
-	if(!reso.SetHKLE(vecScanPos[0], vecScanPos[1], vecScanPos[2], vecScanPos[3]))
+	if(!reso.SetHKLE(vecScanPos[0], vecScanPos[1], vecScanPos[2], vecScanPos[3], pStream))
 	{
 		std::ostringstream ostrErr;
 		ostrErr << "Invalid crystal position: ("
@@ -69,37 +79,287 @@ bool SqwFuncModel::SetTASPos(t_real dPrincipalX, TASReso& reso) const
 }
 
 
-tl::t_real_min SqwFuncModel::operator()(tl::t_real_min x_principal) const
+/**
+ * enables or disables the reuse of the same random numbers for every evaluation,
+ * keeping the random numbers for at most iMaxFrozen scan positions
+ */
+void SqwFuncModel::SetFrozenSample(bool b, std::size_t iMaxFrozen)
 {
-	TASReso/*&*/ reso = *GetTASReso();
-	if(!SetTASPos(t_real_mod(x_principal), reso))
-		return 0.;
+	m_bFrozenSample = b;
+	m_iMaxFrozen = std::max<std::size_t>(iMaxFrozen, 1);
 
-	const t_real xrange = t_real(m_dPrincipalAxisMax - m_dPrincipalAxisMin);
-	const t_real xscale = (t_real(x_principal) - t_real(m_dPrincipalAxisMin)) / xrange;
+	if(m_bFrozenSample)
+	{
+		m_pmapFrozen = std::make_shared<std::map<t_frozenkey, t_frozenval>>();
+		m_plstFrozen = std::make_shared<t_frozenlist>();
+		m_pmtxFrozen = std::make_shared<std::mutex>();
+	}
+	else
+	{
+		m_pmapFrozen.reset();
+		m_plstFrozen.reset();
+		m_pmtxFrozen.reset();
+	}
+
+	ClearEvalCache();
+}
+
+
+/**
+ * enables or disables counter-based random streams,
+ * if bRecycle is set, the same random numbers are used for every evaluation
+ */
+void SqwFuncModel::SetRandStreams(bool b, std::uint64_t iSeed, bool bRecycle)
+{
+	m_bRandStreams = b;
+	m_iRandSeed = iSeed;
+	m_bRecycleStreams = bRecycle;
+	m_iEvalIdx = 0;
+	m_pEvalCounter = std::make_shared<std::atomic<std::uint64_t>>(0);
+
+	ClearResoCache();
+	ClearEvalCache();
+}
+
+
+/**
+ * random stream for scan position dX of the current scan group,
+ * which also depends on the evaluation if bPerEval is set and the neutrons are not recycled
+ */
+PhiloxStream SqwFuncModel::GetRandStream(t_real dX, bool bPerEval) const
+{
+	PhiloxStream stream = PhiloxStream(m_iRandSeed)
+		.Split(m_iCurParamSet)
+		.Split(PhiloxStream::HashValue(dX));
+
+	if(bPerEval && !m_bRecycleStreams)
+		stream = stream.Split(m_iEvalIdx);
+	return stream;
+}
+
+
+/**
+ * get the frozen random numbers for scan position dX, draw them on first use;
+ * positions which have not been used for a while (e.g. plot points) are dropped,
+ * with random streams they are drawn again identically if needed
+ */
+std::shared_ptr<const McFrozenSample> SqwFuncModel::GetFrozenSample(t_real dX, const TASReso& reso) const
+{
+	if(!m_bFrozenSample || !m_pmapFrozen)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(*m_pmtxFrozen);
+
+	t_frozenkey key = std::make_pair(m_iCurParamSet, dX);
+	auto iter = m_pmapFrozen->find(key);
+	if(iter != m_pmapFrozen->end())
+	{
+		// mark as most recently used
+		m_plstFrozen->splice(m_plstFrozen->begin(), *m_plstFrozen, iter->second.second);
+		return iter->second.first;
+	}
+
+	std::shared_ptr<McFrozenSample> pFrozen;
+	if(m_bRandStreams)
+	{
+		const PhiloxStream stream = GetRandStream(dX, false);
+		pFrozen = reso.CreateFrozenSample(m_iNumNeutrons, &stream);
+	}
+	else
+	{
+		pFrozen = reso.CreateFrozenSample(m_iNumNeutrons);
+	}
+
+	// drop the least recently used positions
+	while(m_plstFrozen->size() >= m_iMaxFrozen)
+	{
+		m_pmapFrozen->erase(m_plstFrozen->back());
+		m_plstFrozen->pop_back();
+	}
 
-	const ublas::vector<t_real> vecScanPos = m_vecScanOrigin + t_real(xscale)*m_vecScanDir;
-	std::vector<ublas::vector<t_real_reso>> vecNeutrons;
-	Ellipsoid4d<t_real_reso> elli;
-	if(m_bUseThreads)
-		elli = reso.GenerateMC(m_iNumNeutrons, vecNeutrons);
+	m_plstFrozen->push_front(key);
+	m_pmapFrozen->insert(std::make_pair(key, std::make_pair(pFrozen, m_plstFrozen->begin())));
+	return pFrozen;
+}
+
+
+/**
+ * enables or disables caching of the resolution calculation at each scan position
+ */
+void SqwFuncModel::SetCacheReso(bool b)
+{
+	m_bCacheReso = b;
+	ClearResoCache();
+}
+
+
+/**
+ * invalidates the resolution cache, e.g. if instrument or lattice parameters have changed
+ */
+void SqwFuncModel::ClearResoCache()
+{
+	if(m_bCacheReso)
+	{
+		m_pmapReso = std::make_shared<std::map<t_resokey, std::shared_ptr<const TASReso>>>();
+		m_pmtxReso = std::make_shared<std::mutex>();
+	}
 	else
-		elli = reso.GenerateMC_deferred(m_iNumNeutrons, vecNeutrons);
+	{
+		m_pmapReso.reset();
+		m_pmtxReso.reset();
+	}
+}
+
+
+/**
+ * get the resolution at scan position dX, either from the cache or by calculating it
+ */
+std::shared_ptr<const TASReso> SqwFuncModel::GetTASResoAtPos(t_real dX) const
+{
+	const t_real xrange = t_real(m_dPrincipalAxisMax - m_dPrincipalAxisMin);
+	const t_real xscale = (t_real(dX) - t_real(m_dPrincipalAxisMin)) / xrange;
+	const ublas::vector<t_real> vecScanPos = m_vecScanOrigin + xscale*m_vecScanDir;
+
+	t_resokey key = std::make_tuple(m_iCurParamSet,
+		vecScanPos[0], vecScanPos[1], vecScanPos[2], vecScanPos[3]);
+
+	if(m_bCacheReso && m_pmapReso)
+	{
+		std::lock_guard<std::mutex> lock(*m_pmtxReso);
+
+		auto iter = m_pmapReso->find(key);
+		if(iter != m_pmapReso->end())
+			return iter->second;
+	}
+
+	std::shared_ptr<TASReso> pReso = std::make_shared<TASReso>(*GetTASReso());
+	if(m_bFrozenSample)
+		pReso->SetFrozenSample(GetFrozenSample(dX, *pReso));
+
+	const PhiloxStream stream = GetRandStream(dX);
+	if(!SetTASPos(dX, *pReso, m_bRandStreams ? &stream : nullptr))
+		return nullptr;
+
+	if(m_bCacheReso && m_pmapReso)
+	{
+		std::lock_guard<std::mutex> lock(*m_pmtxReso);
+		m_pmapReso->insert(std::make_pair(key, pReso));
+	}
+
+	return pReso;
+}
+
+
+/**
+ * invalidates the evaluated scan points, e.g. if the fit parameters have changed
+ */
+void SqwFuncModel::ClearEvalCache()
+{
+	m_pmapEval = std::make_shared<std::map<t_evalkey, t_real_mod>>();
+	m_pmtxEval = std::make_shared<std::mutex>();
+}
+
+
+/**
+ * convolution of S(q,w) with the resolution at scan position dX by gauss-hermite quadrature
+ * in the principal-axis frame of the resolution ellipsoid, summed over the sample positions;
+ * returns false if the model does not provide its dispersion or the quadrature is not converged
+ */
+bool SqwFuncModel::EvalQuadrature(t_real dX, const TASReso& reso, t_real& dS) const
+{
+	const t_real xrange = t_real(m_dPrincipalAxisMax - m_dPrincipalAxisMin);
+	const t_real xscale = (t_real(dX) - t_real(m_dPrincipalAxisMin)) / xrange;
+	const ublas::vector<t_real> vecScanPos = m_vecScanOrigin + xscale*m_vecScanDir;
+
+	// opaque model: nothing is known about its line shapes
+	if(std::get<0>(m_pSqw->disp(vecScanPos[0], vecScanPos[1], vecScanPos[2])).empty())
+		return false;
+
+	auto quad = [this, &reso](unsigned int iOrder) -> t_real
+	{
+		McNeutronBatch<t_real_reso> batch;
+		std::vector<t_real_reso> vecWeights;
+		reso.GenerateQuadrature(iOrder, batch, vecWeights);
+
+		const std::size_t iNumNodes = batch.size();
+		std::vector<t_real_reso> vecS(iNumNodes);
+		m_pSqw->SqwBatch(batch.vecH.data(), batch.vecK.data(), batch.vecL.data(), batch.vecE.data(),
+			vecS.data(), iNumNodes);
+
+		t_real dSum = 0.;
+		for(std::size_t iNode=0; iNode<iNumNodes; ++iNode)
+			dSum += t_real(vecWeights[iNode] * vecS[iNode]);
+		return dSum;
+	};
+
+	dS = quad(m_iQuadOrder);
+
+	// compare with the next-lower order, line shapes which are sharp compared
+	// to the resolution cannot be resolved by the nodes
+	if(m_dQuadTol > t_real(0) && m_iQuadOrder > 1)
+	{
+		const t_real dSLower = quad(m_iQuadOrder - 1);
+		if(std::abs(dS - dSLower) > m_dQuadTol * std::abs(dS))
+		{
+			tl::log_debug("Quadrature not converged at x = ", dX, ", using MC.");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * convolution of S(q,w) with the resolution at scan position dX
+ */
+t_real_mod SqwFuncModel::EvalPoint(t_real_mod x_principal, bool bUseThreads) const
+{
+	std::shared_ptr<const TASReso> pReso = GetTASResoAtPos(x_principal);
+	if(!pReso)
+		return 0.;
+	const TASReso& reso = *pReso;
+
+	const PhiloxStream stream = GetRandStream(x_principal);
+	const PhiloxStream *pStream = m_bRandStreams ? &stream : nullptr;
 
 	t_real dS = 0.;
-	t_real dhklE_mean[4] = {0., 0., 0., 0.};
 
-	for(const ublas::vector<t_real_reso>& vecHKLE : vecNeutrons)
+	t_real dSQuad = 0.;
+	if(m_bQuadrature && EvalQuadrature(x_principal, reso, dSQuad))
 	{
-		dS += t_real((*m_pSqw)(vecHKLE[0], vecHKLE[1], vecHKLE[2], vecHKLE[3]));
+		// the weights of each sample position sum to one, as the MC neutrons
+		dS = dSQuad;
+	}
+	else if(m_bAdaptive)
+	{
+		AdaptiveConvoResult res;
+		if(!convolve_adaptive(reso, *m_pSqw, m_adaptiveOpts, bUseThreads, res, nullptr, pStream))
+			return 0.;
 
-		for(int i=0; i<4; ++i)
-			dhklE_mean[i] += t_real(vecHKLE[i]);
+		// same normalisation as for a fixed neutron count, which sums over the sample positions
+		dS = res.dS * t_real(reso.GetNumSamplePos());
 	}
+	else
+	{
+		McNeutronBatch<t_real_reso> batch;
+		Ellipsoid4d<t_real_reso> elli;
+		if(bUseThreads)
+			elli = reso.GenerateMC(m_iNumNeutrons, batch, pStream);
+		else
+			elli = reso.GenerateMC_deferred(m_iNumNeutrons, batch, pStream);
 
-	dS /= t_real(m_iNumNeutrons);
-	for(int i=0; i<4; ++i)
-		dhklE_mean[i] /= t_real(m_iNumNeutrons);
+		const std::size_t iNumBatch = batch.size();
+		const t_real_reso *pH = batch.vecH.data(), *pK = batch.vecK.data();
+		const t_real_reso *pL = batch.vecL.data(), *pE = batch.vecE.data();
+
+		std::vector<t_real_reso> vecS(iNumBatch);
+		m_pSqw->SqwBatch(pH, pK, pL, pE, vecS.data(), iNumBatch);
+		for(t_real_reso dSNeutr : vecS)
+			dS += t_real(dSNeutr);
+
+		dS /= t_real(m_iNumNeutrons);
+	}
 
 	if(reso.GetResoParams().flags & CALC_R0)
 		dS *= reso.GetResoResults().dR0;
@@ -111,8 +371,116 @@ tl::t_real_min SqwFuncModel::operator()(tl::t_real_min x_principal) const
 	if(dYVal < 0.)
 		dYVal = 0.;
 
+	return dYVal;
+}
+
+
+/**
+ * evaluates all points of the current scan group on the task pool,
+ * for multi-fits also all other scan groups if the S(q,w) model can be copied independently
+ */
+bool SqwFuncModel::EvalScans() const
+{
+	if(!m_pEvalScans || m_iCurParamSet >= m_pEvalScans->size())
+		return false;
+
+	std::vector<std::size_t> vecSets = { m_iCurParamSet };
+	if(m_pScans && m_pSqw->HasIndependentCopies())
+	{
+		for(std::size_t iSet=0; iSet<m_pEvalScans->size(); ++iSet)
+			if(iSet != m_iCurParamSet)
+				vecSets.push_back(iSet);
+	}
+
+	// the other scan groups are evaluated on model copies,
+	// which have to exist until all tasks are finished
+	std::vector<std::unique_ptr<SqwFuncModel>> vecMods;
+	std::vector<std::tuple<std::size_t, t_real_mod, std::future<t_real_mod>>> vecFuts;
+	TaskPool& pool = get_task_pool();
+
+	for(std::size_t iSet : vecSets)
+	{
+		const SqwFuncModel *pMod = this;
+		if(iSet != m_iCurParamSet)
+		{
+			SqwFuncModel *pCopy = copy();
+			pCopy->m_psigFuncResult.reset();
+			pCopy->m_psigParamsChanged.reset();
+			pCopy->SetParamSet(iSet);
+			vecMods.emplace_back(pCopy);
+			pMod = pCopy;
+		}
+
+		for(t_real_mod dX : (*m_pEvalScans)[iSet].vecX)
+		{
+			vecFuts.emplace_back(std::make_tuple(iSet, dX,
+				pool.Submit([pMod, dX]() -> t_real_mod
+				{
+					// neutron generation fans out into nested tasks
+					return pMod->EvalPoint(dX, true);
+				})));
+		}
+	}
+
+	std::vector<t_real_mod> vecY;
+	vecY.reserve(vecFuts.size());
+	for(auto& tupFut : vecFuts)
+		vecY.push_back(pool.Wait(std::get<2>(tupFut)));
+
+	std::lock_guard<std::mutex> lock(*m_pmtxEval);
+	for(std::size_t iFut=0; iFut<vecFuts.size(); ++iFut)
+	{
+		t_evalkey key = std::make_pair(std::get<0>(vecFuts[iFut]), std::get<1>(vecFuts[iFut]));
+		(*m_pmapEval)[key] = vecY[iFut];
+	}
+
+	return true;
+}
+
+
+tl::t_real_min SqwFuncModel::operator()(tl::t_real_min x_principal) const
+{
+	const t_real_mod dX = t_real_mod(x_principal);
+	const t_evalkey key = std::make_pair(m_iCurParamSet, dX);
+	t_real dYVal = 0.;
+	bool bHasVal = false;
+
+	// is x one of the scan points which are evaluated all at once?
+	bool bScanPoint = false;
+	if(m_bParallelScans && m_bUseThreads && m_pEvalScans && m_iCurParamSet < m_pEvalScans->size())
+	{
+		const std::vector<t_real_mod>& vecX = (*m_pEvalScans)[m_iCurParamSet].vecX;
+		bScanPoint = (std::find(vecX.begin(), vecX.end(), dX) != vecX.end());
+	}
+
+	if(bScanPoint)
+	{
+		auto lookup = [this, &key, &dYVal]() -> bool
+		{
+			std::lock_guard<std::mutex> lock(*m_pmtxEval);
+			auto iter = m_pmapEval->find(key);
+			if(iter == m_pmapEval->end())
+				return false;
+			dYVal = iter->second;
+			return true;
+		};
+
+		bHasVal = lookup();
+		if(!bHasVal && EvalScans())
+			bHasVal = lookup();
+	}
+
+	if(!bHasVal)
+		dYVal = EvalPoint(dX, m_bUseThreads);
+
 	if(m_psigFuncResult)
+	{
+		const t_real xrange = t_real(m_dPrincipalAxisMax - m_dPrincipalAxisMin);
+		const t_real xscale = (t_real(x_principal) - t_real(m_dPrincipalAxisMin)) / xrange;
+		const ublas::vector<t_real> vecScanPos = m_vecScanOrigin + t_real(xscale)*m_vecScanDir;
+
 		(*m_psigFuncResult)(vecScanPos[0], vecScanPos[1], vecScanPos[2], vecScanPos[3], dYVal);
+	}
 	return tl::t_real_min(dYVal);
 }
 
@@ -127,7 +495,27 @@ SqwFuncModel* SqwFuncModel::copy() const
 	pMod->m_dPrincipalAxisMin = this->m_dPrincipalAxisMin;
 	pMod->m_dPrincipalAxisMax = this->m_dPrincipalAxisMax;
 	pMod->m_iNumNeutrons = this->m_iNumNeutrons;
+	pMod->m_bAdaptive = this->m_bAdaptive;
+	pMod->m_adaptiveOpts = this->m_adaptiveOpts;
+	pMod->m_bQuadrature = this->m_bQuadrature;
+	pMod->m_iQuadOrder = this->m_iQuadOrder;
+	pMod->m_dQuadTol = this->m_dQuadTol;
 	pMod->m_bUseThreads = this->m_bUseThreads;
+	pMod->m_bFrozenSample = this->m_bFrozenSample;
+	pMod->m_iMaxFrozen = this->m_iMaxFrozen;
+	pMod->m_pmapFrozen = this->m_pmapFrozen;
+	pMod->m_plstFrozen = this->m_plstFrozen;
+	pMod->m_pmtxFrozen = this->m_pmtxFrozen;
+	pMod->m_bRandStreams = this->m_bRandStreams;
+	pMod->m_bRecycleStreams = this->m_bRecycleStreams;
+	pMod->m_iRandSeed = this->m_iRandSeed;
+	pMod->m_iEvalIdx = this->m_iEvalIdx;
+	pMod->m_pEvalCounter = this->m_pEvalCounter;
+	pMod->m_bCacheReso = this->m_bCacheReso;
+	pMod->m_pmapReso = this->m_pmapReso;
+	pMod->m_pmtxReso = this->m_pmtxReso;
+	pMod->m_bParallelScans = this->m_bParallelScans;
+	pMod->m_pEvalScans = this->m_pEvalScans;
 	pMod->m_dScale = this->m_dScale;
 	pMod->m_dSlope = this->m_dSlope;
 	pMod->m_dOffs = this->m_dOffs;
@@ -236,6 +624,11 @@ bool SqwFuncModel::SetParams(const std::vector<tl::t_real_min>& vecParams)
 	//	tl::log_debug(d);
 
 	SetModelParams();
+	ClearEvalCache();
+
+	// new random streams for the new parameters; the minimiser sets them sequentially
+	if(m_pEvalCounter)
+		m_iEvalIdx = (*m_pEvalCounter)++;
 	return true;
 }
 
@@ -385,8 +778,13 @@ bool SqwFuncModel::Save(const char *pcFile, std::size_t iNum, std::size_t iSkipB
 
 			// save bragg widths for error calculation
 			// TODO: also save bragg width in rlu
-			TASReso reso = *GetTASReso();
-			SetTASPos(dX, reso);
+			std::shared_ptr<const TASReso> pReso = GetTASResoAtPos(dX);
+			if(!pReso)
+			{
+				ofstr << "\n";
+				continue;
+			}
+			const TASReso& reso = *pReso;
 			const auto& crysopts = reso.GetMCOpts();
 			const ResoResults& resores = reso.GetResoResults();
 
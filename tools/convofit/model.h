@@ -11,6 +11,12 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <map>
+#include <list>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 #include "tlibs/fit/minuit.h"
 #include <Minuit2/FunctionMinimum.h>
@@ -22,6 +28,7 @@
 
 #include "../monteconvo/sqwbase.h"
 #include "../monteconvo/TASReso.h"
+#include "../monteconvo/convo_adaptive.h"
 #include "../res/defs.h"
 #include "scan.h"
 
@@ -41,6 +48,49 @@ protected:
 	unsigned int m_iNumNeutrons = 1000;
 	bool m_bUseThreads = 1;
 
+	// draw neutrons until a target error is reached, sampling around the dispersion branches
+	bool m_bAdaptive = 0;
+	AdaptiveConvoOpts m_adaptiveOpts;
+
+	// gauss-hermite quadrature instead of MC for models which provide their dispersion,
+	// MC is used if the results of orders m_iQuadOrder and m_iQuadOrder-1 differ by more than m_dQuadTol
+	bool m_bQuadrature = 0;
+	unsigned int m_iQuadOrder = 5;
+	t_real_mod m_dQuadTol = 0.05;
+
+	// common random numbers: frozen MC deviates per scan group and scan point,
+	// at most m_iMaxFrozen are kept, the least recently used ones are dropped first
+	bool m_bFrozenSample = 0;
+	std::size_t m_iMaxFrozen = 256;
+	using t_frozenkey = std::pair<std::size_t, t_real_mod>;
+	using t_frozenlist = std::list<t_frozenkey>;
+	using t_frozenval = std::pair<std::shared_ptr<const McFrozenSample>, t_frozenlist::iterator>;
+	std::shared_ptr<std::map<t_frozenkey, t_frozenval>> m_pmapFrozen;
+	std::shared_ptr<t_frozenlist> m_plstFrozen;	// most recently used first
+	std::shared_ptr<std::mutex> m_pmtxFrozen;
+
+	// counter-based random numbers keyed by seed, scan group, scan point and evaluation,
+	// the results do not depend on the number of threads or the order of evaluation
+	bool m_bRandStreams = 0;
+	bool m_bRecycleStreams = 1;	// same streams for every evaluation
+	std::uint64_t m_iRandSeed = 0;
+	std::uint64_t m_iEvalIdx = 0;	// index of the current parameter set, shared counter
+	std::shared_ptr<std::atomic<std::uint64_t>> m_pEvalCounter;
+
+	// resolution cache per scan group and hklE position
+	// (instrument and lattice parameters are no fit variables, so it stays valid during a fit)
+	bool m_bCacheReso = 1;
+	using t_resokey = std::tuple<std::size_t, t_real_mod, t_real_mod, t_real_mod, t_real_mod>;
+	std::shared_ptr<std::map<t_resokey, std::shared_ptr<const TASReso>>> m_pmapReso;
+	std::shared_ptr<std::mutex> m_pmtxReso;
+
+	// scan-level parallelisation: evaluate all points (and scan groups) at once
+	bool m_bParallelScans = 1;
+	const std::vector<Scan>* m_pEvalScans = nullptr;
+	using t_evalkey = std::pair<std::size_t, t_real_mod>;
+	std::shared_ptr<std::map<t_evalkey, t_real_mod>> m_pmapEval;
+	std::shared_ptr<std::mutex> m_pmtxEval;
+
 	ublas::vector<t_real_mod> m_vecScanOrigin;	// hklE
 	ublas::vector<t_real_mod> m_vecScanDir;		// hklE
 	t_real_mod m_dPrincipalAxisMin, m_dPrincipalAxisMax;
@@ -85,7 +135,13 @@ protected:
 protected:
 	void SetModelParams();
 
-	bool SetTASPos(t_real_mod dX, TASReso& reso) const;
+	bool SetTASPos(t_real_mod dX, TASReso& reso, const PhiloxStream* pStream = nullptr) const;
+	PhiloxStream GetRandStream(t_real_mod dX, bool bPerEval = true) const;
+	std::shared_ptr<const McFrozenSample> GetFrozenSample(t_real_mod dX, const TASReso& reso) const;
+	std::shared_ptr<const TASReso> GetTASResoAtPos(t_real_mod dX) const;
+	t_real_mod EvalPoint(t_real_mod dX, bool bUseThreads) const;
+	bool EvalQuadrature(t_real_mod dX, const TASReso& reso, t_real_mod& dS) const;
+	bool EvalScans() const;
 	TASReso* GetTASReso();
 	const TASReso* GetTASReso() const;
 
@@ -118,14 +174,26 @@ public:
 	void SetScans(const std::vector<Scan>* pScans) { m_pScans = pScans; }
 	// -------------------------------------------------------------------------
 
+	// scans whose points can be evaluated in parallel, also for single-fits
+	void SetEvalScans(const std::vector<Scan>* pScans) { m_pEvalScans = pScans; ClearEvalCache(); }
+	void SetParallelScans(bool b) { m_bParallelScans = b; ClearEvalCache(); }
+	void ClearEvalCache();
+
 
 	void SetOtherParamNames(std::string strTemp, std::string strField);
 	void SetOtherParams(t_real_mod dTemperature, t_real_mod dField);
 
-	void SetReso(const TASReso& reso) { /*m_reso = reso;*/ m_vecResos = {reso}; }
-	void SetResos(const std::vector<TASReso>& vecResos) { m_vecResos = vecResos; }
-	void SetNumNeutrons(unsigned int iNum) { m_iNumNeutrons = iNum; }
-	void SetUseThreads(bool b) { m_bUseThreads = b; }
+	void SetReso(const TASReso& reso) { /*m_reso = reso;*/ m_vecResos = {reso}; ClearResoCache(); ClearEvalCache(); }
+	void SetResos(const std::vector<TASReso>& vecResos) { m_vecResos = vecResos; ClearResoCache(); ClearEvalCache(); }
+	void SetCacheReso(bool b);
+	void ClearResoCache();
+	void SetNumNeutrons(unsigned int iNum) { m_iNumNeutrons = iNum; ClearEvalCache(); }
+	void SetAdaptive(bool b, const AdaptiveConvoOpts& opts) { m_bAdaptive = b; m_adaptiveOpts = opts; ClearEvalCache(); }
+	void SetQuadrature(bool b, unsigned int iOrder, t_real_mod dTol)
+	{ m_bQuadrature = b; m_iQuadOrder = iOrder; m_dQuadTol = dTol; ClearEvalCache(); }
+	void SetUseThreads(bool b) { m_bUseThreads = b; ClearEvalCache(); }
+	void SetFrozenSample(bool b, std::size_t iMaxFrozen = 256);
+	void SetRandStreams(bool b, std::uint64_t iSeed, bool bRecycle);
 
 	void SetScanOrigin(t_real_mod h, t_real_mod k, t_real_mod l, t_real_mod E)
 	{ m_vecScanOrigin = tl::make_vec({h,k,l,E}); }
@@ -11,6 +11,8 @@
 #include "tlibs/string/string.h"
 #include "tlibs/file/prop.h"
 
+#include <map>
+
 
 using namespace tl;
 
@@ -34,10 +36,13 @@ int main(int argc, char** argv)
 	}
 
 
+	// devices for which a sics-style "<dev> interest" was requested, with their last values
+	std::map<std::string, std::string> mapInterest;
+
 	TcpTxtServer<> server;
 	server.add_disconnect(disconnected);
 	server.add_server_start(connected);
-	server.add_receiver([&server](const std::string& strMsg)
+	server.add_receiver([&server, &mapInterest](const std::string& strMsg)
 	{
 		log_info("Received: ", strMsg);
 		tl::Prop<> prop;
@@ -45,6 +50,15 @@ int main(int argc, char** argv)
 		{
 			std::vector<std::string> vecMsg;
 			tl::get_tokens<std::string>(strMsg, std::string(" ,"), vecMsg);
+
+			if(vecMsg.size() == 2 && tl::trimmed(vecMsg[1]) == "interest")
+			{
+				std::string strDev = tl::trimmed(vecMsg[0]);
+				mapInterest[strDev] = prop.Query<std::string>("replies/" + strDev, "0");
+				server.write("OK\n");
+				return;
+			}
+
 			for(std::string& strTok : vecMsg)
 			{
 				tl::trim(strTok);
@@ -53,6 +67,16 @@ int main(int argc, char** argv)
 				std::string strVal = prop.Query<std::string>("replies/" + strTok, "0");
 				server.write(strTok + "=" + strVal + "\n");
 			}
+
+			// notify about changed devices (edit replies.ini while running)
+			for(auto& pair : mapInterest)
+			{
+				std::string strVal = prop.Query<std::string>("replies/" + pair.first, "0");
+				if(strVal == pair.second) continue;
+
+				pair.second = strVal;
+				server.write(pair.first + ".position = " + strVal + "\n");
+			}
 		}
 	});
 
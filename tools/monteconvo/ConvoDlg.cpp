@@ -43,7 +43,8 @@ ConvoDlg::ConvoDlg(QWidget* pParent, QSettings* pSett)
 		spinStopH, spinStopK, spinStopL, spinStopE,
 		spinStopH2, spinStopK2, spinStopL2, spinStopE2,
 		spinKfix,
-		spinTolerance
+		spinTolerance,
+		spinTargetErr
 	};
 
 	m_vecSpinNames = {
@@ -51,7 +52,8 @@ ConvoDlg::ConvoDlg(QWidget* pParent, QSettings* pSett)
 		"monteconvo/h_to", "monteconvo/k_to", "monteconvo/l_to", "monteconvo/E_to",
 		"monteconvo/h_to_2", "monteconvo/k_to_2", "monteconvo/l_to_2", "monteconvo/E_to_2",
 		"monteconvo/kfix",
-		"convofit/tolerance"
+		"convofit/tolerance",
+		"monteconvo/target_error"
 	};
 
 	m_vecIntSpinBoxes = { spinNeutrons, spinSampleSteps, spinStepCnt,
@@ -80,10 +82,12 @@ ConvoDlg::ConvoDlg(QWidget* pParent, QSettings* pSett)
 	};
 
 	m_vecCheckBoxes = { checkScan, check2dMap,
-		checkRnd, checkNorm, checkFlip
+		checkRnd, checkNorm, checkFlip,
+		checkAdaptive, checkSobol
 	};
 	m_vecCheckNames = { "monteconvo/has_scanfile", "monteconvo/scan_2d",
-		"convofit/recycle_neutrons", "convofit/normalise", "convofit/flip_coords"
+		"convofit/recycle_neutrons", "convofit/normalise", "convofit/flip_coords",
+		"monteconvo/adaptive", "monteconvo/sobol"
 	};
 	// -------------------------------------------------------------------------
 
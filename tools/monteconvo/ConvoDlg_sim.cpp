@@ -7,9 +7,12 @@
 
 #include "ConvoDlg.h"
 #include "tlibs/time/stopwatch.h"
-#include "tlibs/helper/thread.h"
+#include "libs/taskpool.h"
+#include "convo_adaptive.h"
 #include "tlibs/math/stat.h"
 
+#include <numeric>
+
 
 using t_real = t_real_reso;
 using t_stopwatch = tl::Stopwatch<t_real>;
@@ -17,6 +20,19 @@ using t_stopwatch = tl::Stopwatch<t_real>;
 static constexpr const t_real g_dEpsRlu = 1e-3;
 
 
+/**
+ * run a task on the process-wide pool or, if deferred, in the calling thread
+ * as soon as its result is requested
+ */
+template<class t_func>
+static std::future<typename std::result_of<t_func()>::type> submit_task(t_func&& func, bool bDeferred)
+{
+	if(bDeferred)
+		return std::async(std::launch::deferred, std::forward<t_func>(func));
+	return get_task_pool().Submit(std::forward<t_func>(func));
+}
+
+
 /**
  * determine the x axis of the scan
  */
@@ -124,6 +140,16 @@ void ConvoDlg::Start1D()
 
 		const unsigned int iNumNeutrons = spinNeutrons->value();
 		const unsigned int iNumSampleSteps = spinSampleSteps->value();
+
+		// adaptive mode: the neutron count is the batch size
+		const bool bAdaptive = checkAdaptive->isChecked();
+		AdaptiveConvoOpts adaptiveOpts;
+		adaptiveOpts.iBatch = iNumNeutrons;
+		adaptiveOpts.iMaxNeutrons = CONVO_ADAPTIVE_MAX_BATCHES * iNumNeutrons;
+		adaptiveOpts.dTargetErr = spinTargetErr->value() / t_real(100.);
+
+		const McSampler sampler = checkSobol->isChecked() ? McSampler::SOBOL : McSampler::PSEUDO;
+
 		const unsigned int iNumSteps = spinStepCnt->value();
 
 		bool bScanAxisFound = 0;
@@ -205,6 +231,7 @@ void ConvoDlg::Start1D()
 		reso.SetKiFix(comboFixedK->currentIndex()==0);
 		reso.SetKFix(spinKfix->value());
 		reso.SetOptimalFocus(GetFocus());
+		reso.SetSampler(sampler);
 
 
 		if(m_pSqw == nullptr || !m_pSqw->IsOk())
@@ -243,9 +270,7 @@ void ConvoDlg::Start1D()
 		unsigned int iNumThreads = bForceDeferred ? 0 : get_max_threads();
 		tl::log_debug("Calculating using ", iNumThreads, " threads.");
 
-		void (*pThStartFunc)() = []{ tl::init_rand(); };
-		tl::ThreadPool<std::pair<bool, t_real>()> tp(iNumThreads, pThStartFunc);
-		auto& lstFuts = tp.GetFutures();
+		std::vector<std::future<std::pair<bool, t_real>>> lstFuts;
 
 		for(unsigned int iStep=0; iStep<iNumSteps; ++iStep)
 		{
@@ -254,14 +279,14 @@ void ConvoDlg::Start1D()
 			t_real dCurL = vecL[iStep];
 			t_real dCurE = vecE[iStep];
 
-			tp.AddTask(
-			[&reso, dCurH, dCurK, dCurL, dCurE, iNumNeutrons, iNumSampleSteps, this]()
+			lstFuts.emplace_back(submit_task(
+			[&reso, dCurH, dCurK, dCurL, dCurE, iNumNeutrons, iNumSampleSteps, iNumThreads,
+				bAdaptive, adaptiveOpts, this]()
 				-> std::pair<bool, t_real>
 			{
 				if(m_atStop.load()) return std::pair<bool, t_real>(false, 0.);
 
 				t_real dS = 0.;
-				t_real dhklE_mean[4] = {0., 0., 0., 0.};
 
 				if(iNumNeutrons == 0)
 				{	// if no neutrons are given, just plot the unconvoluted S(q,w)
@@ -271,7 +296,7 @@ void ConvoDlg::Start1D()
 				{	// convolution
 					TASReso localreso = reso;
 					localreso.SetRandomSamplePos(iNumSampleSteps);
-					std::vector<ublas::vector<t_real>> vecNeutrons;
+					McNeutronBatch<t_real> batch;
 
 					try
 					{
@@ -291,47 +316,53 @@ void ConvoDlg::Start1D()
 						return std::pair<bool, t_real>(false, 0.);
 					}
 
-					Ellipsoid4d<t_real> elli =
-						localreso.GenerateMC_deferred(iNumNeutrons, vecNeutrons);
-
-					for(const ublas::vector<t_real>& vecHKLE : vecNeutrons)
+					if(bAdaptive)
+					{	// draw neutrons until the target error is reached
+						AdaptiveConvoResult res;
+						if(!convolve_adaptive(localreso, *m_pSqw, adaptiveOpts, iNumThreads != 0, res, &m_atStop))
+							return std::pair<bool, t_real>(false, 0.);
+						dS = res.dS;
+					}
+					else
 					{
-						if(m_atStop.load()) return std::pair<bool, t_real>(false, 0.);
+						// on the pool, the neutron generation is fanned out into nested tasks
+						Ellipsoid4d<t_real> elli = iNumThreads ?
+							localreso.GenerateMC(iNumNeutrons, batch) :
+							localreso.GenerateMC_deferred(iNumNeutrons, batch);
+
+						const std::size_t iNumBatch = batch.size();
+						const t_real *pH = batch.vecH.data(), *pK = batch.vecK.data();
+						const t_real *pL = batch.vecL.data(), *pE = batch.vecE.data();
+
+						// evaluate S(q,w) in chunks to still be able to stop the calculation
+						const std::size_t iChunk = 1024;
+						std::vector<t_real> vecS(std::min(iChunk, iNumBatch));
+						for(std::size_t iStart=0; iStart<iNumBatch; iStart+=iChunk)
+						{
+							if(m_atStop.load()) return std::pair<bool, t_real>(false, 0.);
 
-						dS += (*m_pSqw)(vecHKLE[0], vecHKLE[1], vecHKLE[2], vecHKLE[3]);
+							const std::size_t iNumChunk = std::min(iChunk, iNumBatch-iStart);
+							m_pSqw->SqwBatch(pH+iStart, pK+iStart, pL+iStart, pE+iStart, vecS.data(), iNumChunk);
+							dS = std::accumulate(vecS.begin(), vecS.begin()+iNumChunk, dS);
+						}
 
-						for(int i=0; i<4; ++i)
-							dhklE_mean[i] += vecHKLE[i];
+						dS /= t_real(iNumNeutrons*iNumSampleSteps);
 					}
 
-					dS /= t_real(iNumNeutrons*iNumSampleSteps);
-					for(int i=0; i<4; ++i)
-						dhklE_mean[i] /= t_real(iNumNeutrons*iNumSampleSteps);
-
 					if(localreso.GetResoParams().flags & CALC_R0)
 						dS *= localreso.GetResoResults().dR0;
 					if(localreso.GetResoParams().flags & CALC_RESVOL)
 						dS /= localreso.GetResoResults().dResVol * tl::get_pi<t_real>() * t_real(3.);
 				}
 				return std::pair<bool, t_real>(true, dS);
-			});
+			}, iNumThreads == 0));
 		}
 
-		tp.StartTasks();
-
-		auto iterTask = tp.GetTasks().begin();
 		unsigned int iStep = 0;
 		for(auto &fut : lstFuts)
 		{
 			if(m_atStop.load()) break;
 
-			// deferred (in main thread), eval this task manually
-			if(iNumThreads == 0)
-			{
-				(*iterTask)();
-				++iterTask;
-			}
-
 			std::pair<bool, t_real> pairS = fut.get();
 			if(!pairS.first) break;
 			t_real dS = pairS.second;
@@ -423,6 +454,13 @@ void ConvoDlg::Start1D()
 			++iStep;
 		}
 
+		// wait for the tasks which are still queued, they refer to local variables
+		if(iNumThreads)
+		{
+			for(auto& fut : lstFuts)
+				if(fut.valid()) fut.wait();
+		}
+
 
 		// approximate chi^2
 		if(bUseScan && m_pSqw)
@@ -531,6 +569,15 @@ void ConvoDlg::Start2D()
 		const unsigned int iNumNeutrons = spinNeutrons->value();
 		const unsigned int iNumSampleSteps = spinSampleSteps->value();
 
+		// adaptive mode: the neutron count is the batch size
+		const bool bAdaptive = checkAdaptive->isChecked();
+		AdaptiveConvoOpts adaptiveOpts;
+		adaptiveOpts.iBatch = iNumNeutrons;
+		adaptiveOpts.iMaxNeutrons = CONVO_ADAPTIVE_MAX_BATCHES * iNumNeutrons;
+		adaptiveOpts.dTargetErr = spinTargetErr->value() / t_real(100.);
+
+		const McSampler sampler = checkSobol->isChecked() ? McSampler::SOBOL : McSampler::PSEUDO;
+
 		const unsigned int iNumSteps = std::sqrt(spinStepCnt->value());
 		const t_real dStartHKL[] =
 		{
@@ -660,6 +707,7 @@ void ConvoDlg::Start2D()
 		reso.SetKiFix(comboFixedK->currentIndex()==0);
 		reso.SetKFix(spinKfix->value());
 		reso.SetOptimalFocus(GetFocus());
+		reso.SetSampler(sampler);
 
 		if(m_pSqw == nullptr || !m_pSqw->IsOk())
 		{
@@ -712,9 +760,7 @@ void ConvoDlg::Start2D()
 		unsigned int iNumThreads = bForceDeferred ? 0 : get_max_threads();
 		tl::log_debug("Calculating using ", iNumThreads, " threads.");
 
-		void (*pThStartFunc)() = []{ tl::init_rand(); };
-		tl::ThreadPool<std::pair<bool, t_real>()> tp(iNumThreads, pThStartFunc);
-		auto& lstFuts = tp.GetFutures();
+		std::vector<std::future<std::pair<bool, t_real>>> lstFuts;
 
 		for(unsigned int iStep=0; iStep<iNumSteps*iNumSteps; ++iStep)
 		{
@@ -723,14 +769,14 @@ void ConvoDlg::Start2D()
 			t_real dCurL = vecL[iStep];
 			t_real dCurE = vecE[iStep];
 
-			tp.AddTask(
-			[&reso, dCurH, dCurK, dCurL, dCurE, iNumNeutrons, iNumSampleSteps, this]()
+			lstFuts.emplace_back(submit_task(
+			[&reso, dCurH, dCurK, dCurL, dCurE, iNumNeutrons, iNumSampleSteps, iNumThreads,
+				bAdaptive, adaptiveOpts, this]()
 				-> std::pair<bool, t_real>
 			{
 				if(m_atStop.load()) return std::pair<bool, t_real>(false, 0.);
 
 				t_real dS = 0.;
-				t_real dhklE_mean[4] = {0., 0., 0., 0.};
 
 				if(iNumNeutrons == 0)
 				{	// if no neutrons are given, just plot the unconvoluted S(q,w)
@@ -740,7 +786,7 @@ void ConvoDlg::Start2D()
 				{	// convolution
 					TASReso localreso = reso;
 					localreso.SetRandomSamplePos(iNumSampleSteps);
-					std::vector<ublas::vector<t_real>> vecNeutrons;
+					McNeutronBatch<t_real> batch;
 
 					try
 					{
@@ -760,47 +806,53 @@ void ConvoDlg::Start2D()
 						return std::pair<bool, t_real>(false, 0.);
 					}
 
-					Ellipsoid4d<t_real> elli =
-						localreso.GenerateMC_deferred(iNumNeutrons, vecNeutrons);
-
-					for(const ublas::vector<t_real>& vecHKLE : vecNeutrons)
+					if(bAdaptive)
+					{	// draw neutrons until the target error is reached
+						AdaptiveConvoResult res;
+						if(!convolve_adaptive(localreso, *m_pSqw, adaptiveOpts, iNumThreads != 0, res, &m_atStop))
+							return std::pair<bool, t_real>(false, 0.);
+						dS = res.dS;
+					}
+					else
 					{
-						if(m_atStop.load()) return std::pair<bool, t_real>(false, 0.);
+						// on the pool, the neutron generation is fanned out into nested tasks
+						Ellipsoid4d<t_real> elli = iNumThreads ?
+							localreso.GenerateMC(iNumNeutrons, batch) :
+							localreso.GenerateMC_deferred(iNumNeutrons, batch);
+
+						const std::size_t iNumBatch = batch.size();
+						const t_real *pH = batch.vecH.data(), *pK = batch.vecK.data();
+						const t_real *pL = batch.vecL.data(), *pE = batch.vecE.data();
+
+						// evaluate S(q,w) in chunks to still be able to stop the calculation
+						const std::size_t iChunk = 1024;
+						std::vector<t_real> vecS(std::min(iChunk, iNumBatch));
+						for(std::size_t iStart=0; iStart<iNumBatch; iStart+=iChunk)
+						{
+							if(m_atStop.load()) return std::pair<bool, t_real>(false, 0.);
 
-						dS += (*m_pSqw)(vecHKLE[0], vecHKLE[1], vecHKLE[2], vecHKLE[3]);
+							const std::size_t iNumChunk = std::min(iChunk, iNumBatch-iStart);
+							m_pSqw->SqwBatch(pH+iStart, pK+iStart, pL+iStart, pE+iStart, vecS.data(), iNumChunk);
+							dS = std::accumulate(vecS.begin(), vecS.begin()+iNumChunk, dS);
+						}
 
-						for(int i=0; i<4; ++i)
-							dhklE_mean[i] += vecHKLE[i];
+						dS /= t_real(iNumNeutrons*iNumSampleSteps);
 					}
 
-					dS /= t_real(iNumNeutrons*iNumSampleSteps);
-					for(int i=0; i<4; ++i)
-						dhklE_mean[i] /= t_real(iNumNeutrons*iNumSampleSteps);
-
 					if(localreso.GetResoParams().flags & CALC_R0)
 						dS *= localreso.GetResoResults().dR0;
 					if(localreso.GetResoParams().flags & CALC_RESVOL)
 						dS /= localreso.GetResoResults().dResVol * tl::get_pi<t_real>() * t_real(3.);
 				}
 				return std::pair<bool, t_real>(true, dS);
-			});
+			}, iNumThreads == 0));
 		}
 
-		tp.StartTasks();
-
-		auto iterTask = tp.GetTasks().begin();
 		unsigned int iStep = 0;
 		for(auto &fut : lstFuts)
 		{
 			if(m_atStop.load()) break;
 
-			// deferred (in main thread), eval this task manually
-			if(iNumThreads == 0)
-			{
-				(*iterTask)();
-				++iterTask;
-			}
-
 			std::pair<bool, t_real> pairS = fut.get();
 			if(!pairS.first) break;
 			t_real dS = pairS.second;
@@ -844,6 +896,13 @@ void ConvoDlg::Start2D()
 			++iStep;
 		}
 
+		// wait for the tasks which are still queued, they refer to local variables
+		if(iNumThreads)
+		{
+			for(auto& fut : lstFuts)
+				if(fut.valid()) fut.wait();
+		}
+
 		// output elapsed time
 		watch.stop();
 		QMetaObject::invokeMethod(editStopTime2d, "setText",
@@ -970,9 +1029,7 @@ void ConvoDlg::StartDisp()
 		unsigned int iNumThreads = bForceDeferred ? 0 : get_max_threads();
 		tl::log_debug("Calculating using ", iNumThreads, " threads.");
 
-		tl::ThreadPool<std::tuple<bool, std::vector<t_real>, std::vector<t_real>>()>
-			tp(iNumThreads);
-		auto& lstFuts = tp.GetFutures();
+		std::vector<std::future<std::tuple<bool, std::vector<t_real>, std::vector<t_real>>>> lstFuts;
 
 		for(unsigned int iStep=0; iStep<iNumSteps; ++iStep)
 		{
@@ -980,7 +1037,7 @@ void ConvoDlg::StartDisp()
 			t_real dCurK = vecK[iStep];
 			t_real dCurL = vecL[iStep];
 
-			tp.AddTask([dCurH, dCurK, dCurL, this]() ->
+			lstFuts.emplace_back(submit_task([dCurH, dCurK, dCurL, this]() ->
 			std::tuple<bool, std::vector<t_real>, std::vector<t_real>>
 			{
 				if(m_atStop.load())
@@ -990,24 +1047,14 @@ void ConvoDlg::StartDisp()
 				std::tie(vecE, vecW) = m_pSqw->disp(dCurH, dCurK, dCurL);
 				return std::tuple<bool, std::vector<t_real>, std::vector<t_real>>
 					(true, vecE, vecW);
-			});
+			}, iNumThreads == 0));
 		}
 
-		tp.StartTasks();
-
-		auto iterTask = tp.GetTasks().begin();
 		unsigned int iStep = 0;
 		for(auto &fut : lstFuts)
 		{
 			if(m_atStop.load()) break;
 
-			// deferred (in main thread), eval this task manually
-			if(iNumThreads == 0)
-			{
-				(*iterTask)();
-				++iterTask;
-			}
-
 			auto tupEW = fut.get();
 			if(!std::get<0>(tupEW)) break;
 
@@ -1070,6 +1117,13 @@ void ConvoDlg::StartDisp()
 			++iStep;
 		}
 
+		// wait for the tasks which are still queued, they refer to local variables
+		if(iNumThreads)
+		{
+			for(auto& fut : lstFuts)
+				if(fut.valid()) fut.wait();
+		}
+
 		// output elapsed time
 		watch.stop();
 		QMetaObject::invokeMethod(editStopTime, "setText",
@@ -10,9 +10,10 @@
 #include "tlibs/math/rand.h"
 #include "tlibs/file/prop.h"
 #include "tlibs/log/log.h"
-#include "tlibs/helper/thread.h"
+#include "libs/taskpool.h"
 
 #include <boost/units/io.hpp>
+#include <algorithm>
 
 
 typedef t_real_reso t_real;
@@ -33,6 +34,7 @@ using wavenumber = tl::t_wavenumber_si<t_real>;
 TASReso::TASReso()
 {
 	m_res.resize(1);
+	m_ell.resize(1);
 
 	m_opts.bCenter = 0;
 	m_opts.coords = McNeutronCoords::RLU;
@@ -53,8 +55,10 @@ const TASReso& TASReso::operator=(const TASReso& res)
 	this->m_reso = res.m_reso;
 	this->m_tofreso = res.m_tofreso;
 	this->m_res = res.m_res;
+	this->m_ell = res.m_ell;
 	this->m_bKiFix = res.m_bKiFix;
 	this->m_dKFix = res.m_dKFix;
+	this->m_pFrozen = res.m_pFrozen;
 	//this->m_bEnableThreads = res.m_bEnableThreads;
 
 	return *this;
@@ -340,7 +344,11 @@ bool TASReso::SetLattice(t_real a, t_real b, t_real c,
 }
 
 
-bool TASReso::SetHKLE(t_real h, t_real k, t_real l, t_real E)
+/**
+ * calculates the resolution at (hkl) and E,
+ * the random sample positions are taken from pStream if given
+ */
+bool TASReso::SetHKLE(t_real h, t_real k, t_real l, t_real E, const PhiloxStream* pStream)
 {
 	static const t_real s_dPlaneDistTolerance = std::cbrt(tl::get_epsilon<t_real>());
 
@@ -462,70 +470,117 @@ bool TASReso::SetHKLE(t_real h, t_real k, t_real l, t_real E)
 	//tl::log_info("angle Q vec0 = ", m_opts.dAngleQVec0);
 	//tl::log_info("calc r0: ", m_reso.bCalcR0);
 
-	for(ResoResults& resores_cur : m_res)
+	// frozen sample position deviates available?
+	const bool bFrozenPos = m_pFrozen && m_pFrozen->vecSamplePos.size() == 3*m_res.size();
+
+	// all sample positions share the kinematics of the current (hkl) and E
+	ResoScanPoint ptBase = get_scan_point(m_reso);
+	ptBase.pos_x = m_reso.pos_x;
+	ptBase.pos_y = m_reso.pos_y;
+	ptBase.pos_z = m_reso.pos_z;
+	std::vector<ResoScanPoint> vecPts(m_res.size(), ptBase);
+
+	for(std::size_t iSamplePos=0; iSamplePos<m_res.size(); ++iSamplePos)
 	{
+		ResoScanPoint& pt = vecPts[iSamplePos];
+
 		// if only one sample position is requested, don't randomise
-		if(m_res.size() > 1)
+		if(m_res.size() > 1 && bFrozenPos)
+		{
+			const t_real *pDev = m_pFrozen->vecSamplePos.data() + 3*iSamplePos;
+
+			pt.pos_x = pDev[0] * t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_w_q/cm) * cm;
+			pt.pos_y = pDev[1] * t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_w_perpq/cm) * cm;
+			pt.pos_z = pDev[2] * t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_h/cm) * cm;
+		}
+		else if(m_res.size() > 1 && pStream)
+		{
+			t_real dDev[4];
+			pStream->GetNormal<t_real>(std::uint32_t(iSamplePos), std::uint32_t(McSubStream::SAMPLE_POS), dDev);
+
+			pt.pos_x = dDev[0] * t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_w_q/cm) * cm;
+			pt.pos_y = dDev[1] * t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_w_perpq/cm) * cm;
+			pt.pos_z = dDev[2] * t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_h/cm) * cm;
+		}
+		else if(m_res.size() > 1)
 		{
 			// TODO: use selected sample geometry
-			/*m_reso.pos_x = tl::rand_real(-t_real(m_reso.sample_w_q*0.5/cm),
+			/*pt.pos_x = tl::rand_real(-t_real(m_reso.sample_w_q*0.5/cm),
 				t_real(m_reso.sample_w_q*0.5/cm)) * cm;
-			m_reso.pos_y = tl::rand_real(-t_real(m_reso.sample_w_perpq*0.5/cm),
+			pt.pos_y = tl::rand_real(-t_real(m_reso.sample_w_perpq*0.5/cm),
 				t_real(m_reso.sample_w_perpq*0.5/cm)) * cm;
-			m_reso.pos_z = tl::rand_real(-t_real(m_reso.sample_h*0.5/cm),
+			pt.pos_z = tl::rand_real(-t_real(m_reso.sample_h*0.5/cm),
 				t_real(m_reso.sample_h*0.5/cm)) * cm;*/
 
-			m_reso.pos_x = tl::rand_norm(t_real(0),
+			pt.pos_x = tl::rand_norm(t_real(0),
 				t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_w_q/cm)) * cm;
-			m_reso.pos_y = tl::rand_norm(t_real(0),
+			pt.pos_y = tl::rand_norm(t_real(0),
 				t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_w_perpq/cm)) * cm;
-			m_reso.pos_z = tl::rand_norm(t_real(0),
+			pt.pos_z = tl::rand_norm(t_real(0),
 				t_real(tl::get_FWHM2SIGMA<t_real>()*m_reso.sample_h/cm)) * cm;
 		}
+	}
 
-		// calculate resolution at (hkl) and E
-		if(m_algo == ResoAlgo::CN)
-		{
-			//tl::log_info("Algorithm: Cooper-Nathans (TAS)");
-			resores_cur = calc_cn(m_reso);
-		}
-		else if(m_algo == ResoAlgo::POP)
-		{
-			//tl::log_info("Algorithm: Popovici (TAS)");
-			resores_cur = calc_pop(m_reso);
-		}
-		else if(m_algo == ResoAlgo::ECK)
-		{
-			//tl::log_info("Algorithm: Eckold-Sobolev (TAS)");
-			resores_cur = calc_eck(m_reso);
-		}
-		else if(m_algo == ResoAlgo::VIOL)
-		{
-			//tl::log_info("Algorithm: Violini (TOF)");
-			m_reso.flags &= ~CALC_R0;
-			resores_cur = calc_viol(m_tofreso);
-		}
-		else
-		{
-			const char* pcErr = "Unknown algorithm selected.";
-			tl::log_err(pcErr);
-			resores_cur.strErr = pcErr;
-			resores_cur.bOk = false;
-			return false;
-		}
+	// calculate resolution at (hkl) and E for all sample positions
+	if(m_algo == ResoAlgo::CN)
+	{
+		//tl::log_info("Algorithm: Cooper-Nathans (TAS)");
+		calc_cn_batch(m_reso, vecPts, m_res);
+	}
+	else if(m_algo == ResoAlgo::POP)
+	{
+		//tl::log_info("Algorithm: Popovici (TAS)");
+		calc_pop_batch(m_reso, vecPts, m_res);
+	}
+	else if(m_algo == ResoAlgo::ECK)
+	{
+		//tl::log_info("Algorithm: Eckold-Sobolev (TAS)");
+		calc_eck_batch(m_reso, vecPts, m_res);
+	}
+	else if(m_algo == ResoAlgo::VIOL)
+	{
+		//tl::log_info("Algorithm: Violini (TOF)");
+		// the tof resolution does not depend on the sample position
+		m_reso.flags &= ~CALC_R0;
+		const ResoResults resViol = calc_viol(m_tofreso);
+		std::fill(m_res.begin(), m_res.end(), resViol);
+	}
+	else
+	{
+		const char* pcErr = "Unknown algorithm selected.";
+		tl::log_err(pcErr);
+		resores.strErr = pcErr;
+		resores.bOk = false;
+		return false;
+	}
+
+	// reset values
+	m_reso.pos_x = m_reso.pos_y = m_reso.pos_z = t_real(0)*cm;
+
+	// the ellipsoid of a failed sample position would still be the one of
+	// the previous (hkl) and E, so the whole position is invalid
+	bool bAllOk = 1;
+
+	for(std::size_t iSamplePos=0; iSamplePos<m_res.size(); ++iSamplePos)
+	{
+		const ResoResults& resores_cur = m_res[iSamplePos];
 
 		if(!resores_cur.bOk)
 		{
+			bAllOk = 0;
 			tl::log_err("Error calculating resolution: ", resores_cur.strErr);
 			tl::log_debug("R0: ", resores_cur.dR0);
 			tl::log_debug("res: ", resores_cur.reso);
 		}
-
-		// reset values
-		m_reso.pos_x = m_reso.pos_y = m_reso.pos_z = t_real(0)*cm;
+		else
+		{
+			// the ellipsoid only depends on the resolution matrix, calculate it once here
+			m_ell[iSamplePos] = calc_res_ellipsoid4d<t_real>(
+				resores_cur.reso, resores_cur.reso_v, resores_cur.reso_s, resores_cur.Q_avg);
+		}
 	}
 
-	return resores.bOk;
+	return bAllOk;
 }
 
 
@@ -544,19 +599,22 @@ Ellipsoid4d<t_real> TASReso::GenerateMC(std::size_t iNum, std::vector<t_vec>& ve
 	if(vecNeutrons.size() != iNum*iIter)
 		vecNeutrons.resize(iNum*iIter);
 
+	// quasi-random sequence shared by all threads
+	std::shared_ptr<const SobolSeq<t_real>> pSeq = mc_create_sequence<t_real>(m_opts.sampler);
+
 	Ellipsoid4d<t_real> ell4dret;
 	for(std::size_t iCurIter=0; iCurIter<iIter; ++iCurIter)
 	{
-		const ResoResults& resores = m_res[iCurIter];
-
-		Ellipsoid4d<t_real> ell4d = calc_res_ellipsoid4d<t_real>(
-			resores.reso, resores.reso_v, resores.reso_s, resores.Q_avg);
+		// ellipsoid has already been calculated in SetHKLE
+		const Ellipsoid4d<t_real>& ell4d = m_ell[iCurIter];
 
 		unsigned int iNumThreads = get_max_threads();
 		std::size_t iNumPerThread = iNum / iNumThreads;
 		std::size_t iRemaining = iNum % iNumThreads;
 
-		tl::ThreadPool<void()> tp(iNumThreads);
+		TaskPool& pool = get_task_pool();
+		std::vector<std::future<void>> vecFuts;
+		vecFuts.reserve(iNumThreads);
 		for(unsigned iThread=0; iThread<iNumThreads; ++iThread)
 		{
 			std::vector<t_vec>::iterator iterBegin = vecNeutrons.begin() + iNumPerThread*iThread + iCurIter*iNum;
@@ -564,15 +622,14 @@ Ellipsoid4d<t_real> TASReso::GenerateMC(std::size_t iNum, std::vector<t_vec>& ve
 			if(iThread == iNumThreads-1)
 				iNumNeutr = iNumPerThread + iRemaining;
 
-			tp.AddTask([iterBegin, iNumNeutr, this, &ell4d]()
-				{ mc_neutrons<t_vec>(ell4d, iNumNeutr, this->m_opts, iterBegin); });
-		}
+			std::size_t iSeqOffs = iNumPerThread*iThread + iCurIter*iNum;
 
-		tp.StartTasks();
+			vecFuts.emplace_back(pool.Submit([iterBegin, iNumNeutr, iSeqOffs, this, &ell4d, &pSeq]()
+				{ mc_neutrons<t_vec>(ell4d, iNumNeutr, this->m_opts, iterBegin, pSeq.get(), iSeqOffs); }));
+		}
 
-		auto& lstFut = tp.GetFutures();
-		for(auto& fut : lstFut)
-			fut.get();
+		for(auto& fut : vecFuts)
+			pool.Wait(fut);
 
 		if(iCurIter == 0)
 			ell4dret = ell4d;
@@ -593,16 +650,113 @@ Ellipsoid4d<t_real> TASReso::GenerateMC_deferred(std::size_t iNum, std::vector<t
 	if(vecNeutrons.size() != iNum*iIter)
 		vecNeutrons.resize(iNum*iIter);
 
+	std::shared_ptr<const SobolSeq<t_real>> pSeq = mc_create_sequence<t_real>(m_opts.sampler);
+
 	Ellipsoid4d<t_real> ell4dret;
 	for(std::size_t iCurIter = 0; iCurIter<iIter; ++iCurIter)
 	{
-		const ResoResults& resores = m_res[iCurIter];
-
-		Ellipsoid4d<t_real> ell4d = calc_res_ellipsoid4d<t_real>(
-			resores.reso, resores.reso_v, resores.reso_s, resores.Q_avg);
+		// ellipsoid has already been calculated in SetHKLE
+		const Ellipsoid4d<t_real>& ell4d = m_ell[iCurIter];
 
 		std::vector<t_vec>::iterator iterBegin = vecNeutrons.begin() + iCurIter*iNum;
-		mc_neutrons<t_vec>(ell4d, iNum, m_opts, iterBegin);
+		mc_neutrons<t_vec>(ell4d, iNum, m_opts, iterBegin, pSeq.get(), iCurIter*iNum);
+
+		if(iCurIter == 0)
+			ell4dret = ell4d;
+	}
+
+	return ell4dret;
+}
+
+
+/**
+ * generates MC neutrons into a structure-of-arrays batch using available threads;
+ * with a counter-based random stream, the result does not depend on the number of threads
+ */
+Ellipsoid4d<t_real> TASReso::GenerateMC(std::size_t iNum, McNeutronBatch<t_real>& batch,
+	const PhiloxStream* pStream) const
+{
+	// number of iterations over random sample positions
+	std::size_t iIter = m_res.size();
+	batch.resize(iNum*iIter);
+
+	// only re-apply the ellipsoid trafo to frozen deviates?
+	const bool bFrozen = m_pFrozen && m_pFrozen->normals.size() == iNum*iIter;
+
+	// quasi-random sequence shared by all threads, each draws the points at its batch indices
+	std::shared_ptr<const SobolSeq<t_real>> pSeq;
+	if(!bFrozen)
+		pSeq = mc_create_sequence<t_real>(m_opts.sampler, pStream);
+
+	Ellipsoid4d<t_real> ell4dret;
+	for(std::size_t iCurIter=0; iCurIter<iIter; ++iCurIter)
+	{
+		// ellipsoid has already been calculated in SetHKLE
+		const Ellipsoid4d<t_real>& ell4d = m_ell[iCurIter];
+
+		unsigned int iNumThreads = get_max_threads();
+		std::size_t iNumPerThread = iNum / iNumThreads;
+		std::size_t iRemaining = iNum % iNumThreads;
+
+		// each task writes to its own, disjoint range of the batch arrays;
+		// when called from within a pool task, these are nested tasks
+		TaskPool& pool = get_task_pool();
+		std::vector<std::future<void>> vecFuts;
+		vecFuts.reserve(iNumThreads);
+		for(unsigned iThread=0; iThread<iNumThreads; ++iThread)
+		{
+			std::size_t iOffs = iNumPerThread*iThread + iCurIter*iNum;
+			std::size_t iNumNeutr = iNumPerThread;
+			if(iThread == iNumThreads-1)
+				iNumNeutr = iNumPerThread + iRemaining;
+
+			vecFuts.emplace_back(pool.Submit([iOffs, iNumNeutr, bFrozen, this, &ell4d, &batch, &pSeq, pStream]()
+			{
+				if(bFrozen)
+					mc_neutrons_batch<t_mat>(ell4d, iNumNeutr, this->m_opts, this->m_pFrozen->normals, batch, iOffs);
+				else
+					mc_neutrons_batch<t_mat>(ell4d, iNumNeutr, this->m_opts, batch, iOffs, pSeq.get(), pStream);
+			}));
+		}
+
+		for(auto& fut : vecFuts)
+			pool.Wait(fut);
+
+		if(iCurIter == 0)
+			ell4dret = ell4d;
+	}
+
+	return ell4dret;
+}
+
+
+/**
+ * generates MC neutrons into a structure-of-arrays batch without using threads
+ */
+Ellipsoid4d<t_real> TASReso::GenerateMC_deferred(std::size_t iNum, McNeutronBatch<t_real>& batch,
+	const PhiloxStream* pStream) const
+{
+	// number of iterations over random sample positions
+	std::size_t iIter = m_res.size();
+	batch.resize(iNum*iIter);
+
+	// only re-apply the ellipsoid trafo to frozen deviates?
+	const bool bFrozen = m_pFrozen && m_pFrozen->normals.size() == iNum*iIter;
+
+	std::shared_ptr<const SobolSeq<t_real>> pSeq;
+	if(!bFrozen)
+		pSeq = mc_create_sequence<t_real>(m_opts.sampler, pStream);
+
+	Ellipsoid4d<t_real> ell4dret;
+	for(std::size_t iCurIter = 0; iCurIter<iIter; ++iCurIter)
+	{
+		// ellipsoid has already been calculated in SetHKLE
+		const Ellipsoid4d<t_real>& ell4d = m_ell[iCurIter];
+
+		if(bFrozen)
+			mc_neutrons_batch<t_mat>(ell4d, iNum, m_opts, m_pFrozen->normals, batch, iCurIter*iNum);
+		else
+			mc_neutrons_batch<t_mat>(ell4d, iNum, m_opts, batch, iCurIter*iNum, pSeq.get(), pStream);
 
 		if(iCurIter == 0)
 			ell4dret = ell4d;
@@ -610,3 +764,137 @@ Ellipsoid4d<t_real> TASReso::GenerateMC_deferred(std::size_t iNum, std::vector<t
 
 	return ell4dret;
 }
+
+
+/**
+ * generates importance-sampled MC neutrons and their weights using available threads,
+ * vecImp holds the energy proposal for each sample position;
+ * these always use pseudo-random numbers, independently of the selected sampler
+ */
+Ellipsoid4d<t_real> TASReso::GenerateMC(std::size_t iNum, const std::vector<McDispImportance<t_real>>& vecImp,
+	McNeutronBatch<t_real>& batch, std::vector<t_real>& vecWeights, const PhiloxStream* pStream) const
+{
+	// number of iterations over random sample positions
+	std::size_t iIter = m_res.size();
+	batch.resize(iNum*iIter);
+	vecWeights.resize(iNum*iIter);
+
+	Ellipsoid4d<t_real> ell4dret;
+	for(std::size_t iCurIter=0; iCurIter<iIter; ++iCurIter)
+	{
+		const Ellipsoid4d<t_real>& ell4d = m_ell[iCurIter];
+		const McDispImportance<t_real>& imp = vecImp[iCurIter];
+
+		unsigned int iNumThreads = get_max_threads();
+		std::size_t iNumPerThread = iNum / iNumThreads;
+		std::size_t iRemaining = iNum % iNumThreads;
+
+		TaskPool& pool = get_task_pool();
+		std::vector<std::future<void>> vecFuts;
+		vecFuts.reserve(iNumThreads);
+		for(unsigned iThread=0; iThread<iNumThreads; ++iThread)
+		{
+			std::size_t iOffs = iNumPerThread*iThread + iCurIter*iNum;
+			std::size_t iNumNeutr = iNumPerThread;
+			if(iThread == iNumThreads-1)
+				iNumNeutr = iNumPerThread + iRemaining;
+
+			vecFuts.emplace_back(pool.Submit([iOffs, iNumNeutr, this, &ell4d, &imp, &batch, &vecWeights, pStream]()
+			{
+				mc_neutrons_batch<t_mat>(ell4d, iNumNeutr, this->m_opts, imp, batch, vecWeights, iOffs, pStream);
+			}));
+		}
+
+		for(auto& fut : vecFuts)
+			pool.Wait(fut);
+
+		if(iCurIter == 0)
+			ell4dret = ell4d;
+	}
+
+	return ell4dret;
+}
+
+
+/**
+ * generates importance-sampled MC neutrons and their weights without using threads
+ */
+Ellipsoid4d<t_real> TASReso::GenerateMC_deferred(std::size_t iNum, const std::vector<McDispImportance<t_real>>& vecImp,
+	McNeutronBatch<t_real>& batch, std::vector<t_real>& vecWeights, const PhiloxStream* pStream) const
+{
+	// number of iterations over random sample positions
+	std::size_t iIter = m_res.size();
+	batch.resize(iNum*iIter);
+	vecWeights.resize(iNum*iIter);
+
+	Ellipsoid4d<t_real> ell4dret;
+	for(std::size_t iCurIter = 0; iCurIter<iIter; ++iCurIter)
+	{
+		const Ellipsoid4d<t_real>& ell4d = m_ell[iCurIter];
+		mc_neutrons_batch<t_mat>(ell4d, iNum, m_opts, vecImp[iCurIter], batch, vecWeights, iCurIter*iNum, pStream);
+
+		if(iCurIter == 0)
+			ell4dret = ell4d;
+	}
+
+	return ell4dret;
+}
+
+
+/**
+ * generates the nodes of a gauss-hermite quadrature of order iOrder (iOrder^4 nodes)
+ * of the resolution function at each sample position, the weights of each position sum to 1
+ */
+Ellipsoid4d<t_real> TASReso::GenerateQuadrature(unsigned iOrder, McNeutronBatch<t_real>& batch,
+	std::vector<t_real>& vecWeights) const
+{
+	iOrder = std::min<unsigned>(std::max<unsigned>(iOrder, 1), RESO_QUAD_MAX_ORDER);
+	const std::size_t iNum = std::size_t(iOrder)*iOrder*iOrder*iOrder;
+
+	// number of iterations over random sample positions
+	std::size_t iIter = m_res.size();
+	batch.resize(iNum*iIter);
+	vecWeights.resize(iNum*iIter);
+
+	for(std::size_t iCurIter = 0; iCurIter<iIter; ++iCurIter)
+		quad_neutrons_batch<t_mat>(m_ell[iCurIter], iOrder, m_opts, batch, vecWeights, iCurIter*iNum);
+
+	return m_ell[0];
+}
+
+
+/**
+ * draws the random numbers for iNum neutrons and all sample positions once,
+ * to be reused for all evaluations at a given scan point,
+ * they are taken from pStream if given
+ */
+std::shared_ptr<McFrozenSample> TASReso::CreateFrozenSample(std::size_t iNum, const PhiloxStream* pStream) const
+{
+	std::shared_ptr<McFrozenSample> pFrozen = std::make_shared<McFrozenSample>();
+
+	std::size_t iIter = m_res.size();
+	pFrozen->vecSamplePos.reserve(3*iIter);
+	for(std::size_t iPos=0; iPos<iIter; ++iPos)
+	{
+		t_real dDev[4];
+		if(pStream)
+		{
+			pStream->GetNormal<t_real>(std::uint32_t(iPos), std::uint32_t(McSubStream::SAMPLE_POS), dDev);
+		}
+		else
+		{
+			for(int i=0; i<3; ++i)
+				dDev[i] = tl::rand_norm<t_real>(t_real(0), t_real(1));
+		}
+		pFrozen->vecSamplePos.insert(pFrozen->vecSamplePos.end(), dDev, dDev+3);
+	}
+
+	std::shared_ptr<const SobolSeq<t_real>> pSeq = mc_create_sequence<t_real>(m_opts.sampler, pStream);
+	if(pSeq)
+		mc_normals_batch<t_real>(*pSeq, iNum*iIter, pFrozen->normals);
+	else if(pStream)
+		mc_normals_batch<t_real>(*pStream, iNum*iIter, pFrozen->normals);
+	else
+		mc_normals_batch<t_real>(iNum*iIter, pFrozen->normals);
+	return pFrozen;
+}
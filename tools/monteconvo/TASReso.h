@@ -12,8 +12,10 @@
 #include "../res/viol.h"
 #include "../res/ellipse.h"
 #include "../res/mc.h"
+#include "../res/quad.h"
 
 #include<vector>
+#include<memory>
 
 
 enum class ResoFocus : unsigned
@@ -30,6 +32,21 @@ enum class ResoFocus : unsigned
 };
 
 
+/**
+ * frozen random numbers for common-random-number MC:
+ * the same deviates are reused for every evaluation at a given scan point,
+ * only the ellipsoid trafo is re-applied
+ */
+struct McFrozenSample
+{
+	// standard-normal deviates of the random sample positions, 3 per position
+	std::vector<t_real_reso> vecSamplePos;
+
+	// standard-normal 4d deviates of the neutrons for all sample positions
+	McNeutronBatch<t_real_reso> normals;
+};
+
+
 class TASReso
 {
 protected:
@@ -42,10 +59,15 @@ protected:
 
 	// randomly smear out sample position if vector size >= 1
 	std::vector<ResoResults> m_res;
+	// resolution ellipsoids corresponding to m_res
+	std::vector<Ellipsoid4d<t_real_reso>> m_ell;
 
 	bool m_bKiFix = 0;
 	t_real_reso m_dKFix = 1.4;
 
+	// use these random numbers instead of fresh ones if set
+	std::shared_ptr<const McFrozenSample> m_pFrozen;
+
 public:
 	TASReso();
 	TASReso(const TASReso& res);
@@ -59,15 +81,29 @@ public:
 	bool SetLattice(t_real_reso a, t_real_reso b, t_real_reso c,
 		t_real_reso alpha, t_real_reso beta, t_real_reso gamma,
 		const ublas::vector<t_real_reso>& vec1, const ublas::vector<t_real_reso>& vec2);
-	bool SetHKLE(t_real_reso h, t_real_reso k, t_real_reso l, t_real_reso E);
+	bool SetHKLE(t_real_reso h, t_real_reso k, t_real_reso l, t_real_reso E,
+		const PhiloxStream* pStream = nullptr);
 	Ellipsoid4d<t_real_reso> GenerateMC(std::size_t iNum, std::vector<ublas::vector<t_real_reso>>&) const;
 	Ellipsoid4d<t_real_reso> GenerateMC_deferred(std::size_t iNum, std::vector<ublas::vector<t_real_reso>>&) const;
+	Ellipsoid4d<t_real_reso> GenerateMC(std::size_t iNum, McNeutronBatch<t_real_reso>&,
+		const PhiloxStream* pStream = nullptr) const;
+	Ellipsoid4d<t_real_reso> GenerateMC_deferred(std::size_t iNum, McNeutronBatch<t_real_reso>&,
+		const PhiloxStream* pStream = nullptr) const;
+	Ellipsoid4d<t_real_reso> GenerateMC(std::size_t iNum, const std::vector<McDispImportance<t_real_reso>>&,
+		McNeutronBatch<t_real_reso>&, std::vector<t_real_reso>& vecWeights,
+		const PhiloxStream* pStream = nullptr) const;
+	Ellipsoid4d<t_real_reso> GenerateMC_deferred(std::size_t iNum, const std::vector<McDispImportance<t_real_reso>>&,
+		McNeutronBatch<t_real_reso>&, std::vector<t_real_reso>& vecWeights,
+		const PhiloxStream* pStream = nullptr) const;
+	Ellipsoid4d<t_real_reso> GenerateQuadrature(unsigned iOrder, McNeutronBatch<t_real_reso>&,
+		std::vector<t_real_reso>& vecWeights) const;
 
 	void SetKiFix(bool bKiFix) { m_bKiFix = bKiFix; }
 	void SetKFix(t_real_reso dKFix) { m_dKFix = dKFix; }
 
 	void SetAlgo(ResoAlgo algo) { m_algo = algo; }
 	void SetOptimalFocus(ResoFocus foc) { m_foc = foc; }
+	void SetSampler(McSampler sampler) { m_opts.sampler = sampler; }
 
 	const EckParams& GetResoParams() const { return m_reso; }
 	const ViolParams& GetTofResoParams() const { return m_tofreso; }
@@ -76,8 +112,15 @@ public:
 	ViolParams& GetTofResoParams() { return m_tofreso; }
 
 	const ResoResults& GetResoResults() const { return m_res[0]; }
+	const Ellipsoid4d<t_real_reso>& GetResoEllipsoid() const { return m_ell[0]; }
+	const Ellipsoid4d<t_real_reso>& GetResoEllipsoid(std::size_t iPos) const { return m_ell[iPos]; }
+	std::size_t GetNumSamplePos() const { return m_ell.size(); }
+
+	void SetRandomSamplePos(std::size_t iNum) { m_res.resize(iNum); m_ell.resize(iNum); }
 
-	void SetRandomSamplePos(std::size_t iNum) { m_res.resize(iNum); }
+	std::shared_ptr<McFrozenSample> CreateFrozenSample(std::size_t iNum,
+		const PhiloxStream* pStream = nullptr) const;
+	void SetFrozenSample(const std::shared_ptr<const McFrozenSample>& pFrozen) { m_pFrozen = pFrozen; }
 };
 
 #endif
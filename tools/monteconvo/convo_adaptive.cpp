@@ -0,0 +1,315 @@
+/**
+ * adaptive MC convolution with importance sampling around the dispersion branches
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#include "convo_adaptive.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
+
+using t_real = t_real_reso;
+using t_mat = ublas::matrix<t_real>;
+
+
+/**
+ * scans the integrand N(t; 0, 1) * S(t) along a direction of the deviates in iNumPts steps,
+ * returns its integral, mean and standard deviation
+ */
+static bool scan_integrand(const SqwBase& sqw, const t_real *pMat, const t_real *pOffs,
+	const t_real *pDir, t_real dStart, t_real dEnd, std::size_t iNumPts,
+	t_real& dIntegral, t_real& dMean, t_real& dStd)
+{
+	McNeutronBatch<t_real> batch;
+	batch.resize(iNumPts);
+
+	const t_real dStep = (dEnd - dStart) / t_real(iNumPts-1);
+	for(std::size_t iPt=0; iPt<iNumPts; ++iPt)
+	{
+		const t_real t = dStart + t_real(iPt)*dStep;
+		t_real *pComps[4] = { &batch.vecH[iPt], &batch.vecK[iPt], &batch.vecL[iPt], &batch.vecE[iPt] };
+		for(int i=0; i<4; ++i)
+		{
+			*pComps[i] = pOffs[i];
+			for(int j=0; j<4; ++j)
+				*pComps[i] += pMat[i*4 + j] * pDir[j] * t;
+		}
+	}
+
+	std::vector<t_real> vecS(iNumPts);
+	sqw.SqwBatch(batch.vecH.data(), batch.vecK.data(), batch.vecL.data(), batch.vecE.data(),
+		vecS.data(), iNumPts);
+
+	t_real dSum = 0, dSumT = 0, dSumT2 = 0;
+	for(std::size_t iPt=0; iPt<iNumPts; ++iPt)
+	{
+		const t_real t = dStart + t_real(iPt)*dStep;
+		const t_real dVal = std::exp(-t_real(0.5)*t*t) * std::abs(vecS[iPt]);
+		if(!std::isfinite(dVal))
+			continue;
+
+		dSum += dVal;
+		dSumT += dVal*t;
+		dSumT2 += dVal*t*t;
+	}
+
+	if(dSum <= t_real(0))
+		return false;
+
+	dIntegral = dSum * dStep;
+	dMean = dSumT / dSum;
+	dStd = std::sqrt(std::max(dSumT2/dSum - dMean*dMean, t_real(0)));
+	return true;
+}
+
+
+/**
+ * the branch energies E_i(Q) of the model are linearised around the centre of the ellipsoid,
+ * E = E_i(Q) is then a hyperplane in the space of the standard-normal MC deviates.
+ * each branch gives a mixture component which samples the deviates across its plane,
+ * the component's position, width and weight are refined by scanning S(q,w) along the
+ * plane normal. the branches are also mirrored to -E for the annihilation side.
+ */
+McDispImportance<t_real> get_disp_importance(const SqwBase& sqw,
+	const Ellipsoid4d<t_real>& ell4d, const McNeutronOpts<t_mat>& opts,
+	t_real dFrac, t_real dWidth)
+{
+	McDispImportance<t_real> imp;
+	imp.dFrac = dFrac;
+
+	// the dispersion is given in rlu
+	if(dFrac <= t_real(0) || opts.coords != McNeutronCoords::RLU || opts.bCenter)
+		return imp;
+
+	t_real matTrafo[4*4], vecOffs[4];
+	mc_neutron_trafo<t_mat>(ell4d, opts, matTrafo, vecOffs);
+
+	std::vector<t_real> vecE, vecW;
+	std::tie(vecE, vecW) = sqw.disp(vecOffs[0], vecOffs[1], vecOffs[2]);
+	const std::size_t iNumBranches = vecE.size();
+	if(!iNumBranches)
+		return imp;
+
+	// gradients of the branches by central differences over the Q width of the ellipsoid,
+	// the second differences estimate how far the branches curve away from their planes
+	std::vector<std::vector<t_real>> vecGrads(iNumBranches, std::vector<t_real>(3, t_real(0)));
+	std::vector<t_real> vecCurv2(iNumBranches, t_real(0));
+	for(int iQ=0; iQ<3; ++iQ)
+	{
+		const t_real *pQRow = matTrafo + iQ*4;
+		const t_real dDelta = std::sqrt(pQRow[0]*pQRow[0] + pQRow[1]*pQRow[1] + pQRow[2]*pQRow[2] + pQRow[3]*pQRow[3]);
+		if(dDelta <= t_real(0))
+			continue;
+
+		t_real vecQ1[3] = { vecOffs[0], vecOffs[1], vecOffs[2] };
+		t_real vecQ2[3] = { vecOffs[0], vecOffs[1], vecOffs[2] };
+		vecQ1[iQ] -= dDelta;
+		vecQ2[iQ] += dDelta;
+
+		const std::vector<t_real> vecE1 = std::get<0>(sqw.disp(vecQ1[0], vecQ1[1], vecQ1[2]));
+		const std::vector<t_real> vecE2 = std::get<0>(sqw.disp(vecQ2[0], vecQ2[1], vecQ2[2]));
+
+		// the branches cannot be matched if their number changes
+		if(vecE1.size() != iNumBranches || vecE2.size() != iNumBranches)
+			continue;
+
+		for(std::size_t iBranch=0; iBranch<iNumBranches; ++iBranch)
+		{
+			vecGrads[iBranch][iQ] = (vecE2[iBranch] - vecE1[iBranch]) / (t_real(2)*dDelta);
+
+			const t_real dCurv = t_real(0.5) * (vecE1[iBranch] + vecE2[iBranch] - t_real(2)*vecE[iBranch]);
+			if(std::isfinite(dCurv))
+				vecCurv2[iBranch] += dCurv*dCurv;
+		}
+	}
+
+	const t_real dSigma = std::min(std::max(dWidth, t_real(1e-3)), t_real(1));
+	std::vector<t_real> vecDirs, vecCentre, vecWeight, vecMinSigma;
+	t_real dTotalWeight = 0;
+
+	for(std::size_t iBranch=0; iBranch<iNumBranches; ++iBranch)
+	{
+		t_real dBranchWeight = t_real(1);
+		if(vecW.size() == iNumBranches)
+			dBranchWeight = std::abs(vecW[iBranch]);
+		if(!std::isfinite(vecE[iBranch]) || !std::isfinite(dBranchWeight) || dBranchWeight <= t_real(0))
+			continue;
+
+		for(t_real dSign : { t_real(1), t_real(-1) })
+		{
+			if(dSign < t_real(0) && vecE[iBranch] == t_real(0))
+				continue;
+
+			// plane m*x = c for the deviates x
+			t_real vecNorm[4];
+			t_real dNorm2 = 0;
+			for(int j=0; j<4; ++j)
+			{
+				vecNorm[j] = matTrafo[3*4 + j];
+				for(int iQ=0; iQ<3; ++iQ)
+					vecNorm[j] -= dSign * vecGrads[iBranch][iQ] * matTrafo[iQ*4 + j];
+				dNorm2 += vecNorm[j]*vecNorm[j];
+			}
+			if(dNorm2 <= std::numeric_limits<t_real>::epsilon())
+				continue;
+
+			const t_real dNorm = std::sqrt(dNorm2);
+			const t_real dDist = (dSign*vecE[iBranch] - vecOffs[3]) / dNorm;
+			const t_real dWeight = dBranchWeight * std::exp(-t_real(0.5)*dDist*dDist) / dNorm;
+			if(!std::isfinite(dWeight) || dWeight <= t_real(0))
+				continue;
+
+			for(int j=0; j<4; ++j)
+				vecDirs.push_back(vecNorm[j] / dNorm);
+			vecCentre.push_back(dDist);
+			vecWeight.push_back(dWeight);
+			vecMinSigma.push_back(std::sqrt(vecCurv2[iBranch]) / dNorm);
+			dTotalWeight += dWeight;
+		}
+	}
+
+	// refine the components, first near the linearised position, then around the found peak
+	const std::size_t iNumScan = 64;
+	std::vector<t_real> vecSigma(vecCentre.size(), dSigma);
+	std::vector<t_real> vecRefWeight(vecCentre.size(), t_real(0));
+	t_real dTotalRefWeight = 0;
+
+	for(std::size_t iComp=0; iComp<vecCentre.size(); ++iComp)
+	{
+		if(vecWeight[iComp] < dTotalWeight * t_real(1e-4))
+			continue;
+
+		const t_real *pDir = vecDirs.data() + iComp*4;
+		t_real dIntegral = 0, dMean = 0, dStd = 0;
+		t_real dRange = t_real(1);
+		if(!scan_integrand(sqw, matTrafo, vecOffs, pDir, vecCentre[iComp]-dRange,
+			vecCentre[iComp]+dRange, iNumScan, dIntegral, dMean, dStd))
+		{
+			dRange = t_real(4);
+			if(!scan_integrand(sqw, matTrafo, vecOffs, pDir, vecCentre[iComp]-dRange,
+				vecCentre[iComp]+dRange, iNumScan, dIntegral, dMean, dStd))
+				continue;
+		}
+
+		t_real dHalfWidth = t_real(5) * std::max(dStd, t_real(2)*dRange/t_real(iNumScan-1));
+		if(scan_integrand(sqw, matTrafo, vecOffs, pDir, dMean-dHalfWidth, dMean+dHalfWidth,
+			iNumScan, dIntegral, dMean, dStd))
+		{
+			// a slightly broader proposal keeps the weights of the peak's tails small
+			dHalfWidth = t_real(2)*dHalfWidth/t_real(iNumScan-1);
+			dStd = t_real(1.25) * std::max(dStd, dHalfWidth);
+		}
+
+		vecCentre[iComp] = dMean;
+		vecSigma[iComp] = std::min(std::max(dStd, vecMinSigma[iComp]), t_real(1));
+		vecRefWeight[iComp] = dIntegral;
+		dTotalRefWeight += dIntegral;
+	}
+
+	// use the linearised estimates if there's no signal along any of the normals
+	if(dTotalRefWeight > t_real(0))
+	{
+		vecWeight = vecRefWeight;
+		dTotalWeight = dTotalRefWeight;
+	}
+	else
+	{
+		vecSigma.assign(vecCentre.size(), dSigma);
+	}
+
+	// normalise the weights and drop the negligible components
+	t_real dKeptWeight = 0;
+	for(std::size_t iComp=0; iComp<vecWeight.size(); ++iComp)
+	{
+		if(vecWeight[iComp] < dTotalWeight * t_real(1e-4))
+			continue;
+
+		imp.vecDirs.insert(imp.vecDirs.end(), vecDirs.begin()+iComp*4, vecDirs.begin()+(iComp+1)*4);
+		imp.vecCentre.push_back(vecCentre[iComp]);
+		imp.vecSigma.push_back(vecSigma[iComp]);
+		imp.vecWeight.push_back(vecWeight[iComp]);
+		dKeptWeight += vecWeight[iComp];
+	}
+
+	for(t_real& dWeight : imp.vecWeight)
+		dWeight /= dKeptWeight;
+
+	return imp;
+}
+
+
+/**
+ * draws batches of (importance-sampled) neutrons until the relative standard error
+ * of the weighted mean of S(q,w) reaches the target or the neutron limit is hit;
+ * if pStream is given, each batch draws from its own sub-stream
+ */
+bool convolve_adaptive(const TASReso& reso, const SqwBase& sqw,
+	const AdaptiveConvoOpts& opts, bool bUseThreads, AdaptiveConvoResult& res,
+	const std::atomic<bool>* pStop, const PhiloxStream* pStream)
+{
+	res = AdaptiveConvoResult();
+
+	const std::size_t iNumPos = reso.GetNumSamplePos();
+	const std::size_t iBatch = std::max<std::size_t>(opts.iBatch, 1);
+	const std::size_t iMaxNeutrons = std::max(opts.iMaxNeutrons, iBatch);
+	if(!iNumPos)
+		return false;
+
+	std::vector<McDispImportance<t_real>> vecImp(iNumPos);
+	for(std::size_t iPos=0; iPos<iNumPos; ++iPos)
+	{
+		vecImp[iPos] = get_disp_importance(sqw, reso.GetResoEllipsoid(iPos), reso.GetMCOpts(),
+			opts.dImportanceFrac, opts.dImportanceWidth);
+	}
+
+	McNeutronBatch<t_real> batch;
+	std::vector<t_real> vecWeights, vecS;
+	t_real dSum = 0, dSum2 = 0;
+
+	for(std::size_t iBatchIdx=0; res.iNumNeutrons < iMaxNeutrons; ++iBatchIdx)
+	{
+		if(pStop && pStop->load())
+			return false;
+
+		PhiloxStream streamBatch;
+		if(pStream)
+			streamBatch = pStream->Split(iBatchIdx);
+		const PhiloxStream *pStreamBatch = pStream ? &streamBatch : nullptr;
+
+		const std::size_t iNum = std::min(iBatch, iMaxNeutrons - res.iNumNeutrons);
+		if(bUseThreads)
+			reso.GenerateMC(iNum, vecImp, batch, vecWeights, pStreamBatch);
+		else
+			reso.GenerateMC_deferred(iNum, vecImp, batch, vecWeights, pStreamBatch);
+
+		const std::size_t iNumBatch = batch.size();
+		vecS.resize(iNumBatch);
+		sqw.SqwBatch(batch.vecH.data(), batch.vecK.data(), batch.vecL.data(), batch.vecE.data(),
+			vecS.data(), iNumBatch);
+
+		for(std::size_t iNeutr=0; iNeutr<iNumBatch; ++iNeutr)
+		{
+			const t_real dVal = vecWeights[iNeutr] * vecS[iNeutr];
+			dSum += dVal;
+			dSum2 += dVal*dVal;
+		}
+		res.iNumNeutrons += iNum;
+
+		const t_real dCnt = t_real(res.iNumNeutrons * iNumPos);
+		res.dS = dSum / dCnt;
+		res.dErr = std::sqrt(std::max(dSum2/dCnt - res.dS*res.dS, t_real(0)) / dCnt);
+
+		// no signal within the resolution ellipsoid
+		if(dSum == t_real(0))
+			break;
+		if(res.dErr <= opts.dTargetErr * std::abs(res.dS))
+			break;
+	}
+
+	return true;
+}
@@ -0,0 +1,70 @@
+/**
+ * adaptive MC convolution with importance sampling around the dispersion branches
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __CONVO_ADAPTIVE_H__
+#define __CONVO_ADAPTIVE_H__
+
+#include <atomic>
+#include <vector>
+
+#include "sqwbase.h"
+#include "TASReso.h"
+
+
+// maximum number of neutron batches per point for the monteconvo settings
+#define CONVO_ADAPTIVE_MAX_BATCHES	100
+
+
+/**
+ * settings of the adaptive convolution
+ */
+struct AdaptiveConvoOpts
+{
+	// neutrons per sample position drawn in each step
+	std::size_t iBatch = 1000;
+
+	// upper limit of neutrons per sample position
+	std::size_t iMaxNeutrons = 10000;
+
+	// stop when the standard error relative to the convolution result is below this value
+	t_real_reso dTargetErr = 0.01;
+
+	// fraction of neutrons sampled around the dispersion branches, 0: no importance sampling
+	t_real_reso dImportanceFrac = 0.5;
+
+	// width of the sampling across a branch if it cannot be determined from S(q,w),
+	// in units of the resolution width in that direction
+	t_real_reso dImportanceWidth = 0.2;
+};
+
+
+/**
+ * result of the adaptive convolution
+ */
+struct AdaptiveConvoResult
+{
+	// S(Q,E) averaged over the resolution function and its standard error
+	t_real_reso dS = 0.;
+	t_real_reso dErr = 0.;
+
+	// neutrons used per sample position
+	std::size_t iNumNeutrons = 0;
+};
+
+
+// MC proposal around the dispersion branches within the resolution ellipsoid
+extern McDispImportance<t_real_reso> get_disp_importance(const SqwBase& sqw,
+	const Ellipsoid4d<t_real_reso>& ell4d, const McNeutronOpts<ublas::matrix<t_real_reso>>& opts,
+	t_real_reso dFrac, t_real_reso dWidth);
+
+// convolution of S(q,w) with the resolution at the current position of reso
+extern bool convolve_adaptive(const TASReso& reso, const SqwBase& sqw,
+	const AdaptiveConvoOpts& opts, bool bUseThreads, AdaptiveConvoResult& res,
+	const std::atomic<bool>* pStop = nullptr, const PhiloxStream* pStream = nullptr);
+
+
+#endif
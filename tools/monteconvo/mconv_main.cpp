@@ -11,6 +11,7 @@
 #include <fstream>
 #include <memory>
 #include <unordered_map>
+#include <numeric>
 
 #include "tlibs/string/string.h"
 #include "tlibs/log/log.h"
@@ -193,7 +194,8 @@ static inline int monteconvo(const char* pcRes, const char* pcCrys,
 	ofstrOut << "# Format: h k l E S\n";
 	ofstrOut << "#\n";
 
-	std::vector<ublas::vector<t_real>> vecNeutrons;
+	McNeutronBatch<t_real> batch;
+	std::vector<t_real> vecS;
 	for(unsigned int iStep=0; iStep<iNumSteps; ++iStep)
 	{
 		t_real dProgress = t_real(iStep)/t_real(iNumSteps)*100.;
@@ -211,7 +213,7 @@ static inline int monteconvo(const char* pcRes, const char* pcCrys,
 			<< std::setprecision(3) << dProgress <<  "%"
 			<< " - generating MC neutrons"
 			<< "\x07" << std::flush;
-		Ellipsoid4d<t_real> elli = reso.GenerateMC(iNumNeutrons, vecNeutrons);
+		Ellipsoid4d<t_real> elli = reso.GenerateMC(iNumNeutrons, batch);
 
 		t_real dS = 0.;
 		t_real dhklE_mean[4] = {0., 0., 0., 0.};
@@ -220,13 +222,13 @@ static inline int monteconvo(const char* pcRes, const char* pcCrys,
 			<< std::setprecision(3) << dProgress <<  "%"
 			<< " - calculating S(q,w)"
 			<< "\x07" << std::flush;
-		for(const ublas::vector<t_real>& vecHKLE : vecNeutrons)
-		{
-			dS += (*psqw)(vecHKLE[0], vecHKLE[1], vecHKLE[2], vecHKLE[3]);
-
-			for(int i=0; i<4; ++i)
-				dhklE_mean[i] += vecHKLE[i];
-		}
+		const std::vector<t_real>* pComps[] = { &batch.vecH, &batch.vecK, &batch.vecL, &batch.vecE };
+		vecS.resize(batch.size());
+		psqw->SqwBatch(batch.vecH.data(), batch.vecK.data(), batch.vecL.data(), batch.vecE.data(),
+			vecS.data(), batch.size());
+		dS = std::accumulate(vecS.begin(), vecS.end(), t_real(0));
+		for(int i=0; i<4; ++i)
+			dhklE_mean[i] = std::accumulate(pComps[i]->begin(), pComps[i]->end(), t_real(0));
 
 		dS /= t_real(iNumNeutrons);
 		for(int i=0; i<4; ++i)
@@ -20,7 +20,8 @@ using t_real = t_real_reso;
 //------------------------------------------------------------------------------
 
 
-SqwElast::SqwElast(const char* pcFile) : m_bLoadedFromFile(true)
+SqwElast::SqwElast(const char* pcFile) : m_bLoadedFromFile(true),
+	m_pPeaks(std::make_shared<std::vector<ElastPeak>>())
 {
 	std::ifstream ifstr(pcFile);
 	if(!ifstr)
@@ -44,25 +45,93 @@ SqwElast::SqwElast(const char* pcFile) : m_bLoadedFromFile(true)
 		AddPeak(h,k,l, dSigQ, dSigE, dS);
 	}
 
-	tl::log_info("Number of elastic peaks: ", m_lstPeaks.size());
+	tl::log_info("Number of elastic peaks: ", m_pPeaks->size());
+	CreateIndex();
 	SqwBase::m_bOk = true;
 }
 
 void SqwElast::AddPeak(t_real h, t_real k, t_real l, t_real dSigQ, t_real dSigE, t_real dS)
 {
+	// don't modify the peaks of other copies
+	if(m_pPeaks.use_count() > 1)
+		m_pPeaks = std::make_shared<std::vector<ElastPeak>>(*m_pPeaks);
+
 	ElastPeak pk;
 	pk.h = h; pk.k = k; pk.l = l;
 	pk.dSigQ = dSigQ; pk.dSigE = dSigE;
 	pk.dS = dS;
-	m_lstPeaks.push_back(std::move(pk));
+	m_pPeaks->push_back(std::move(pk));
+
+	// the index is out of date, CreateIndex() has to be called again
+	m_pCells.reset();
 }
 
-t_real SqwElast::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
+
+/**
+ * sort the peaks into cells which are as large as the cutoff distance of the widest peak
+ */
+void SqwElast::CreateIndex()
 {
-	const ublas::vector<t_real> vecCur = tl::make_vec({dh, dk, dl});
+	m_pCells.reset();
+	m_dCellSize = 0.;
+
+	if(m_dSigmaCutoff <= 0. || !m_pPeaks->size())
+		return;
+
+	t_real dMaxSigQ = 0.;
+	for(const ElastPeak& pk : *m_pPeaks)
+		dMaxSigQ = std::max(dMaxSigQ, std::abs(pk.dSigQ));
+
+	m_dCellSize = m_dSigmaCutoff * dMaxSigQ;
+	if(m_dCellSize <= 0.)
+		return;
+
+	m_pCells = std::make_shared<t_cells>();
+	for(std::size_t iPeak=0; iPeak<m_pPeaks->size(); ++iPeak)
+	{
+		const ElastPeak& pk = (*m_pPeaks)[iPeak];
+		(*m_pCells)[GetCellKey(pk.h, pk.k, pk.l)].push_back(iPeak);
+	}
+}
+
+
+/**
+ * hash key of the cell containing (h,k,l), shifted by the given number of cells;
+ * distant cells may share a key, which only costs a few more peak evaluations
+ */
+std::int64_t SqwElast::GetCellKey(t_real dh, t_real dk, t_real dl, int iOffsH, int iOffsK, int iOffsL) const
+{
+	const std::int64_t iMask = (std::int64_t(1) << 21) - 1;
+
+	std::int64_t iH = std::int64_t(std::floor(dh / m_dCellSize)) + iOffsH;
+	std::int64_t iK = std::int64_t(std::floor(dk / m_dCellSize)) + iOffsK;
+	std::int64_t iL = std::int64_t(std::floor(dl / m_dCellSize)) + iOffsL;
+
+	return ((iH & iMask) << 42) | ((iK & iMask) << 21) | (iL & iMask);
+}
 
+
+t_real SqwElast::PeakContribution(const ElastPeak& pk, t_real dh, t_real dk, t_real dl, t_real dE) const
+{
+	const t_real dDistQ2 = (pk.h-dh)*(pk.h-dh) + (pk.k-dk)*(pk.k-dk) + (pk.l-dl)*(pk.l-dl);
+
+	if(m_dSigmaCutoff > 0.)
+	{
+		const t_real dMaxQ = m_dSigmaCutoff * pk.dSigQ;
+		if(dDistQ2 > dMaxQ*dMaxQ || std::abs(dE) > m_dSigmaCutoff * pk.dSigE)
+			return 0.;
+	}
+
+	return pk.dS * tl::gauss_model<t_real>(std::sqrt(dDistQ2), 0., pk.dSigQ, 1., 0.) *
+		tl::gauss_model<t_real>(dE, 0., pk.dSigE, 1., 0.);
+}
+
+
+t_real SqwElast::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
+{
 	if(!m_bLoadedFromFile)	// use nearest integer bragg peak
 	{
+		const ublas::vector<t_real> vecCur = tl::make_vec({dh, dk, dl});
 		const ublas::vector<t_real> vecPt = tl::make_vec({std::round(dh), std::round(dk), std::round(dl)});
 
 		const t_real dDistQ = ublas::norm_2(vecPt-vecCur);
@@ -76,13 +145,25 @@ t_real SqwElast::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 	{
 		t_real dS = 0.;
 
-		for(const ElastPeak& pk : m_lstPeaks)
+		if(m_pCells)
 		{
-			const ublas::vector<t_real> vecPk = tl::make_vec({pk.h, pk.k, pk.l});
-			const t_real dDistQ = ublas::norm_2(vecPk-vecCur);
+			// all peaks within the cutoff are in the surrounding cells
+			for(int iOffsH=-1; iOffsH<=1; ++iOffsH)
+			for(int iOffsK=-1; iOffsK<=1; ++iOffsK)
+			for(int iOffsL=-1; iOffsL<=1; ++iOffsL)
+			{
+				auto iterCell = m_pCells->find(GetCellKey(dh, dk, dl, iOffsH, iOffsK, iOffsL));
+				if(iterCell == m_pCells->end())
+					continue;
 
-			dS += pk.dS * tl::gauss_model<t_real>(dDistQ, 0., pk.dSigQ, 1., 0.) *
-				tl::gauss_model<t_real>(dE, 0., pk.dSigE, 1., 0.);
+				for(std::size_t iPeak : iterCell->second)
+					dS += PeakContribution((*m_pPeaks)[iPeak], dh, dk, dl, dE);
+			}
+		}
+		else
+		{
+			for(const ElastPeak& pk : *m_pPeaks)
+				dS += PeakContribution(pk, dh, dk, dl, dE);
 		}
 
 		return dS;
@@ -93,12 +174,30 @@ t_real SqwElast::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 std::vector<SqwBase::t_var> SqwElast::GetVars() const
 {
 	std::vector<SqwBase::t_var> vecVars;
+
+	vecVars.push_back(SqwBase::t_var{"sigma_cutoff", "real", tl::var_to_str(m_dSigmaCutoff)});
+
 	return vecVars;
 }
 
 
-void SqwElast::SetVars(const std::vector<SqwBase::t_var>&)
+void SqwElast::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 {
+	for(const SqwBase::t_var& var : vecVars)
+	{
+		const std::string& strVar = std::get<0>(var);
+		const std::string& strVal = std::get<2>(var);
+
+		if(strVar == "sigma_cutoff")
+		{
+			t_real dCutoff = tl::str_to_var<t_real>(strVal);
+			if(!tl::float_equal<t_real>(dCutoff, m_dSigmaCutoff))
+			{
+				m_dSigmaCutoff = dCutoff;
+				CreateIndex();
+			}
+		}
+	}
 }
 
 
@@ -108,7 +207,10 @@ SqwBase* SqwElast::shallow_copy() const
 	*static_cast<SqwBase*>(pElast) = *static_cast<const SqwBase*>(this);
 
 	pElast->m_bLoadedFromFile = m_bLoadedFromFile;
-	pElast->m_lstPeaks = m_lstPeaks;	// not a shallow copy!
+	pElast->m_pPeaks = m_pPeaks;
+	pElast->m_pCells = m_pCells;
+	pElast->m_dCellSize = m_dCellSize;
+	pElast->m_dSigmaCutoff = m_dSigmaCutoff;
 	return pElast;
 }
 
@@ -127,16 +229,15 @@ SqwKdTree::SqwKdTree(const char* pcFile)
 }
 
 
-bool SqwKdTree::open(const char* pcFile)
+/**
+ * reads the S(q,w) points and the header parameters from the file
+ */
+bool SqwKdTree::ReadFile(std::list<std::vector<t_real>>& lstPoints)
 {
-	m_kd = std::make_shared<tl::Kd<t_real>>();
-
-	std::ifstream ifstr(pcFile);
+	std::ifstream ifstr(m_strFile);
 	if(!ifstr.is_open())
 		return false;
 
-	std::list<std::vector<t_real>> lstPoints;
-	std::size_t iCurPoint = 0;
 	while(!ifstr.eof())
 	{
 		std::string strLine;
@@ -162,13 +263,60 @@ bool SqwKdTree::open(const char* pcFile)
 		}
 
 		lstPoints.push_back(vecSqw);
-		++iCurPoint;
 	}
 
-	tl::log_info("Loaded ",  iCurPoint, " S(q,w) points.");
+	return true;
+}
+
+
+/**
+ * the interpolator is only needed if interpolation is enabled, so it is
+ * created on demand, re-reading the points from the file if necessary
+ */
+void SqwKdTree::CreateInterp(const std::list<std::vector<t_real>>* plstPoints)
+{
+	std::list<std::vector<t_real>> lstPoints;
+	if(!plstPoints)
+	{
+		if(!ReadFile(lstPoints))
+		{
+			tl::log_err("Cannot reload S(q,w) points for interpolation.");
+			return;
+		}
+		plstPoints = &lstPoints;
+	}
+
+	m_interp = std::make_shared<TableInterp<t_real>>();
+	m_interp->Load(*plstPoints, 4);
+	tl::log_info("Points ", m_interp->IsRegular() ? "form" : "do not form", " a regular grid.");
+}
+
+
+bool SqwKdTree::open(const char* pcFile)
+{
+	m_strFile = pcFile;
+	m_kd = std::make_shared<tl::Kd<t_real>>();
+	m_interp.reset();
+
+	std::list<std::vector<t_real>> lstPoints;
+	if(!ReadFile(lstPoints))
+		return false;
+
+	tl::log_info("Loaded ",  lstPoints.size(), " S(q,w) points.");
 	m_kd->Load(lstPoints, 4);
 	tl::log_info("Generated k-d tree.");
 
+	// interpolation can be switched on in the file header
+	auto iterInterp = m_mapParams.find("interp");
+	if(iterInterp != m_mapParams.end())
+		m_bInterp = tl::str_to_var<bool>(iterInterp->second);
+	auto iterNeighbours = m_mapParams.find("interp_neighbours");
+	if(iterNeighbours != m_mapParams.end())
+		m_iNeighbours = tl::str_to_var<unsigned int>(iterNeighbours->second);
+
+	if(m_bInterp)
+		CreateInterp(&lstPoints);
+
 	//std::ofstream ofstrkd("kd.dbg");
 	//m_kd->GetRootNode()->print(ofstrkd);
 	return true;
@@ -179,6 +327,8 @@ t_real SqwKdTree::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 {
 	// meV and rlu units will have equal scaling in the kd tree!
 	std::vector<t_real> vechklE = {dh, dk, dl, dE};
+	if(m_bInterp && m_interp)
+		return (*m_interp)(vechklE.data(), m_iNeighbours);
 	if(!m_kd->IsPointInGrid(vechklE))
 		return 0.;
 
@@ -195,16 +345,61 @@ t_real SqwKdTree::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 }
 
 
+/**
+ * S(Q,E) for arrays of points, reusing the query vector
+ */
+void SqwKdTree::SqwBatch(const t_real* pH, const t_real* pK, const t_real* pL,
+	const t_real* pE, t_real* pS, std::size_t iNum) const
+{
+	std::vector<t_real> vechklE(4);
+
+	for(std::size_t i=0; i<iNum; ++i)
+	{
+		vechklE[0] = pH[i]; vechklE[1] = pK[i];
+		vechklE[2] = pL[i]; vechklE[3] = pE[i];
+
+		if(m_bInterp && m_interp)
+		{
+			pS[i] = (*m_interp)(vechklE.data(), m_iNeighbours);
+			continue;
+		}
+
+		if(!m_kd->IsPointInGrid(vechklE))
+		{
+			pS[i] = 0.;
+			continue;
+		}
+
+		const std::vector<t_real>& vec = m_kd->GetNearestNode(vechklE);
+		pS[i] = vec[4];
+	}
+}
+
+
 std::vector<SqwBase::t_var> SqwKdTree::GetVars() const
 {
 	std::vector<SqwBase::t_var> vecVars;
 
+	vecVars.push_back(SqwBase::t_var{"interp", "uint", tl::var_to_str(m_bInterp)});
+	vecVars.push_back(SqwBase::t_var{"interp_neighbours", "uint", tl::var_to_str(m_iNeighbours)});
+
 	return vecVars;
 }
 
 
-void SqwKdTree::SetVars(const std::vector<SqwBase::t_var>&)
+void SqwKdTree::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 {
+	for(const SqwBase::t_var& var : vecVars)
+	{
+		const std::string& strVar = std::get<0>(var);
+		const std::string& strVal = std::get<2>(var);
+
+		if(strVar == "interp") m_bInterp = tl::str_to_var<decltype(m_bInterp)>(strVal);
+		else if(strVar == "interp_neighbours") m_iNeighbours = tl::str_to_var<decltype(m_iNeighbours)>(strVal);
+	}
+
+	if(m_bInterp && !m_interp && m_strFile.length())
+		CreateInterp();
 }
 
 
@@ -214,7 +409,11 @@ SqwBase* SqwKdTree::shallow_copy() const
 	*static_cast<SqwBase*>(pTree) = *static_cast<const SqwBase*>(this);
 
 	pTree->m_mapParams = m_mapParams;
+	pTree->m_strFile = m_strFile;
 	pTree->m_kd = m_kd;
+	pTree->m_interp = m_interp;
+	pTree->m_bInterp = m_bInterp;
+	pTree->m_iNeighbours = m_iNeighbours;
 
 	return pTree;
 }
@@ -255,25 +454,19 @@ void SqwTable1d::CreateKd()
 	}
 
 	m_kd = std::make_shared<tl::Kd<t_real>>();
-	std::list<std::vector<t_real>> lstPoints;
+	std::list<std::vector<t_real>> lstPoints = GetPoints();
 
 	t_real minq = std::numeric_limits<t_real>::max();
 	t_real maxq = -std::numeric_limits<t_real>::max();
 	t_real minE = std::numeric_limits<t_real>::max();
 	t_real maxE = -std::numeric_limits<t_real>::max();
 
-	for(std::size_t iRow=0; iRow<m_dat->GetRowCount(); ++iRow)
+	for(const std::vector<t_real>& vecPt : lstPoints)
 	{
-		t_real q = m_dat->GetColumn(m_qcol)[iRow];
-		t_real E = m_dat->GetColumn(m_Ecol)[iRow];
-		t_real S = m_dat->GetColumn(m_Scol)[iRow];
-
-		minq = std::min(minq, q);
-		maxq = std::max(maxq, q);
-		minE = std::min(minE, E);
-		maxE = std::max(maxE, E);
-
-		lstPoints.emplace_back(std::vector<t_real>{{ q, E, S }});
+		minq = std::min(minq, vecPt[0]);
+		maxq = std::max(maxq, vecPt[0]);
+		minE = std::min(minE, vecPt[1]);
+		maxE = std::max(maxE, vecPt[1]);
 	}
 
 	tl::log_info("Loaded ", m_dat->GetRowCount(), " S(q,w) points.");
@@ -281,6 +474,36 @@ void SqwTable1d::CreateKd()
 
 	m_kd->Load(lstPoints, 2);
 	tl::log_info("Generated k-d tree.");
+
+	// the interpolator only has to be created if it is used
+	m_interp.reset();
+	if(m_bInterp)
+		CreateInterp(lstPoints);
+}
+
+
+void SqwTable1d::CreateInterp(const std::list<std::vector<t_real>>& lstPoints)
+{
+	m_interp = std::make_shared<TableInterp<t_real>>();
+	m_interp->Load(lstPoints, 2);
+	tl::log_info("Points ", m_interp->IsRegular() ? "form" : "do not form", " a regular grid.");
+}
+
+
+/**
+ * (q, E, S) points from the table columns
+ */
+std::list<std::vector<t_real>> SqwTable1d::GetPoints() const
+{
+	std::list<std::vector<t_real>> lstPoints;
+
+	for(std::size_t iRow=0; iRow<m_dat->GetRowCount(); ++iRow)
+	{
+		lstPoints.emplace_back(std::vector<t_real>{{ m_dat->GetColumn(m_qcol)[iRow],
+			m_dat->GetColumn(m_Ecol)[iRow], m_dat->GetColumn(m_Scol)[iRow] }});
+	}
+
+	return lstPoints;
 }
 
 
@@ -296,6 +519,8 @@ t_real SqwTable1d::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 	// meV and rlu units will have equal scaling in the kd tree!
 	std::vector<t_real> vecqE{{dq, dE}};
 
+	if(m_bInterp && m_interp)
+		return (*m_interp)(vecqE.data(), m_iNeighbours);
 	if(!m_kd->IsPointInGrid(vecqE))
 		return 0.;
 
@@ -320,6 +545,8 @@ std::vector<SqwBase::t_var> SqwTable1d::GetVars() const
 	vecVars.push_back(SqwBase::t_var{"E_column", "uint", tl::var_to_str(m_Ecol)});
 	vecVars.push_back(SqwBase::t_var{"S_column", "uint", tl::var_to_str(m_Scol)});
 	vecVars.push_back(SqwBase::t_var{"G", "vector", ostr.str()});
+	vecVars.push_back(SqwBase::t_var{"interp", "uint", tl::var_to_str(m_bInterp)});
+	vecVars.push_back(SqwBase::t_var{"interp_neighbours", "uint", tl::var_to_str(m_iNeighbours)});
 
 	return vecVars;
 }
@@ -330,6 +557,8 @@ void SqwTable1d::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 	if(vecVars.size() == 0)
 		return;
 
+	const unsigned int iOldCols[] = { m_qcol, m_Ecol, m_Scol };
+
 	for(const SqwBase::t_var& var : vecVars)
 	{
 		const std::string& strVar = std::get<0>(var);
@@ -338,6 +567,8 @@ void SqwTable1d::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 		if(strVar == "q_column") m_qcol = tl::str_to_var<decltype(m_qcol)>(strVal);
 		else if(strVar == "E_column") m_Ecol = tl::str_to_var<decltype(m_Ecol)>(strVal);
 		else if(strVar == "S_column") m_Scol = tl::str_to_var<decltype(m_Scol)>(strVal);
+		else if(strVar == "interp") m_bInterp = tl::str_to_var<decltype(m_bInterp)>(strVal);
+		else if(strVar == "interp_neighbours") m_iNeighbours = tl::str_to_var<decltype(m_iNeighbours)>(strVal);
 		else if(strVar == "G")
 		{
 			std::istringstream istr(strVal);
@@ -345,7 +576,11 @@ void SqwTable1d::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 		}
 	}
 
-	CreateKd();
+	// only rebuild the tables if other columns are used
+	if(iOldCols[0] != m_qcol || iOldCols[1] != m_Ecol || iOldCols[2] != m_Scol || !m_kd)
+		CreateKd();
+	else if(m_bInterp && !m_interp && m_bOk)
+		CreateInterp(GetPoints());
 }
 
 
@@ -356,6 +591,9 @@ SqwBase* SqwTable1d::shallow_copy() const
 
 	pTab->m_dat = m_dat;
 	pTab->m_kd = m_kd;
+	pTab->m_interp = m_interp;
+	pTab->m_bInterp = m_bInterp;
+	pTab->m_iNeighbours = m_iNeighbours;
 
 	return pTab;
 }
@@ -382,7 +620,6 @@ void SqwPhonon::create()
 	m_kd = std::make_shared<tl::Kd<t_real>>();
 #endif
 
-	const bool bSaveOnlyIndices = 1;
 	destroy();
 
 	if(m_vecBragg.size()==0 || m_vecLA.size()==0 || m_vecTA1.size()==0 || m_vecTA2.size()==0)
@@ -405,6 +642,8 @@ void SqwPhonon::create()
 	tl::log_info("TA1: ", m_vecTA1);
 	tl::log_info("TA2: ", m_vecTA2);
 
+	// the nodes only hold the geometry: the position along the branch and the
+	// branch index, energies and widths are calculated from the current parameters
 	std::list<std::vector<t_real>> lst;
 	for(t_real dq=-1.; dq<1.; dq+=1./t_real(m_iNumqs))
 	{
@@ -412,34 +651,12 @@ void SqwPhonon::create()
 		ublas::vector<t_real> vecQTA1 = dq*m_vecTA1;
 		ublas::vector<t_real> vecQTA2 = dq*m_vecTA2;
 
-		t_real dELA = phonon_disp(dq, m_dLA_amp, m_dLA_freq);
-		t_real dETA1 = phonon_disp(dq, m_dTA1_amp, m_dTA1_freq);
-		t_real dETA2 = phonon_disp(dq, m_dTA2_amp, m_dTA2_freq);
-
-		t_real dLA_E_HWHM = m_dLA_E_HWHM;
-		t_real dLA_q_HWHM = m_dLA_q_HWHM;
-		t_real dTA1_E_HWHM = m_dTA1_E_HWHM;
-		t_real dTA1_q_HWHM = m_dTA1_q_HWHM;
-		t_real dTA2_E_HWHM = m_dTA2_E_HWHM;
-		t_real dTA2_q_HWHM = m_dTA2_q_HWHM;
-
-		t_real dLA_S0 = m_dLA_S0;
-		t_real dTA1_S0 = m_dTA1_S0;
-		t_real dTA2_S0 = m_dTA2_S0;
-
-		if(bSaveOnlyIndices)
-		{
-			dTA1_E_HWHM = dTA1_q_HWHM = dTA1_S0 = -1.;
-			dTA2_E_HWHM = dTA2_q_HWHM = dTA2_S0 = -2.;
-			dLA_E_HWHM = dLA_q_HWHM = dLA_S0 = -3.;
-		}
-
 		// only generate exact phonon branches, no arcs
 		if(m_iNumArc==0 || m_iNumArc==1)
 		{
-			lst.push_back(std::vector<t_real>({vecQLA[0]+m_vecBragg[0], vecQLA[1]+m_vecBragg[1], vecQLA[2]+m_vecBragg[2], dELA, dLA_S0, dLA_E_HWHM, dLA_q_HWHM}));
-			lst.push_back(std::vector<t_real>({vecQTA1[0]+m_vecBragg[0], vecQTA1[1]+m_vecBragg[1], vecQTA1[2]+m_vecBragg[2], dETA1, dTA1_S0, dTA1_E_HWHM, dTA1_q_HWHM}));
-			lst.push_back(std::vector<t_real>({vecQTA2[0]+m_vecBragg[0], vecQTA2[1]+m_vecBragg[1], vecQTA2[2]+m_vecBragg[2], dETA2, dTA2_S0, dTA2_E_HWHM, dTA2_q_HWHM}));
+			lst.push_back(std::vector<t_real>({vecQLA[0]+m_vecBragg[0], vecQLA[1]+m_vecBragg[1], vecQLA[2]+m_vecBragg[2], dq, t_real(BRANCH_LA)}));
+			lst.push_back(std::vector<t_real>({vecQTA1[0]+m_vecBragg[0], vecQTA1[1]+m_vecBragg[1], vecQTA1[2]+m_vecBragg[2], dq, t_real(BRANCH_TA1)}));
+			lst.push_back(std::vector<t_real>({vecQTA2[0]+m_vecBragg[0], vecQTA2[1]+m_vecBragg[1], vecQTA2[2]+m_vecBragg[2], dq, t_real(BRANCH_TA2)}));
 		}
 		else
 		{
@@ -449,15 +666,15 @@ void SqwPhonon::create()
 			{
 				// ta2
 				ublas::vector<t_real> vecArcTA2 = tl::sph_shell(vecQTA2, dph, dth) + m_vecBragg;;
-				lst.push_back(std::vector<t_real>({vecArcTA2[0], vecArcTA2[1], vecArcTA2[2], dETA2, dTA2_S0, dTA2_E_HWHM, dTA2_q_HWHM}));
+				lst.push_back(std::vector<t_real>({vecArcTA2[0], vecArcTA2[1], vecArcTA2[2], dq, t_real(BRANCH_TA2)}));
 
 				// ta1
 				ublas::vector<t_real> vecArcTA1 = tl::sph_shell(vecQTA1, dph, dth) + m_vecBragg;;
-				lst.push_back(std::vector<t_real>({vecArcTA1[0], vecArcTA1[1], vecArcTA1[2], dETA1, dTA1_S0, dTA1_E_HWHM, dTA1_q_HWHM}));
+				lst.push_back(std::vector<t_real>({vecArcTA1[0], vecArcTA1[1], vecArcTA1[2], dq, t_real(BRANCH_TA1)}));
 
 				// la
 				ublas::vector<t_real> vecArcLA = tl::sph_shell(vecQLA, dph, dth) + m_vecBragg;;
-				lst.push_back(std::vector<t_real>({vecArcLA[0], vecArcLA[1], vecArcLA[2], dELA, dLA_S0, dLA_E_HWHM, dLA_q_HWHM}));
+				lst.push_back(std::vector<t_real>({vecArcLA[0], vecArcLA[1], vecArcLA[2], dq, t_real(BRANCH_LA)}));
 			}
 		}
 	}
@@ -573,6 +790,31 @@ SqwPhonon::SqwPhonon(const char* pcFile)
 t_real SqwPhonon::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 {
 	std::vector<t_real> vechklE = {dh, dk, dl, dE};
+	return SqwAtPoint(vechklE);
+}
+
+
+/**
+ * S(Q,E) for arrays of points, reusing the query vector
+ */
+void SqwPhonon::SqwBatch(const t_real* pH, const t_real* pK, const t_real* pL,
+	const t_real* pE, t_real* pS, std::size_t iNum) const
+{
+	std::vector<t_real> vechklE(4);
+
+	for(std::size_t i=0; i<iNum; ++i)
+	{
+		vechklE[0] = pH[i]; vechklE[1] = pK[i];
+		vechklE[2] = pL[i]; vechklE[3] = pE[i];
+
+		pS[i] = SqwAtPoint(vechklE);
+	}
+}
+
+
+t_real SqwPhonon::SqwAtPoint(const std::vector<t_real>& vechklE) const
+{
+	const t_real dE = vechklE[3];
 #ifdef USE_RTREE
 	if(!m_rt->IsPointInGrid(vechklE)) return 0.;
 	std::vector<t_real> vec = m_rt->GetNearestNode(vechklE);
@@ -584,39 +826,31 @@ t_real SqwPhonon::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 	//std::cout << "query: " << dh << " " << dk << " " << dl << " " << dE << std::endl;
 	//std::cout << "nearest: " << vec[0] << " " << vec[1] << " " << vec[2] << " " << vec[3] << std::endl;
 
-	t_real dE0 = vec[3];
-	t_real dS = vec[4];
-	t_real dT = m_dT;
-	t_real dE_HWHM = vec[5];
-	t_real dQ_HWHM = vec[6];
+	const t_real dq = vec[3];
+	const t_real dT = m_dT;
+	t_real dE0, dS, dE_HWHM, dQ_HWHM;
 
-	// index, not value
-	if(dE_HWHM < 0.)
+	switch(int(std::round(vec[4])))
 	{
-		if(tl::float_equal<t_real>(dE_HWHM, -1., 0.1))		// TA1
+		case BRANCH_TA1:
+			dE0 = phonon_disp(dq, m_dTA1_amp, m_dTA1_freq);
+			dS = m_dTA1_S0;
 			dE_HWHM = m_dTA1_E_HWHM;
-		else if(tl::float_equal<t_real>(dE_HWHM, -2., 0.1))	// TA2
-			dE_HWHM = m_dTA2_E_HWHM;
-		else if(tl::float_equal<t_real>(dE_HWHM, -3., 0.1))	// LA
-			dE_HWHM = m_dLA_E_HWHM;
-	}
-	if(dQ_HWHM < 0.)
-	{
-		if(tl::float_equal<t_real>(dQ_HWHM, -1., 0.1))		// TA1
 			dQ_HWHM = m_dTA1_q_HWHM;
-		else if(tl::float_equal<t_real>(dQ_HWHM, -2., 0.1))	// TA2
-			dQ_HWHM = m_dTA2_q_HWHM;
-		else if(tl::float_equal<t_real>(dQ_HWHM, -3., 0.1))	// LA
-			dQ_HWHM = m_dLA_q_HWHM;
-	}
-	if(dS < 0.)
-	{
-		if(tl::float_equal<t_real>(dS, -1., 0.1))		// TA1
-			dS = m_dTA1_S0;
-		else if(tl::float_equal<t_real>(dS, -2., 0.1))	// TA2
+			break;
+		case BRANCH_TA2:
+			dE0 = phonon_disp(dq, m_dTA2_amp, m_dTA2_freq);
 			dS = m_dTA2_S0;
-		else if(tl::float_equal<t_real>(dS, -3., 0.1))	// LA
+			dE_HWHM = m_dTA2_E_HWHM;
+			dQ_HWHM = m_dTA2_q_HWHM;
+			break;
+		case BRANCH_LA:
+		default:
+			dE0 = phonon_disp(dq, m_dLA_amp, m_dLA_freq);
 			dS = m_dLA_S0;
+			dE_HWHM = m_dLA_E_HWHM;
+			dQ_HWHM = m_dLA_q_HWHM;
+			break;
 	}
 
 	t_real dqDist = std::sqrt(std::pow(vec[0]-vechklE[0], 2.)
@@ -677,6 +911,11 @@ void SqwPhonon::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 	if(vecVars.size() == 0)
 		return;
 
+	const unsigned int iOldNumqs = m_iNumqs, iOldNumArc = m_iNumArc;
+	const t_real dOldArcMax = m_dArcMax;
+	const ublas::vector<t_real> vecOldBragg = m_vecBragg, vecOldLA = m_vecLA;
+	const ublas::vector<t_real> vecOldTA1 = m_vecTA1, vecOldTA2 = m_vecTA2;
+
 	for(const SqwBase::t_var& var : vecVars)
 	{
 		const std::string& strVar = std::get<0>(var);
@@ -714,19 +953,34 @@ void SqwPhonon::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 		else if(strVar == "T") m_dT = tl::str_to_var<decltype(m_dT)>(strVal);
 	}
 
-	bool bRecreateTree = 0;
-
-	for(const SqwBase::t_var& var : vecVars)
+	// only the geometry of the branches is stored in the tree, the dispersion
+	// parameters are evaluated on each query and need no rebuild
+	auto same_dir = [](const ublas::vector<t_real>& vec1, const ublas::vector<t_real>& vec2) -> bool
 	{
-		const std::string& strVar = std::get<0>(var);
-		if(strVar != "T" && strVar.find("HWHM") == std::string::npos &&
-			strVar.find("inc") == std::string::npos &&
-			strVar.find("S0") == std::string::npos)
-			bRecreateTree = 1;
-	}
+		if(vec1.size() != vec2.size())
+			return false;
+		if(vec1.size() == 0)
+			return true;
+		return ublas::norm_2(vec1/ublas::norm_2(vec1) - vec2/ublas::norm_2(vec2)) < 1e-8;
+	};
+
+	bool bRecreateTree = m_iNumqs != iOldNumqs || m_iNumArc != iOldNumArc ||
+		!tl::float_equal<t_real>(m_dArcMax, dOldArcMax) ||
+		m_vecBragg.size() != vecOldBragg.size() ||
+		(m_vecBragg.size() && ublas::norm_2(m_vecBragg - vecOldBragg) > 1e-8) ||
+		!same_dir(m_vecTA1, vecOldTA1) || !same_dir(m_vecTA2, vecOldTA2);
 
 	if(bRecreateTree)
+	{
 		create();
+	}
+	else
+	{
+		// keep the normalised directions
+		m_vecLA = vecOldLA;
+		m_vecTA1 = vecOldTA1;
+		m_vecTA2 = vecOldTA2;
+	}
 }
 
 
@@ -11,7 +11,9 @@
 //#define USE_RTREE
 
 #include <list>
+#include <vector>
 #include <unordered_map>
+#include <cstdint>
 
 #include "tlibs/helper/boost_hacks.h"
 #include <boost/numeric/ublas/vector.hpp>
@@ -21,6 +23,7 @@
 #include "tlibs/file/loaddat.h"
 #include "../res/defs.h"
 #include "sqwbase.h"
+#include "sqw_interp.h"
 
 #ifdef USE_RTREE
 	#include "tlibs/math/rt.h"
@@ -46,15 +49,29 @@ struct ElastPeak
 class SqwElast : public SqwBase
 {
 protected:
+	using t_cells = std::unordered_map<std::int64_t, std::vector<std::size_t>>;
+
 	bool m_bLoadedFromFile = false;
-	std::list<ElastPeak> m_lstPeaks;
+	std::shared_ptr<std::vector<ElastPeak>> m_pPeaks;
+
+	// spatial hash of the peaks: only peaks in the neighbouring cells are evaluated
+	std::shared_ptr<t_cells> m_pCells;
+	t_real_reso m_dCellSize = 0.;
+
+	// peaks farther away than this many sigmas are ignored, 0: evaluate all peaks
+	t_real_reso m_dSigmaCutoff = 8.;
+
+protected:
+	std::int64_t GetCellKey(t_real_reso dh, t_real_reso dk, t_real_reso dl, int iOffsH=0, int iOffsK=0, int iOffsL=0) const;
+	t_real_reso PeakContribution(const ElastPeak& pk, t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const;
 
 public:
-	SqwElast() { SqwBase::m_bOk = true; }
+	SqwElast() : m_pPeaks(std::make_shared<std::vector<ElastPeak>>()) { SqwBase::m_bOk = true; }
 	SqwElast(const char* pcFile);
 	virtual t_real_reso operator()(t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const override;
 
 	void AddPeak(t_real_reso h, t_real_reso k, t_real_reso l, t_real_reso dSigQ, t_real_reso dSigE, t_real_reso dS);
+	void CreateIndex();
 
 	virtual std::vector<SqwBase::t_var> GetVars() const override;
 	virtual void SetVars(const std::vector<SqwBase::t_var>&) override;
@@ -74,6 +91,16 @@ class SqwKdTree : public SqwBase
 protected:
 	std::unordered_map<std::string, std::string> m_mapParams;
 	std::shared_ptr<tl::Kd<t_real_reso>> m_kd;
+	std::string m_strFile;
+
+	// interpolate instead of using the nearest node?
+	std::shared_ptr<TableInterp<t_real_reso>> m_interp;
+	bool m_bInterp = false;
+	unsigned int m_iNeighbours = 8;
+
+protected:
+	bool ReadFile(std::list<std::vector<t_real_reso>>& lstPoints);
+	void CreateInterp(const std::list<std::vector<t_real_reso>>* plstPoints = nullptr);
 
 public:
 	SqwKdTree(const char* pcFile = nullptr);
@@ -81,6 +108,8 @@ public:
 
 	bool open(const char* pcFile);
 	virtual t_real_reso operator()(t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const override;
+	virtual void SqwBatch(const t_real_reso* pH, const t_real_reso* pK, const t_real_reso* pL,
+		const t_real_reso* pE, t_real_reso* pS, std::size_t iNum) const override;
 
 	virtual std::vector<SqwBase::t_var> GetVars() const override;
 	virtual void SetVars(const std::vector<SqwBase::t_var>&) override;
@@ -102,6 +131,11 @@ protected:
 	std::shared_ptr<tl::DatFile<t_real_reso>> m_dat;
 	std::shared_ptr<tl::Kd<t_real_reso>> m_kd;
 
+	// interpolate instead of using the nearest node?
+	std::shared_ptr<TableInterp<t_real_reso>> m_interp;
+	bool m_bInterp = false;
+	unsigned int m_iNeighbours = 4;
+
 	t_real_reso m_G[3] = { 0., 0., 0. };
 
 	unsigned int m_qcol = 0;
@@ -110,6 +144,8 @@ protected:
 
 protected:
 	void CreateKd();
+	void CreateInterp(const std::list<std::vector<t_real_reso>>& lstPoints);
+	std::list<std::vector<t_real_reso>> GetPoints() const;
 
 public:
 	SqwTable1d(const char* pcFile = nullptr);
@@ -139,11 +175,16 @@ private:
 	SqwPhonon() {};
 
 protected:
+	// branch indices stored in the tree nodes
+	enum : int { BRANCH_TA1 = 1, BRANCH_TA2 = 2, BRANCH_LA = 3 };
+
 	static t_real_reso phonon_disp(t_real_reso dq, t_real_reso da, t_real_reso df);
 
 	void create();
 	void destroy();
 
+	t_real_reso SqwAtPoint(const std::vector<t_real_reso>& vechklE) const;
+
 protected:
 #ifdef USE_RTREE
 	std::shared_ptr<tl::Rt<t_real_reso, 3, RT_ELEMS>> m_rt;
@@ -180,6 +221,8 @@ public:
 	virtual ~SqwPhonon() = default;
 
 	virtual t_real_reso operator()(t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const override;
+	virtual void SqwBatch(const t_real_reso* pH, const t_real_reso* pK, const t_real_reso* pL,
+		const t_real_reso* pE, t_real_reso* pS, std::size_t iNum) const override;
 
 
 	const ublas::vector<t_real_reso>& GetBragg() const { return m_vecBragg; }
@@ -0,0 +1,526 @@
+/**
+ * memory-mapped S(Q,w) grid model
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#include "sqw_grid.h"
+#include "tlibs/string/string.h"
+#include "tlibs/log/log.h"
+#include "tlibs/math/math.h"
+#include "tlibs/phys/neutrons.h"
+#include "tlibs/file/prop.h"
+
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cmath>
+
+using t_real = t_real_reso;
+namespace ipr = boost::interprocess;
+
+
+// ----------------------------------------------------------------------------
+// model
+
+SqwGrid::SqwGrid(const char* pcFile)
+{
+	if(pcFile)
+		m_bOk = open(pcFile);
+}
+
+
+/**
+ * map the grid file, it stays mapped for the lifetime of the model and its copies
+ */
+bool SqwGrid::open(const char* pcFile)
+{
+	m_pHeader = nullptr;
+	m_pIdx = nullptr;
+	m_pBranches = nullptr;
+
+	try
+	{
+		m_pFile = std::make_shared<ipr::file_mapping>(pcFile, ipr::read_only);
+		m_pRegion = std::make_shared<ipr::mapped_region>(*m_pFile, ipr::read_only);
+	}
+	catch(const std::exception& ex)
+	{
+		tl::log_err("Cannot map grid file \"", pcFile, "\": ", ex.what(), ".");
+		return false;
+	}
+
+	const std::size_t iFileSize = m_pRegion->get_size();
+	const char *pcMem = static_cast<const char*>(m_pRegion->get_address());
+
+	if(iFileSize < sizeof(SqwGridHeader))
+	{
+		tl::log_err("Grid file \"", pcFile, "\" is too small.");
+		return false;
+	}
+
+	const SqwGridHeader *pHeader = reinterpret_cast<const SqwGridHeader*>(pcMem);
+	if(std::strncmp(pHeader->magic, SQWGRID_MAGIC, sizeof(pHeader->magic)) != 0)
+	{
+		tl::log_err("\"", pcFile, "\" is not a grid file.");
+		return false;
+	}
+	if(pHeader->iVersion != SQWGRID_VERSION || pHeader->iRealSize != sizeof(double))
+	{
+		tl::log_err("Unsupported version or float size in grid file \"", pcFile, "\".");
+		return false;
+	}
+
+	const std::uint64_t iNumPts = pHeader->iDims[0] * pHeader->iDims[1] * pHeader->iDims[2];
+	const std::uint64_t iExpectedSize = sizeof(SqwGridHeader) +
+		(iNumPts+1)*sizeof(std::uint64_t) + pHeader->iNumBranches*2*sizeof(double);
+	if(iNumPts == 0 || iFileSize < iExpectedSize)
+	{
+		tl::log_err("Grid file \"", pcFile, "\" is truncated, expected ", iExpectedSize, " bytes.");
+		return false;
+	}
+
+	for(int i=0; i<3; ++i)
+	{
+		if(pHeader->dStep[i] <= 0.)
+		{
+			tl::log_err("Invalid grid step in grid file \"", pcFile, "\".");
+			return false;
+		}
+	}
+
+	const std::uint64_t *pIdx = reinterpret_cast<const std::uint64_t*>(pcMem + sizeof(SqwGridHeader));
+	if(pIdx[iNumPts] != pHeader->iNumBranches)
+	{
+		tl::log_err("Branch index mismatch in grid file \"", pcFile, "\".");
+		return false;
+	}
+
+	// lookups are scattered over the grid
+	m_pRegion->advise(ipr::mapped_region::advice_random);
+
+	m_pHeader = pHeader;
+	m_pIdx = pIdx;
+	m_pBranches = reinterpret_cast<const double*>(pIdx + iNumPts+1);
+
+	tl::log_info("Mapped S(q,w) grid with ", pHeader->iDims[0], " x ", pHeader->iDims[1], " x ",
+		pHeader->iDims[2], " points and ", pHeader->iNumBranches, " branches.");
+	return true;
+}
+
+
+/**
+ * index of the grid point nearest to (h,k,l), false if outside the grid
+ */
+bool SqwGrid::GetGridIndex(t_real dh, t_real dk, t_real dl, std::size_t& iIdx) const
+{
+	if(!m_pHeader)
+		return false;
+
+	const t_real hkl[] = { dh, dk, dl };
+	std::size_t iPos[3];
+
+	for(int i=0; i<3; ++i)
+	{
+		t_real dPos = std::floor((hkl[i] - m_pHeader->dMin[i]) / m_pHeader->dStep[i] + 0.5);
+		if(dPos < 0. || dPos >= t_real(m_pHeader->iDims[i]))
+			return false;
+		iPos[i] = std::size_t(dPos);
+	}
+
+	iIdx = (iPos[0]*m_pHeader->iDims[1] + iPos[1])*m_pHeader->iDims[2] + iPos[2];
+	return true;
+}
+
+
+/**
+ * dispersion branches at the nearest grid point
+ */
+std::tuple<std::vector<t_real>, std::vector<t_real>>
+SqwGrid::disp(t_real dh, t_real dk, t_real dl) const
+{
+	std::vector<t_real> vecE, vecW;
+
+	std::size_t iIdx = 0;
+	if(!GetGridIndex(dh, dk, dl, iIdx))
+		return std::make_tuple(vecE, vecW);
+
+	const std::uint64_t iBegin = m_pIdx[iIdx];
+	const std::uint64_t iEnd = m_pIdx[iIdx+1];
+	if(iBegin > iEnd || iEnd > m_pHeader->iNumBranches)
+		return std::make_tuple(vecE, vecW);
+
+	vecE.reserve(iEnd - iBegin);
+	vecW.reserve(iEnd - iBegin);
+
+	for(std::uint64_t iBranch=iBegin; iBranch<iEnd; ++iBranch)
+	{
+		vecE.push_back(t_real(m_pBranches[iBranch*2 + 0]));
+		vecW.push_back(t_real(m_pBranches[iBranch*2 + 1]));
+	}
+
+	return std::make_tuple(vecE, vecW);
+}
+
+
+t_real SqwGrid::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
+{
+	std::vector<t_real> vecE, vecW;
+	std::tie(vecE, vecW) = disp(dh, dk, dl);
+
+	t_real dInc = 0.;
+	if(!tl::float_equal<t_real>(m_dIncAmp, 0.))
+		dInc = tl::gauss_model<t_real>(dE, 0., m_dIncSig, m_dIncAmp, 0.);
+
+	t_real dS = 0.;
+	for(std::size_t iE=0; iE<vecE.size(); ++iE)
+		dS += tl::gauss_model<t_real>(dE, vecE[iE], m_dSigma, vecW[iE], 0.);
+
+	return m_dS0*dS * tl::bose_cutoff(dE, m_dT, m_dcut) + dInc;
+}
+
+
+std::vector<SqwBase::t_var> SqwGrid::GetVars() const
+{
+	std::vector<SqwBase::t_var> vecVars;
+
+	vecVars.push_back(SqwBase::t_var{"T", "real", tl::var_to_str(m_dT)});
+	vecVars.push_back(SqwBase::t_var{"bose_cutoff", "real", tl::var_to_str(m_dcut)});
+	vecVars.push_back(SqwBase::t_var{"sigma", "real", tl::var_to_str(m_dSigma)});
+	vecVars.push_back(SqwBase::t_var{"S0", "real", tl::var_to_str(m_dS0)});
+	vecVars.push_back(SqwBase::t_var{"inc_amp", "real", tl::var_to_str(m_dIncAmp)});
+	vecVars.push_back(SqwBase::t_var{"inc_sig", "real", tl::var_to_str(m_dIncSig)});
+
+	return vecVars;
+}
+
+
+void SqwGrid::SetVars(const std::vector<SqwBase::t_var>& vecVars)
+{
+	if(vecVars.size() == 0)
+		return;
+
+	for(const SqwBase::t_var& var : vecVars)
+	{
+		const std::string& strVar = std::get<0>(var);
+		const std::string& strVal = std::get<2>(var);
+
+		if(strVar == "T") m_dT = tl::str_to_var<decltype(m_dT)>(strVal);
+		else if(strVar == "bose_cutoff") m_dcut = tl::str_to_var<decltype(m_dcut)>(strVal);
+		else if(strVar == "sigma") m_dSigma = tl::str_to_var<decltype(m_dSigma)>(strVal);
+		else if(strVar == "S0") m_dS0 = tl::str_to_var<decltype(m_dS0)>(strVal);
+		else if(strVar == "inc_amp") m_dIncAmp = tl::str_to_var<decltype(m_dIncAmp)>(strVal);
+		else if(strVar == "inc_sig") m_dIncSig = tl::str_to_var<decltype(m_dIncSig)>(strVal);
+	}
+}
+
+
+SqwBase* SqwGrid::shallow_copy() const
+{
+	SqwGrid *pCpy = new SqwGrid();
+	*static_cast<SqwBase*>(pCpy) = *static_cast<const SqwBase*>(this);
+
+	pCpy->m_pFile = m_pFile;
+	pCpy->m_pRegion = m_pRegion;
+	pCpy->m_pHeader = m_pHeader;
+	pCpy->m_pIdx = m_pIdx;
+	pCpy->m_pBranches = m_pBranches;
+
+	pCpy->m_dT = m_dT;
+	pCpy->m_dcut = m_dcut;
+	pCpy->m_dSigma = m_dSigma;
+	pCpy->m_dS0 = m_dS0;
+	pCpy->m_dIncAmp = m_dIncAmp;
+	pCpy->m_dIncSig = m_dIncSig;
+
+	return pCpy;
+}
+
+// ----------------------------------------------------------------------------
+
+
+
+// ----------------------------------------------------------------------------
+// conversion
+
+static SqwGridHeader make_grid_header(const std::uint64_t* piDims, const double* pdMin, const double* pdStep)
+{
+	SqwGridHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::strncpy(header.magic, SQWGRID_MAGIC, sizeof(header.magic));
+	header.iVersion = SQWGRID_VERSION;
+	header.iRealSize = sizeof(double);
+
+	for(int i=0; i<3; ++i)
+	{
+		header.iDims[i] = piDims[i];
+		header.dMin[i] = pdMin[i];
+		header.dStep[i] = pdStep[i];
+	}
+
+	return header;
+}
+
+
+/**
+ * converts a text table with "h k l E w" columns
+ */
+bool sqwgrid_from_table(const std::string& strInFile, const std::string& strOutFile)
+{
+	struct Branch
+	{
+		std::uint64_t iIdx;
+		double dE, dW;
+	};
+
+	std::ifstream ifstr(strInFile);
+	if(!ifstr)
+	{
+		tl::log_err("Cannot open table file \"", strInFile, "\".");
+		return false;
+	}
+
+	std::vector<std::vector<double>> vecCoords(3);
+	std::vector<double> vecE, vecW;
+
+	std::string strLine;
+	while(std::getline(ifstr, strLine))
+	{
+		tl::trim(strLine);
+		if(strLine.length()==0 || strLine[0]=='#')
+			continue;
+
+		std::vector<double> vecRow;
+		tl::get_tokens<double>(strLine, std::string(" \t"), vecRow);
+		if(vecRow.size() != 5)
+		{
+			tl::log_err("Need h,k,l,E,w data.");
+			return false;
+		}
+
+		// no need to store branches without weight
+		if(tl::float_equal<double>(vecRow[4], 0.))
+			continue;
+
+		for(int i=0; i<3; ++i)
+			vecCoords[i].push_back(vecRow[i]);
+		vecE.push_back(vecRow[3]);
+		vecW.push_back(vecRow[4]);
+	}
+
+	if(vecE.size() == 0)
+	{
+		tl::log_err("No data in table file \"", strInFile, "\".");
+		return false;
+	}
+
+	// determine the regular grid from the distinct coordinates
+	const double dEps = 1e-6;
+	std::uint64_t iDims[3];
+	double dMin[3], dStep[3];
+
+	for(int i=0; i<3; ++i)
+	{
+		std::vector<double> vecUnique = vecCoords[i];
+		std::sort(vecUnique.begin(), vecUnique.end());
+		vecUnique.erase(std::unique(vecUnique.begin(), vecUnique.end(),
+			[dEps](double d1, double d2) -> bool { return std::abs(d1-d2) < dEps; }),
+			vecUnique.end());
+
+		dMin[i] = vecUnique.front();
+		dStep[i] = 1.;
+		for(std::size_t iVal=1; iVal<vecUnique.size(); ++iVal)
+		{
+			if(iVal == 1 || vecUnique[iVal]-vecUnique[iVal-1] < dStep[i])
+				dStep[i] = vecUnique[iVal]-vecUnique[iVal-1];
+		}
+
+		iDims[i] = std::uint64_t(std::round((vecUnique.back() - dMin[i]) / dStep[i])) + 1;
+	}
+
+	std::vector<Branch> vecBranches;
+	vecBranches.reserve(vecE.size());
+
+	for(std::size_t iRow=0; iRow<vecE.size(); ++iRow)
+	{
+		std::uint64_t iIdx = 0;
+		for(int i=0; i<3; ++i)
+		{
+			double dPos = (vecCoords[i][iRow] - dMin[i]) / dStep[i];
+			if(std::abs(dPos - std::round(dPos)) > 1e-3)
+			{
+				tl::log_err("Point ", iRow, " is not on a regular grid.");
+				return false;
+			}
+			iIdx = iIdx*iDims[i] + std::uint64_t(std::round(dPos));
+		}
+
+		vecBranches.emplace_back(Branch{iIdx, vecE[iRow], vecW[iRow]});
+	}
+
+	std::stable_sort(vecBranches.begin(), vecBranches.end(),
+		[](const Branch& b1, const Branch& b2) -> bool { return b1.iIdx < b2.iIdx; });
+
+
+	std::ofstream ofstr(strOutFile, std::ios_base::binary);
+	if(!ofstr)
+	{
+		tl::log_err("Cannot open output file \"", strOutFile, "\".");
+		return false;
+	}
+
+	SqwGridHeader header = make_grid_header(iDims, dMin, dStep);
+	header.iNumBranches = vecBranches.size();
+	ofstr.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	const std::uint64_t iNumPts = iDims[0]*iDims[1]*iDims[2];
+	std::size_t iBranch = 0;
+	for(std::uint64_t iPt=0; iPt<=iNumPts; ++iPt)
+	{
+		while(iBranch < vecBranches.size() && vecBranches[iBranch].iIdx < iPt)
+			++iBranch;
+		std::uint64_t iOffs = iBranch;
+		ofstr.write(reinterpret_cast<const char*>(&iOffs), sizeof(iOffs));
+	}
+
+	for(const Branch& branch : vecBranches)
+	{
+		const double dEW[] = { branch.dE, branch.dW };
+		ofstr.write(reinterpret_cast<const char*>(dEW), sizeof(dEW));
+	}
+
+	if(!ofstr)
+	{
+		tl::log_err("Cannot write output file \"", strOutFile, "\".");
+		return false;
+	}
+
+	tl::log_info("Wrote ", iDims[0], " x ", iDims[1], " x ", iDims[2], " grid with ",
+		vecBranches.size(), " branches to \"", strOutFile, "\".");
+	return true;
+}
+
+
+/**
+ * converts the description, index and data files of the grid module example;
+ * the files are streamed, so they need not fit into memory
+ */
+bool sqwgrid_from_idxgrid(const std::string& strCfgFile, const std::string& strOutFile)
+{
+	tl::Prop<std::string> prop;
+	if(!prop.Load(strCfgFile.c_str(), tl::PropType::INFO))
+	{
+		tl::log_err("Grid description file \"", strCfgFile, "\" could not be loaded.");
+		return false;
+	}
+
+	const std::string strIndexFile = prop.Query<std::string>("files/index");
+	const std::string strDataFile = prop.Query<std::string>("files/data");
+
+	const char* pcAxes[] = { "h", "k", "l" };
+	std::uint64_t iDims[3];
+	double dMin[3], dStep[3];
+	for(int i=0; i<3; ++i)
+	{
+		const std::string strAxis = pcAxes[i];
+		dMin[i] = prop.QueryAndParse<double>("dims/" + strAxis + "min");
+		double dMax = prop.QueryAndParse<double>("dims/" + strAxis + "max");
+		dStep[i] = prop.QueryAndParse<double>("dims/" + strAxis + "step");
+
+		// same size convention as in the grid module
+		iDims[i] = std::uint64_t((dMax - dMin[i]) / dStep[i]);
+		if(iDims[i] == 0)
+		{
+			tl::log_err("Invalid grid dimensions in \"", strCfgFile, "\".");
+			return false;
+		}
+	}
+
+	std::ifstream ifstrIdx(strIndexFile, std::ios_base::binary);
+	std::ifstream ifstrDat(strDataFile, std::ios_base::binary);
+	std::ofstream ofstr(strOutFile, std::ios_base::binary);
+	if(!ifstrIdx || !ifstrDat || !ofstr)
+	{
+		tl::log_err("Cannot open index, data or output file.");
+		return false;
+	}
+
+	// iterate the branches of all grid points
+	const std::uint64_t iNumPts = iDims[0]*iDims[1]*iDims[2];
+	auto for_all_branches = [&ifstrIdx, &ifstrDat, iNumPts](
+		const std::function<void(std::uint64_t iPt, double dE, double dW)>& func) -> bool
+	{
+		ifstrIdx.clear();
+		ifstrIdx.seekg(0);
+
+		for(std::uint64_t iPt=0; iPt<iNumPts; ++iPt)
+		{
+			std::size_t iDatOffs = 0;
+			unsigned int iNumBranches = 0;
+
+			ifstrIdx.read(reinterpret_cast<char*>(&iDatOffs), sizeof(iDatOffs));
+			ifstrDat.seekg(iDatOffs);
+			ifstrDat.read(reinterpret_cast<char*>(&iNumBranches), sizeof(iNumBranches));
+
+			std::vector<t_real> vecEW(iNumBranches*2);
+			ifstrDat.read(reinterpret_cast<char*>(vecEW.data()), vecEW.size()*sizeof(t_real));
+			if(!ifstrIdx || !ifstrDat)
+			{
+				tl::log_err("Cannot read grid point ", iPt, ".");
+				return false;
+			}
+
+			for(unsigned int iBranch=0; iBranch<iNumBranches; ++iBranch)
+			{
+				// the grid module ignores branches without weight
+				if(!tl::float_equal<t_real>(vecEW[iBranch*2 + 1], 0.))
+					func(iPt, vecEW[iBranch*2 + 0], vecEW[iBranch*2 + 1]);
+			}
+		}
+		return true;
+	};
+
+
+	SqwGridHeader header = make_grid_header(iDims, dMin, dStep);
+	ofstr.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	// first pass: branch indices
+	std::uint64_t iCurPt = 0, iTotalBranches = 0;
+	bool bOk = for_all_branches([&ofstr, &iCurPt, &iTotalBranches](std::uint64_t iPt, double, double)
+	{
+		for(; iCurPt<=iPt; ++iCurPt)
+			ofstr.write(reinterpret_cast<const char*>(&iTotalBranches), sizeof(iTotalBranches));
+		++iTotalBranches;
+	});
+	if(!bOk)
+		return false;
+	for(; iCurPt<=iNumPts; ++iCurPt)
+		ofstr.write(reinterpret_cast<const char*>(&iTotalBranches), sizeof(iTotalBranches));
+
+	// second pass: branch table
+	bOk = for_all_branches([&ofstr](std::uint64_t, double dE, double dW)
+	{
+		const double dEW[] = { dE, dW };
+		ofstr.write(reinterpret_cast<const char*>(dEW), sizeof(dEW));
+	});
+	if(!bOk)
+		return false;
+
+	header.iNumBranches = iTotalBranches;
+	ofstr.seekp(0);
+	ofstr.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if(!ofstr)
+	{
+		tl::log_err("Cannot write output file \"", strOutFile, "\".");
+		return false;
+	}
+
+	tl::log_info("Wrote ", iDims[0], " x ", iDims[1], " x ", iDims[2], " grid with ",
+		iTotalBranches, " branches to \"", strOutFile, "\".");
+	return true;
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,107 @@
+/**
+ * memory-mapped S(Q,w) grid model
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __SQW_GRID_H__
+#define __SQW_GRID_H__
+
+#include "sqwbase.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+
+#define SQWGRID_MAGIC "takgrid"
+#define SQWGRID_VERSION 1
+
+
+/**
+ * header of a binary S(Q,w) grid file, all values are in native byte order.
+ *
+ * the header is followed by
+ *   (1) dims[0]*dims[1]*dims[2] + 1 uint64 branch indices, one per (h,k,l) grid
+ *       point in row-major order (l running fastest); the branches of point i
+ *       are the entries idx[i] ... idx[i+1]-1 of the branch table,
+ *   (2) the branch table with iNumBranches (E, w) pairs of doubles.
+ */
+struct SqwGridHeader
+{
+	char magic[8];				// SQWGRID_MAGIC, zero-terminated
+	std::uint32_t iVersion;		// SQWGRID_VERSION
+	std::uint32_t iRealSize;	// sizeof(double)
+
+	std::uint64_t iDims[3];		// number of h, k, l grid points
+	double dMin[3];				// first h, k, l grid point
+	double dStep[3];			// h, k, l grid step
+
+	std::uint64_t iNumBranches;	// total number of (E, w) pairs
+};
+
+
+/**
+ * tabulated dispersion branches on a regular (h,k,l) grid
+ */
+class SqwGrid : public SqwBase
+{
+protected:
+	// the mapping is shared by all copies
+	std::shared_ptr<boost::interprocess::file_mapping> m_pFile;
+	std::shared_ptr<boost::interprocess::mapped_region> m_pRegion;
+
+	const SqwGridHeader *m_pHeader = nullptr;
+	const std::uint64_t *m_pIdx = nullptr;
+	const double *m_pBranches = nullptr;
+
+	// temperature for Bose factor
+	t_real_reso m_dT = 100.;
+
+	// Bose cutoff
+	t_real_reso m_dcut = 0.02;
+
+	// peak width for creation and annihilation
+	t_real_reso m_dSigma = 0.05;
+
+	// S(Q,w) scaling factor
+	t_real_reso m_dS0 = 1.;
+
+	// incoherent amplitude and width
+	t_real_reso m_dIncAmp = 0.;
+	t_real_reso m_dIncSig = 0.05;
+
+protected:
+	bool GetGridIndex(t_real_reso dh, t_real_reso dk, t_real_reso dl, std::size_t& iIdx) const;
+
+public:
+	SqwGrid(const char* pcFile = nullptr);
+	virtual ~SqwGrid() = default;
+
+	bool open(const char* pcFile);
+
+	virtual std::tuple<std::vector<t_real_reso>, std::vector<t_real_reso>>
+		disp(t_real_reso dh, t_real_reso dk, t_real_reso dl) const override;
+	virtual t_real_reso operator()(t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const override;
+
+	virtual std::vector<SqwBase::t_var> GetVars() const override;
+	virtual void SetVars(const std::vector<SqwBase::t_var>&) override;
+
+	virtual SqwBase* shallow_copy() const override;
+};
+
+
+// ----------------------------------------------------------------------------
+// conversion to the binary grid format
+
+// text table with "h k l E w" columns, each line defining one branch at a grid point
+extern bool sqwgrid_from_table(const std::string& strInFile, const std::string& strOutFile);
+
+// description file, index and data files of the grid module example
+extern bool sqwgrid_from_idxgrid(const std::string& strCfgFile, const std::string& strOutFile);
+// ----------------------------------------------------------------------------
+
+#endif
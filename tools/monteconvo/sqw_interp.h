@@ -0,0 +1,326 @@
+/**
+ * interpolation of tabulated S(Q,w) points
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __SQW_INTERP_H__
+#define __SQW_INTERP_H__
+
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <limits>
+#include <cmath>
+
+
+/**
+ * interpolates the last column of a point table over the remaining coordinates:
+ * multilinearly if the points form a regular (rectilinear) grid,
+ * otherwise by inverse-distance weighting of the nearest neighbours
+ */
+template<class t_real = double>
+class TableInterp
+{
+protected:
+	std::size_t m_iDim = 0;
+	std::vector<t_real> m_vecMin, m_vecMax;
+
+	// regular grid: coordinates along each axis and values in row-major order
+	bool m_bRegular = false;
+	std::vector<std::vector<t_real>> m_vecAxes;
+	std::vector<std::size_t> m_vecStrides;
+	std::vector<t_real> m_vecGrid;
+
+	// scattered points: flat array of (coordinates, value), ordered as an implicit k-d tree
+	std::vector<t_real> m_vecPts;
+
+protected:
+	const t_real* GetPt(std::size_t iPt) const { return m_vecPts.data() + iPt*(m_iDim+1); }
+
+	/**
+	 * index of a coordinate on a grid axis, false if it is not a grid point
+	 */
+	static bool GetAxisIndex(const std::vector<t_real>& vecAxis, t_real dVal, t_real dEps, std::size_t& iIdx)
+	{
+		auto iter = std::lower_bound(vecAxis.begin(), vecAxis.end(), dVal - dEps);
+		if(iter == vecAxis.end() || std::abs(*iter - dVal) > dEps)
+			return false;
+		iIdx = iter - vecAxis.begin();
+		return true;
+	}
+
+	bool CreateGrid(const std::list<std::vector<t_real>>& lstPts)
+	{
+		m_vecAxes.clear();
+		m_vecAxes.resize(m_iDim);
+		m_vecStrides.resize(m_iDim);
+
+		std::vector<t_real> vecEps(m_iDim);
+		std::size_t iNumCells = 1;
+
+		for(std::size_t iAxis=0; iAxis<m_iDim; ++iAxis)
+		{
+			vecEps[iAxis] = std::max((m_vecMax[iAxis]-m_vecMin[iAxis]) * t_real(1e-6),
+				std::numeric_limits<t_real>::epsilon());
+
+			std::vector<t_real>& vecAxis = m_vecAxes[iAxis];
+			for(const std::vector<t_real>& vecPt : lstPts)
+				vecAxis.push_back(vecPt[iAxis]);
+
+			std::sort(vecAxis.begin(), vecAxis.end());
+			t_real dEps = vecEps[iAxis];
+			vecAxis.erase(std::unique(vecAxis.begin(), vecAxis.end(),
+				[dEps](t_real d1, t_real d2) -> bool { return std::abs(d1-d2) <= dEps; }),
+				vecAxis.end());
+
+			iNumCells *= vecAxis.size();
+			if(iNumCells > lstPts.size())
+				return false;
+		}
+
+		if(iNumCells != lstPts.size())
+			return false;
+
+		std::size_t iStride = 1;
+		for(std::size_t iAxis=m_iDim; iAxis>0; --iAxis)
+		{
+			m_vecStrides[iAxis-1] = iStride;
+			iStride *= m_vecAxes[iAxis-1].size();
+		}
+
+		// every grid point has to be defined exactly once
+		m_vecGrid.resize(iNumCells);
+		std::vector<bool> vecDefined(iNumCells, false);
+
+		for(const std::vector<t_real>& vecPt : lstPts)
+		{
+			std::size_t iCell = 0;
+			for(std::size_t iAxis=0; iAxis<m_iDim; ++iAxis)
+			{
+				std::size_t iIdx = 0;
+				if(!GetAxisIndex(m_vecAxes[iAxis], vecPt[iAxis], vecEps[iAxis], iIdx))
+					return false;
+				iCell += iIdx*m_vecStrides[iAxis];
+			}
+
+			if(vecDefined[iCell])
+				return false;
+			vecDefined[iCell] = true;
+			m_vecGrid[iCell] = vecPt[m_iDim];
+		}
+
+		return true;
+	}
+
+	/**
+	 * sort the points into an implicit k-d tree: the median of each range
+	 * is its node, the points left and right of it are its subtrees
+	 */
+	void CreateTree(std::vector<std::size_t>& vecIdx, const std::vector<t_real>& vecPts,
+		std::size_t iBegin, std::size_t iEnd, std::size_t iDepth) const
+	{
+		if(iEnd - iBegin <= 1)
+			return;
+
+		const std::size_t iAxis = iDepth % m_iDim;
+		const std::size_t iMid = (iBegin + iEnd) / 2;
+
+		std::nth_element(vecIdx.begin()+iBegin, vecIdx.begin()+iMid, vecIdx.begin()+iEnd,
+			[this, &vecPts, iAxis](std::size_t i1, std::size_t i2) -> bool
+			{ return vecPts[i1*(m_iDim+1) + iAxis] < vecPts[i2*(m_iDim+1) + iAxis]; });
+
+		CreateTree(vecIdx, vecPts, iBegin, iMid, iDepth+1);
+		CreateTree(vecIdx, vecPts, iMid+1, iEnd, iDepth+1);
+	}
+
+	/**
+	 * collect the nearest neighbours in a max-heap of (squared distance, point index)
+	 */
+	void FindNearest(const t_real* pQuery, std::size_t iBegin, std::size_t iEnd, std::size_t iDepth,
+		std::size_t iNum, std::vector<std::pair<t_real, std::size_t>>& vecHeap) const
+	{
+		if(iBegin >= iEnd)
+			return;
+
+		const std::size_t iAxis = iDepth % m_iDim;
+		const std::size_t iMid = (iBegin + iEnd) / 2;
+		const t_real *pPt = GetPt(iMid);
+
+		t_real dDist2 = 0;
+		for(std::size_t i=0; i<m_iDim; ++i)
+			dDist2 += (pPt[i]-pQuery[i]) * (pPt[i]-pQuery[i]);
+
+		if(vecHeap.size() < iNum)
+		{
+			vecHeap.emplace_back(dDist2, iMid);
+			std::push_heap(vecHeap.begin(), vecHeap.end());
+		}
+		else if(dDist2 < vecHeap.front().first)
+		{
+			std::pop_heap(vecHeap.begin(), vecHeap.end());
+			vecHeap.back() = std::make_pair(dDist2, iMid);
+			std::push_heap(vecHeap.begin(), vecHeap.end());
+		}
+
+		const t_real dPlaneDist = pQuery[iAxis] - pPt[iAxis];
+		const bool bLeftFirst = dPlaneDist < t_real(0);
+
+		if(bLeftFirst)
+			FindNearest(pQuery, iBegin, iMid, iDepth+1, iNum, vecHeap);
+		else
+			FindNearest(pQuery, iMid+1, iEnd, iDepth+1, iNum, vecHeap);
+
+		// the other side can only contain nearer points if the splitting plane is closer
+		if(vecHeap.size() < iNum || dPlaneDist*dPlaneDist < vecHeap.front().first)
+		{
+			if(bLeftFirst)
+				FindNearest(pQuery, iMid+1, iEnd, iDepth+1, iNum, vecHeap);
+			else
+				FindNearest(pQuery, iBegin, iMid, iDepth+1, iNum, vecHeap);
+		}
+	}
+
+	t_real InterpolateGrid(const t_real* pQuery) const
+	{
+		std::vector<std::size_t> vecLower(m_iDim);
+		std::vector<t_real> vecFrac(m_iDim);
+
+		for(std::size_t iAxis=0; iAxis<m_iDim; ++iAxis)
+		{
+			const std::vector<t_real>& vecAxis = m_vecAxes[iAxis];
+			if(vecAxis.size() == 1)
+			{
+				vecLower[iAxis] = 0;
+				vecFrac[iAxis] = 0;
+				continue;
+			}
+
+			std::size_t iUpper = std::upper_bound(vecAxis.begin(), vecAxis.end(), pQuery[iAxis]) - vecAxis.begin();
+			iUpper = std::min(std::max(iUpper, std::size_t(1)), vecAxis.size()-1);
+
+			vecLower[iAxis] = iUpper - 1;
+			vecFrac[iAxis] = (pQuery[iAxis] - vecAxis[iUpper-1]) / (vecAxis[iUpper] - vecAxis[iUpper-1]);
+		}
+
+		// sum over the corners of the enclosing cell
+		t_real dVal = 0;
+		for(std::size_t iCorner=0; iCorner < (std::size_t(1) << m_iDim); ++iCorner)
+		{
+			t_real dWeight = 1;
+			std::size_t iCell = 0;
+
+			for(std::size_t iAxis=0; iAxis<m_iDim; ++iAxis)
+			{
+				const bool bUpper = (iCorner >> iAxis) & 1;
+				if(bUpper && m_vecAxes[iAxis].size() == 1)
+				{
+					dWeight = 0;
+					break;
+				}
+
+				dWeight *= bUpper ? vecFrac[iAxis] : t_real(1)-vecFrac[iAxis];
+				iCell += (vecLower[iAxis] + (bUpper ? 1 : 0)) * m_vecStrides[iAxis];
+			}
+
+			if(dWeight != t_real(0))
+				dVal += dWeight * m_vecGrid[iCell];
+		}
+
+		return dVal;
+	}
+
+	t_real InterpolateScattered(const t_real* pQuery, std::size_t iNum) const
+	{
+		std::vector<std::pair<t_real, std::size_t>> vecHeap;
+		vecHeap.reserve(iNum);
+		FindNearest(pQuery, 0, m_vecPts.size()/(m_iDim+1), 0, iNum, vecHeap);
+
+		// inverse squared distance weights
+		t_real dVal = 0, dNorm = 0;
+		for(const std::pair<t_real, std::size_t>& neighbour : vecHeap)
+		{
+			const t_real dNodeVal = GetPt(neighbour.second)[m_iDim];
+			if(neighbour.first <= std::numeric_limits<t_real>::epsilon())
+				return dNodeVal;
+
+			dVal += dNodeVal / neighbour.first;
+			dNorm += t_real(1) / neighbour.first;
+		}
+
+		return dNorm > t_real(0) ? dVal/dNorm : t_real(0);
+	}
+
+public:
+	/**
+	 * each point consists of iDim coordinates followed by the value
+	 */
+	void Load(const std::list<std::vector<t_real>>& lstPts, std::size_t iDim)
+	{
+		m_iDim = iDim;
+		m_vecMin.assign(iDim, std::numeric_limits<t_real>::max());
+		m_vecMax.assign(iDim, std::numeric_limits<t_real>::lowest());
+		m_vecPts.clear();
+		m_vecGrid.clear();
+
+		for(const std::vector<t_real>& vecPt : lstPts)
+		{
+			for(std::size_t i=0; i<iDim; ++i)
+			{
+				m_vecMin[i] = std::min(m_vecMin[i], vecPt[i]);
+				m_vecMax[i] = std::max(m_vecMax[i], vecPt[i]);
+			}
+		}
+
+		m_bRegular = lstPts.size() && CreateGrid(lstPts);
+		if(m_bRegular)
+			return;
+		m_vecAxes.clear();
+		m_vecGrid.clear();
+
+		std::vector<t_real> vecPts;
+		vecPts.reserve(lstPts.size() * (iDim+1));
+		for(const std::vector<t_real>& vecPt : lstPts)
+			vecPts.insert(vecPts.end(), vecPt.begin(), vecPt.begin()+iDim+1);
+
+		std::vector<std::size_t> vecIdx(lstPts.size());
+		std::iota(vecIdx.begin(), vecIdx.end(), 0);
+		CreateTree(vecIdx, vecPts, 0, vecIdx.size(), 0);
+
+		m_vecPts.reserve(vecPts.size());
+		for(std::size_t iPt : vecIdx)
+			m_vecPts.insert(m_vecPts.end(), vecPts.begin() + iPt*(iDim+1), vecPts.begin() + (iPt+1)*(iDim+1));
+	}
+
+	bool IsRegular() const { return m_bRegular; }
+
+	bool IsInside(const t_real* pQuery) const
+	{
+		if(!m_iDim)
+			return false;
+
+		for(std::size_t i=0; i<m_iDim; ++i)
+			if(pQuery[i] < m_vecMin[i] || pQuery[i] > m_vecMax[i])
+				return false;
+		return true;
+	}
+
+	/**
+	 * interpolated value at the given coordinates, zero outside the table
+	 */
+	t_real operator()(const t_real* pQuery, std::size_t iNeighbours = 8) const
+	{
+		if(!IsInside(pQuery))
+			return t_real(0);
+
+		if(m_bRegular)
+			return InterpolateGrid(pQuery);
+		return InterpolateScattered(pQuery, std::max(iNeighbours, std::size_t(1)));
+	}
+};
+
+
+#endif
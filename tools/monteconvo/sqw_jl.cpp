@@ -11,6 +11,10 @@
 #include "tlibs/file/file.h"
 #include "tlibs/ext/jl.h"
 
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
 using t_real = t_real_reso;
 
 #define MAX_PARAM_VAL_SIZE 128
@@ -55,6 +59,7 @@ SqwJl::SqwJl(const char* pcFile) : m_pmtx(std::make_shared<std::mutex>())
 	m_pInit = jl_get_function(jl_main_module, "TakinInit");
 	m_pSqw = jl_get_function(jl_main_module, "TakinSqw");
 	m_pDisp = jl_get_function(jl_main_module, "TakinDisp");
+	m_pSqwBatch = jl_get_function(jl_main_module, "TakinSqwBatch");	// optional
 
 	PrintExceptions();
 
@@ -184,6 +189,75 @@ t_real SqwJl::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 }
 
 
+/**
+ * S(Q,E) for arrays of points: the arrays are passed to Julia without copying,
+ * either to the optional TakinSqwBatch function or by broadcasting TakinSqw
+ */
+void SqwJl::SqwBatch(const t_real* pH, const t_real* pK, const t_real* pL,
+	const t_real* pE, t_real* pS, std::size_t iNum) const
+{
+	std::fill(pS, pS+iNum, t_real(0));
+
+	if(!m_bOk)
+	{
+		tl::log_err("Julia interpreter has not initialised, cannot query S(q,w).");
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(*m_pmtx);
+
+	jl_value_t *pElemType = std::is_same<t_real, float>::value ?
+		(jl_value_t*)jl_float32_type : (jl_value_t*)jl_float64_type;
+	jl_value_t *pArrType = jl_apply_array_type(pElemType, 1);
+
+	jl_array_t *parrH = nullptr, *parrK = nullptr, *parrL = nullptr, *parrE = nullptr;
+	jl_value_t *pRet = nullptr;
+	JL_GC_PUSH5(&parrH, &parrK, &parrL, &parrE, &pRet);
+
+	// wrap the c arrays, julia does not own them
+	parrH = jl_ptr_to_array_1d(pArrType, const_cast<t_real*>(pH), iNum, 0);
+	parrK = jl_ptr_to_array_1d(pArrType, const_cast<t_real*>(pK), iNum, 0);
+	parrL = jl_ptr_to_array_1d(pArrType, const_cast<t_real*>(pL), iNum, 0);
+	parrE = jl_ptr_to_array_1d(pArrType, const_cast<t_real*>(pE), iNum, 0);
+
+	if(m_pSqwBatch)
+	{
+		jl_value_t *phklE[4] = { (jl_value_t*)parrH, (jl_value_t*)parrK,
+			(jl_value_t*)parrL, (jl_value_t*)parrE };
+		pRet = jl_call((jl_function_t*)m_pSqwBatch, phklE, 4);
+	}
+	else
+	{
+		jl_function_t *pBroadcast = jl_get_function(jl_base_module, "broadcast");
+		jl_value_t *pArgs[5] = { (jl_value_t*)m_pSqw, (jl_value_t*)parrH, (jl_value_t*)parrK,
+			(jl_value_t*)parrL, (jl_value_t*)parrE };
+		pRet = jl_call(pBroadcast, pArgs, 5);
+	}
+
+	if(pRet && jl_is_array(pRet) && jl_array_len((jl_array_t*)pRet) == iNum)
+	{
+		jl_array_t *parrS = reinterpret_cast<jl_array_t*>(pRet);
+
+		if(jl_array_eltype(pRet) == pElemType)
+		{
+			std::memcpy(pS, jl_array_data(parrS), iNum*sizeof(t_real));
+		}
+		else
+		{
+			for(std::size_t i=0; i<iNum; ++i)
+				pS[i] = t_real(tl::jl_traits<t_real>::unbox(jl_arrayref(parrS, i)));
+		}
+	}
+	else if(pRet)
+	{
+		tl::log_err("Julia S(q,w) batch function has to return an array of ", iNum, " values.");
+	}
+
+	JL_GC_POP();
+	PrintExceptions();
+}
+
+
 std::vector<SqwBase::t_var> SqwJl::GetVars() const
 {
 	std::vector<SqwBase::t_var> vecVars;
@@ -294,6 +368,7 @@ SqwBase* SqwJl::shallow_copy() const
 	pSqw->m_pInit = this->m_pInit;
 	pSqw->m_pSqw = this->m_pSqw;
 	pSqw->m_pDisp = this->m_pDisp;
+	pSqw->m_pSqwBatch = this->m_pSqwBatch;
 	pSqw->m_pmtx = this->m_pmtx;
 
 	return pSqw;
@@ -10,42 +10,94 @@
 
 #include "sqw.h"
 #include <mutex>
+#include <atomic>
 #include <memory>
+#include <vector>
+#include <string>
+#include <thread>
+#include <utility>
 #include <unistd.h>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/managed_shared_memory.hpp>
 
+struct ProcMsg;
 
+
+/**
+ * a forked model process and its communication channels
+ */
+struct SqwProcWorker
+{
+	std::mutex mtx;
+
+	std::string strProcName;
+	pid_t pidChild = 0;
+	bool bOk = 0;
+	bool bReportedDead = 0;
+
+	std::shared_ptr<boost::interprocess::managed_shared_memory> pMem;
+	std::shared_ptr<boost::interprocess::message_queue> pmsgIn, pmsgOut;
+	void *pSharedPars = nullptr;
+
+	// binary array buffer for batch queries
+	std::shared_ptr<boost::interprocess::shared_memory_object> pBatchMem;
+	std::shared_ptr<boost::interprocess::mapped_region> pBatchRegion;
+};
+
+
+/**
+ * delegates the model to one or several child processes,
+ * batches are distributed over all idle processes
+ */
 template<class t_sqw>
 class SqwProc : public SqwBase
 {
-private:
-	std::size_t m_iRefCnt = 0;
+protected:
+	std::string m_strCfg;
+	std::shared_ptr<std::vector<std::shared_ptr<SqwProcWorker>>> m_pWorkers;
+	mutable std::shared_ptr<std::atomic<std::size_t>> m_piNextWorker;
+
+	// variables set so far, they are re-applied to respawned processes
+	std::shared_ptr<std::vector<SqwBase::t_var>> m_pVars;
+	std::shared_ptr<std::mutex> m_pmtxVars;
+
+	// only the thread which created the processes forks new ones
+	std::thread::id m_idOwner;
 
 protected:
-	mutable std::shared_ptr<std::mutex> m_pmtx;
+	bool IsOwnerThread() const { return std::this_thread::get_id() == m_idOwner; }
 
-	std::string m_strProcName;
-	pid_t m_pidChild = 0;
+	bool StartWorker(SqwProcWorker& worker) const;
+	void StopWorker(SqwProcWorker& worker, bool bKill) const;
+	bool RespawnWorker(SqwProcWorker& worker) const;
+	bool Request(SqwProcWorker& worker, const ProcMsg& msg, ProcMsg& msgRet) const;
+	bool Receive(SqwProcWorker& worker, ProcMsg& msgRet) const;
 
-	std::shared_ptr<boost::interprocess::managed_shared_memory> m_pMem;
-	std::shared_ptr<boost::interprocess::message_queue> m_pmsgIn, m_pmsgOut;
-	void *m_pSharedPars = nullptr;
+	using t_locked_workers = std::vector<std::pair<SqwProcWorker*, std::unique_lock<std::mutex>>>;
+	t_locked_workers AcquireWorkers(bool bAll) const;
 
 public:
 	SqwProc();
-	SqwProc(const char* pcCfg);
+	SqwProc(const char* pcCfg, unsigned int iNumProcs = 1);
 	virtual ~SqwProc();
 
 	virtual std::tuple<std::vector<t_real_reso>, std::vector<t_real_reso>>
 		disp(t_real_reso dh, t_real_reso dk, t_real_reso dl) const override;
 	virtual t_real_reso
 		operator()(t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const override;
+	virtual void SqwBatch(const t_real_reso* pH, const t_real_reso* pK, const t_real_reso* pL,
+		const t_real_reso* pE, t_real_reso* pS, std::size_t iNum) const override;
 	virtual bool IsOk() const override;
 
 	virtual std::vector<SqwBase::t_var> GetVars() const override;
 	virtual void SetVars(const std::vector<SqwBase::t_var>&) override;
 
 	virtual SqwBase* shallow_copy() const override;
+	virtual bool HasIndependentCopies() const override { return false; }
+
+	std::size_t GetNumProcs() const { return m_pWorkers ? m_pWorkers->size() : 0; }
 };
 
 #endif
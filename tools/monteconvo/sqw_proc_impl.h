@@ -17,9 +17,21 @@
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/containers/string.hpp>
 
+#include <algorithm>
+#include <sys/wait.h>
+#include <signal.h>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #define MSG_QUEUE_SIZE 128
 #define PARAM_MEM 1024*1024
 
+// number of points per batch transfer, the buffer holds the h, k, l, E and S arrays
+#define BATCH_ELEMS 16384
+#define BATCH_ARRAYS 5
+
+// interval for checking if a child process is still alive while waiting for it
+#define PROC_POLL_MS 250
+
 
 namespace ipr = boost::interprocess;
 using t_real = t_real_reso;
@@ -37,63 +49,6 @@ using t_sh_str_alloc = t_sh_str_alloc_gen<char>;
 using t_sh_str = t_sh_str_gen<char>;
 
 
-/**
- * converts the energy and weight vectors of the dispersion to a string
- */
-static void disp_to_str(
-	t_sh_str& str, const std::tuple<std::vector<t_real>, std::vector<t_real>>& tup)
-{
-	try
-	{
-		str.clear();
-		std::string strVecE = tl::cont_to_str<std::vector<t_real>>(std::get<0>(tup), ",");
-		std::string strVecW = tl::cont_to_str<std::vector<t_real>>(std::get<1>(tup), ",");
-
-		std::size_t iLenTotal = strVecE.length() + strVecW.length() + 3 + 1;
-		if(iLenTotal >= std::size_t(PARAM_MEM))
-		{
-			tl::log_err("Process buffer limit reached. Cannot proceed.");
-			return;
-		}
-
-		str.append(strVecE.c_str()); str.append("#,#");
-		str.append(strVecW.c_str());
-	}
-	catch(const std::exception& ex)
-	{
-		tl::log_err(ex.what());
-	}
-}
-
-
-/**
- * converts a string to the energy and weight vectors of the dispersion
- */
-static std::tuple<std::vector<t_real>, std::vector<t_real>>
-str_to_disp(const t_sh_str& _str)
-{
-	std::vector<t_real> vecE, vecW;
-
-	try
-	{
-		std::string str;
-		for(const t_sh_str::value_type& ch : _str) str.push_back(ch);
-
-		std::string strVecE, strVecW;
-		std::tie(strVecE, strVecW) = tl::split_first<std::string>(str, "#,#", 1, 1);
-
-		tl::get_tokens<t_real, std::string, decltype(vecE)>(strVecE, ",", vecE);
-		tl::get_tokens<t_real, std::string, decltype(vecW)>(strVecW, ",", vecW);
-	}
-	catch(const std::exception& ex)
-	{
-		tl::log_err(ex.what());
-	}
-
-	return std::make_tuple(vecE, vecW);
-}
-
-
 /**
  * converts the model parameters to a string
  */
@@ -186,6 +141,7 @@ enum class ProcMsgTypes
 
 	DISP,
 	SQW,
+	SQW_BATCH,
 	GET_VARS,
 	SET_VARS,
 
@@ -201,6 +157,9 @@ struct ProcMsg
 	t_real dRet;
 	bool bRet;
 
+	// number of array elements in the batch buffer
+	std::size_t iNum = 0;
+
 	t_sh_str *pPars = nullptr;
 };
 
@@ -235,6 +194,31 @@ static ProcMsg msg_recv(ipr::message_queue& msgqueue)
 	return msg;
 }
 
+/**
+ * receive a message, returns false on timeout
+ */
+static bool msg_recv_timed(ipr::message_queue& msgqueue, ProcMsg& msg, unsigned int iTimeoutMS)
+{
+	try
+	{
+		std::size_t iSize;
+		unsigned int iPrio;
+		auto tmEnd = boost::posix_time::microsec_clock::universal_time() +
+			boost::posix_time::milliseconds(iTimeoutMS);
+		if(!msgqueue.timed_receive(&msg, sizeof(msg), iSize, iPrio, tmEnd))
+			return false;
+
+		if(iSize != sizeof(msg))
+			tl::log_err("Message size mismatch.");
+	}
+	catch(const std::exception& ex)
+	{
+		tl::log_err(ex.what());
+		return false;
+	}
+	return true;
+}
+
 // ----------------------------------------------------------------------------
 
 
@@ -245,7 +229,7 @@ static ProcMsg msg_recv(ipr::message_queue& msgqueue)
 
 template<class t_sqw>
 static void child_proc(ipr::message_queue& msgToParent, ipr::message_queue& msgFromParent,
-	const char* pcCfg)
+	const char* pcCfg, t_real* pBatch)
 {
 	std::unique_ptr<t_sqw> pSqw(new t_sqw(pcCfg));
 
@@ -264,9 +248,16 @@ static void child_proc(ipr::message_queue& msgToParent, ipr::message_queue& msgF
 		{
 			case ProcMsgTypes::DISP:	// dispersion
 			{
+				std::vector<t_real> vecE, vecW;
+				std::tie(vecE, vecW) = pSqw->disp(msg.dParam1, msg.dParam2, msg.dParam3);
+
+				// energies and weights are returned in the first two arrays of the batch buffer
 				msgRet.ty = msg.ty;
-				msgRet.pPars = msg.pPars;	// use provided pointer to shared mem
-				disp_to_str(*msgRet.pPars, pSqw->disp(msg.dParam1, msg.dParam2, msg.dParam3));
+				msgRet.iNum = std::min(std::min(vecE.size(), vecW.size()), std::size_t(BATCH_ELEMS));
+				if(msgRet.iNum < vecE.size() || msgRet.iNum < vecW.size())
+					tl::log_err("Dispersion has too many branches, truncating.");
+				std::copy(vecE.begin(), vecE.begin()+msgRet.iNum, pBatch);
+				std::copy(vecW.begin(), vecW.begin()+msgRet.iNum, pBatch + BATCH_ELEMS);
 				msg_send(msgToParent, msgRet);
 				break;
 			}
@@ -277,6 +268,15 @@ static void child_proc(ipr::message_queue& msgToParent, ipr::message_queue& msgF
 				msg_send(msgToParent, msgRet);
 				break;
 			}
+			case ProcMsgTypes::SQW_BATCH:	// structure factor for the arrays in the batch buffer
+			{
+				msgRet.ty = msg.ty;
+				msgRet.iNum = std::min(msg.iNum, std::size_t(BATCH_ELEMS));
+				pSqw->SqwBatch(pBatch, pBatch + BATCH_ELEMS, pBatch + 2*BATCH_ELEMS,
+					pBatch + 3*BATCH_ELEMS, pBatch + 4*BATCH_ELEMS, msgRet.iNum);
+				msg_send(msgToParent, msgRet);
+				break;
+			}
 			case ProcMsgTypes::GET_VARS:	// get variables
 			{
 				msgRet.ty = msg.ty;
@@ -303,7 +303,8 @@ static void child_proc(ipr::message_queue& msgToParent, ipr::message_queue& msgF
 			case ProcMsgTypes::QUIT:
 			{
 				//tl::log_debug("Exiting child process");
-				exit(0);
+				// no atexit handlers, they belong to the parent
+				_exit(0);
 				break;
 			}
 			default:
@@ -320,95 +321,308 @@ static void child_proc(ipr::message_queue& msgToParent, ipr::message_queue& msgF
 
 template<class t_sqw>
 SqwProc<t_sqw>::SqwProc()
+{}
+
+
+/**
+ * create sub-processes
+ */
+template<class t_sqw>
+SqwProc<t_sqw>::SqwProc(const char* pcCfg, unsigned int iNumProcs)
+	: m_strCfg(pcCfg),
+	m_pWorkers(std::make_shared<std::vector<std::shared_ptr<SqwProcWorker>>>()),
+	m_piNextWorker(std::make_shared<std::atomic<std::size_t>>(0)),
+	m_pVars(std::make_shared<std::vector<SqwBase::t_var>>()),
+	m_pmtxVars(std::make_shared<std::mutex>()),
+	m_idOwner(std::this_thread::get_id())
 {
-	++m_iRefCnt;
+	if(iNumProcs == 0)
+		iNumProcs = 1;
+
+	m_bOk = 1;
+	for(unsigned int iProc=0; iProc<iNumProcs; ++iProc)
+	{
+		std::shared_ptr<SqwProcWorker> pWorker = std::make_shared<SqwProcWorker>();
+		if(!StartWorker(*pWorker))
+		{
+			// remove the partly started process
+			StopWorker(*pWorker, true);
+			m_bOk = 0;
+			break;
+		}
+		m_pWorkers->push_back(pWorker);
+	}
+
+	if(iNumProcs > 1)
+		tl::log_info("Started ", m_pWorkers->size(), " S(q,w) model processes.");
 }
 
 
 /**
- * create sub-process
+ * clean up sub-processes
  */
 template<class t_sqw>
-SqwProc<t_sqw>::SqwProc(const char* pcCfg)
-	: m_pmtx(std::make_shared<std::mutex>()),
-	m_strProcName(tl::rand_name<std::string>(8))
+SqwProc<t_sqw>::~SqwProc()
 {
-	++m_iRefCnt;
+	// is this instance the last?
+	if(!m_pWorkers || m_pWorkers.use_count() > 1) return;
 
-	try
+	for(std::shared_ptr<SqwProcWorker>& pWorker : *m_pWorkers)
 	{
-		tl::log_debug("Creating process memory \"", "takin_sqw_proc_*_", m_strProcName, "\".");
+		std::lock_guard<std::mutex> lock(pWorker->mtx);
+		StopWorker(*pWorker, false);
+	}
+}
 
-		m_pMem = std::make_shared<ipr::managed_shared_memory>(ipr::create_only,
-			("takin_sqw_proc_mem_" + m_strProcName).c_str(), PARAM_MEM);
-		m_pSharedPars = static_cast<void*>(m_pMem->construct<t_sh_str>
-			(("takin_sqw_proc_params_" + m_strProcName).c_str())
-			(t_sh_str_alloc(m_pMem->get_segment_manager())));
 
-		m_pmsgIn = std::make_shared<ipr::message_queue>(ipr::create_only,
-			("takin_sqw_proc_in_" + m_strProcName).c_str(), MSG_QUEUE_SIZE, sizeof(ProcMsg));
-		m_pmsgOut = std::make_shared<ipr::message_queue>(ipr::create_only,
-			("takin_sqw_proc_out_" + m_strProcName).c_str(), MSG_QUEUE_SIZE, sizeof(ProcMsg));
+/**
+ * fork a new model process
+ */
+template<class t_sqw>
+bool SqwProc<t_sqw>::StartWorker(SqwProcWorker& worker) const
+{
+	worker.strProcName = tl::rand_name<std::string>(8);
+	worker.bOk = 0;
 
-		m_pidChild = fork();
-		if(m_pidChild < 0)
+	try
+	{
+		tl::log_debug("Creating process memory \"", "takin_sqw_proc_*_", worker.strProcName, "\".");
+
+		worker.pMem = std::make_shared<ipr::managed_shared_memory>(ipr::create_only,
+			("takin_sqw_proc_mem_" + worker.strProcName).c_str(), PARAM_MEM);
+		worker.pSharedPars = static_cast<void*>(worker.pMem->construct<t_sh_str>
+			(("takin_sqw_proc_params_" + worker.strProcName).c_str())
+			(t_sh_str_alloc(worker.pMem->get_segment_manager())));
+
+		worker.pmsgIn = std::make_shared<ipr::message_queue>(ipr::create_only,
+			("takin_sqw_proc_in_" + worker.strProcName).c_str(), MSG_QUEUE_SIZE, sizeof(ProcMsg));
+		worker.pmsgOut = std::make_shared<ipr::message_queue>(ipr::create_only,
+			("takin_sqw_proc_out_" + worker.strProcName).c_str(), MSG_QUEUE_SIZE, sizeof(ProcMsg));
+
+		// the mapping is inherited by the child process at the same address
+		worker.pBatchMem = std::make_shared<ipr::shared_memory_object>(ipr::create_only,
+			("takin_sqw_proc_batch_" + worker.strProcName).c_str(), ipr::read_write);
+		worker.pBatchMem->truncate(BATCH_ELEMS*BATCH_ARRAYS*sizeof(t_real));
+		worker.pBatchRegion = std::make_shared<ipr::mapped_region>(*worker.pBatchMem, ipr::read_write);
+
+		worker.pidChild = fork();
+		if(worker.pidChild < 0)
 		{
 			tl::log_err("Cannot fork process.");
-			return;
+			return false;
 		}
-		else if(m_pidChild == 0)
+		else if(worker.pidChild == 0)
 		{
-			child_proc<t_sqw>(*m_pmsgIn, *m_pmsgOut, pcCfg);
-			exit(0);
+			child_proc<t_sqw>(*worker.pmsgIn, *worker.pmsgOut, m_strCfg.c_str(),
+				static_cast<t_real*>(worker.pBatchRegion->get_address()));
+			_exit(0);
 		}
 
 		tl::log_debug("Waiting for client to become ready...");
-		ProcMsg msgReady = msg_recv(*m_pmsgIn);
-		if(!msgReady.bRet)
+		ProcMsg msgReady;
+		if(!Receive(worker, msgReady))
+			tl::log_err("Client has terminated during initialisation.");
+		else if(!msgReady.bRet)
 			tl::log_err("Client reports failure.");
 		else
 			tl::log_debug("Client is ready.");
 
-		m_bOk = msgReady.bRet;
+		worker.bOk = msgReady.bRet;
+		worker.bReportedDead = 0;
 	}
 	catch(const std::exception& ex)
 	{
-		m_bOk = 0;
+		worker.bOk = 0;
 		tl::log_err(ex.what());
 	}
+
+	return worker.bOk;
 }
 
 
 /**
- * clean up sub-process
+ * end a model process and remove its resources
  */
 template<class t_sqw>
-SqwProc<t_sqw>::~SqwProc()
+void SqwProc<t_sqw>::StopWorker(SqwProcWorker& worker, bool bKill) const
 {
-	// is this instance the last?
-	if(m_pMem.use_count() > 1) return;
-
 	try
 	{
-		if(m_pmsgOut)
+		if(worker.pidChild > 0)
 		{
-			ProcMsg msg;
-			msg.ty = ProcMsgTypes::QUIT;
-			msg_send(*m_pmsgOut, msg);
+			if(bKill)
+			{
+				kill(worker.pidChild, SIGKILL);
+			}
+			else if(worker.pmsgOut)
+			{
+				ProcMsg msg;
+				msg.ty = ProcMsgTypes::QUIT;
+				msg_send(*worker.pmsgOut, msg);
+			}
+
+			waitpid(worker.pidChild, nullptr, 0);
+			worker.pidChild = 0;
 		}
 
-		if(--m_iRefCnt == 0)
-		{
-			tl::log_debug("Removing process memory \"", "takin_sqw_proc_*_", m_strProcName, "\".");
+		tl::log_debug("Removing process memory \"", "takin_sqw_proc_*_", worker.strProcName, "\".");
 
-			ipr::shared_memory_object::remove(("takin_sqw_proc_mem_" + m_strProcName).c_str());
+		worker.pBatchRegion.reset();
+		worker.pBatchMem.reset();
+		worker.pmsgIn.reset();
+		worker.pmsgOut.reset();
+		worker.pMem.reset();
+		worker.pSharedPars = nullptr;
 
-			ipr::message_queue::remove(("takin_sqw_proc_in_" + m_strProcName).c_str());
-			ipr::message_queue::remove(("takin_sqw_proc_out_" + m_strProcName).c_str());
-		}
+		ipr::shared_memory_object::remove(("takin_sqw_proc_mem_" + worker.strProcName).c_str());
+		ipr::shared_memory_object::remove(("takin_sqw_proc_batch_" + worker.strProcName).c_str());
+
+		ipr::message_queue::remove(("takin_sqw_proc_in_" + worker.strProcName).c_str());
+		ipr::message_queue::remove(("takin_sqw_proc_out_" + worker.strProcName).c_str());
 	}
 	catch(const std::exception&)
 	{}
+
+	worker.bOk = 0;
+}
+
+
+/**
+ * replace a terminated model process by a new one with the same variables;
+ * forking from another thread could copy locks held by the remaining threads
+ * into the child, so this is only done by the thread owning the processes
+ */
+template<class t_sqw>
+bool SqwProc<t_sqw>::RespawnWorker(SqwProcWorker& worker) const
+{
+	if(!IsOwnerThread())
+	{
+		if(!worker.bReportedDead)
+		{
+			tl::log_warn("S(q,w) model process \"", worker.strProcName,
+				"\" has terminated, it will be restarted by the main thread.");
+			worker.bReportedDead = 1;
+		}
+		return false;
+	}
+
+	tl::log_warn("S(q,w) model process \"", worker.strProcName, "\" has terminated, restarting it.");
+
+	StopWorker(worker, true);
+	if(!StartWorker(worker))
+		return false;
+
+	std::vector<SqwBase::t_var> vecVars;
+	{
+		std::lock_guard<std::mutex> lock(*m_pmtxVars);
+		vecVars = *m_pVars;
+	}
+	if(!vecVars.size())
+		return true;
+
+	ProcMsg msg, msgRet;
+	msg.ty = ProcMsgTypes::SET_VARS;
+	msg.pPars = static_cast<decltype(msg.pPars)>(worker.pSharedPars);
+	pars_to_str(*msg.pPars, vecVars);
+	msg_send(*worker.pmsgOut, msg);
+
+	return Receive(worker, msgRet) && msgRet.bRet;
+}
+
+
+/**
+ * wait for the reply of a model process, returns false if it has terminated
+ */
+template<class t_sqw>
+bool SqwProc<t_sqw>::Receive(SqwProcWorker& worker, ProcMsg& msgRet) const
+{
+	if(!worker.pmsgIn)
+		return false;
+
+	while(!msg_recv_timed(*worker.pmsgIn, msgRet, PROC_POLL_MS))
+	{
+		// still alive?
+		if(worker.pidChild <= 0 || waitpid(worker.pidChild, nullptr, WNOHANG) != 0)
+		{
+			worker.pidChild = 0;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * send a request to a model process and wait for its reply,
+ * restarts the process and repeats the request once if the process has terminated
+ */
+template<class t_sqw>
+bool SqwProc<t_sqw>::Request(SqwProcWorker& worker, const ProcMsg& msg, ProcMsg& msgRet) const
+{
+	for(int iTry=0; iTry<2; ++iTry)
+	{
+		if(!worker.bOk && !RespawnWorker(worker))
+			return false;
+
+		ProcMsg msgCur = msg;
+		if(msgCur.pPars)
+			msgCur.pPars = static_cast<decltype(msgCur.pPars)>(worker.pSharedPars);
+
+		msg_send(*worker.pmsgOut, msgCur);
+		if(Receive(worker, msgRet))
+			return true;
+
+		worker.bOk = 0;
+	}
+
+	tl::log_err("S(q,w) model process failed repeatedly.");
+	return false;
+}
+
+
+/**
+ * lock the model processes to use: either all currently idle ones or,
+ * if none is idle, wait for one of them;
+ * terminated processes are skipped unless the owning thread can restart them
+ */
+template<class t_sqw>
+typename SqwProc<t_sqw>::t_locked_workers SqwProc<t_sqw>::AcquireWorkers(bool bAll) const
+{
+	t_locked_workers vecLocks;
+	const std::size_t iNumWorkers = m_pWorkers->size();
+	const std::size_t iStart = (*m_piNextWorker)++;
+	const bool bCanRespawn = IsOwnerThread();
+
+	for(std::size_t i=0; i<iNumWorkers; ++i)
+	{
+		SqwProcWorker *pWorker = (*m_pWorkers)[(iStart+i) % iNumWorkers].get();
+		std::unique_lock<std::mutex> lock(pWorker->mtx, std::try_to_lock);
+		if(lock.owns_lock() && (pWorker->bOk || bCanRespawn))
+		{
+			vecLocks.emplace_back(pWorker, std::move(lock));
+			if(!bAll)
+				break;
+		}
+	}
+
+	// wait for a busy process
+	for(std::size_t i=0; !vecLocks.size() && i<iNumWorkers; ++i)
+	{
+		SqwProcWorker *pWorker = (*m_pWorkers)[(iStart+i) % iNumWorkers].get();
+		std::unique_lock<std::mutex> lock(pWorker->mtx);
+		if(pWorker->bOk || bCanRespawn)
+			vecLocks.emplace_back(pWorker, std::move(lock));
+	}
+
+	// all processes have terminated, the request will fail
+	if(!vecLocks.size())
+	{
+		SqwProcWorker *pWorker = (*m_pWorkers)[iStart % iNumWorkers].get();
+		vecLocks.emplace_back(pWorker, std::unique_lock<std::mutex>(pWorker->mtx));
+	}
+
+	return vecLocks;
 }
 
 
@@ -419,18 +633,23 @@ template<class t_sqw>
 std::tuple<std::vector<t_real>, std::vector<t_real>>
 SqwProc<t_sqw>::disp(t_real dh, t_real dk, t_real dl) const
 {
-	std::lock_guard<std::mutex> lock(*m_pmtx);
+	t_locked_workers vecLocks = AcquireWorkers(false);
+	SqwProcWorker& worker = *vecLocks[0].first;
 
 	ProcMsg msg;
 	msg.ty = ProcMsgTypes::DISP;
 	msg.dParam1 = dh;
 	msg.dParam2 = dk;
 	msg.dParam3 = dl;
-	msg.pPars = static_cast<decltype(msg.pPars)>(m_pSharedPars);
-	msg_send(*m_pmsgOut, msg);
 
-	ProcMsg msgDisp = msg_recv(*m_pmsgIn);
-	return str_to_disp(*msgDisp.pPars);
+	ProcMsg msgDisp;
+	if(!Request(worker, msg, msgDisp))
+		return std::make_tuple(std::vector<t_real>(), std::vector<t_real>());
+
+	const t_real *pBatch = static_cast<const t_real*>(worker.pBatchRegion->get_address());
+	std::vector<t_real> vecE(pBatch, pBatch + msgDisp.iNum);
+	std::vector<t_real> vecW(pBatch + BATCH_ELEMS, pBatch + BATCH_ELEMS + msgDisp.iNum);
+	return std::make_tuple(vecE, vecW);
 }
 
 
@@ -440,7 +659,8 @@ SqwProc<t_sqw>::disp(t_real dh, t_real dk, t_real dl) const
 template<class t_sqw>
 t_real SqwProc<t_sqw>::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 {
-	std::lock_guard<std::mutex> lock(*m_pmtx);
+	t_locked_workers vecLocks = AcquireWorkers(false);
+	SqwProcWorker& worker = *vecLocks[0].first;
 
 	ProcMsg msg;
 	msg.ty = ProcMsgTypes::SQW;
@@ -448,23 +668,135 @@ t_real SqwProc<t_sqw>::operator()(t_real dh, t_real dk, t_real dl, t_real dE) co
 	msg.dParam2 = dk;
 	msg.dParam3 = dl;
 	msg.dParam4 = dE;
-	msg_send(*m_pmsgOut, msg);
 
-	ProcMsg msgS = msg_recv(*m_pmsgIn);
+	ProcMsg msgS;
+	if(!Request(worker, msg, msgS))
+		return t_real(0);
 	return msgS.dRet;
 }
 
+
+/**
+ * query dynamical structure factor for arrays of points:
+ * the arrays are split over all idle processes and transferred
+ * in chunks through their binary batch buffers
+ */
+template<class t_sqw>
+void SqwProc<t_sqw>::SqwBatch(const t_real* pH, const t_real* pK, const t_real* pL,
+	const t_real* pE, t_real* pS, std::size_t iNum) const
+{
+	t_locked_workers vecLocks = AcquireWorkers(true);
+	const std::size_t iNumWorkers = vecLocks.size();
+
+	// copy a chunk into a worker's batch buffer
+	auto put_chunk = [pH, pK, pL, pE](SqwProcWorker& worker, std::size_t iStart, std::size_t iChunk)
+	{
+		t_real *pBatch = static_cast<t_real*>(worker.pBatchRegion->get_address());
+		std::copy(pH+iStart, pH+iStart+iChunk, pBatch);
+		std::copy(pK+iStart, pK+iStart+iChunk, pBatch + BATCH_ELEMS);
+		std::copy(pL+iStart, pL+iStart+iChunk, pBatch + 2*BATCH_ELEMS);
+		std::copy(pE+iStart, pE+iStart+iChunk, pBatch + 3*BATCH_ELEMS);
+	};
+
+	// copy the results of a chunk from a worker's batch buffer
+	auto get_chunk = [pS](SqwProcWorker& worker, std::size_t iStart, std::size_t iChunk)
+	{
+		const t_real *pBatch = static_cast<const t_real*>(worker.pBatchRegion->get_address());
+		std::copy(pBatch + 4*BATCH_ELEMS, pBatch + 4*BATCH_ELEMS + iChunk, pS+iStart);
+	};
+
+	std::size_t iStart = 0;
+	while(iStart < iNum)
+	{
+		// one chunk per process
+		std::vector<std::size_t> vecStarts, vecChunks;
+		std::size_t iPerWorker = (iNum - iStart + iNumWorkers - 1) / iNumWorkers;
+		iPerWorker = std::min(iPerWorker, std::size_t(BATCH_ELEMS));
+
+		for(std::size_t iWorker=0; iWorker<iNumWorkers && iStart<iNum; ++iWorker)
+		{
+			SqwProcWorker& worker = *vecLocks[iWorker].first;
+			const std::size_t iChunk = std::min(iNum-iStart, iPerWorker);
+			vecStarts.push_back(iStart);
+			vecChunks.push_back(iChunk);
+			iStart += iChunk;
+
+			if(!worker.bOk)
+				continue;	// handled below
+
+			put_chunk(worker, vecStarts.back(), iChunk);
+
+			ProcMsg msg;
+			msg.ty = ProcMsgTypes::SQW_BATCH;
+			msg.iNum = iChunk;
+			msg_send(*worker.pmsgOut, msg);
+		}
+
+		for(std::size_t iWorker=0; iWorker<vecStarts.size(); ++iWorker)
+		{
+			SqwProcWorker *pWorker = vecLocks[iWorker].first;
+
+			ProcMsg msgS;
+			bool bOk = pWorker->bOk && Receive(*pWorker, msgS);
+			if(!bOk)
+			{
+				// process has died, restart it and repeat the chunk; if it
+				// cannot be restarted from this thread, use an already finished process
+				pWorker->bOk = 0;
+				if(!RespawnWorker(*pWorker))
+				{
+					pWorker = nullptr;
+					for(std::size_t iOther=0; iOther<iWorker; ++iOther)
+					{
+						if(vecLocks[iOther].first->bOk)
+						{
+							pWorker = vecLocks[iOther].first;
+							break;
+						}
+					}
+				}
+
+				if(pWorker)
+				{
+					ProcMsg msg;
+					msg.ty = ProcMsgTypes::SQW_BATCH;
+					msg.iNum = vecChunks[iWorker];
+
+					put_chunk(*pWorker, vecStarts[iWorker], vecChunks[iWorker]);
+					msg_send(*pWorker->pmsgOut, msg);
+					bOk = Receive(*pWorker, msgS);
+					if(!bOk)
+						pWorker->bOk = 0;
+				}
+			}
+
+			if(bOk && msgS.ty == ProcMsgTypes::SQW_BATCH && msgS.iNum == vecChunks[iWorker])
+			{
+				get_chunk(*pWorker, vecStarts[iWorker], vecChunks[iWorker]);
+			}
+			else
+			{
+				tl::log_err("Invalid batch reply from S(q,w) process.");
+				std::fill(pS+vecStarts[iWorker], pS+vecStarts[iWorker]+vecChunks[iWorker], t_real(0));
+			}
+		}
+	}
+}
+
+
 template<class t_sqw>
 bool SqwProc<t_sqw>::IsOk() const
 {
-	if(!m_bOk) return false;
-	std::lock_guard<std::mutex> lock(*m_pmtx);
+	if(!m_bOk || !m_pWorkers) return false;
 
-	ProcMsg msg;
+	t_locked_workers vecLocks = AcquireWorkers(false);
+	SqwProcWorker& worker = *vecLocks[0].first;
+
+	ProcMsg msg, msgRet;
 	msg.ty = ProcMsgTypes::IS_OK;
-	msg_send(*m_pmsgOut, msg);
 
-	ProcMsg msgRet = msg_recv(*m_pmsgIn);
+	if(!Request(worker, msg, msgRet))
+		return false;
 	return msgRet.bRet;
 }
 
@@ -475,36 +807,54 @@ bool SqwProc<t_sqw>::IsOk() const
 template<class t_sqw>
 std::vector<SqwBase::t_var> SqwProc<t_sqw>::GetVars() const
 {
-	std::lock_guard<std::mutex> lock(*m_pmtx);
+	t_locked_workers vecLocks = AcquireWorkers(false);
+	SqwProcWorker& worker = *vecLocks[0].first;
 
-	ProcMsg msg;
+	ProcMsg msg, msgRet;
 	msg.ty = ProcMsgTypes::GET_VARS;
-	msg.pPars = static_cast<decltype(msg.pPars)>(m_pSharedPars);
-	msg_send(*m_pmsgOut, msg);
+	msg.pPars = static_cast<decltype(msg.pPars)>(worker.pSharedPars);
 
-	ProcMsg msgRet = msg_recv(*m_pmsgIn);
-	return str_to_pars(*msg.pPars);
+	if(!Request(worker, msg, msgRet))
+		return std::vector<SqwBase::t_var>();
+	return str_to_pars(*static_cast<decltype(msg.pPars)>(worker.pSharedPars));
 }
 
 
 /**
- * set variables
+ * set variables in all processes
  */
 template<class t_sqw>
 void SqwProc<t_sqw>::SetVars(const std::vector<SqwBase::t_var>& vecVars)
 {
-	std::lock_guard<std::mutex> lock(*m_pmtx);
+	// remember the variables for respawned processes
+	{
+		std::lock_guard<std::mutex> lock(*m_pmtxVars);
+		for(const SqwBase::t_var& var : vecVars)
+		{
+			auto iter = std::find_if(m_pVars->begin(), m_pVars->end(),
+				[&var](const SqwBase::t_var& varOld) -> bool
+				{ return std::get<0>(varOld) == std::get<0>(var); });
+
+			if(iter == m_pVars->end())
+				m_pVars->push_back(var);
+			else
+				*iter = var;
+		}
+	}
 
-	ProcMsg msg;
-	msg.ty = ProcMsgTypes::SET_VARS;
-	msg.pPars = static_cast<decltype(msg.pPars)>(m_pSharedPars);
-	pars_to_str(*msg.pPars, vecVars);
-	//tl::log_debug("Message string: ", *msg.pPars);
-	msg_send(*m_pmsgOut, msg);
+	for(std::shared_ptr<SqwProcWorker>& pWorker : *m_pWorkers)
+	{
+		std::lock_guard<std::mutex> lock(pWorker->mtx);
+
+		ProcMsg msg, msgRet;
+		msg.ty = ProcMsgTypes::SET_VARS;
+		msg.pPars = static_cast<decltype(msg.pPars)>(pWorker->pSharedPars);
+		if(msg.pPars)
+			pars_to_str(*msg.pPars, vecVars);
 
-	ProcMsg msgRet = msg_recv(*m_pmsgIn);
-	if(!msgRet.bRet)
-		tl::log_err("Could not set variables.");
+		if(!Request(*pWorker, msg, msgRet) || !msgRet.bRet)
+			tl::log_err("Could not set variables.");
+	}
 }
 
 
@@ -514,13 +864,12 @@ SqwBase* SqwProc<t_sqw>::shallow_copy() const
 	SqwProc* pSqw = new SqwProc();
 	*static_cast<SqwBase*>(pSqw) = *static_cast<const SqwBase*>(this);
 
-	pSqw->m_pmtx = this->m_pmtx;
-	pSqw->m_pMem = this->m_pMem;
-	pSqw->m_pmsgIn = this->m_pmsgIn;
-	pSqw->m_pmsgOut = this->m_pmsgOut;
-	pSqw->m_strProcName = this->m_strProcName;
-	pSqw->m_pidChild = this->m_pidChild;
-	pSqw->m_pSharedPars = this->m_pSharedPars;
+	pSqw->m_strCfg = this->m_strCfg;
+	pSqw->m_pWorkers = this->m_pWorkers;
+	pSqw->m_piNextWorker = this->m_piNextWorker;
+	pSqw->m_pVars = this->m_pVars;
+	pSqw->m_pmtxVars = this->m_pmtxVars;
+	pSqw->m_idOwner = this->m_idOwner;
 
 	return pSqw;
 }
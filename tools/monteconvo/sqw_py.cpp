@@ -11,6 +11,7 @@
 #include "tlibs/file/file.h"
 
 #include <boost/python/stl_iterator.hpp>
+#include <algorithm>
 
 using t_real = t_real_reso;
 
@@ -93,6 +94,22 @@ SqwPy::SqwPy(const char* pcFile) : m_pmtx(std::make_shared<std::mutex>())
 				m_disp = moddict["TakinDisp"];
 			else
 				tl::log_warn("Python script has no TakinDisp function.");
+
+			if(moddict.has_key("TakinSqwBatch"))
+			{
+				m_SqwBatch = moddict["TakinSqwBatch"];
+
+				// pass the batch arrays as numpy arrays, if available
+				try
+				{
+					m_np = py::import("numpy");
+				}
+				catch(const py::error_already_set& ex)
+				{
+					PyErr_Clear();
+					tl::log_warn("Numpy is not available, passing lists to TakinSqwBatch.");
+				}
+			}
 		}
 		catch(const py::error_already_set& ex) {}
 	}
@@ -203,6 +220,69 @@ t_real SqwPy::operator()(t_real dh, t_real dk, t_real dl, t_real dE) const
 }
 
 
+/**
+ * S(Q,E) for arrays of points: calls the optional TakinSqwBatch function once
+ * or, if it does not exist, TakinSqw for each point while locking only once
+ */
+void SqwPy::SqwBatch(const t_real* pH, const t_real* pK, const t_real* pL,
+	const t_real* pE, t_real* pS, std::size_t iNum) const
+{
+	std::fill(pS, pS+iNum, t_real(0));
+
+	if(!m_bOk)
+	{
+		tl::log_err("Interpreter has not initialised, cannot query S(q,w).");
+		return;
+	}
+
+
+	std::lock_guard<std::mutex> lock(*m_pmtx);
+	try
+	{
+		if(!!m_SqwBatch)
+		{
+			py::list lstH, lstK, lstL, lstE;
+			for(std::size_t i=0; i<iNum; ++i)
+			{
+				lstH.append(pH[i]); lstK.append(pK[i]);
+				lstL.append(pL[i]); lstE.append(pE[i]);
+			}
+
+			py::object arrS;
+			if(!m_np.is_none())
+			{
+				py::object asarray = m_np.attr("asarray");
+				arrS = m_SqwBatch(asarray(lstH), asarray(lstK), asarray(lstL), asarray(lstE));
+			}
+			else
+			{
+				arrS = m_SqwBatch(lstH, lstK, lstL, lstE);
+			}
+
+			py::stl_input_iterator<t_real> iterS(arrS);
+			py::stl_input_iterator<t_real> endS;
+
+			std::size_t iNumRet = 0;
+			for(; iterS != endS && iNumRet < iNum; ++iterS, ++iNumRet)
+				pS[iNumRet] = *iterS;
+
+			if(iNumRet != iNum)
+				tl::log_err("TakinSqwBatch returned ", iNumRet, " values, but ", iNum, " were expected.");
+		}
+		else
+		{
+			for(std::size_t i=0; i<iNum; ++i)
+				pS[i] = py::extract<t_real>(m_Sqw(pH[i], pK[i], pL[i], pE[i]));
+		}
+	}
+	catch(const py::error_already_set& ex)
+	{
+		PyErr_Print();
+		PyErr_Clear();
+	}
+}
+
+
 /**
  * Gets model variables.
  */
@@ -356,6 +436,8 @@ SqwBase* SqwPy::shallow_copy() const
 	pSqw->m_Sqw = this->m_Sqw;
 	pSqw->m_Init = this->m_Init;
 	pSqw->m_disp = this->m_disp;
+	pSqw->m_SqwBatch = this->m_SqwBatch;
+	pSqw->m_np = this->m_np;
 
 	return pSqw;
 }
@@ -28,6 +28,7 @@ protected:
 
 	py::object m_sys, m_os, m_mod;
 	py::object m_Sqw, m_disp, m_Init;
+	py::object m_SqwBatch, m_np;
 
 	// filter variables that don't start with the given prefix
 	std::string m_strVarPrefix = "g_";
@@ -40,11 +41,14 @@ public:
 	virtual std::tuple<std::vector<t_real_reso>, std::vector<t_real_reso>>
 		disp(t_real_reso dh, t_real_reso dk, t_real_reso dl) const override;
 	virtual t_real_reso operator()(t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const override;
+	virtual void SqwBatch(const t_real_reso* pH, const t_real_reso* pK, const t_real_reso* pL,
+		const t_real_reso* pE, t_real_reso* pS, std::size_t iNum) const override;
 
 	virtual std::vector<SqwBase::t_var> GetVars() const override;
 	virtual void SetVars(const std::vector<SqwBase::t_var>&) override;
 
 	virtual SqwBase* shallow_copy() const override;
+	virtual bool HasIndependentCopies() const override { return false; }
 
 	void SetVarPrefix(const char* pcFilter) { m_strVarPrefix = pcFilter; }
 };
@@ -30,6 +30,17 @@ bool SqwBase::SetVarIfAvail(const std::string& strKey, const std::string& strNew
 }
 
 
+/**
+ * S(Q,E) for arrays of points, models can override this with a native batch version
+ */
+void SqwBase::SqwBatch(const t_real_reso* pH, const t_real_reso* pK, const t_real_reso* pL,
+	const t_real_reso* pE, t_real_reso* pS, std::size_t iNum) const
+{
+	for(std::size_t i=0; i<iNum; ++i)
+		pS[i] = (*this)(pH[i], pK[i], pL[i], pE[i]);
+}
+
+
 const SqwBase& SqwBase::operator=(const SqwBase& sqw)
 {
 	this->m_bOk = sqw.m_bOk;
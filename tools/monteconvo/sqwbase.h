@@ -46,6 +46,13 @@ public:
 
 	// S(Q,E) dynamical structure factor function
 	virtual t_real_reso operator()(t_real_reso dh, t_real_reso dk, t_real_reso dl, t_real_reso dE) const = 0;
+
+	/**
+	 * S(Q,E) for iNum points at once, the results are written to pS
+	 * (the default implementation calls operator() for each point)
+	 */
+	virtual void SqwBatch(const t_real_reso* pH, const t_real_reso* pK, const t_real_reso* pL,
+		const t_real_reso* pE, t_real_reso* pS, std::size_t iNum) const;
 	virtual bool IsOk() const { return m_bOk; }
 
 	// return model variables
@@ -64,6 +71,9 @@ public:
 	SqwBase(const SqwBase& sqw) { this->operator=(sqw); }
 
 	virtual SqwBase* shallow_copy() const = 0;
+
+	// do shallow copies have their own model variables or do they share them?
+	virtual bool HasIndependentCopies() const { return true; }
 };
 
 
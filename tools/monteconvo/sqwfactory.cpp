@@ -7,6 +7,7 @@
 
 #include "sqwfactory.h"
 #include "sqw.h"
+#include "sqw_grid.h"
 
 #if !defined(NO_PY) || defined(USE_JL)
 	#include "sqw_proc.h"
@@ -67,20 +68,24 @@ static t_mapSqw g_mapSqw =
 	{ "py", t_mapSqw::mapped_type {
 		[](const std::string& strCfgFile) -> std::shared_ptr<SqwBase>
 		//{ return std::make_shared<SqwPy>(strCfgFile.c_str()); },
-		{ return std::make_shared<SqwProc<SqwPy>>(strCfgFile.c_str()); },
+		{ return std::make_shared<SqwProc<SqwPy>>(strCfgFile.c_str(), g_iSqwProcs); },
 		"Python Model" } },
 #endif
 #ifdef USE_JL
 	{ "jl", t_mapSqw::mapped_type {
 		[](const std::string& strCfgFile) -> std::shared_ptr<SqwBase>
 		//{ return std::make_shared<SqwJl>(strCfgFile.c_str()); },
-		{ return std::make_shared<SqwProc<SqwJl>>(strCfgFile.c_str()); },
+		{ return std::make_shared<SqwProc<SqwJl>>(strCfgFile.c_str(), g_iSqwProcs); },
 		"Julia Model" } },
 #endif
 	{ "elastic", t_mapSqw::mapped_type {
 		[](const std::string& strCfgFile) -> std::shared_ptr<SqwBase>
 		{ return std::make_shared<SqwElast>(strCfgFile.c_str()); },
 		"Elastic Model" } },
+	{ "grid", t_mapSqw::mapped_type {
+		[](const std::string& strCfgFile) -> std::shared_ptr<SqwBase>
+		{ return std::make_shared<SqwGrid>(strCfgFile.c_str()); },
+		"Memory-Mapped Grid of the Form (h, k, l) -> (E, w)" } },
 };
 
 
@@ -0,0 +1,45 @@
+/**
+ * converts tabulated S(Q,w) data to the binary grid format
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#include <clocale>
+#include <iostream>
+#include <string>
+
+#include "tlibs/log/log.h"
+#include "sqw_grid.h"
+
+
+int main(int argc, char** argv)
+{
+#ifdef NO_TERM_CMDS
+	tl::Log::SetUseTermCmds(0);
+#endif
+
+	std::setlocale(LC_ALL, "C");
+
+	if(argc != 4)
+	{
+		std::cerr << "Usage:\n";
+		std::cerr << "\t" << argv[0] << " table <in.dat> <out.grid>\n";
+		std::cerr << "\t\tconverts a text table with \"h k l E w\" columns\n";
+		std::cerr << "\t" << argv[0] << " idxgrid <in.cfg> <out.grid>\n";
+		std::cerr << "\t\tconverts the index and data files of the grid module" << std::endl;
+		return -1;
+	}
+
+	const std::string strMode = argv[1];
+	bool bOk = false;
+
+	if(strMode == "table")
+		bOk = sqwgrid_from_table(argv[2], argv[3]);
+	else if(strMode == "idxgrid")
+		bOk = sqwgrid_from_idxgrid(argv[2], argv[3]);
+	else
+		tl::log_err("Unknown input format \"", strMode, "\".");
+
+	return bOk ? 0 : -1;
+}
@@ -13,8 +13,10 @@
 
 #include "../res/ellipse.h"
 #include "../res/helper.h"
+#include "libs/globals.h"
 #include "tlibs/phys/neutrons.h"
 #include "tlibs/math/stat.h"
+#include "tlibs/math/rand.h"
 #include "tlibs/log/log.h"
 
 #include <algorithm>
@@ -28,14 +30,11 @@ using namespace ublas;
 using t_real = t_real_reso;
 
 
-/*
- * this function tries to be a 1:1 C++ reimplementation of the Perl function
- * 'read_mcstas_res' of the McStas 'mcresplot' program
+/**
+ * resolution from the mean and the (untransformed) covariance of the events
  */
-Resolution calc_res(const std::vector<vector<t_real>>& Q_vec, const std::vector<t_real>* pp_vec)
+static Resolution calc_res_cov(const vector<t_real>& Q_avg, const matrix<t_real>& cov)
 {
-	vector<t_real> Q_avg = pp_vec ? tl::mean_value(*pp_vec, Q_vec) : tl::mean_value(Q_vec);
-
 	vector<t_real> Q_dir = tl::make_vec({Q_avg[0], Q_avg[1], Q_avg[2]});
 	Q_dir = Q_dir / norm_2(Q_dir);
 	vector<t_real> Q_perp = tl::make_vec({-Q_dir[1], Q_dir[0], Q_dir[2]});
@@ -60,15 +59,7 @@ Resolution calc_res(const std::vector<vector<t_real>>& Q_vec, const std::vector<
 	tl::log_info("Transformed average Q vector: ", reso.Q_avg);
 
 	reso.res.resize(4,4,0);
-	reso.cov.resize(4,4,0);
-
-	/*for(std::size_t iElem=0; iElem<Q_vec.size(); ++iElem)
-	{
-		std::cout << "Q = (" << Q_vec[iElem][0] << ", " << Q_vec[iElem][1] << ", " << Q_vec[iElem][0] << "), "
-			<< "p = " << (*pp_vec)[iElem] << std::endl;
-	}*/
-
-	std::tie(reso.cov, std::ignore) = tl::covariance(Q_vec, pp_vec);
+	reso.cov = cov;
 	tl::log_info("Covariance matrix (untransformed): ", reso.cov);
 
 	reso.cov = tl::transform<matrix<t_real>>(reso.cov, trafo, true);
@@ -98,8 +89,6 @@ Resolution calc_res(const std::vector<vector<t_real>>& Q_vec, const std::vector<
 		std::copy(reso.Q_avg.begin(), reso.Q_avg.end(),
 			std::ostream_iterator<t_real>(ostrElli, ", "));
 
-		reso.vecQ = Q_vec;
-
 		tl::log_info(ostrVals.str());
 		tl::log_info(ostrIncVals.str());
 		tl::log_info(ostrElli.str());
@@ -109,6 +98,87 @@ Resolution calc_res(const std::vector<vector<t_real>>& Q_vec, const std::vector<
 }
 
 
+/*
+ * this function tries to be a 1:1 C++ reimplementation of the Perl function
+ * 'read_mcstas_res' of the McStas 'mcresplot' program
+ */
+Resolution calc_res(const std::vector<vector<t_real>>& Q_vec, const std::vector<t_real>* pp_vec)
+{
+	// weighted mean and covariance, reduced in parallel
+	const CovAccumulator<t_real, 4> acc = calc_covariance<t_real, 4>(Q_vec, pp_vec, &get_task_pool());
+	const vector<t_real> Q_avg = acc.GetMean();
+
+	/*for(std::size_t iElem=0; iElem<Q_vec.size(); ++iElem)
+	{
+		std::cout << "Q = (" << Q_vec[iElem][0] << ", " << Q_vec[iElem][1] << ", " << Q_vec[iElem][0] << "), "
+			<< "p = " << (*pp_vec)[iElem] << std::endl;
+	}*/
+
+	Resolution reso = calc_res_cov(Q_avg, acc.GetCovariance());
+	if(reso.bHasRes)
+		reso.vecQ = Q_vec;
+
+	return reso;
+}
+
+
+/**
+ * resolution from streamed events, the subsample is used for plotting
+ */
+Resolution calc_res(const ResoEventStream& events)
+{
+	tl::log_info("Calculating resolution from ", events.cov.GetNum(), " events...");
+	if(events.cov.GetWeightSum() <= t_real(0))
+	{
+		tl::log_err("No events with non-zero weight.");
+		return Resolution();
+	}
+
+	const vector<t_real> Q_avg = events.cov.GetMean();
+	tl::log_info("Average Q vector: ", Q_avg);
+
+	Resolution reso = calc_res_cov(Q_avg, events.cov.GetCovariance());
+	if(reso.bHasRes)
+		reso.vecQ = events.vecSubsample;
+
+	return reso;
+}
+
+
+void ResoEventStream::AddQE(const t_real *pQE, t_real p)
+{
+	cov.Add(pQE, p);
+
+	// reservoir sampling: the n-th event replaces a stored one with probability iMaxSubsample/n
+	const std::size_t iNum = cov.GetNum();
+	if(vecSubsample.size() < iMaxSubsample)
+	{
+		vecSubsample.emplace_back(tl::make_vec<vector<t_real>>({pQE[0], pQE[1], pQE[2], pQE[3]}));
+	}
+	else if(iMaxSubsample)
+	{
+		const std::size_t iIdx = std::size_t(tl::rand_real<t_real>(t_real(0), t_real(iNum)));
+		if(iIdx < iMaxSubsample)
+		{
+			vector<t_real>& vecQ = vecSubsample[iIdx];
+			for(std::size_t i=0; i<4; ++i)
+				vecQ[i] = pQE[i];
+		}
+	}
+}
+
+
+void kikf_to_QE(const t_real *pKi, const t_real *pKf, t_real *pQE)
+{
+	const t_real dKi2 = pKi[0]*pKi[0] + pKi[1]*pKi[1] + pKi[2]*pKi[2];
+	const t_real dKf2 = pKf[0]*pKf[0] + pKf[1]*pKf[1] + pKf[2]*pKf[2];
+
+	for(std::size_t i=0; i<3; ++i)
+		pQE[i] = pKi[i] - pKf[i];
+	pQE[3] = tl::get_KSQ2E<t_real>() * (dKi2 - dKf2);
+}
+
+
 
 /*
  * this function tries to be a 1:1 C++ reimplementation of the Perl function
@@ -13,6 +13,7 @@
 #define __MONTERES_H__
 
 #include "../res/defs.h"
+#include "../res/covariance.h"
 #include "tlibs/math/linalg.h"
 #include <utility>
 namespace ublas = boost::numeric::ublas;
@@ -36,15 +37,38 @@ struct Resolution
 	// ellipse origin
 	ublas::vector<t_real_reso> Q_avg, Q_avg_notrafo;
 
-	// all MC events
+	// all MC events (or a random subsample of them)
 	std::vector<ublas::vector<t_real_reso>> vecQ;
 };
 
+
+/**
+ * MC events accumulated one by one without storing all of them:
+ * mean and covariance of (Q, E) and a uniform random subsample for plotting
+ */
+struct ResoEventStream
+{
+	CovAccumulator<t_real_reso, 4> cov;
+
+	// reservoir of at most iMaxSubsample events
+	std::size_t iMaxSubsample = 100000;
+	std::vector<ublas::vector<t_real_reso>> vecSubsample;
+
+	// adds an event given by (Qx, Qy, Qz, E) and its weight
+	void AddQE(const t_real_reso *pQE, t_real_reso p = 1.);
+};
+
+
+// (Qx, Qy, Qz, E) of an event given by ki and kf
+void kikf_to_QE(const t_real_reso *pKi, const t_real_reso *pKf, t_real_reso *pQE);
+
 t_real_reso get_vanadium_fwhm(const Resolution& reso);
 
 Resolution calc_res(const std::vector<ublas::vector<t_real_reso>>& Q_vec,
 	const std::vector<t_real_reso>* pp_vec = nullptr);
 
+Resolution calc_res(const ResoEventStream& events);
+
 Resolution calc_res(const std::vector<ublas::vector<t_real_reso>>& vecKi,
 	const std::vector<ublas::vector<t_real_reso>>& vecKf,
 	const std::vector<t_real_reso>* p_i = nullptr,
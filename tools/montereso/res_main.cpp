@@ -8,16 +8,23 @@
 #include "res.h"
 #include "tlibs/log/log.h"
 #include "tlibs/string/string.h"
+#include "tlibs/math/rand.h"
 #include "dialogs/EllipseDlg.h"
 #include "../res/helper.h"
+#include "libs/globals.h"
 
 #include <clocale>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include <unordered_map>
 #include <string>
 #include <memory>
 
+#include <boost/iostreams/device/mapped_file.hpp>
+
 using namespace ublas;
 using t_real = t_real_reso;
 
@@ -49,6 +56,8 @@ enum class FileType
 {
 	NEUTRON_Q_LIST,
 	NEUTRON_KIKF_LIST,
+	NEUTRON_Q_LIST_BIN,
+	NEUTRON_KIKF_LIST_BIN,
 
 	RESOLUTION_MATRIX,
 	COVARIANCE_MATRIX,
@@ -113,7 +122,40 @@ static bool load_mat(const char* pcFile, Resolution& reso, FileType ft)
 }
 
 
-static bool load_mc_list(const char* pcFile, Resolution& res)
+/**
+ * (Q, E) and weight of an event from the columns "ki_x ki_y ki_z kf_x kf_y kf_z x y z p_i p_f"
+ * of a mcstas ki, kf list, converted to the takin coordinate system
+ */
+static t_real get_kikf_event(const t_real *pCols, t_real *pQE)
+{
+	const t_real dKi[] = { -pCols[0], pCols[2], pCols[1] };
+	const t_real dKf[] = { -pCols[3], pCols[5], pCols[4] };
+
+	kikf_to_QE(dKi, dKf, pQE);
+	return std::abs(pCols[9] * pCols[10]);
+}
+
+
+/**
+ * reads up to iNum numbers from a line, missing ones are set to 0
+ */
+static void parse_line(const char *pcLine, t_real *pVals, std::size_t iNum)
+{
+	for(std::size_t i=0; i<iNum; ++i)
+	{
+		char *pcEnd = nullptr;
+		pVals[i] = std::strtod(pcLine, &pcEnd);
+		if(pcEnd == pcLine)
+		{
+			std::fill(pVals+i, pVals+iNum, t_real(0));
+			break;
+		}
+		pcLine = pcEnd;
+	}
+}
+
+
+static bool load_mc_list(const char* pcFile, Resolution& res, std::size_t iMaxSubsample)
 {
 	FileType ft = FileType::NEUTRON_Q_LIST;
 
@@ -124,12 +166,10 @@ static bool load_mc_list(const char* pcFile, Resolution& res)
 		return 0;
 	}
 
-	// neutron Q,E list
-	std::vector<vector<t_real>> vecQ;
+	// the events are accumulated while reading, only a subsample is kept
+	ResoEventStream events;
+	events.iMaxSubsample = iMaxSubsample;
 
-	// neutron ki, kf list
-	std::vector<vector<t_real>> vecKi, vecKf, vecPos;
-	std::vector<t_real> vecPi, vecPf;
 	std::string strLine;
 
 	std::unordered_map<std::string, std::string> mapParams;
@@ -166,47 +206,151 @@ static bool load_mc_list(const char* pcFile, Resolution& res)
 			}
 		}
 
-		std::istringstream istr(strLine);
-
 		if(ft == FileType::NEUTRON_Q_LIST)
 		{
-			t_real dQx=0., dQy=0., dQz=0., dE=0.;
-			istr >> dQx >> dQy >> dQz >> dE;
-			vector<t_real> _vec = tl::make_vec<vector<t_real>>({dQx, dQy, dQz, dE});
-
-			vecQ.push_back(std::move(_vec));
+			t_real dQE[4];
+			parse_line(strLine.c_str(), dQE, 4);
+			events.AddQE(dQE);
 		}
 		else if(ft == FileType::NEUTRON_KIKF_LIST)
 		{
-			t_real dKi[3], dKf[3], dPos[3], dPi=0., dPf=0.;
+			t_real dCols[11], dQE[4];
+			parse_line(strLine.c_str(), dCols, 11);
+			const t_real p = get_kikf_event(dCols, dQE);
+			events.AddQE(dQE, p);
+		}
+
+		++uiNumNeutr;
+	}
+
+	tl::log_info("Number of neutrons in file: ", uiNumNeutr);
+	//print_map(std::cout, mapParams);
+
+	res = calc_res(events);
+
+	for(vector<t_real>& vecCurQ : res.vecQ)
+		vecCurQ -= res.Q_avg_notrafo;
+
+	if(!res.bHasRes)
+	{
+		tl::log_err("Cannot calculate resolution matrix.");
+		return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+ * loads a binary event list of native 64 bit floats, memory-mapped,
+ * with the columns "Qx Qy Qz E" (Q list) or "ki_x ki_y ki_z kf_x kf_y kf_z x y z p_i p_f" (ki, kf list)
+ */
+static bool load_mc_list_bin(const char* pcFile, Resolution& res, FileType ft, std::size_t iMaxSubsample)
+{
+	const std::size_t iCols = (ft == FileType::NEUTRON_KIKF_LIST_BIN) ? 11 : 4;
+	const std::size_t iEventSize = iCols * sizeof(double);
+
+	boost::iostreams::mapped_file_source file;
+	try
+	{
+		file.open(pcFile);
+	}
+	catch(const std::exception& ex)
+	{
+		tl::log_err("Cannot map \"", pcFile, "\": ", ex.what());
+		return 0;
+	}
+
+	if(!file.is_open() || file.size() % iEventSize != 0)
+	{
+		tl::log_err("\"", pcFile, "\" is not a binary list with ", iCols, " columns.");
+		return 0;
+	}
+
+	const std::size_t uiNumNeutr = file.size() / iEventSize;
+	const char *pcData = file.data();
+
+	// (Q, E) and weight of an event
+	auto read_event = [pcData, iCols, iEventSize, ft](std::size_t iEvent, t_real *pQE) -> t_real
+	{
+		double dColsRaw[11];
+		std::memcpy(dColsRaw, pcData + iEvent*iEventSize, iEventSize);
+
+		t_real dCols[11];
+		std::copy(dColsRaw, dColsRaw+iCols, dCols);
+
+		if(ft == FileType::NEUTRON_KIKF_LIST_BIN)
+			return get_kikf_event(dCols, pQE);
+
+		std::copy(dCols, dCols+4, pQE);
+		return t_real(1);
+	};
+
+	// mean and covariance, reduced in parallel directly from the mapped file
+	ResoEventStream events;
+	events.cov = cov_reduce<t_real, 4>(uiNumNeutr,
+		[&read_event](std::size_t iBegin, std::size_t iEnd, CovAccumulator<t_real, 4>& acc)
+		{
+			constexpr std::size_t BLOCK = 256;
+			t_real dComps[4][BLOCK], dW[BLOCK];
+			const t_real *pBlock[] = { dComps[0], dComps[1], dComps[2], dComps[3] };
+
+			for(std::size_t iBlock=iBegin; iBlock<iEnd; iBlock+=BLOCK)
+			{
+				const std::size_t iNum = std::min(BLOCK, iEnd - iBlock);
+				for(std::size_t iEvent=0; iEvent<iNum; ++iEvent)
+				{
+					t_real dQE[4];
+					dW[iEvent] = read_event(iBlock + iEvent, dQE);
+					for(std::size_t i=0; i<4; ++i)
+						dComps[i][iEvent] = dQE[i];
+				}
 
-			istr >> dKi[0] >> dKi[2] >> dKi[1];
-			istr >> dKf[0] >> dKf[2] >> dKf[1];
-			istr >> dPos[0] >> dPos[2] >> dPos[1];
-			istr >> dPi >> dPf;
+				acc.AddChunk(pBlock, dW, iNum);
+			}
+		}, &get_task_pool());
 
-			dKi[0] = -dKi[0];
-			dKf[0] = -dKf[0];
-			dPos[0] = -dPos[0];
+	// random subsample for plotting
+	std::vector<std::size_t> vecIdx;
+	if(uiNumNeutr <= iMaxSubsample)
+	{
+		vecIdx.resize(uiNumNeutr);
+		for(std::size_t iEvent=0; iEvent<uiNumNeutr; ++iEvent)
+			vecIdx[iEvent] = iEvent;
+	}
+	else
+	{
+		// partial fisher-yates shuffle to draw distinct events, the permutation
+		// only stores the entries which differ from the identity
+		std::unordered_map<std::size_t, std::size_t> mapPerm;
+		auto get_perm = [&mapPerm](std::size_t iIdx) -> std::size_t
+		{
+			auto iter = mapPerm.find(iIdx);
+			return iter == mapPerm.end() ? iIdx : iter->second;
+		};
 
-			vecKi.emplace_back(tl::make_vec<vector<t_real>>({dKi[0], dKi[1], dKi[2]}));
-			vecKf.emplace_back(tl::make_vec<vector<t_real>>({dKf[0], dKf[1], dKf[2]}));
-			vecPos.emplace_back(tl::make_vec<vector<t_real>>({dPos[0], dPos[1], dPos[2]}));
+		vecIdx.resize(iMaxSubsample);
+		for(std::size_t iDraw=0; iDraw<iMaxSubsample; ++iDraw)
+		{
+			std::size_t iOther = iDraw + std::size_t(tl::rand_real<t_real>(0., t_real(uiNumNeutr - iDraw)));
+			iOther = std::min(iOther, uiNumNeutr-1);
 
-			vecPi.push_back(dPi);
-			vecPf.push_back(dPf);
+			vecIdx[iDraw] = get_perm(iOther);
+			mapPerm[iOther] = get_perm(iDraw);
 		}
+		std::sort(vecIdx.begin(), vecIdx.end());
+	}
 
-		++uiNumNeutr;
+	events.vecSubsample.reserve(vecIdx.size());
+	for(std::size_t iIdx : vecIdx)
+	{
+		t_real dQE[4];
+		read_event(iIdx, dQE);
+		events.vecSubsample.emplace_back(tl::make_vec<vector<t_real>>({dQE[0], dQE[1], dQE[2], dQE[3]}));
 	}
 
 	tl::log_info("Number of neutrons in file: ", uiNumNeutr);
-	//print_map(std::cout, mapParams);
-
-	if(ft == FileType::NEUTRON_Q_LIST)
-		res = calc_res(std::forward<decltype(vecQ)&&>(vecQ));
-	else if(ft == FileType::NEUTRON_KIKF_LIST)
-		res = calc_res(vecKi, vecKf, &vecPi, &vecPf);
+	res = calc_res(events);
 
 	for(vector<t_real>& vecCurQ : res.vecQ)
 		vecCurQ -= res.Q_avg_notrafo;
@@ -242,12 +386,16 @@ static EllipseDlg* show_ellipses(const Resolution& res)
 int main(int argc, char **argv)
 {
 	std::setlocale(LC_ALL, "C");
+	tl::init_rand();
 	if(argc <= 1)
 	{
 		std::ostringstream ostr;
-		ostr << "Usage: " << argv[0] << " [-r,-c] <file>\n" 
+		ostr << "Usage: " << argv[0] << " [-r,-c,-bq,-bk] [-n <num>] <file>\n" 
 			<< "\t-r\t<file> contains resolution matrix\n"
 			<< "\t-c\t<file> contains covariance matrix\n"
+			<< "\t-bq\t<file> contains binary Q list (Qx Qy Qz E, 64 bit floats)\n"
+			<< "\t-bk\t<file> contains binary ki,kf list (ki kf pos p_i p_f, 64 bit floats)\n"
+			<< "\t-n\tnumber of neutrons to keep for plotting (default: 100000)\n"
 			<< "\t<n/a>\t<file> contains Q or ki,kf list";
 
 		tl::log_err("No input file given.\n", ostr.str());
@@ -257,12 +405,19 @@ int main(int argc, char **argv)
 	const char* pcFile = argv[argc-1];
 
 	FileType ft = FileType::UNKNOWN;
-	for(int iArg=1; iArg<argc; ++iArg)
+	std::size_t iMaxSubsample = 100000;
+	for(int iArg=1; iArg<argc-1; ++iArg)
 	{
 		if(strcmp(argv[iArg], "-r") == 0)
 			ft = FileType::RESOLUTION_MATRIX;
 		else if(strcmp(argv[iArg], "-c") == 0)
 			ft = FileType::COVARIANCE_MATRIX;
+		else if(strcmp(argv[iArg], "-bq") == 0)
+			ft = FileType::NEUTRON_Q_LIST_BIN;
+		else if(strcmp(argv[iArg], "-bk") == 0)
+			ft = FileType::NEUTRON_KIKF_LIST_BIN;
+		else if(strcmp(argv[iArg], "-n") == 0 && iArg+1 < argc-1)
+			iMaxSubsample = tl::str_to_var<std::size_t>(std::string(argv[++iArg]));
 	}
 
 
@@ -274,10 +429,16 @@ int main(int argc, char **argv)
 		if(!load_mat(pcFile, res, ft))
 			return -1;
 	}
+	else if(ft==FileType::NEUTRON_Q_LIST_BIN || ft==FileType::NEUTRON_KIKF_LIST_BIN)
+	{
+		tl::log_info("Loading binary neutron list from \"", pcFile, "\".");
+		if(!load_mc_list_bin(pcFile, res, ft, iMaxSubsample))
+			return -1;
+	}
 	else
 	{
 		tl::log_info("Loading neutron list from \"", pcFile, "\".");
-		if(!load_mc_list(pcFile, res))
+		if(!load_mc_list(pcFile, res, iMaxSubsample))
 			return -1;
 	}
 
@@ -131,8 +131,10 @@ ResoDlg::ResoDlg(QWidget *pParent, QSettings* pSettings)
 	m_vecPosEditBoxes = {editE, editQ, editKi, editKf};
 	m_vecPosEditNames = {"reso/E", "reso/Q", "reso/ki", "reso/kf"};
 
-	m_vecCheckBoxes = {checkUseR0, checkUseResVol, checkUseGeneralR0, checkUseKi3, checkUseKf3, checkUseKfKi};
-	m_vecCheckNames = {"reso/use_R0", "reso/use_resvol", "reso/use_general_R0", "reso/use_ki3", "reso/use_kf3", "reso/use_kfki"};
+	m_vecCheckBoxes = {checkUseR0, checkUseResVol, checkUseGeneralR0, checkUseKi3, checkUseKf3, checkUseKfKi,
+		checkMCSobol};
+	m_vecCheckNames = {"reso/use_R0", "reso/use_resvol", "reso/use_general_R0", "reso/use_ki3", "reso/use_kf3", "reso/use_kfki",
+		"reso/mc_live_sobol"};
 
 	m_vecRadioPlus = {radioMonoScatterPlus, radioAnaScatterPlus,
 		radioSampleScatterPlus,
@@ -696,13 +698,17 @@ void ResoDlg::Calc()
 
 				opts.dAngleQVec0 = m_dAngleQVec0;
 
+				// the same quasi-random points are used for both coordinate systems
+				opts.sampler = checkMCSobol->isChecked() ? McSampler::SOBOL : McSampler::PSEUDO;
+				std::shared_ptr<const SobolSeq<t_real_reso>> pSeq = mc_create_sequence<t_real_reso>(opts.sampler);
+
 				if(m_bHasUB)
 				{
 					// rlu system
 					opts.coords = McNeutronCoords::RLU;
 					if(m_vecMC_HKL.size() != iNumMC)
 						m_vecMC_HKL.resize(iNumMC);
-					mc_neutrons<t_vec>(m_ell4d, iNumMC, opts, m_vecMC_HKL.begin());
+					mc_neutrons<t_vec>(m_ell4d, iNumMC, opts, m_vecMC_HKL.begin(), pSeq.get());
 				}
 				else
 					m_vecMC_HKL.clear();
@@ -711,7 +717,7 @@ void ResoDlg::Calc()
 				opts.coords = McNeutronCoords::DIRECT;
 				if(m_vecMC_direct.size() != iNumMC)
 					m_vecMC_direct.resize(iNumMC);
-				mc_neutrons<t_vec>(m_ell4d, iNumMC, opts, m_vecMC_direct.begin());
+				mc_neutrons<t_vec>(m_ell4d, iNumMC, opts, m_vecMC_direct.begin(), pSeq.get());
 			}
 			else
 			{
@@ -1033,6 +1039,10 @@ void ResoDlg::MCGenerate()
 
 
 	opts.dAngleQVec0 = m_dAngleQVec0;
+	// the quasi-random setting ("reso/mc_live_sobol") only applies to the live plots,
+	// the exported neutrons are independent pseudo-random events
+	opts.sampler = McSampler::PSEUDO;
+
 	vecNeutrons.resize(iNeutrons);
 	mc_neutrons<t_vec>(m_ell4d, iNeutrons, opts, vecNeutrons.begin());
 
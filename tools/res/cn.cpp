@@ -22,7 +22,6 @@
 #include "tlibs/log/log.h"
 
 #include <string>
-#include <future>
 #include <iostream>
 
 
@@ -58,189 +57,215 @@ static const t_real sig2fwhm = tl::get_SIGMA2FWHM<t_real>();
  * e.g. E ~ ki^2 - kf^2
  * dE ~ 2ki*dki - 2kf*dkf
  */
-t_mat get_trafo_dkidkf_dQdE(const angle& ki_Q, const angle& kf_Q,
+t_mat_fix<t_real, 6> get_trafo_dkidkf_dQdE_fix(const angle& ki_Q, const angle& kf_Q,
 	const wavenumber& ki, const wavenumber& kf)
 {
-	t_mat Ti = tl::rotation_matrix_2d(ki_Q/rads);
-	t_mat Tf = -tl::rotation_matrix_2d(kf_Q/rads);
-
-	t_mat U = ublas::zero_matrix<t_real>(6,6);
-	tl::submatrix_copy(U, Ti, 0, 0);
-	tl::submatrix_copy(U, Tf, 0, 3);
+	// Ti = rotation(ki_Q), Tf = -rotation(kf_Q)
+	const t_real dSi = units::sin(ki_Q), dCi = units::cos(ki_Q);
+	const t_real dSf = units::sin(kf_Q), dCf = units::cos(kf_Q);
+
+	t_mat_fix<t_real, 6> U = fix_zero_matrix<t_real, 6>();
+	U(0,0) = dCi; U(0,1) = -dSi;
+	U(1,0) = dSi; U(1,1) = dCi;
+	U(0,3) = -dCf; U(0,4) = dSf;
+	U(1,3) = -dSf; U(1,4) = -dCf;
 	U(2,2) = 1.; U(2,5) = -1.;
 	U(3,0) = +t_real(2)*ki * tl::get_KSQ2E<t_real>() * angs;
 	U(3,3) = -t_real(2)*kf * tl::get_KSQ2E<t_real>() * angs;
 	U(4,0) = 1.; U(5,2) = 1.;
-	//tl::log_info("Trafo matrix (CN) = ", U);
 
 	return U;
 }
 
 
-ResoResults calc_cn(const CNParams& cn)
+t_mat get_trafo_dkidkf_dQdE(const angle& ki_Q, const angle& kf_Q,
+	const wavenumber& ki, const wavenumber& kf)
 {
-	ResoResults res;
+	return t_mat(get_trafo_dkidkf_dQdE_fix(ki_Q, kf_Q, ki, kf));
+}
+
 
+/**
+ * scan-dependent part of the parameters
+ */
+ResoScanPoint get_scan_point(const CNParams& cn)
+{
+	ResoScanPoint pt;
+
+	pt.ki = cn.ki; pt.kf = cn.kf;
+	pt.Q = cn.Q; pt.E = cn.E;
+	pt.thetaa = cn.thetaa; pt.thetam = cn.thetam;
+	pt.twotheta = cn.twotheta;
+	pt.angle_ki_Q = cn.angle_ki_Q;
+	pt.angle_kf_Q = cn.angle_kf_Q;
+	pt.pos_x = pt.pos_y = pt.pos_z = t_real(0)*angs;
+
+	return pt;
+}
+
+
+/**
+ * horizontal and vertical mono or ana part of the resolution matrix, [mit84], equ. A.5,
+ * written to the 3x3 block starting at iOffs
+ */
+static void calc_mono_ana_res(angle theta, wavenumber k,
+	angle mosaic, angle mosaic_v,
+	angle coll1, angle coll2,
+	angle coll1_v, angle coll2_v,
+	t_mat_fix<t_real, 6>& M, std::size_t iOffs)
+{
+	// horizontal part
+	const t_real dTan = units::tan(theta);
+	const t_real dMos = t_real(1) / (k*angs * mosaic/rads);
+	const t_real dColl1 = t_real(1) / (k*angs * coll1/rads);
+	const t_real dColl2 = t_real(1) / (k*angs * coll2/rads);
+
+	const t_real vecMos[2] = { dTan*dMos, dMos };
+	const t_real vecColl1[2] = { t_real(2)*dTan*dColl1, dColl1 };
+	const t_real vecColl2[2] = { t_real(0), dColl2 };
+
+	for(std::size_t i=0; i<2; ++i)
+		for(std::size_t j=0; j<2; ++j)
+			M(iOffs+i, iOffs+j) = vecMos[i]*vecMos[j] +
+				vecColl1[i]*vecColl1[j] + vecColl2[i]*vecColl2[j];
+
+	// vertical part, [mit84], equ. A.9 & A.13
+	M(iOffs+2, iOffs+2) = t_real(1)/(k*k * angs*angs) * rads*rads *
+	(
+		t_real(1) / (coll2_v * coll2_v) +
+		t_real(1) / ((t_real(2)*units::sin(theta) * mosaic_v) *
+			(t_real(2)*units::sin(theta) * mosaic_v) +
+			coll1_v * coll1_v)
+	);
+}
+
+
+/**
+ * cooper-nathans resolution at one scan point
+ */
+static void calc_cn_point(const CNParams& cn, const ResoScanPoint& pt, ResoResults& res)
+{
 	res.Q_avg.resize(4);
-	res.Q_avg[0] = cn.Q * angs;
+	res.Q_avg[0] = pt.Q * angs;
 	res.Q_avg[1] = 0.;
 	res.Q_avg[2] = 0.;
-	res.Q_avg[3] = cn.E / meV;
-
-	angle coll_h_pre_mono = cn.coll_h_pre_mono;
-	angle coll_v_pre_mono = cn.coll_v_pre_mono;
+	res.Q_avg[3] = pt.E / meV;
 
 	// use the same as the horizontal mosaics for now
 	angle mono_mosaic_v = cn.mono_mosaic;
 	angle ana_mosaic_v = cn.ana_mosaic;
 
-	/*const length lam = tl::k2lam(cn.ki);
-	if(cn.bGuide)
-	{
-		coll_h_pre_mono = lam*(cn.guide_div_h/angs);
-		coll_v_pre_mono = lam*(cn.guide_div_v/angs);
-	}*/
-
-	angle thetaa = cn.thetaa * cn.dana_sense;
-	angle thetam = cn.thetam * cn.dmono_sense;
-	angle ki_Q = cn.angle_ki_Q;
-	angle kf_Q = cn.angle_kf_Q;
+	angle thetaa = pt.thetaa * cn.dana_sense;
+	angle thetam = pt.thetam * cn.dmono_sense;
+	angle ki_Q = pt.angle_ki_Q * cn.dsample_sense;
+	angle kf_Q = pt.angle_kf_Q * cn.dsample_sense;
 
-	ki_Q *= cn.dsample_sense;
-	kf_Q *= cn.dsample_sense;
-
-	t_mat U = get_trafo_dkidkf_dQdE(ki_Q, kf_Q, cn.ki, cn.kf);
+	const t_mat_fix<t_real, 6> U = get_trafo_dkidkf_dQdE_fix(ki_Q, kf_Q, pt.ki, pt.kf);
 
 	// V matrix -> [mit84], equ. A.16
-	t_mat V(6,6);
-	if(!tl::inverse(U, V))
+	t_mat_fix<t_real, 6> V;
+	if(!fix_inverse(U, V))
 	{
 		res.bOk = false;
 		res.strErr = "Transformation matrix cannot be inverted.";
-		return res;
+		return;
 	}
 	// -------------------------------------------------------------------------
 
 
-	const auto tupScFact = get_scatter_factors(cn.flags, cn.thetam, cn.ki, cn.thetaa, cn.kf);
+	const auto tupScFact = get_scatter_factors(cn.flags, pt.thetam, pt.ki, pt.thetaa, pt.kf);
 
 	t_real dmono_refl = cn.dmono_refl * std::get<0>(tupScFact);
 	t_real dana_effic = cn.dana_effic * std::get<1>(tupScFact);
-	if(cn.mono_refl_curve) dmono_refl *= (*cn.mono_refl_curve)(cn.ki);
-	if(cn.ana_effic_curve) dana_effic *= (*cn.ana_effic_curve)(cn.kf);
+	if(cn.mono_refl_curve) dmono_refl *= (*cn.mono_refl_curve)(pt.ki);
+	if(cn.ana_effic_curve) dana_effic *= (*cn.ana_effic_curve)(pt.kf);
 	t_real dxsec = std::get<2>(tupScFact);
 
 
 	// -------------------------------------------------------------------------
 	// resolution matrix, [mit84], equ. A.5
-	t_mat M = ublas::zero_matrix<t_real>(6,6);
-
-	auto calc_mono_ana_res =
-		[](angle theta, wavenumber k,
-		angle mosaic, angle mosaic_v,
-		angle coll1, angle coll2,
-		angle coll1_v, angle coll2_v) -> std::pair<t_mat, t_real>
-	{
-		// horizontal part
-		t_vec vecMos(2);
-		vecMos[0] = units::tan(theta);
-		vecMos[1] = 1.;
-		vecMos /= k*angs * mosaic/rads;
-
-		t_vec vecColl1(2);
-		vecColl1[0] = 2.*units::tan(theta);
-		vecColl1[1] = 1.;
-		vecColl1 /= (k*angs * coll1/rads);
-
-		t_vec vecColl2(2);
-		vecColl2[0] = 0;
-		vecColl2[1] = 1.;
-		vecColl2 /= (k*angs * coll2/rads);
-
-		t_mat matHori = ublas::outer_prod(vecMos, vecMos) +
-			ublas::outer_prod(vecColl1, vecColl1) +
-			ublas::outer_prod(vecColl2, vecColl2);
-
-		// vertical part, [mit84], equ. A.9 & A.13
-		t_real dVert = t_real(1)/(k*k * angs*angs) * rads*rads *
-		(
-			t_real(1) / (coll2_v * coll2_v) +
-			t_real(1) / ((t_real(2)*units::sin(theta) * mosaic_v) *
-				(t_real(2)*units::sin(theta) * mosaic_v) +
-				coll1_v * coll1_v)
-		);
-
-		return std::pair<t_mat, t_real>(matHori, dVert);
-	};
-
-	std::launch lpol = /*std::launch::deferred |*/ std::launch::async;
-	std::future<std::pair<t_mat, t_real>> futMono
-		= std::async(lpol, calc_mono_ana_res,
-			thetam, cn.ki,
-			cn.mono_mosaic, mono_mosaic_v,
-			cn.coll_h_pre_mono, cn.coll_h_pre_sample,
-			cn.coll_v_pre_mono, cn.coll_v_pre_sample);
-	std::future<std::pair<t_mat, t_real>> futAna
-		= std::async(lpol, calc_mono_ana_res,
-			-thetaa, cn.kf,
-			cn.ana_mosaic, ana_mosaic_v,
-			cn.coll_h_post_ana, cn.coll_h_post_sample,
-			cn.coll_v_post_ana, cn.coll_v_post_sample);
-
-	t_mat matMonoH, matAnaH;
-	t_real dMonoV, dAnaV;
-	std::tie(matMonoH, dMonoV) = futMono.get();
-	std::tie(matAnaH, dAnaV) = futAna.get();
-
-	tl::submatrix_copy(M, matMonoH, 0, 0);
-	tl::submatrix_copy(M, matAnaH, 3, 3);
-	M(2,2) = dMonoV;
-	M(5,5) = dAnaV;
+	t_mat_fix<t_real, 6> M = fix_zero_matrix<t_real, 6>();
+
+	calc_mono_ana_res(thetam, pt.ki,
+		cn.mono_mosaic, mono_mosaic_v,
+		cn.coll_h_pre_mono, cn.coll_h_pre_sample,
+		cn.coll_v_pre_mono, cn.coll_v_pre_sample,
+		M, 0);
+	calc_mono_ana_res(-thetaa, pt.kf,
+		cn.ana_mosaic, ana_mosaic_v,
+		cn.coll_h_post_ana, cn.coll_h_post_sample,
+		cn.coll_v_post_ana, cn.coll_v_post_sample,
+		M, 3);
 	// -------------------------------------------------------------------------
 
 
-	t_mat N = tl::transform(M, V, 1);
+	const t_mat_fix<t_real, 6> N6 = fix_transform(M, V);
+	const t_mat_fix<t_real, 5> N5 = fix_quadric_proj(N6, 5);
+	const t_mat_fix<t_real, 4> N = fix_quadric_proj(N5, 4);
+
+	const t_real dSampleMos = cn.sample_mosaic/rads * pt.Q*angs;
+	const t_real dDenom = t_real(1)/(dSampleMos*dSampleMos) + N(1,1);
 
-	N = quadric_proj(N, 5);
-	N = quadric_proj(N, 4);
+	t_mat_fix<t_real, 4> reso;
+	for(std::size_t i=0; i<4; ++i)
+		for(std::size_t j=0; j<4; ++j)
+			reso(i,j) = (N(i,j) - N(i,1)*N(j,1) / dDenom) * sig2fwhm*sig2fwhm;
+	reso(2,2) = N(2,2) * sig2fwhm*sig2fwhm;
 
-	t_vec vec1 = tl::get_column<t_vec>(N, 1);
-	res.reso = N - ublas::outer_prod(vec1,vec1)
-		/ (1./((cn.sample_mosaic/rads * cn.Q*angs)
-		* (cn.sample_mosaic/rads * cn.Q*angs)) + N(1,1));
-	res.reso(2,2) = N(2,2);
-	res.reso *= sig2fwhm*sig2fwhm;
+	// mirror Q_perp
+	if(cn.dsample_sense < 0.)
+		fix_mirror(reso, 1);
 
+	res.reso = reso;
 	res.reso_v = ublas::zero_vector<t_real>(4);
 	res.reso_s = 0.;
 
-	if(cn.dsample_sense < 0.)
-	{
-		// mirror Q_perp
-		t_mat matMirror = tl::mirror_matrix<t_mat>(res.reso.size1(), 1);
-		res.reso = tl::transform(res.reso, matMirror, true);
-		res.reso_v[1] = -res.reso_v[1];
-	}
-
 	// -------------------------------------------------------------------------
 
 
 	res.dResVol = tl::get_ellipsoid_volume(res.reso);
-	res.dR0 = chess_R0(cn.ki,cn.kf, thetam, thetaa, cn.twotheta, cn.mono_mosaic,
+	res.dR0 = chess_R0(pt.ki, pt.kf, thetam, thetaa, pt.twotheta, cn.mono_mosaic,
 		cn.ana_mosaic, cn.coll_v_pre_mono, cn.coll_v_post_ana, dmono_refl, dana_effic);
 	res.dR0 *= dxsec;
 
 	// Bragg widths
-	const std::vector<t_real> vecFwhms = calc_bragg_fwhms(res.reso);
-	std::copy(vecFwhms.begin(), vecFwhms.end(), res.dBraggFWHMs);
+	for(std::size_t i=0; i<4; ++i)
+		res.dBraggFWHMs[i] = sig2fwhm/std::sqrt(reso(i,i));
 
 	if(tl::is_nan_or_inf(res.dR0) || tl::is_nan_or_inf(res.reso))
 	{
 		res.strErr = "Invalid result.";
 		res.bOk = false;
-		return res;
+		return;
 	}
 
+	res.strErr = "";
 	res.bOk = true;
-	return res;
+}
+
+
+/**
+ * cooper-nathans resolution at all scan points
+ */
+void calc_cn_batch(const CNParams& cn,
+	const std::vector<ResoScanPoint>& vecPts, std::vector<ResoResults>& vecRes)
+{
+	vecRes.resize(vecPts.size());
+
+	for(std::size_t iPt=0; iPt<vecPts.size(); ++iPt)
+	{
+		// the result does not depend on the sample position
+		if(iPt > 0 && vecPts[iPt].SameKinematics(vecPts[iPt-1]))
+			vecRes[iPt] = vecRes[iPt-1];
+		else
+			calc_cn_point(cn, vecPts[iPt], vecRes[iPt]);
+	}
+}
+
+
+ResoResults calc_cn(const CNParams& cn)
+{
+	std::vector<ResoResults> vecRes;
+	calc_cn_batch(cn, { get_scan_point(cn) }, vecRes);
+	return vecRes[0];
 }
@@ -16,11 +16,13 @@
 #define __TAKIN_CN_H__
 
 #include "defs.h"
+#include "fixedmat.h"
 #include "refl_curve.h"
 #include "tlibs/phys/neutrons.h"
 #include "tlibs/math/linalg.h"
 #include <tuple>
 #include <memory>
+#include <vector>
 
 namespace units = boost::units;
 namespace codata = boost::units::si::constants::codata;
@@ -75,7 +77,40 @@ struct CNParams
 	std::size_t flags = CALC_R0 | CALC_RESVOL | CALC_KI3 | CALC_KF3 | CALC_KFKI;
 };
 
+
+/**
+ * scan-dependent TAS parameters, the other parameters in CNParams
+ * are the same for all points of a scan
+ */
+struct ResoScanPoint
+{
+	tl::t_wavenumber_si<t_real_reso> ki, kf, Q;
+	tl::t_energy_si<t_real_reso> E;
+
+	tl::t_angle_si<t_real_reso> thetaa, thetam;
+	tl::t_angle_si<t_real_reso> twotheta;
+
+	tl::t_angle_si<t_real_reso> angle_ki_Q;
+	tl::t_angle_si<t_real_reso> angle_kf_Q;
+
+	// sample position, only used by the eckold-sobolev algorithm
+	tl::t_length_si<t_real_reso> pos_x, pos_y, pos_z;
+
+	// same spectrometer position, i.e. only the sample position may differ
+	bool SameKinematics(const ResoScanPoint& pt) const
+	{
+		return ki == pt.ki && kf == pt.kf && Q == pt.Q && E == pt.E &&
+			thetaa == pt.thetaa && thetam == pt.thetam && twotheta == pt.twotheta &&
+			angle_ki_Q == pt.angle_ki_Q && angle_kf_Q == pt.angle_kf_Q;
+	}
+};
+
+
+extern ResoScanPoint get_scan_point(const CNParams& cn);
+
 extern ResoResults calc_cn(const CNParams& cn);
+extern void calc_cn_batch(const CNParams& cn,
+	const std::vector<ResoScanPoint>& vecPts, std::vector<ResoResults>& vecRes);
 
 extern std::tuple<t_real_reso, t_real_reso, t_real_reso>
 	get_scatter_factors(std::size_t flags,
@@ -88,4 +123,8 @@ extern ublas::matrix<t_real_reso> get_trafo_dkidkf_dQdE(
 	const tl::t_angle_si<t_real_reso>& ki_Q, const tl::t_angle_si<t_real_reso>& kf_Q,
 	const tl::t_wavenumber_si<t_real_reso>& ki, const tl::t_wavenumber_si<t_real_reso>& kf);
 
+extern t_mat_fix<t_real_reso, 6> get_trafo_dkidkf_dQdE_fix(
+	const tl::t_angle_si<t_real_reso>& ki_Q, const tl::t_angle_si<t_real_reso>& kf_Q,
+	const tl::t_wavenumber_si<t_real_reso>& ki, const tl::t_wavenumber_si<t_real_reso>& kf);
+
 #endif
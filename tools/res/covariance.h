@@ -0,0 +1,292 @@
+/**
+ * streaming mean and covariance of weighted events
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __RESO_COVARIANCE_H__
+#define __RESO_COVARIANCE_H__
+
+#include <cstddef>
+#include <vector>
+#include <future>
+#include <algorithm>
+
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
+#include "libs/taskpool.h"
+
+
+// number of events reduced per chunk in calc_covariance
+#define COV_CHUNK_SIZE	16384
+
+
+/**
+ * one-pass weighted mean and covariance (welford's algorithm, weighted form by west),
+ * the events themselves are not stored.
+ * the covariance is normalised to the sum of the weights, so it does not change
+ * if all weights are scaled by the same factor.
+ */
+template<class t_real = double, std::size_t N = 4>
+class CovAccumulator
+{
+protected:
+	t_real m_dW = t_real(0);
+	std::size_t m_iNum = 0;
+	t_real m_mean[N];
+
+	// sum of the weighted squared deviations, upper triangle in row-major order
+	t_real m_comoment[N*(N+1)/2];
+
+public:
+	CovAccumulator() { Clear(); }
+
+	void Clear()
+	{
+		m_dW = t_real(0);
+		m_iNum = 0;
+		for(std::size_t i=0; i<N; ++i)
+			m_mean[i] = t_real(0);
+		for(std::size_t i=0; i<N*(N+1)/2; ++i)
+			m_comoment[i] = t_real(0);
+	}
+
+	/**
+	 * adds an event x (N values) with weight dW
+	 */
+	void Add(const t_real *x, t_real dW = t_real(1))
+	{
+		++m_iNum;
+		if(dW <= t_real(0))
+			return;
+
+		m_dW += dW;
+		const t_real dFact = dW / m_dW;
+
+		t_real dDeltaOld[N], dDeltaNew[N];
+		for(std::size_t i=0; i<N; ++i)
+		{
+			dDeltaOld[i] = x[i] - m_mean[i];
+			m_mean[i] += dFact * dDeltaOld[i];
+			dDeltaNew[i] = x[i] - m_mean[i];
+		}
+
+		for(std::size_t i=0, iElem=0; i<N; ++i)
+			for(std::size_t j=i; j<N; ++j, ++iElem)
+				m_comoment[iElem] += dW * dDeltaOld[i] * dDeltaNew[j];
+	}
+
+	/**
+	 * adds the events [0, iNum) given as one array per component (pComps[0..N-1])
+	 * with the weights pW (all 1 if null), using the chunk's own mean as reference
+	 */
+	void AddChunk(const t_real* const *pComps, const t_real *pW, std::size_t iNum)
+	{
+		CovAccumulator<t_real, N> acc;
+		acc.m_iNum = iNum;
+
+		for(std::size_t iEvent=0; iEvent<iNum; ++iEvent)
+		{
+			const t_real dW = pW ? pW[iEvent] : t_real(1);
+			if(dW <= t_real(0))
+				continue;
+
+			acc.m_dW += dW;
+			for(std::size_t i=0; i<N; ++i)
+				acc.m_mean[i] += dW * pComps[i][iEvent];
+		}
+
+		if(acc.m_dW > t_real(0))
+		{
+			for(std::size_t i=0; i<N; ++i)
+				acc.m_mean[i] /= acc.m_dW;
+
+			for(std::size_t iEvent=0; iEvent<iNum; ++iEvent)
+			{
+				const t_real dW = pW ? pW[iEvent] : t_real(1);
+				if(dW <= t_real(0))
+					continue;
+
+				t_real dDelta[N];
+				for(std::size_t i=0; i<N; ++i)
+					dDelta[i] = pComps[i][iEvent] - acc.m_mean[i];
+
+				for(std::size_t i=0, iElem=0; i<N; ++i)
+					for(std::size_t j=i; j<N; ++j, ++iElem)
+						acc.m_comoment[iElem] += dW * dDelta[i] * dDelta[j];
+			}
+		}
+
+		Merge(acc);
+	}
+
+	/**
+	 * merges the events of another accumulator into this one (chan's pairwise update)
+	 */
+	void Merge(const CovAccumulator<t_real, N>& acc)
+	{
+		m_iNum += acc.m_iNum;
+		if(acc.m_dW <= t_real(0))
+			return;
+
+		if(m_dW <= t_real(0))
+		{
+			m_dW = acc.m_dW;
+			std::copy(acc.m_mean, acc.m_mean+N, m_mean);
+			std::copy(acc.m_comoment, acc.m_comoment+N*(N+1)/2, m_comoment);
+			return;
+		}
+
+		const t_real dW = m_dW + acc.m_dW;
+		const t_real dFact = m_dW * acc.m_dW / dW;
+
+		t_real dDelta[N];
+		for(std::size_t i=0; i<N; ++i)
+		{
+			dDelta[i] = acc.m_mean[i] - m_mean[i];
+			m_mean[i] += dDelta[i] * acc.m_dW / dW;
+		}
+
+		for(std::size_t i=0, iElem=0; i<N; ++i)
+			for(std::size_t j=i; j<N; ++j, ++iElem)
+				m_comoment[iElem] += acc.m_comoment[iElem] + dFact * dDelta[i] * dDelta[j];
+
+		m_dW = dW;
+	}
+
+	// number of added events, including the ones with zero weight
+	std::size_t GetNum() const { return m_iNum; }
+	t_real GetWeightSum() const { return m_dW; }
+
+	ublas::vector<t_real> GetMean() const
+	{
+		ublas::vector<t_real> vec(N);
+		for(std::size_t i=0; i<N; ++i)
+			vec[i] = m_mean[i];
+		return vec;
+	}
+
+	ublas::matrix<t_real> GetCovariance() const
+	{
+		ublas::matrix<t_real> mat(N, N);
+		const t_real dNorm = m_dW > t_real(0) ? t_real(1)/m_dW : t_real(0);
+
+		for(std::size_t i=0, iElem=0; i<N; ++i)
+			for(std::size_t j=i; j<N; ++j, ++iElem)
+				mat(i,j) = mat(j,i) = m_comoment[iElem] * dNorm;
+		return mat;
+	}
+};
+
+
+/**
+ * reduces the events [0, iNum) chunk by chunk, in parallel if a pool is given;
+ * funcChunk(iBegin, iEnd, acc) has to add the events [iBegin, iEnd) to acc.
+ * the chunks are merged in a fixed order, so the result does not depend on the number of threads.
+ */
+template<class t_real, std::size_t N, class t_func>
+CovAccumulator<t_real, N> cov_reduce(std::size_t iNum, t_func funcChunk,
+	TaskPool* pPool = nullptr, std::size_t iChunkSize = COV_CHUNK_SIZE)
+{
+	if(iChunkSize == 0)
+		iChunkSize = COV_CHUNK_SIZE;
+	const std::size_t iNumChunks = (iNum + iChunkSize - 1) / iChunkSize;
+	std::vector<CovAccumulator<t_real, N>> vecAccs(iNumChunks);
+
+	auto reduce_chunks = [&funcChunk, &vecAccs, iNum, iChunkSize](std::size_t iFirst, std::size_t iLast)
+	{
+		for(std::size_t iChunk=iFirst; iChunk<iLast; ++iChunk)
+		{
+			const std::size_t iBegin = iChunk * iChunkSize;
+			const std::size_t iEnd = std::min(iBegin + iChunkSize, iNum);
+			funcChunk(iBegin, iEnd, vecAccs[iChunk]);
+		}
+	};
+
+	const std::size_t iNumTasks = pPool ? std::min<std::size_t>(iNumChunks, pPool->GetNumActive()) : 1;
+	if(iNumTasks > 1)
+	{
+		std::vector<std::future<void>> vecFuts;
+		vecFuts.reserve(iNumTasks);
+
+		for(std::size_t iTask=0; iTask<iNumTasks; ++iTask)
+		{
+			const std::size_t iFirst = iNumChunks * iTask / iNumTasks;
+			const std::size_t iLast = iNumChunks * (iTask+1) / iNumTasks;
+			vecFuts.emplace_back(pPool->Submit([&reduce_chunks, iFirst, iLast]
+				{ reduce_chunks(iFirst, iLast); }));
+		}
+
+		for(std::future<void>& fut : vecFuts)
+			pPool->Wait(fut);
+	}
+	else
+	{
+		reduce_chunks(0, iNumChunks);
+	}
+
+	CovAccumulator<t_real, N> acc;
+	for(const CovAccumulator<t_real, N>& accChunk : vecAccs)
+		acc.Merge(accChunk);
+	return acc;
+}
+
+
+/**
+ * mean and covariance of iNum events given as one array per component (pComps[0..N-1]),
+ * with the weights pW (all 1 if null)
+ */
+template<class t_real, std::size_t N>
+CovAccumulator<t_real, N> calc_covariance(const t_real* const *pComps, const t_real *pW,
+	std::size_t iNum, TaskPool* pPool = nullptr)
+{
+	return cov_reduce<t_real, N>(iNum,
+		[pComps, pW](std::size_t iBegin, std::size_t iEnd, CovAccumulator<t_real, N>& acc)
+		{
+			const t_real *pChunk[N];
+			for(std::size_t i=0; i<N; ++i)
+				pChunk[i] = pComps[i] + iBegin;
+
+			acc.AddChunk(pChunk, pW ? pW + iBegin : nullptr, iEnd - iBegin);
+		}, pPool);
+}
+
+
+/**
+ * mean and covariance of events given as vectors with at least N components,
+ * with the weights pW (all 1 if null)
+ */
+template<class t_real, std::size_t N, class t_vec = ublas::vector<t_real>>
+CovAccumulator<t_real, N> calc_covariance(const std::vector<t_vec>& vecEvents,
+	const std::vector<t_real>* pW = nullptr, TaskPool* pPool = nullptr)
+{
+	return cov_reduce<t_real, N>(vecEvents.size(),
+		[&vecEvents, pW](std::size_t iBegin, std::size_t iEnd, CovAccumulator<t_real, N>& acc)
+		{
+			// copy blocks of the events into component arrays
+			constexpr std::size_t BLOCK = 256;
+			t_real dComps[N][BLOCK];
+			const t_real *pBlock[N];
+			for(std::size_t i=0; i<N; ++i)
+				pBlock[i] = dComps[i];
+
+			for(std::size_t iBlock=iBegin; iBlock<iEnd; iBlock+=BLOCK)
+			{
+				const std::size_t iNum = std::min(BLOCK, iEnd - iBlock);
+				for(std::size_t iEvent=0; iEvent<iNum; ++iEvent)
+				{
+					const t_vec& vec = vecEvents[iBlock + iEvent];
+					for(std::size_t i=0; i<N; ++i)
+						dComps[i][iEvent] = vec[i];
+				}
+
+				acc.AddChunk(pBlock, pW ? pW->data() + iBlock : nullptr, iNum);
+			}
+		}, pPool);
+}
+
+
+#endif
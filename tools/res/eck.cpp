@@ -18,7 +18,6 @@
 #include "ellipse.h"
 
 #include <tuple>
-#include <future>
 #include <string>
 #include <iostream>
 
@@ -42,8 +41,33 @@ static const t_real pi = tl::get_pi<t_real>();
 static const t_real sig2fwhm = tl::get_SIGMA2FWHM<t_real>();
 
 
-static std::tuple<t_mat, t_vec, t_real, t_real, t_real>
-get_mono_vals(const length& src_w, const length& src_h,
+using t_mat2 = t_mat_fix<t_real, 2>;
+using t_mat3 = t_mat_fix<t_real, 3>;
+using t_mat4 = t_mat_fix<t_real, 4>;
+using t_mat5 = t_mat_fix<t_real, 5>;
+using t_mat6 = t_mat_fix<t_real, 6>;
+using t_vec3 = t_vec_fix<t_real, 3>;
+using t_vec5 = t_vec_fix<t_real, 5>;
+using t_vec6 = t_vec_fix<t_real, 6>;
+
+
+/**
+ * mono or ana part of the quadric, [eck14], equs. 26-28 & 38-40;
+ * the terms depending on the sample position are given for a position of 1 cm
+ */
+struct EckMonoVals
+{
+	t_mat3 A;
+	t_mat2 Av;
+
+	t_real B[2], Bv[2];
+	t_real C, Cv;
+
+	t_real refl;
+};
+
+
+static void get_mono_vals(const length& src_w, const length& src_h,
 	const length& mono_w, const length& mono_h,
 	const length& dist_src_mono, const length& dist_mono_sample,
 	const wavenumber& ki, const angle& thetam,
@@ -51,11 +75,15 @@ get_mono_vals(const length& src_w, const length& src_h,
 	const angle& coll_v_pre_mono, const angle& coll_v_pre_sample,
 	const angle& mono_mosaic, const angle& mono_mosaic_v,
 	const inv_length& inv_mono_curvh, const inv_length& inv_mono_curvv,
-	const length& pos_x , const length& pos_y, const length& pos_z,
-	t_real dRefl)
+	t_real dRefl, EckMonoVals& vals)
 {
+	// unit sample position, the B terms are linear and the C terms quadratic in it
+	const length pos_y = t_real(1)*cm;
+	const length pos_z = t_real(1)*cm;
+
 	// A matrix: formula 26 in [eck14]
-	t_mat A = ublas::identity_matrix<t_real>(3);
+	t_mat3& A = vals.A;
+	A = fix_unit_matrix<t_real, 3>();
 	{
 		const auto A_t0 = t_real(1) / mono_mosaic;
 		const auto A_tx = inv_mono_curvh*dist_mono_sample / units::abs(units::sin(thetam));
@@ -93,7 +121,7 @@ get_mono_vals(const length& src_w, const length& src_h,
 	// some typos in paper leading to the (false) result of a better Qz resolution when focusing
 	// => trying to match terms in Av with corresponding terms in A
 	// corresponding pre-mono terms commented out in Av, as they are not considered there
-	t_mat Av(2,2);
+	t_mat2& Av = vals.Av;
 	{
 		const auto Av_t0 = t_real(0.5) / (mono_mosaic_v*units::abs(units::sin(thetam)));
 		const auto Av_t1 = inv_mono_curvv*dist_mono_sample / mono_mosaic_v;
@@ -125,16 +153,16 @@ get_mono_vals(const length& src_w, const length& src_h,
 	}
 
 	// B vector: formula 27 in [eck14]
-	t_vec B(3);
+	t_real (&B)[2] = vals.B;
 	{
 		const auto B_t0 = inv_mono_curvh / (mono_mosaic*mono_mosaic*units::abs(units::sin(thetam)));
 
-		B(0) = sig2fwhm*sig2fwhm * pos_y / (ki*angs) * units::tan(thetam) *
+		B[0] = sig2fwhm*sig2fwhm * pos_y / (ki*angs) * units::tan(thetam) *
 		(
 /*i*/			+ t_real(2)*dist_src_mono / (src_w*src_w)
 /*j*/			+ B_t0 *rads*rads
 		);
-		B(1) = sig2fwhm*sig2fwhm * pos_y / (ki*angs) *
+		B[1] = sig2fwhm*sig2fwhm * pos_y / (ki*angs) *
 		(
 /*r*/			- dist_mono_sample / (units::pow<2>(mono_w*units::abs(units::sin(thetam))))
 /*s*/			+ B_t0 * rads*rads
@@ -145,18 +173,18 @@ get_mono_vals(const length& src_w, const length& src_h,
 	}
 
 	// Bv vector: formula 39 in [eck14]
-	t_vec Bv(2);
+	t_real (&Bv)[2] = vals.Bv;
 	{
 		const auto Bv_t0 = inv_mono_curvv/(mono_mosaic_v*mono_mosaic_v);
 
-		Bv(0) = sig2fwhm*sig2fwhm * pos_z / (ki*angs) * t_real(-1.) *
+		Bv[0] = sig2fwhm*sig2fwhm * pos_z / (ki*angs) * t_real(-1.) *
 		(
 /*r*/			+ dist_mono_sample / (mono_h*mono_h)	// typo in paper?
 /*~s*/			- t_real(0.5)*Bv_t0 *rads*rads / units::abs(units::sin(thetam))
 /*~t*/			+ Bv_t0 * rads*rads * inv_mono_curvv*dist_mono_sample
 /*~u*/			+ dist_mono_sample / (src_h*src_h)		// typo in paper?
 		);
-		Bv(1) = sig2fwhm*sig2fwhm * pos_z / (ki*angs) * t_real(-1.) *
+		Bv[1] = sig2fwhm*sig2fwhm * pos_z / (ki*angs) * t_real(-1.) *
 		(
 /*i*/			+ dist_src_mono / (src_h*src_h)			// typo in paper?
 /*j*/			+ t_real(0.5)*Bv_t0/units::abs(units::sin(thetam)) * rads*rads
@@ -165,7 +193,7 @@ get_mono_vals(const length& src_w, const length& src_h,
 
 
 	// C scalar: formula 28 in [eck14]
-	t_real C = t_real(0.5)*sig2fwhm*sig2fwhm * pos_y*pos_y *
+	vals.C = t_real(0.5)*sig2fwhm*sig2fwhm * pos_y*pos_y *
 	(
 		t_real(1)/(src_w*src_w) +
 		units::pow<2>(t_real(1)/(mono_w*units::abs(units::sin(thetam)))) +
@@ -173,7 +201,7 @@ get_mono_vals(const length& src_w, const length& src_h,
 	);
 
 	// Cv scalar: formula 40 in [eck14]
-	t_real Cv = t_real(0.5)*sig2fwhm*sig2fwhm * pos_z*pos_z *
+	vals.Cv = t_real(0.5)*sig2fwhm*sig2fwhm * pos_z*pos_z *
 	(
 		t_real(1)/(src_h*src_h) +
 		t_real(1)/(mono_h*mono_h) +
@@ -183,26 +211,76 @@ get_mono_vals(const length& src_w, const length& src_h,
 
 	// z components, [eck14], equ. 42
 	A(2,2) = Av(0,0) - Av(0,1)*Av(0,1)/Av(1,1);
-	B[2] = Bv[0] - Bv[1]*Av(0,1)/Av(1,1);
-	t_real D = Cv - t_real(0.25)*Bv[1]/Av(1,1);
-
 
 	// [eck14], equ. 54
-	t_real refl = dRefl * std::sqrt(pi / (Av(1,1) /* * A(1,1) */));	// check: typo in paper?
+	vals.refl = dRefl * std::sqrt(pi / (Av(1,1) /* * A(1,1) */));	// check: typo in paper?
+}
+
 
+/**
+ * position-dependent vector and scalar parts of the mono or ana quadric, [eck14], equ. 42
+ */
+static void get_mono_pos_vals(const EckMonoVals& vals, const length& pos_y, const length& pos_z,
+	t_vec3& B, t_real& C, t_real& D)
+{
+	const t_real y = pos_y / cm;
+	const t_real z = pos_z / cm;
+	const t_real Bv[2] = { vals.Bv[0]*z, vals.Bv[1]*z };
+
+	B[0] = vals.B[0]*y;
+	B[1] = vals.B[1]*y;
+	B[2] = Bv[0] - Bv[1]*vals.Av(0,1)/vals.Av(1,1);
 
-	return std::make_tuple(A, B, C, D, refl);
+	C = vals.C*y*y;
+	D = vals.Cv*z*z - t_real(0.25)*Bv[1]/vals.Av(1,1);
 }
 
 
-ResoResults calc_eck(const EckParams& eck)
+/**
+ * rotation around the z axis, same as tl::rotation_matrix_3d_z
+ */
+static t_mat3 rotation_z(t_real dAngle)
 {
-	angle twotheta = eck.twotheta * eck.dsample_sense;
-	angle thetaa = eck.thetaa * eck.dana_sense;
-	angle thetam = eck.thetam * eck.dmono_sense;
-	angle ki_Q = eck.angle_ki_Q * eck.dsample_sense;
-	angle kf_Q = eck.angle_kf_Q * eck.dsample_sense;
+	const t_real s = std::sin(dAngle), c = std::cos(dAngle);
+
+	t_mat3 mat = fix_unit_matrix<t_real, 3>();
+	mat(0,0) = c; mat(0,1) = -s;
+	mat(1,0) = s; mat(1,1) = c;
+	return mat;
+}
+
+
+/**
+ * part of the eckold-sobolev calculation which does not depend on the sample position
+ */
+struct EckKinematics
+{
+	EckMonoVals mono, ana;
+
+	t_mat6 Tinv;
+	t_mat3 Dalph_i, Dalph_f;
+	t_mat6 U1;
+	t_mat5 U2;
+
+	angle twotheta;
+	t_real dR0, dxsec;
+
+	// results without the position-dependent parts
+	ResoResults res;
+};
+
+
+static bool calc_eck_kinematics(const EckParams& eck, const ResoScanPoint& pt, EckKinematics& kin)
+{
+	ResoResults& res = kin.res;
+
+	angle twotheta = pt.twotheta * eck.dsample_sense;
+	angle thetaa = pt.thetaa * eck.dana_sense;
+	angle thetam = pt.thetam * eck.dmono_sense;
+	angle ki_Q = pt.angle_ki_Q * eck.dsample_sense;
+	angle kf_Q = pt.angle_kf_Q * eck.dsample_sense;
 	//kf_Q = ki_Q + twotheta;
+	kin.twotheta = twotheta;
 
 
 	// --------------------------------------------------------------------
@@ -225,15 +303,10 @@ ResoResults calc_eck(const EckParams& eck)
 	if(eck.bMonoIsCurvedV) inv_mono_curvv = t_real(1)/mono_curvv;
 	if(eck.bAnaIsCurvedH) inv_ana_curvh = t_real(1)/ana_curvh;
 	if(eck.bAnaIsCurvedV) inv_ana_curvv = t_real(1)/ana_curvv;
-
-	//if(eck.bMonoIsCurvedH) tl::log_debug("mono curv h: ", mono_curvh);
-	//if(eck.bMonoIsCurvedV) tl::log_debug("mono curv v: ", mono_curvv);
-	//if(eck.bAnaIsCurvedH) tl::log_debug("ana curv h: ", ana_curvh);
-	//if(eck.bAnaIsCurvedV) tl::log_debug("ana curv v: ", ana_curvv);
 	// --------------------------------------------------------------------
 
 
-	const length lam = tl::k2lam(eck.ki);
+	const length lam = tl::k2lam(pt.ki);
 
 	angle coll_h_pre_mono = eck.coll_h_pre_mono;
 	angle coll_v_pre_mono = eck.coll_v_pre_mono;
@@ -245,22 +318,11 @@ ResoResults calc_eck(const EckParams& eck)
 	}
 
 
-	//std::cout << "thetaM = " << t_real(thetam/rads/M_PI*180.) << " deg"<< std::endl;
-	//std::cout << "thetaA = " << t_real(thetaa/rads/M_PI*180.) << " deg"<< std::endl;
-	//std::cout << "ki = " << t_real(eck.ki*angs) << ", kf = " << t_real(eck.kf*angs) << std::endl;
-	//std::cout << "Q = " << t_real(eck.Q*angs) << ", E = " << t_real(eck.E/meV) << std::endl;
-	//std::cout << "kiQ = " << t_real(ki_Q/rads/M_PI*180.) << " deg"<< std::endl;
-	//std::cout << "kfQ = " << t_real(kf_Q/rads/M_PI*180.) << " deg"<< std::endl;
-	//std::cout << "2theta = " << t_real(twotheta/rads/M_PI*180.) << " deg"<< std::endl;
-
-
-	ResoResults res;
-
 	res.Q_avg.resize(4);
-	res.Q_avg[0] = eck.Q*angs;
+	res.Q_avg[0] = pt.Q*angs;
 	res.Q_avg[1] = 0.;
 	res.Q_avg[2] = 0.;
-	res.Q_avg[3] = eck.E/meV;
+	res.Q_avg[3] = pt.E/meV;
 
 
 	// -------------------------------------------------------------------------
@@ -268,31 +330,27 @@ ResoResults calc_eck(const EckParams& eck)
 	// - if the instruments works in kf=const mode and the scans are counted for
 	//   or normalised to monitor counts no ki^3 or kf^3 factor is needed.
 	// - if the instrument works in ki=const mode the kf^3 factor is needed.
-	const auto tupScFact = get_scatter_factors(eck.flags, eck.thetam, eck.ki, eck.thetaa, eck.kf);
+	const auto tupScFact = get_scatter_factors(eck.flags, pt.thetam, pt.ki, pt.thetaa, pt.kf);
 
 	t_real dmono_refl = eck.dmono_refl * std::get<0>(tupScFact);
 	t_real dana_effic = eck.dana_effic * std::get<1>(tupScFact);
-	if(eck.mono_refl_curve) dmono_refl *= (*eck.mono_refl_curve)(eck.ki);
-	if(eck.ana_effic_curve) dana_effic *= (*eck.ana_effic_curve)(eck.kf);
-	t_real dxsec = std::get<2>(tupScFact);
+	if(eck.mono_refl_curve) dmono_refl *= (*eck.mono_refl_curve)(pt.ki);
+	if(eck.ana_effic_curve) dana_effic *= (*eck.ana_effic_curve)(pt.kf);
+	kin.dxsec = std::get<2>(tupScFact);
 
 
 	//--------------------------------------------------------------------------
 	// mono part
 
-	std::launch lpol = /*std::launch::deferred |*/ std::launch::async;
-	std::future<std::tuple<t_mat, t_vec, t_real, t_real, t_real>> futMono
-		= std::async(lpol, get_mono_vals,
-			eck.src_w, eck.src_h,
-			eck.mono_w, eck.mono_h,
-			eck.dist_src_mono, eck.dist_mono_sample,
-			eck.ki, thetam,
-			coll_h_pre_mono, eck.coll_h_pre_sample,
-			coll_v_pre_mono, eck.coll_v_pre_sample,
-			eck.mono_mosaic, eck.mono_mosaic_v,
-			inv_mono_curvh, inv_mono_curvv,
-			eck.pos_x , eck.pos_y, eck.pos_z,
-			dmono_refl);
+	get_mono_vals(eck.src_w, eck.src_h,
+		eck.mono_w, eck.mono_h,
+		eck.dist_src_mono, eck.dist_mono_sample,
+		pt.ki, thetam,
+		coll_h_pre_mono, eck.coll_h_pre_sample,
+		coll_v_pre_mono, eck.coll_v_pre_sample,
+		eck.mono_mosaic, eck.mono_mosaic_v,
+		inv_mono_curvh, inv_mono_curvv,
+		dmono_refl, kin.mono);
 
 	//--------------------------------------------------------------------------
 
@@ -300,65 +358,33 @@ ResoResults calc_eck(const EckParams& eck)
 	//--------------------------------------------------------------------------
 	// ana part
 
-	// equ 43 in [eck14]
-	length pos_y2 = - eck.pos_x*units::sin(twotheta)
-		+ eck.pos_y*units::cos(twotheta);
-	std::future<std::tuple<t_mat, t_vec, t_real, t_real, t_real>> futAna
-		= std::async(lpol, get_mono_vals,
-			eck.det_w, eck.det_h,
-			eck.ana_w, eck.ana_h,
-			eck.dist_ana_det, eck.dist_sample_ana,
-			eck.kf, -thetaa,
-			eck.coll_h_post_ana, eck.coll_h_post_sample,
-			eck.coll_v_post_ana, eck.coll_v_post_sample,
-			eck.ana_mosaic, eck.ana_mosaic_v,
-			inv_ana_curvh, inv_ana_curvv,
-			eck.pos_x, pos_y2, eck.pos_z,
-			dana_effic);
+	get_mono_vals(eck.det_w, eck.det_h,
+		eck.ana_w, eck.ana_h,
+		eck.dist_ana_det, eck.dist_sample_ana,
+		pt.kf, -thetaa,
+		eck.coll_h_post_ana, eck.coll_h_post_sample,
+		eck.coll_v_post_ana, eck.coll_v_post_sample,
+		eck.ana_mosaic, eck.ana_mosaic_v,
+		inv_ana_curvh, inv_ana_curvv,
+		dana_effic, kin.ana);
 
-	//--------------------------------------------------------------------------
-	// get mono & ana results
-
-	std::tuple<t_mat, t_vec, t_real, t_real, t_real> tupMono = futMono.get();
-	const t_mat& A = std::get<0>(tupMono);
-	const t_vec& B = std::get<1>(tupMono);
-	const t_real& C = std::get<2>(tupMono);
-	const t_real& D = std::get<3>(tupMono);
-	const t_real& dReflM = std::get<4>(tupMono);
-
-	std::tuple<t_mat, t_vec, t_real, t_real, t_real> tupAna = futAna.get();
-	const t_mat& E = std::get<0>(tupAna);
-	const t_vec& F = std::get<1>(tupAna);
-	const t_real& G = std::get<2>(tupAna);
-	const t_real& H = std::get<3>(tupAna);
-	const t_real& dReflA = std::get<4>(tupAna);
-
-	/*std::cout << "A = " << A << std::endl;
-	std::cout << "B = " << B << std::endl;
-	std::cout << "C = " << C << std::endl;
-	std::cout << "D = " << D << std::endl;
-	std::cout << "RM = " << dReflM << std::endl;
-
-	std::cout << "E = " << E << std::endl;
-	std::cout << "F = " << F << std::endl;
-	std::cout << "G = " << G << std::endl;
-	std::cout << "H = " << H << std::endl;
-	std::cout << "RA = " << dReflA << std::endl;*/
+	const t_mat3& A = kin.mono.A;
+	const t_mat3& E = kin.ana.A;
 
 	//--------------------------------------------------------------------------
 
 
 	// equ 4 & equ 53 in [eck14]
-	const t_real dE = (eck.ki*eck.ki - eck.kf*eck.kf) / (t_real(2)*eck.Q*eck.Q);
-	const wavenumber kipara = eck.Q*(t_real(0.5)+dE);
-	const wavenumber kfpara = eck.Q-kipara;
-	wavenumber kperp = tl::my_units_sqrt<wavenumber>(units::abs(kipara*kipara - eck.ki*eck.ki));
+	const t_real dE = (pt.ki*pt.ki - pt.kf*pt.kf) / (t_real(2)*pt.Q*pt.Q);
+	const wavenumber kipara = pt.Q*(t_real(0.5)+dE);
+	const wavenumber kfpara = pt.Q-kipara;
+	wavenumber kperp = tl::my_units_sqrt<wavenumber>(units::abs(kipara*kipara - pt.ki*pt.ki));
 	kperp *= eck.dsample_sense;
 
 	const t_real ksq2E = tl::get_KSQ2E<t_real>();
 
 	// trafo, equ 52 in [eck14]
-	t_mat T = ublas::identity_matrix<t_real>(6);
+	t_mat6 T = fix_unit_matrix<t_real, 6>();
 	T(0,3) = T(1,4) = T(2,5) = -1.;
 	T(3,0) = t_real(2)*ksq2E * kipara * angs;
 	T(3,3) = t_real(2)*ksq2E * kfpara * angs;
@@ -366,77 +392,54 @@ ResoResults calc_eck(const EckParams& eck)
 	T(3,4) = t_real(-2)*ksq2E * kperp * angs;
 	T(4,1) = T(5,2) = (0.5 - dE);
 	T(4,4) = T(5,5) = (0.5 + dE);
-	t_mat Tinv;
-	if(!tl::inverse(T, Tinv))
+	if(!fix_inverse(T, kin.Tinv))
 	{
 		res.bOk = false;
 		res.strErr = "Matrix T cannot be inverted.";
-		return res;
+		return false;
 	}
-	//std::cout << "Trafo matrix (Eck) = " << T << std::endl;
-	//std::cout << "Tinv = " << Tinv << std::endl;
 
 	// equ 54 in [eck14]
-	t_mat Dalph_i = tl::rotation_matrix_3d_z(-ki_Q/rads);
-	t_mat Dalph_f = tl::rotation_matrix_3d_z(-kf_Q/rads);
-	t_mat Arot = tl::transform(A, Dalph_i, 1);
-	t_mat Erot = tl::transform(E, Dalph_f, 1);
+	kin.Dalph_i = rotation_z(-ki_Q/rads);
+	kin.Dalph_f = rotation_z(-kf_Q/rads);
+	const t_mat3 Arot = fix_transform(A, kin.Dalph_i);
+	const t_mat3 Erot = fix_transform(E, kin.Dalph_f);
 
-	t_mat matAE = ublas::zero_matrix<t_real>(6,6);
-	tl::submatrix_copy(matAE, Arot, 0,0);
-	tl::submatrix_copy(matAE, Erot, 3,3);
-	//std::cout << "AE = " << matAE << std::endl;
+	t_mat6 matAE = fix_zero_matrix<t_real, 6>();
+	for(std::size_t i=0; i<3; ++i)
+	{
+		for(std::size_t j=0; j<3; ++j)
+		{
+			matAE(i, j) = Arot(i, j);
+			matAE(i+3, j+3) = Erot(i, j);
+		}
+	}
 
 	// U1 matrix
-	t_mat U1 = tl::transform(matAE, Tinv, 1);	// typo in paper in quadric trafo in equ 54 (top)?
-	//std::cout << "U1 = " << U1 << std::endl;
-
-	// V1 vector
-	t_vec vecBF = ublas::zero_vector<t_real>(6);
-	t_vec vecBrot = ublas::prod(ublas::trans(Dalph_i), B);
-	t_vec vecFrot = ublas::prod(ublas::trans(Dalph_f), F);
-	tl::subvector_copy(vecBF, vecBrot, 0);
-	tl::subvector_copy(vecBF, vecFrot, 3);
-	t_vec V1 = ublas::prod(vecBF, Tinv);
-
+	kin.U1 = fix_transform(matAE, kin.Tinv);	// typo in paper in quadric trafo in equ 54 (top)?
 
 
 	//--------------------------------------------------------------------------
 	// integrate last 2 vars -> equs 57 & 58 in [eck14]
 
-	t_mat U2 = quadric_proj(U1, 5);
-	t_mat U = quadric_proj(U2, 4);
-
-	t_vec V2 = quadric_proj(V1, U1, 5);
-	t_vec V = quadric_proj(V2, U2, 4);
+	kin.U2 = fix_quadric_proj(kin.U1, 5);
+	const t_mat4 U = fix_quadric_proj(kin.U2, 4);
 
-	t_real W = (C + D + G + H) - 0.25*V1[5]/U1(5,5) - 0.25*V2[4]/U2(4,4);
-
-	t_real Z = dReflM*dReflA
-		* std::sqrt(pi/std::abs(U1(5,5)))
-		* std::sqrt(pi/std::abs(U2(4,4)));
-
-	/*std::cout << "U = " << U << std::endl;
-	std::cout << "V = " << V << std::endl;
-	std::cout << "W = " << W << std::endl;
-	std::cout << "Z = " << Z << std::endl;*/
+	t_real Z = kin.mono.refl*kin.ana.refl
+		* std::sqrt(pi/std::abs(kin.U1(5,5)))
+		* std::sqrt(pi/std::abs(kin.U2(4,4)));
 	//--------------------------------------------------------------------------
 
 
 	// quadratic part of quadric (matrix U)
 	// careful: factor -0.5*... missing in U matrix compared to normal gaussian!
-	res.reso = t_real(2) * U;
-	// linear (vector V) and constant (scalar W) part of quadric
-	res.reso_v = V;
-	res.reso_s = W;
+	t_mat4 reso = t_real(2) * U;
 
+	// mirror Q_perp
 	if(eck.dsample_sense < 0.)
-	{
-		// mirror Q_perp
-		t_mat matMirror = tl::mirror_matrix<t_mat>(res.reso.size1(), 1);
-		res.reso = tl::transform(res.reso, matMirror, true);
-		res.reso_v[1] = -res.reso_v[1];
-	}
+		fix_mirror(reso, 1);
+
+	res.reso = reso;
 
 	// prefactor and volume
 	res.dResVol = tl::get_ellipsoid_volume(res.reso);
@@ -444,32 +447,118 @@ ResoResults calc_eck(const EckParams& eck)
 	if(eck.flags & CALC_GENERAL_R0)
 	{
 		// alternate R0 normalisation factor, see [mit84], equ. A.57
-		res.dR0 = mitch_R0<t_real>(dmono_refl, dana_effic,
-			tl::get_ellipsoid_volume(A), tl::get_ellipsoid_volume(E), res.dResVol, false);
+		kin.dR0 = mitch_R0<t_real>(dmono_refl, dana_effic,
+			tl::get_ellipsoid_volume(t_mat(A)), tl::get_ellipsoid_volume(t_mat(E)), res.dResVol, false);
 	}
 	else
 	{
-		res.dR0 = Z;
+		kin.dR0 = Z;
 		// missing volume prefactor to normalise gaussian,
 		// cf. equ. 56 in [eck14] to  equ. 1 in [pop75] and equ. A.57 in [mit84]
-		//res.dR0 /= std::sqrt(std::abs(tl::determinant(res.reso))) / (2.*pi*2.*pi);
-		res.dR0 *= res.dResVol * pi * t_real(3.);
+		//kin.dR0 /= std::sqrt(std::abs(tl::determinant(res.reso))) / (2.*pi*2.*pi);
+		kin.dR0 *= res.dResVol * pi * t_real(3.);
 	}
 
-	res.dR0 *= std::exp(-W);
-	res.dR0 *= dxsec;
-
 	// Bragg widths
-	const std::vector<t_real> vecFwhms = calc_bragg_fwhms(res.reso);
-	std::copy(vecFwhms.begin(), vecFwhms.end(), res.dBraggFWHMs);
+	for(std::size_t i=0; i<4; ++i)
+		res.dBraggFWHMs[i] = sig2fwhm/std::sqrt(reso(i,i));
+
+	res.bOk = true;
+	return true;
+}
+
+
+/**
+ * adds the sample position dependent parts to the results
+ */
+static void calc_eck_pos(const EckParams& eck, const ResoScanPoint& pt,
+	const EckKinematics& kin, ResoResults& res)
+{
+	t_vec3 B, F;
+	t_real C, D, G, H;
+
+	get_mono_pos_vals(kin.mono, pt.pos_y, pt.pos_z, B, C, D);
+
+	// equ 43 in [eck14]
+	length pos_y2 = - pt.pos_x*units::sin(kin.twotheta)
+		+ pt.pos_y*units::cos(kin.twotheta);
+	get_mono_pos_vals(kin.ana, pos_y2, pt.pos_z, F, G, H);
+
+	// V1 vector
+	const t_vec3 vecBrot = fix_prod(B, kin.Dalph_i);
+	const t_vec3 vecFrot = fix_prod(F, kin.Dalph_f);
+	t_vec6 vecBF;
+	for(std::size_t i=0; i<3; ++i)
+	{
+		vecBF[i] = vecBrot[i];
+		vecBF[i+3] = vecFrot[i];
+	}
+	const t_vec6 V1 = fix_prod(vecBF, kin.Tinv);
+
+	// integrate last 2 vars -> equs 57 & 58 in [eck14]
+	const t_vec5 V2 = fix_quadric_proj(V1, kin.U1, 5);
+	t_vec_fix<t_real, 4> V = fix_quadric_proj(V2, kin.U2, 4);
+
+	t_real W = (C + D + G + H) - 0.25*V1[5]/kin.U1(5,5) - 0.25*V2[4]/kin.U2(4,4);
+
+	// mirror Q_perp
+	if(eck.dsample_sense < 0.)
+		V[1] = -V[1];
+
+	// linear (vector V) and constant (scalar W) part of quadric
+	res.reso_v = V;
+	res.reso_s = W;
+
+	res.dR0 = kin.dR0;
+	res.dR0 *= std::exp(-W);
+	res.dR0 *= kin.dxsec;
 
 	if(tl::is_nan_or_inf(res.dR0) || tl::is_nan_or_inf(res.reso))
 	{
 		res.strErr = "Invalid result.";
 		res.bOk = false;
-		return res;
+		return;
 	}
 
+	res.strErr = "";
 	res.bOk = true;
-	return res;
+}
+
+
+/**
+ * eckold-sobolev resolution at all scan points,
+ * the position-independent part is only calculated once for all sample positions at a scan point
+ */
+void calc_eck_batch(const EckParams& eck,
+	const std::vector<ResoScanPoint>& vecPts, std::vector<ResoResults>& vecRes)
+{
+	vecRes.resize(vecPts.size());
+
+	EckKinematics kin;
+	bool bKinOk = false;
+
+	for(std::size_t iPt=0; iPt<vecPts.size(); ++iPt)
+	{
+		const ResoScanPoint& pt = vecPts[iPt];
+
+		if(iPt == 0 || !pt.SameKinematics(vecPts[iPt-1]))
+			bKinOk = calc_eck_kinematics(eck, pt, kin);
+
+		vecRes[iPt] = kin.res;
+		if(bKinOk)
+			calc_eck_pos(eck, pt, kin, vecRes[iPt]);
+	}
+}
+
+
+ResoResults calc_eck(const EckParams& eck)
+{
+	ResoScanPoint pt = get_scan_point(eck);
+	pt.pos_x = eck.pos_x;
+	pt.pos_y = eck.pos_y;
+	pt.pos_z = eck.pos_z;
+
+	std::vector<ResoResults> vecRes;
+	calc_eck_batch(eck, { pt }, vecRes);
+	return vecRes[0];
 }
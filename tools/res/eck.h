@@ -26,6 +26,8 @@ struct EckParams : public PopParams
 
 
 extern ResoResults calc_eck(const EckParams& eck);
+extern void calc_eck_batch(const EckParams& eck,
+	const std::vector<ResoScanPoint>& vecPts, std::vector<ResoResults>& vecRes);
 
 
 #endif
@@ -26,6 +26,7 @@
 #include "tlibs/math/linalg2.h"
 #include "tlibs/math/math.h"
 #include "defs.h"
+#include "fixedmat.h"
 
 namespace ublas = boost::numeric::ublas;
 
@@ -117,7 +118,6 @@ template<class T = t_real_reso>
 ublas::matrix<T> quadric_proj(const ublas::matrix<T>& mat, std::size_t iIdx)
 {
 	using t_mat = ublas::matrix<T>;
-	using t_vec = ublas::vector<T>;
 
 	if(tl::float_equal<T>(mat(iIdx, iIdx), T{0}))
 	{
@@ -125,19 +125,29 @@ ublas::matrix<T> quadric_proj(const ublas::matrix<T>& mat, std::size_t iIdx)
 		return tl::remove_elems(mat, iIdx);
 	}
 
-	// symmetric matrix -> col and row are equal to one another and to this average b
-	t_vec b = T(0.5)*(tl::get_column(mat, iIdx) + tl::get_row(mat, iIdx));
-	//T blen = tl::veclen(b);
-	//b /= blen;
+	// symmetric matrix -> col and row are equal to one another and to this average b,
+	// subtract b b^T / m_ii and remove row and column iIdx in one pass
+	const std::size_t iDim = mat.size1();
+	const T dscale = T(1) / mat(iIdx, iIdx);
 
-	t_mat m = mat;
-	//T dscale = blen / b[iIdx];	// == blen*blen / mat(iIdx,iIdx)
-	T dscale = 1. / mat(iIdx, iIdx);
-	m -= dscale * tl::outer<t_vec,t_mat>(b,b);
+	t_mat m(iDim-1, iDim-1);
+	for(std::size_t i=0, iNew=0; i<iDim; ++i)
+	{
+		if(i == iIdx) continue;
+
+		const T bi = T(0.5) * (mat(i, iIdx) + mat(iIdx, i));
+		for(std::size_t j=0, jNew=0; j<iDim; ++j)
+		{
+			if(j == iIdx) continue;
+
+			const T bj = T(0.5) * (mat(j, iIdx) + mat(iIdx, j));
+			m(iNew, jNew) = mat(i, j) - dscale * bi * bj;
+			++jNew;
+		}
+		++iNew;
+	}
 
 	//tl::log_debug(mat, " -> ", m);
-	m = tl::remove_elems(m, iIdx);
-
 	return m;
 }
 
@@ -158,17 +168,40 @@ ublas::vector<T> quadric_proj(const ublas::vector<T>& vec,
 		return tl::remove_elem(vec, iIdx);
 	}
 
-	t_vec b = T(0.5)*(tl::get_column(mat, iIdx) + tl::get_row(mat, iIdx));
+	const std::size_t iDim = vec.size();
+	const T dscale = vec[iIdx] / mat(iIdx, iIdx);
 
-	t_vec vecProj = vec;
-	T dscale = vecProj[iIdx] / mat(iIdx, iIdx);
-	vecProj -= dscale * b;
+	t_vec vecProj(iDim-1);
+	for(std::size_t i=0, iNew=0; i<iDim; ++i)
+	{
+		if(i == iIdx) continue;
+
+		const T bi = T(0.5) * (mat(i, iIdx) + mat(iIdx, i));
+		vecProj[iNew] = vec[i] - dscale * bi;
+		++iNew;
+	}
 
-	vecProj = tl::remove_elem(vecProj, iIdx);
 	return vecProj;
 }
 
 
+/**
+ * projections of quadrics with compile-time dimensions
+ */
+template<class T, std::size_t N>
+t_mat_fix<T, N-1> quadric_proj(const t_mat_fix<T, N>& mat, std::size_t iIdx)
+{
+	return fix_quadric_proj<T, N>(mat, iIdx);
+}
+
+template<class T, std::size_t N>
+t_vec_fix<T, N-1> quadric_proj(const t_vec_fix<T, N>& vec,
+	const t_mat_fix<T, N>& mat, std::size_t iIdx)
+{
+	return fix_quadric_proj<T, N>(vec, mat, iIdx);
+}
+
+
 // --------------------------------------------------------------------------------
 
 template<class t_real = t_real_reso>
@@ -236,13 +269,18 @@ void Ellipse2d<t_real>::GetCurvePoints(std::vector<t_real>& x, std::vector<t_rea
 	x.resize(iPoints);
 	y.resize(iPoints);
 
+	// same as operator(), but without temporary vectors
+	const t_real r00 = rot(0,0), r01 = rot(0,1);
+	const t_real r10 = rot(1,0), r11 = rot(1,1);
+
 	for(std::size_t i=0; i<iPoints; ++i)
 	{
-		t_real dT = t_real(i)/t_real(iPoints-1);
-		ublas::vector<t_real> vec = operator()(dT);
+		const t_real dT = t_real(i)/t_real(iPoints-1);
+		const t_real dX = x_hwhm * std::cos(t_real(2)*tl::get_pi<t_real>()*dT);
+		const t_real dY = y_hwhm * std::sin(t_real(2)*tl::get_pi<t_real>()*dT);
 
-		x[i] = vec[0];
-		y[i] = vec[1];
+		x[i] = r00*dX + r01*dY + x_offs;
+		y[i] = r10*dX + r11*dY + y_offs;
 	}
 
 	if(pLRTB)	// bounding rect
@@ -446,10 +484,12 @@ t_real calc_vanadium_fwhm(
 	*/
 
 	// project all Q axes
-	ublas::matrix<t_real> M = quadric_proj(matReso, 0);
-	M = quadric_proj(M, 0);
-	M = quadric_proj(M, 0);
+	t_mat_fix<t_real, 4> M4;
+	for(std::size_t i=0; i<4; ++i)
+		for(std::size_t j=0; j<4; ++j)
+			M4(i,j) = matReso(i,j);
 
+	const t_mat_fix<t_real, 1> M = quadric_proj(quadric_proj(quadric_proj(M4, 0), 0), 0);
 	return tl::get_SIGMA2FWHM<t_real>() / std::sqrt(std::abs(M(0,0)));
 }
 
@@ -0,0 +1,343 @@
+/**
+ * fixed-size matrices for the resolution calculation
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __RESO_FIXEDMAT_H__
+#define __RESO_FIXEDMAT_H__
+
+#include <cstddef>
+#include <cmath>
+#include <utility>
+
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/vector.hpp>
+
+#include "tlibs/math/math.h"
+#include "tlibs/log/log.h"
+
+namespace ublas = boost::numeric::ublas;
+
+
+/**
+ * matrix and vector with compile-time dimensions on the stack,
+ * these are ublas containers and can be assigned to ublas::matrix and ublas::vector
+ */
+template<class T, std::size_t N, std::size_t M = N>
+using t_mat_fix = ublas::c_matrix<T, N, M>;
+
+template<class T, std::size_t N>
+using t_vec_fix = ublas::c_vector<T, N>;
+
+
+template<class T, std::size_t N, std::size_t M = N>
+t_mat_fix<T, N, M> fix_zero_matrix()
+{
+	t_mat_fix<T, N, M> mat;
+	for(std::size_t i=0; i<N; ++i)
+		for(std::size_t j=0; j<M; ++j)
+			mat(i,j) = T(0);
+	return mat;
+}
+
+
+template<class T, std::size_t N>
+t_mat_fix<T, N> fix_unit_matrix()
+{
+	t_mat_fix<T, N> mat = fix_zero_matrix<T, N>();
+	for(std::size_t i=0; i<N; ++i)
+		mat(i,i) = T(1);
+	return mat;
+}
+
+
+template<class T, std::size_t N>
+t_vec_fix<T, N> fix_zero_vector()
+{
+	t_vec_fix<T, N> vec;
+	for(std::size_t i=0; i<N; ++i)
+		vec[i] = T(0);
+	return vec;
+}
+
+
+/**
+ * matrix product A*B
+ */
+template<class T, std::size_t N, std::size_t K, std::size_t M>
+t_mat_fix<T, N, M> fix_prod(const t_mat_fix<T, N, K>& A, const t_mat_fix<T, K, M>& B)
+{
+	t_mat_fix<T, N, M> mat;
+	for(std::size_t i=0; i<N; ++i)
+	{
+		for(std::size_t j=0; j<M; ++j)
+		{
+			T dSum = T(0);
+			for(std::size_t k=0; k<K; ++k)
+				dSum += A(i,k) * B(k,j);
+			mat(i,j) = dSum;
+		}
+	}
+	return mat;
+}
+
+
+/**
+ * matrix-vector product A*v
+ */
+template<class T, std::size_t N, std::size_t M>
+t_vec_fix<T, N> fix_prod(const t_mat_fix<T, N, M>& A, const t_vec_fix<T, M>& v)
+{
+	t_vec_fix<T, N> vec;
+	for(std::size_t i=0; i<N; ++i)
+	{
+		T dSum = T(0);
+		for(std::size_t j=0; j<M; ++j)
+			dSum += A(i,j) * v[j];
+		vec[i] = dSum;
+	}
+	return vec;
+}
+
+
+/**
+ * vector-matrix product v^T*A
+ */
+template<class T, std::size_t N, std::size_t M>
+t_vec_fix<T, M> fix_prod(const t_vec_fix<T, N>& v, const t_mat_fix<T, N, M>& A)
+{
+	t_vec_fix<T, M> vec;
+	for(std::size_t j=0; j<M; ++j)
+	{
+		T dSum = T(0);
+		for(std::size_t i=0; i<N; ++i)
+			dSum += v[i] * A(i,j);
+		vec[j] = dSum;
+	}
+	return vec;
+}
+
+
+/**
+ * quadric trafo A^T * M * A, same as tl::transform(M, A, 1)
+ */
+template<class T, std::size_t N, std::size_t K>
+t_mat_fix<T, K> fix_transform(const t_mat_fix<T, N>& M, const t_mat_fix<T, N, K>& A)
+{
+	const t_mat_fix<T, N, K> MA = fix_prod(M, A);
+
+	t_mat_fix<T, K> mat;
+	for(std::size_t i=0; i<K; ++i)
+	{
+		for(std::size_t j=0; j<K; ++j)
+		{
+			T dSum = T(0);
+			for(std::size_t k=0; k<N; ++k)
+				dSum += A(k,i) * MA(k,j);
+			mat(i,j) = dSum;
+		}
+	}
+	return mat;
+}
+
+
+/**
+ * inverse quadric trafo A * M * A^T, same as tl::transform_inv(M, A, 1)
+ */
+template<class T, std::size_t N, std::size_t K>
+t_mat_fix<T, N> fix_transform_inv(const t_mat_fix<T, K>& M, const t_mat_fix<T, N, K>& A)
+{
+	const t_mat_fix<T, N, K> AM = fix_prod(A, M);
+
+	t_mat_fix<T, N> mat;
+	for(std::size_t i=0; i<N; ++i)
+	{
+		for(std::size_t j=0; j<N; ++j)
+		{
+			T dSum = T(0);
+			for(std::size_t k=0; k<K; ++k)
+				dSum += AM(i,k) * A(j,k);
+			mat(i,j) = dSum;
+		}
+	}
+	return mat;
+}
+
+
+/**
+ * inverse by gauss-jordan elimination with partial pivoting
+ * @return false if the matrix is singular
+ */
+template<class T, std::size_t N>
+bool fix_inverse(const t_mat_fix<T, N>& mat, t_mat_fix<T, N>& inv)
+{
+	t_mat_fix<T, N> M = mat;
+	inv = fix_unit_matrix<T, N>();
+
+	for(std::size_t iCol=0; iCol<N; ++iCol)
+	{
+		std::size_t iPivot = iCol;
+		for(std::size_t iRow=iCol+1; iRow<N; ++iRow)
+		{
+			if(std::abs(M(iRow, iCol)) > std::abs(M(iPivot, iCol)))
+				iPivot = iRow;
+		}
+
+		const T dPivot = M(iPivot, iCol);
+		if(dPivot == T(0) || tl::is_nan_or_inf(dPivot))
+			return false;
+
+		if(iPivot != iCol)
+		{
+			for(std::size_t j=0; j<N; ++j)
+			{
+				std::swap(M(iPivot, j), M(iCol, j));
+				std::swap(inv(iPivot, j), inv(iCol, j));
+			}
+		}
+
+		for(std::size_t j=0; j<N; ++j)
+		{
+			M(iCol, j) /= dPivot;
+			inv(iCol, j) /= dPivot;
+		}
+
+		for(std::size_t iRow=0; iRow<N; ++iRow)
+		{
+			const T dFact = M(iRow, iCol);
+			if(iRow == iCol || dFact == T(0))
+				continue;
+
+			for(std::size_t j=0; j<N; ++j)
+			{
+				M(iRow, j) -= dFact * M(iCol, j);
+				inv(iRow, j) -= dFact * inv(iCol, j);
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * determinant by lu decomposition with partial pivoting
+ */
+template<class T, std::size_t N>
+T fix_determinant(const t_mat_fix<T, N>& mat)
+{
+	t_mat_fix<T, N> M = mat;
+	T dDet = T(1);
+
+	for(std::size_t iCol=0; iCol<N; ++iCol)
+	{
+		std::size_t iPivot = iCol;
+		for(std::size_t iRow=iCol+1; iRow<N; ++iRow)
+		{
+			if(std::abs(M(iRow, iCol)) > std::abs(M(iPivot, iCol)))
+				iPivot = iRow;
+		}
+
+		if(M(iPivot, iCol) == T(0))
+			return T(0);
+
+		if(iPivot != iCol)
+		{
+			for(std::size_t j=iCol; j<N; ++j)
+				std::swap(M(iPivot, j), M(iCol, j));
+			dDet = -dDet;
+		}
+
+		dDet *= M(iCol, iCol);
+
+		for(std::size_t iRow=iCol+1; iRow<N; ++iRow)
+		{
+			const T dFact = M(iRow, iCol) / M(iCol, iCol);
+			for(std::size_t j=iCol+1; j<N; ++j)
+				M(iRow, j) -= dFact * M(iCol, j);
+		}
+	}
+
+	return dDet;
+}
+
+
+/**
+ * mirrors the quadric along axis iIdx, same as the trafo with tl::mirror_matrix
+ */
+template<class T, std::size_t N>
+void fix_mirror(t_mat_fix<T, N>& mat, std::size_t iIdx)
+{
+	for(std::size_t i=0; i<N; ++i)
+	{
+		if(i == iIdx)
+			continue;
+		mat(i, iIdx) = -mat(i, iIdx);
+		mat(iIdx, i) = -mat(iIdx, i);
+	}
+}
+
+
+/**
+ * project the quadratic part of the quadric along axis iIdx
+ * @see quadric_proj in ellipse.h
+ */
+template<class T, std::size_t N>
+t_mat_fix<T, N-1> fix_quadric_proj(const t_mat_fix<T, N>& mat, std::size_t iIdx)
+{
+	const bool bSlice = tl::float_equal<T>(mat(iIdx, iIdx), T{0});
+	if(bSlice)
+		tl::log_warn("Cannot project quadric, slicing instead.");
+	const T dScale = bSlice ? T(0) : T(1) / mat(iIdx, iIdx);
+
+	t_mat_fix<T, N-1> matProj;
+	for(std::size_t i=0, iNew=0; i<N; ++i)
+	{
+		if(i == iIdx) continue;
+
+		const T bi = T(0.5) * (mat(i, iIdx) + mat(iIdx, i));
+		for(std::size_t j=0, jNew=0; j<N; ++j)
+		{
+			if(j == iIdx) continue;
+
+			const T bj = T(0.5) * (mat(j, iIdx) + mat(iIdx, j));
+			matProj(iNew, jNew) = mat(i, j) - dScale * bi * bj;
+			++jNew;
+		}
+		++iNew;
+	}
+
+	return matProj;
+}
+
+
+/**
+ * project the linear part of the quadric along axis iIdx
+ * @see quadric_proj in ellipse.h
+ */
+template<class T, std::size_t N>
+t_vec_fix<T, N-1> fix_quadric_proj(const t_vec_fix<T, N>& vec,
+	const t_mat_fix<T, N>& mat, std::size_t iIdx)
+{
+	const bool bSlice = tl::float_equal<T>(mat(iIdx, iIdx), T{0});
+	if(bSlice)
+		tl::log_warn("Cannot project vector part of quadric, slicing instead.");
+	const T dScale = bSlice ? T(0) : vec[iIdx] / mat(iIdx, iIdx);
+
+	t_vec_fix<T, N-1> vecProj;
+	for(std::size_t i=0, iNew=0; i<N; ++i)
+	{
+		if(i == iIdx) continue;
+
+		const T bi = T(0.5) * (mat(i, iIdx) + mat(iIdx, i));
+		vecProj[iNew] = vec[i] - dScale * bi;
+		++iNew;
+	}
+
+	return vecProj;
+}
+
+
+#endif
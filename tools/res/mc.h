@@ -13,6 +13,8 @@
 #include <ostream>
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <memory>
 
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
@@ -20,6 +22,9 @@ namespace ublas = boost::numeric::ublas;
 
 #include "tlibs/math/math.h"
 #include "tlibs/math/rand.h"
+#include "qmc.h"
+#include "philox.h"
+#include "fixedmat.h"
 
 
 enum class McNeutronCoords
@@ -29,6 +34,21 @@ enum class McNeutronCoords
 	RLU = 2
 };
 
+enum class McSampler
+{
+	PSEUDO = 0,	// pseudo-random numbers
+	SOBOL = 1	// scrambled sobol quasi-random sequence
+};
+
+// sub-streams of the counter-based random numbers
+enum class McSubStream : std::uint32_t
+{
+	NEUTRONS = 0,	// standard-normal 4d deviates of the neutrons
+	IMPORTANCE = 1,	// importance sampling around the dispersion
+	SAMPLE_POS = 2,	// random sample positions
+	SCRAMBLE = 3	// scrambling of the quasi-random sequence
+};
+
 template<class t_mat = ublas::matrix<double>>
 struct McNeutronOpts
 {
@@ -40,9 +60,94 @@ struct McNeutronOpts
 	real_type dAngleQVec0;
 
 	bool bCenter;
+
+	McSampler sampler = McSampler::PSEUDO;
 };
 
 
+/**
+ * creates a freshly scrambled quasi-random sequence for the 4d neutron deviates,
+ * or none if pseudo-random numbers are used;
+ * one sequence is shared by all threads, which draw the points by index.
+ * the scrambling is taken from pStream if given.
+ */
+template<class t_real = double>
+std::shared_ptr<const SobolSeq<t_real>> mc_create_sequence(McSampler sampler,
+	const PhiloxStream* pStream = nullptr)
+{
+	if(sampler == McSampler::SOBOL)
+		return std::make_shared<SobolSeq<t_real>>(4, true,
+			pStream, std::uint32_t(McSubStream::SCRAMBLE));
+	return nullptr;
+}
+
+
+
+/**
+ * calculates the fused affine trafo from standard-normal deviates to neutron coordinates:
+ * vecNeutron = matTrafo * vecNorm + vecOffs,
+ * with matTrafo = (coordinate trafo) * rot * (sigma scaling)
+ *
+ * pMat: 4x4 matrix in row-major order, pOffs: 4-vector
+ */
+template<class t_mat = ublas::matrix<double>>
+void mc_neutron_trafo(const Ellipsoid4d<typename t_mat::value_type>& ell4d,
+	const McNeutronOpts<t_mat>& opts,
+	typename t_mat::value_type *pMat, typename t_mat::value_type *pOffs)
+{
+	using t_real = typename t_mat::value_type;
+	using t_mat4 = t_mat_fix<t_real, 4>;
+	using t_vec4 = t_vec_fix<t_real, 4>;
+
+	const t_real dSig[] = {
+		ell4d.x_hwhm*tl::get_HWHM2SIGMA<t_real>(), ell4d.y_hwhm*tl::get_HWHM2SIGMA<t_real>(),
+		ell4d.z_hwhm*tl::get_HWHM2SIGMA<t_real>(), ell4d.w_hwhm*tl::get_HWHM2SIGMA<t_real>() };
+
+	// rot * matSig, with the diagonal sigma matrix
+	t_mat4 matTrafo;
+	for(std::size_t i=0; i<4; ++i)
+		for(std::size_t j=0; j<4; ++j)
+			matTrafo(i,j) = ell4d.rot(i,j) * dSig[j];
+
+	t_vec4 vecOffs = fix_zero_vector<t_real, 4>();
+	if(!opts.bCenter)
+	{
+		vecOffs[0] = ell4d.x_offs; vecOffs[1] = ell4d.y_offs;
+		vecOffs[2] = ell4d.z_offs; vecOffs[3] = ell4d.w_offs;
+	}
+
+	if(opts.coords == McNeutronCoords::ANGS || opts.coords == McNeutronCoords::RLU)
+	{
+		// rotation by -dAngleQVec0 in the scattering plane
+		const t_real dCos = std::cos(-opts.dAngleQVec0);
+		const t_real dSin = std::sin(-opts.dAngleQVec0);
+		t_mat4 matQVec0 = fix_unit_matrix<t_real, 4>();
+		matQVec0(0,0) = matQVec0(1,1) = dCos;
+		matQVec0(0,1) = -dSin;
+		matQVec0(1,0) = dSin;
+
+		t_mat4 matCoord = matQVec0;
+		if(opts.coords == McNeutronCoords::RLU)
+		{
+			t_mat4 matUBinv;
+			for(std::size_t i=0; i<4; ++i)
+				for(std::size_t j=0; j<4; ++j)
+					matUBinv(i,j) = opts.matUBinv(i,j);
+			matCoord = fix_prod(matUBinv, matQVec0);
+		}
+
+		matTrafo = fix_prod(matCoord, matTrafo);
+		vecOffs = fix_prod(matCoord, vecOffs);
+	}
+
+	for(std::size_t i=0; i<4; ++i)
+	{
+		pOffs[i] = vecOffs[i];
+		for(std::size_t j=0; j<4; ++j)
+			pMat[i*4 + j] = matTrafo(i,j);
+	}
+}
+
 
 /**
  * Ellipsoid E in Q||... coord. system in 1/A
@@ -50,47 +155,356 @@ struct McNeutronOpts
  * matQVec0: trafo from Q||... to orient1, orient2 system in 1/A
  * Uinv * matQVec0: trafo from Q||... system to lab 1/A system
  * Binv * Uinv * matQVec0: trafo from Q||... system to crystal rlu system
+ *
+ * pSeq: quasi-random sequence to use instead of pseudo-random numbers,
+ * the points iSeqOffs ... iSeqOffs+iNum-1 are taken from it
  */
 template<class t_vec = ublas::vector<double>, class t_mat = ublas::matrix<double>,
 	class t_iter = typename std::vector<t_vec>::iterator>
 void mc_neutrons(const Ellipsoid4d<typename t_vec::value_type>& ell4d,
-	std::size_t iNum, const McNeutronOpts<t_mat>& opts, t_iter iterResult)
+	std::size_t iNum, const McNeutronOpts<t_mat>& opts, t_iter iterResult,
+	const SobolSeq<typename t_vec::value_type>* pSeq = nullptr, std::size_t iSeqOffs = 0)
 {
 	using t_real = typename t_vec::value_type;
 
-	t_vec vecTrans = tl::make_vec<t_vec>({ell4d.x_offs, ell4d.y_offs, ell4d.z_offs, ell4d.w_offs});
-	const t_mat& rot = ell4d.rot;
-	//if(vecResult.size() != iNum)
-	//	vecResult.resize(iNum);
+	// fused trafo: coordinate trafo * (rot * sigma * deviates + offset)
+	t_real m[4*4], o[4];
+	mc_neutron_trafo<t_mat>(ell4d, opts, m, o);
 
-	//tl::log_debug("rot: ", rot);
-	//tl::log_debug("Qvec0 = ", opts.dAngleQVec0/M_PI*180.);
-	t_mat matQVec0 = tl::rotation_matrix_2d(-opts.dAngleQVec0);
-	tl::resize_unity(matQVec0, 4);
+	for(std::size_t iCur=0; iCur<iNum; ++iCur)
+	{
+		t_real x[4];
+		for(unsigned iComp=0; iComp<4; ++iComp)
+		{
+			x[iComp] = pSeq ? pSeq->GetNormal(iSeqOffs+iCur, iComp)
+				: tl::rand_norm<t_real>(t_real(0), t_real(1));
+		}
 
-	t_mat matUBinvQVec0 = ublas::prod(opts.matUBinv, matQVec0);
+		t_vec vecMC(4);
+		for(std::size_t i=0; i<4; ++i)
+			vecMC[i] = m[i*4+0]*x[0] + m[i*4+1]*x[1] + m[i*4+2]*x[2] + m[i*4+3]*x[3] + o[i];
 
+		iterResult[iCur] = std::move(vecMC);
+	}
+}
+
+
+
+/**
+ * MC neutrons in a structure-of-arrays layout,
+ * one contiguous array per component: h, k, l, E (or Q_para, Q_perp, Q_z, E)
+ */
+template<class t_real = double>
+struct McNeutronBatch
+{
+	std::vector<t_real> vecH, vecK, vecL, vecE;
+
+	std::size_t size() const { return vecH.size(); }
+
+	void resize(std::size_t iSize)
+	{
+		for(std::vector<t_real>* pVec : {&vecH, &vecK, &vecL, &vecE})
+			if(pVec->size() != iSize)
+				pVec->resize(iSize);
+	}
+};
+
+
+/**
+ * applies the fused trafo to standard-normal deviates in batchNorm in the range
+ * [iOffs, iOffs+iNum) and writes the result into the same range of batch
+ * (both batches may be the same object for an in-place trafo)
+ */
+template<class t_real = double>
+void mc_neutrons_apply_trafo(const t_real *pMat, const t_real *pOffs,
+	const McNeutronBatch<t_real>& batchNorm, McNeutronBatch<t_real>& batch,
+	std::size_t iOffs, std::size_t iNum)
+{
+	const t_real *pNormH = batchNorm.vecH.data() + iOffs;
+	const t_real *pNormK = batchNorm.vecK.data() + iOffs;
+	const t_real *pNormL = batchNorm.vecL.data() + iOffs;
+	const t_real *pNormE = batchNorm.vecE.data() + iOffs;
+
+	t_real *pH = batch.vecH.data() + iOffs;
+	t_real *pK = batch.vecK.data() + iOffs;
+	t_real *pL = batch.vecL.data() + iOffs;
+	t_real *pE = batch.vecE.data() + iOffs;
+
+	const t_real m00 = pMat[0], m01 = pMat[1], m02 = pMat[2], m03 = pMat[3];
+	const t_real m10 = pMat[4], m11 = pMat[5], m12 = pMat[6], m13 = pMat[7];
+	const t_real m20 = pMat[8], m21 = pMat[9], m22 = pMat[10], m23 = pMat[11];
+	const t_real m30 = pMat[12], m31 = pMat[13], m32 = pMat[14], m33 = pMat[15];
+	const t_real o0 = pOffs[0], o1 = pOffs[1], o2 = pOffs[2], o3 = pOffs[3];
+
+	// no branches in the loop body -> vectorisable
 	for(std::size_t iCur=0; iCur<iNum; ++iCur)
 	{
-		t_vec vecMC = tl::make_vec<t_vec, std::vector>(
-			tl::rand_norm_nd<t_real, std::vector>
-				({0.,0.,0.,0.},
-				{ ell4d.x_hwhm*tl::get_HWHM2SIGMA<t_real>(),
-				ell4d.y_hwhm*tl::get_HWHM2SIGMA<t_real>(),
-				ell4d.z_hwhm*tl::get_HWHM2SIGMA<t_real>(),
-				ell4d.w_hwhm*tl::get_HWHM2SIGMA<t_real>() }));
-
-		vecMC = ublas::prod(rot, vecMC);
-		if(!opts.bCenter)
-			vecMC += vecTrans;
-
-		if(opts.coords == McNeutronCoords::ANGS)
-			vecMC = ublas::prod(matQVec0, vecMC);
-		else if(opts.coords == McNeutronCoords::RLU)
-			vecMC = ublas::prod(matUBinvQVec0, vecMC);
+		const t_real x0 = pNormH[iCur], x1 = pNormK[iCur], x2 = pNormL[iCur], x3 = pNormE[iCur];
 
-		iterResult[iCur] = std::move(vecMC);
+		pH[iCur] = m00*x0 + m01*x1 + m02*x2 + m03*x3 + o0;
+		pK[iCur] = m10*x0 + m11*x1 + m12*x2 + m13*x3 + o1;
+		pL[iCur] = m20*x0 + m21*x1 + m22*x2 + m23*x3 + o2;
+		pE[iCur] = m30*x0 + m31*x1 + m32*x2 + m33*x3 + o3;
+	}
+}
+
+
+/**
+ * draws standard-normal 4d deviates into the batch in the range [iOffs, iOffs+iNum)
+ */
+template<class t_real = double>
+void mc_normals_batch(std::size_t iNum, McNeutronBatch<t_real>& batch, std::size_t iOffs = 0)
+{
+	if(batch.size() < iOffs + iNum)
+		batch.resize(iOffs + iNum);
+
+	for(std::vector<t_real>* pVec : {&batch.vecH, &batch.vecK, &batch.vecL, &batch.vecE})
+	{
+		t_real *pComp = pVec->data() + iOffs;
+		for(std::size_t iCur=0; iCur<iNum; ++iCur)
+			pComp[iCur] = tl::rand_norm<t_real>(t_real(0), t_real(1));
 	}
 }
 
+
+/**
+ * draws quasi-random standard-normal 4d deviates into the batch in the range [iOffs, iOffs+iNum),
+ * using the points with the same indices of the sequence, independently of how the range is split
+ */
+template<class t_real = double>
+void mc_normals_batch(const SobolSeq<t_real>& seq, std::size_t iNum,
+	McNeutronBatch<t_real>& batch, std::size_t iOffs = 0)
+{
+	if(batch.size() < iOffs + iNum)
+		batch.resize(iOffs + iNum);
+
+	std::vector<t_real>* pComps[] = {&batch.vecH, &batch.vecK, &batch.vecL, &batch.vecE};
+	for(unsigned iComp=0; iComp<4; ++iComp)
+	{
+		t_real *pComp = pComps[iComp]->data() + iOffs;
+		for(std::size_t iCur=0; iCur<iNum; ++iCur)
+			pComp[iCur] = seq.GetNormal(iOffs+iCur, iComp);
+	}
+}
+
+
+/**
+ * draws standard-normal 4d deviates from a counter-based stream into the batch
+ * in the range [iOffs, iOffs+iNum), using the stream elements with the same indices,
+ * independently of how the range is split
+ */
+template<class t_real = double>
+void mc_normals_batch(const PhiloxStream& stream, std::size_t iNum,
+	McNeutronBatch<t_real>& batch, std::size_t iOffs = 0)
+{
+	if(batch.size() < iOffs + iNum)
+		batch.resize(iOffs + iNum);
+
+	t_real *pH = batch.vecH.data() + iOffs;
+	t_real *pK = batch.vecK.data() + iOffs;
+	t_real *pL = batch.vecL.data() + iOffs;
+	t_real *pE = batch.vecE.data() + iOffs;
+
+	for(std::size_t iCur=0; iCur<iNum; ++iCur)
+	{
+		t_real x[4];
+		stream.GetNormal<t_real>(std::uint32_t(iOffs+iCur), std::uint32_t(McSubStream::NEUTRONS), x);
+
+		pH[iCur] = x[0];
+		pK[iCur] = x[1];
+		pL[iCur] = x[2];
+		pE[iCur] = x[3];
+	}
+}
+
+
+/**
+ * generates MC neutrons into a structure-of-arrays batch in the range [iOffs, iOffs+iNum)
+ * pSeq: quasi-random sequence to use instead of pseudo-random numbers
+ * pStream: counter-based random numbers to use instead of the global generator
+ * @see mc_neutrons
+ */
+template<class t_mat = ublas::matrix<double>>
+void mc_neutrons_batch(const Ellipsoid4d<typename t_mat::value_type>& ell4d,
+	std::size_t iNum, const McNeutronOpts<t_mat>& opts,
+	McNeutronBatch<typename t_mat::value_type>& batch, std::size_t iOffs = 0,
+	const SobolSeq<typename t_mat::value_type>* pSeq = nullptr,
+	const PhiloxStream* pStream = nullptr)
+{
+	using t_real = typename t_mat::value_type;
+
+	t_real matTrafo[4*4], vecOffs[4];
+	mc_neutron_trafo<t_mat>(ell4d, opts, matTrafo, vecOffs);
+
+	if(pSeq)
+		mc_normals_batch<t_real>(*pSeq, iNum, batch, iOffs);
+	else if(pStream)
+		mc_normals_batch<t_real>(*pStream, iNum, batch, iOffs);
+	else
+		mc_normals_batch<t_real>(iNum, batch, iOffs);
+	mc_neutrons_apply_trafo<t_real>(matTrafo, vecOffs, batch, batch, iOffs, iNum);
+}
+
+
+/**
+ * generates MC neutrons from given (frozen) standard-normal deviates
+ * in the range [iOffs, iOffs+iNum) of both batches
+ * @see mc_neutrons_batch
+ */
+template<class t_mat = ublas::matrix<double>>
+void mc_neutrons_batch(const Ellipsoid4d<typename t_mat::value_type>& ell4d,
+	std::size_t iNum, const McNeutronOpts<t_mat>& opts,
+	const McNeutronBatch<typename t_mat::value_type>& batchNorm,
+	McNeutronBatch<typename t_mat::value_type>& batch, std::size_t iOffs = 0)
+{
+	using t_real = typename t_mat::value_type;
+
+	t_real matTrafo[4*4], vecOffs[4];
+	mc_neutron_trafo<t_mat>(ell4d, opts, matTrafo, vecOffs);
+
+	if(batch.size() < iOffs + iNum)
+		batch.resize(iOffs + iNum);
+
+	mc_neutrons_apply_trafo<t_real>(matTrafo, vecOffs, batchNorm, batch, iOffs, iNum);
+}
+
+
+/**
+ * importance sampling around the dispersion branches:
+ * each component is a direction in the space of the standard-normal deviates
+ * (the normal of a branch's surface E = E(Q) within the ellipsoid), along which the
+ * deviate is drawn from N(centre, sigma) instead of N(0, 1); the deviates of a neutron
+ * are drawn from one of the components with probability dFrac, else unchanged.
+ * every neutron then has to be weighted with N(x; 0, 1) / q(x) for the mixture density q,
+ * which is bounded by 1/(1-dFrac).
+ */
+template<class t_real = double>
+struct McDispImportance
+{
+	// mixture components: unit directions (4 values each), centres, widths (<= 1) and weights (normalised to 1)
+	std::vector<t_real> vecDirs, vecCentre, vecSigma, vecWeight;
+
+	// fraction of neutrons drawn from the components
+	t_real dFrac = 0.5;
+
+	bool IsActive() const { return !vecCentre.empty() && dFrac > t_real(0) && dFrac < t_real(1); }
+
+	/**
+	 * draws the deviates x of a neutron from the mixture, x is standard-normal on input
+	 */
+	void Draw(t_real *x) const
+	{
+		const t_real dRnd = tl::rand_real<t_real>(t_real(0), t_real(1));
+		if(dRnd >= dFrac)
+			return;
+
+		Draw(x, dRnd, tl::rand_norm<t_real>(t_real(0), t_real(1)));
+	}
+
+	/**
+	 * draws the deviates x of a neutron from the mixture
+	 * using the given uniform and standard-normal random numbers
+	 */
+	void Draw(t_real *x, t_real dRnd, t_real dRndNorm) const
+	{
+		if(dRnd >= dFrac)
+			return;
+
+		// select a component by its weight
+		dRnd /= dFrac;
+		std::size_t iComp = 0;
+		for(; iComp+1<vecCentre.size(); ++iComp)
+		{
+			if(dRnd < vecWeight[iComp])
+				break;
+			dRnd -= vecWeight[iComp];
+		}
+
+		// replace the deviate along the component's direction
+		const t_real *pDir = vecDirs.data() + iComp*4;
+		const t_real dProj = pDir[0]*x[0] + pDir[1]*x[1] + pDir[2]*x[2] + pDir[3]*x[3];
+		const t_real dNew = vecCentre[iComp] + vecSigma[iComp]*dRndNorm;
+		for(int i=0; i<4; ++i)
+			x[i] += (dNew - dProj) * pDir[i];
+	}
+
+	/**
+	 * weight N(x; 0, 1) / q(x) of the deviates x
+	 */
+	t_real Weight(const t_real *x) const
+	{
+		t_real dDens = t_real(1) - dFrac;
+		for(std::size_t iComp=0; iComp<vecCentre.size(); ++iComp)
+		{
+			const t_real *pDir = vecDirs.data() + iComp*4;
+			const t_real dProj = pDir[0]*x[0] + pDir[1]*x[1] + pDir[2]*x[2] + pDir[3]*x[3];
+			const t_real dArg = (dProj - vecCentre[iComp]) / vecSigma[iComp];
+
+			// ratio of the component's density along its direction to the standard normal one
+			dDens += dFrac * vecWeight[iComp] *
+				std::exp(t_real(0.5)*(dProj*dProj - dArg*dArg)) / vecSigma[iComp];
+		}
+		return t_real(1) / dDens;
+	}
+};
+
+
+/**
+ * generates importance-sampled MC neutrons into a structure-of-arrays batch
+ * in the range [iOffs, iOffs+iNum), the weights are written to the same range of vecWeights
+ * pStream: counter-based random numbers to use instead of the global generator
+ * @see McDispImportance
+ */
+template<class t_mat = ublas::matrix<double>>
+void mc_neutrons_batch(const Ellipsoid4d<typename t_mat::value_type>& ell4d,
+	std::size_t iNum, const McNeutronOpts<t_mat>& opts,
+	const McDispImportance<typename t_mat::value_type>& imp,
+	McNeutronBatch<typename t_mat::value_type>& batch,
+	std::vector<typename t_mat::value_type>& vecWeights, std::size_t iOffs = 0,
+	const PhiloxStream* pStream = nullptr)
+{
+	using t_real = typename t_mat::value_type;
+
+	t_real matTrafo[4*4], vecOffs[4];
+	mc_neutron_trafo<t_mat>(ell4d, opts, matTrafo, vecOffs);
+
+	if(pStream)
+		mc_normals_batch<t_real>(*pStream, iNum, batch, iOffs);
+	else
+		mc_normals_batch<t_real>(iNum, batch, iOffs);
+	if(vecWeights.size() < iOffs + iNum)
+		vecWeights.resize(iOffs + iNum);
+	std::fill(vecWeights.begin()+iOffs, vecWeights.begin()+iOffs+iNum, t_real(1));
+
+	if(imp.IsActive())
+	{
+		t_real *pComps[4] = { batch.vecH.data()+iOffs, batch.vecK.data()+iOffs,
+			batch.vecL.data()+iOffs, batch.vecE.data()+iOffs };
+
+		for(std::size_t iCur=0; iCur<iNum; ++iCur)
+		{
+			t_real x[4] = { pComps[0][iCur], pComps[1][iCur], pComps[2][iCur], pComps[3][iCur] };
+			if(pStream)
+			{
+				// uniform number for the component selection, normal one by box-muller
+				t_real u[4];
+				pStream->GetUniform<t_real>(std::uint32_t(iOffs+iCur), std::uint32_t(McSubStream::IMPORTANCE), u);
+				const t_real dRndNorm = std::sqrt(-t_real(2)*std::log(u[1])) *
+					std::cos(t_real(2)*tl::get_pi<t_real>()*u[2]);
+				imp.Draw(x, u[0], dRndNorm);
+			}
+			else
+			{
+				imp.Draw(x);
+			}
+			vecWeights[iOffs + iCur] = imp.Weight(x);
+
+			for(int i=0; i<4; ++i)
+				pComps[i][iCur] = x[i];
+		}
+	}
+
+	mc_neutrons_apply_trafo<t_real>(matTrafo, vecOffs, batch, batch, iOffs, iNum);
+}
+
 #endif
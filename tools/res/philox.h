@@ -0,0 +1,149 @@
+/**
+ * counter-based random number streams
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ *
+ * @see J. K. Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11 (2011)
+ */
+
+#ifndef __PHILOX_STREAM_H__
+#define __PHILOX_STREAM_H__
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include "tlibs/math/math.h"
+
+
+/**
+ * philox-4x32-10 generator: the random numbers are a keyed bijection of a counter,
+ * so any element of a stream can be computed directly from its index,
+ * without a state shared between threads.
+ * the key is the seed, the counter consists of the element index, a sub-stream
+ * index and the 64-bit stream id (e.g. identifying a scan point or batch)
+ */
+class PhiloxStream
+{
+protected:
+	std::uint32_t m_key[2] = { 0, 0 };
+	std::uint32_t m_stream[2] = { 0, 0 };
+
+protected:
+	static void MulHiLo(std::uint32_t a, std::uint32_t b, std::uint32_t& hi, std::uint32_t& lo)
+	{
+		const std::uint64_t prod = std::uint64_t(a) * std::uint64_t(b);
+		hi = std::uint32_t(prod >> 32);
+		lo = std::uint32_t(prod);
+	}
+
+public:
+	PhiloxStream(std::uint64_t iSeed = 0, std::uint64_t iStream = 0)
+	{
+		m_key[0] = std::uint32_t(iSeed);
+		m_key[1] = std::uint32_t(iSeed >> 32);
+		m_stream[0] = std::uint32_t(iStream);
+		m_stream[1] = std::uint32_t(iStream >> 32);
+	}
+
+	std::uint64_t GetSeed() const { return (std::uint64_t(m_key[1]) << 32) | m_key[0]; }
+	std::uint64_t GetStream() const { return (std::uint64_t(m_stream[1]) << 32) | m_stream[0]; }
+
+	/**
+	 * 64-bit mixing function (splitmix64 finaliser)
+	 */
+	static std::uint64_t Hash(std::uint64_t i)
+	{
+		i += 0x9e3779b97f4a7c15ull;
+		i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ull;
+		i = (i ^ (i >> 27)) * 0x94d049bb133111ebull;
+		return i ^ (i >> 31);
+	}
+
+	/**
+	 * hash of the bit pattern of a value, e.g. a scan coordinate
+	 */
+	template<class T>
+	static std::uint64_t HashValue(const T& val)
+	{
+		static_assert(sizeof(T) <= sizeof(std::uint64_t), "Value too large for hashing.");
+
+		std::uint64_t iBits = 0;
+		std::memcpy(&iBits, &val, sizeof(T));
+		return Hash(iBits);
+	}
+
+	/**
+	 * independent stream derived from this one and the given id
+	 */
+	PhiloxStream Split(std::uint64_t iId) const
+	{
+		return PhiloxStream(GetSeed(), Hash(GetStream() ^ Hash(iId)));
+	}
+
+	/**
+	 * four random 32-bit words for element iIdx of sub-stream iSub
+	 */
+	void GetBits(std::uint32_t iIdx, std::uint32_t iSub, std::uint32_t *pOut) const
+	{
+		std::uint32_t ctr[4] = { iIdx, iSub, m_stream[0], m_stream[1] };
+		std::uint32_t key[2] = { m_key[0], m_key[1] };
+
+		for(int iRound=0; iRound<10; ++iRound)
+		{
+			if(iRound)
+			{
+				key[0] += 0x9e3779b9u;
+				key[1] += 0xbb67ae85u;
+			}
+
+			std::uint32_t hi0, lo0, hi1, lo1;
+			MulHiLo(0xd2511f53u, ctr[0], hi0, lo0);
+			MulHiLo(0xcd9e8d57u, ctr[2], hi1, lo1);
+
+			ctr[0] = hi1 ^ ctr[1] ^ key[0];
+			ctr[1] = lo1;
+			ctr[2] = hi0 ^ ctr[3] ^ key[1];
+			ctr[3] = lo0;
+		}
+
+		for(int i=0; i<4; ++i)
+			pOut[i] = ctr[i];
+	}
+
+	/**
+	 * four uniform random numbers in (0, 1) for element iIdx of sub-stream iSub
+	 */
+	template<class t_real = double>
+	void GetUniform(std::uint32_t iIdx, std::uint32_t iSub, t_real *pOut) const
+	{
+		std::uint32_t bits[4];
+		GetBits(iIdx, iSub, bits);
+
+		for(int i=0; i<4; ++i)
+			pOut[i] = (t_real(bits[i]) + t_real(0.5)) / t_real(std::uint64_t(1) << 32);
+	}
+
+	/**
+	 * four standard-normal random numbers for element iIdx of sub-stream iSub (box-muller)
+	 */
+	template<class t_real = double>
+	void GetNormal(std::uint32_t iIdx, std::uint32_t iSub, t_real *pOut) const
+	{
+		t_real u[4];
+		GetUniform<t_real>(iIdx, iSub, u);
+
+		for(int i=0; i<4; i+=2)
+		{
+			const t_real dRad = std::sqrt(-t_real(2) * std::log(u[i]));
+			const t_real dPhi = t_real(2) * tl::get_pi<t_real>() * u[i+1];
+
+			pOut[i] = dRad * std::cos(dPhi);
+			pOut[i+1] = dRad * std::sin(dPhi);
+		}
+	}
+};
+
+
+#endif
@@ -19,6 +19,7 @@
 #include "tlibs/math/math.h"
 
 #include <string>
+#include <algorithm>
 #include <iostream>
 
 
@@ -39,152 +40,163 @@ static const auto cm = tl::get_one_centimeter<t_real>();
 static const t_real sig2fwhm = tl::get_SIGMA2FWHM<t_real>();
 
 
-ResoResults calc_pop(const PopParams& pop)
-{
-	ResoResults res;
-
-	res.Q_avg.resize(4);
-	res.Q_avg[0] = pop.Q * angs;
-	res.Q_avg[1] = 0.;
-	res.Q_avg[2] = 0.;
-	res.Q_avg[3] = pop.E / meV;
+using t_mat4 = t_mat_fix<t_real, 4>;
+using t_mat8 = t_mat_fix<t_real, 8>;
+using t_mat13 = t_mat_fix<t_real, 13>;
 
 
-	length lam = tl::k2lam(pop.ki);
-	angle twotheta = pop.twotheta;
-	angle thetaa = pop.thetaa * pop.dana_sense;
-	angle thetam = pop.thetam * pop.dmono_sense;
-	angle ki_Q = pop.angle_ki_Q;
-	angle kf_Q = pop.angle_kf_Q;
-	//kf_Q = ki_Q + twotheta;
-
-	twotheta *= pop.dsample_sense;
-	ki_Q *= pop.dsample_sense;
-	kf_Q *= pop.dsample_sense;
-
-	// B matrix, [pop75], Appendix 1 -> U matrix in CN
-	t_mat B = get_trafo_dkidkf_dQdE(ki_Q, kf_Q, pop.ki, pop.kf);
-	B.resize(4,6, true);
-
-	angle coll_h_pre_mono = pop.coll_h_pre_mono;
-	angle coll_v_pre_mono = pop.coll_v_pre_mono;
+/**
+ * scan-invariant part of the popovici calculation
+ */
+struct PopInvariants
+{
+	// diagonals of the collimator covariance matrix G (without guide),
+	// of the inverse crystal mosaic covariance matrix F^(-1)
+	// and of the inverse component geometry covariance matrix S^(-1)
+	t_real G[8];
+	t_real Fi[4];
+	t_real SI[13];
 
-	if(pop.bGuide)
-	{
-		coll_h_pre_mono = lam*(pop.guide_div_h/angs);
-		coll_v_pre_mono = lam*(pop.guide_div_v/angs);
-	}
+	t_real dDetS, dDetF;
+};
 
 
+/**
+ * matrices which do not change during a scan
+ */
+static bool calc_pop_invariants(const PopParams& pop, PopInvariants& inv, ResoResults& res)
+{
 	// collimator covariance matrix G, [pop75], Appendix 1
-	t_mat G = tl::diag_matrix({
-		t_real(1)/(coll_h_pre_mono*coll_h_pre_mono /rads/rads),
-		t_real(1)/(pop.coll_h_pre_sample*pop.coll_h_pre_sample /rads/rads),
-
-		t_real(1)/(coll_v_pre_mono*coll_v_pre_mono /rads/rads),
-		t_real(1)/(pop.coll_v_pre_sample*pop.coll_v_pre_sample /rads/rads),
-
-		t_real(1)/(pop.coll_h_post_sample*pop.coll_h_post_sample /rads/rads),
-		t_real(1)/(pop.coll_h_post_ana*pop.coll_h_post_ana /rads/rads),
+	const angle colls[8] =
+	{
+		pop.coll_h_pre_mono, pop.coll_h_pre_sample,
+		pop.coll_v_pre_mono, pop.coll_v_pre_sample,
+		pop.coll_h_post_sample, pop.coll_h_post_ana,
+		pop.coll_v_post_sample, pop.coll_v_post_ana
+	};
 
-		t_real(1)/(pop.coll_v_post_sample*pop.coll_v_post_sample /rads/rads),
-		t_real(1)/(pop.coll_v_post_ana*pop.coll_v_post_ana /rads/rads)
-	});
+	for(std::size_t i=0; i<8; ++i)
+		inv.G[i] = t_real(1)/(colls[i]*colls[i] /rads/rads);
 
 
+	// crystal mosaic covariance matrix F, [pop75], Appendix 1
 	const angle mono_mosaic_spread = pop.mono_mosaic;
 	const angle ana_mosaic_spread = pop.ana_mosaic;
-	const angle sample_mosaic_spread = pop.sample_mosaic;
 
-	// crystal mosaic covariance matrix F, [pop75], Appendix 1
-	t_mat F = tl::diag_matrix(
-	{
-		t_real(1)/(pop.mono_mosaic*pop.mono_mosaic /rads/rads),
-		t_real(1)/(mono_mosaic_spread*mono_mosaic_spread /rads/rads),
-		t_real(1)/(pop.ana_mosaic*pop.ana_mosaic /rads/rads),
-		t_real(1)/(ana_mosaic_spread*ana_mosaic_spread /rads/rads)
-	});
-
-	// C matrix, [pop75], Appendix 1
-	t_mat C = ublas::zero_matrix<t_real>(4,8);
-	C(2,5) = C(2,4) = C(0,1) = C(0,0) = 0.5;
-	C(1,2) = t_real(0.5)/units::sin(thetam);
-	C(1,3) /*C(2,2)*/ = t_real(-0.5)/units::sin(thetam);	// Popovici says C(2,2), not C(1,3)
-	C(3,6) = t_real(0.5)/units::sin(thetaa);
-	C(3,7) = t_real(-0.5)/units::sin(thetaa);
-
-	// A matrix, [pop75], Appendix 1
-	t_mat A = ublas::zero_matrix<t_real>(6,8);
-	A(0,0) = t_real(0.5) * pop.ki*angs * units::cos(thetam)/units::sin(thetam);
-	A(0,1) = t_real(-0.5) * pop.ki*angs * units::cos(thetam)/units::sin(thetam);
-	A(2,3) = A(1,1) = pop.ki * angs;
-	A(3,4) = t_real(0.5) * pop.kf*angs * units::cos(thetaa)/units::sin(thetaa);
-	A(3,5) = t_real(-0.5) * pop.kf*angs * units::cos(thetaa)/units::sin(thetaa);
-	A(5,6) = A(4,4) = pop.kf * angs;
+	inv.Fi[0] = pop.mono_mosaic*pop.mono_mosaic /rads/rads;
+	inv.Fi[1] = mono_mosaic_spread*mono_mosaic_spread /rads/rads;
+	inv.Fi[2] = pop.ana_mosaic*pop.ana_mosaic /rads/rads;
+	inv.Fi[3] = ana_mosaic_spread*ana_mosaic_spread /rads/rads;
 
+	inv.dDetF = t_real(1);
+	for(std::size_t i=0; i<4; ++i)
+		inv.dDetF /= inv.Fi[i];
 
 
 	// covariance matrix of component geometries, S, [pop75], Appendix 2
 	// source
 	t_real dMult = 1./12.;
 	if(!pop.bSrcRect) dMult = 1./16.;
-	t_real dSiSrc[] =
-	{
-		dMult * pop.src_w*pop.src_w /cm/cm,
-		dMult * pop.src_h*pop.src_h /cm/cm
-	};
+	inv.SI[0] = dMult * pop.src_w*pop.src_w /cm/cm;
+	inv.SI[1] = dMult * pop.src_h*pop.src_h /cm/cm;
 
 	// mono
-	t_real dSiMono[] =
-	{
-		t_real(1./12.) * pop.mono_thick*pop.mono_thick /cm/cm,
-		t_real(1./12.) * pop.mono_w*pop.mono_w /cm/cm,
-		t_real(1./12.) * pop.mono_h*pop.mono_h /cm/cm
-	};
+	inv.SI[2] = t_real(1./12.) * pop.mono_thick*pop.mono_thick /cm/cm;
+	inv.SI[3] = t_real(1./12.) * pop.mono_w*pop.mono_w /cm/cm;
+	inv.SI[4] = t_real(1./12.) * pop.mono_h*pop.mono_h /cm/cm;
 
 	// sample
 	dMult = 1./12.;
 	if(!pop.bSampleCub) dMult = 1./16.;
-	t_real dSiSample[] =
-	{
-		dMult * pop.sample_w_perpq *pop.sample_w_perpq /cm/cm,
-		dMult * pop.sample_w_q*pop.sample_w_q /cm/cm,
-		t_real(1./12.) * pop.sample_h*pop.sample_h /cm/cm
-	};
+	inv.SI[5] = dMult * pop.sample_w_perpq *pop.sample_w_perpq /cm/cm;
+	inv.SI[6] = dMult * pop.sample_w_q*pop.sample_w_q /cm/cm;
+	inv.SI[7] = t_real(1./12.) * pop.sample_h*pop.sample_h /cm/cm;
 
 	// ana
-	t_real dSiAna[] =
-	{
-		t_real(1./12.) * pop.ana_thick*pop.ana_thick /cm/cm,
-		t_real(1./12.) * pop.ana_w*pop.ana_w /cm/cm,
-		t_real(1./12.) * pop.ana_h*pop.ana_h /cm/cm
-	};
+	inv.SI[8] = t_real(1./12.) * pop.ana_thick*pop.ana_thick /cm/cm;
+	inv.SI[9] = t_real(1./12.) * pop.ana_w*pop.ana_w /cm/cm;
+	inv.SI[10] = t_real(1./12.) * pop.ana_h*pop.ana_h /cm/cm;
 
 	// det
 	dMult = 1./12.;
 	if(!pop.bDetRect) dMult = 1./16.;
-	t_real dSiDet[] =
+	inv.SI[11] = dMult * pop.det_w*pop.det_w /cm/cm;
+	inv.SI[12] = dMult * pop.det_h*pop.det_h /cm/cm;
+
+	inv.dDetS = t_real(1);
+	for(std::size_t i=0; i<13; ++i)
 	{
-		dMult * pop.det_w*pop.det_w /cm/cm,
-		dMult * pop.det_h*pop.det_h /cm/cm
-	};
+		inv.SI[i] *= sig2fwhm*sig2fwhm;
+		if(inv.SI[i] == t_real(0) || tl::is_nan_or_inf(inv.SI[i]))
+		{
+			res.bOk = false;
+			res.strErr = "S matrix cannot be inverted.";
+			return false;
+		}
+
+		inv.dDetS /= inv.SI[i];
+	}
+
+	return true;
+}
+
+
+/**
+ * popovici resolution at one scan point
+ */
+static void calc_pop_point(const PopParams& pop, const PopInvariants& inv,
+	const ResoScanPoint& pt, ResoResults& res)
+{
+	res.Q_avg.resize(4);
+	res.Q_avg[0] = pt.Q * angs;
+	res.Q_avg[1] = 0.;
+	res.Q_avg[2] = 0.;
+	res.Q_avg[3] = pt.E / meV;
+
 
-	t_mat SI = tl::diag_matrix({dSiSrc[0], dSiSrc[1],
-		dSiMono[0], dSiMono[1], dSiMono[2],
-		dSiSample[0], dSiSample[1], dSiSample[2],
-		dSiAna[0], dSiAna[1], dSiAna[2],
-		dSiDet[0], dSiDet[1]});
+	length lam = tl::k2lam(pt.ki);
+	angle twotheta = pt.twotheta;
+	angle thetaa = pt.thetaa * pop.dana_sense;
+	angle thetam = pt.thetam * pop.dmono_sense;
+	angle ki_Q = pt.angle_ki_Q;
+	angle kf_Q = pt.angle_kf_Q;
+	//kf_Q = ki_Q + twotheta;
+
+	twotheta *= pop.dsample_sense;
+	ki_Q *= pop.dsample_sense;
+	kf_Q *= pop.dsample_sense;
+
+	// B matrix, [pop75], Appendix 1 -> U matrix in CN
+	const t_mat_fix<t_real, 6> U = get_trafo_dkidkf_dQdE_fix(ki_Q, kf_Q, pt.ki, pt.kf);
+	t_mat_fix<t_real, 4, 6> B;
+	for(std::size_t i=0; i<4; ++i)
+		for(std::size_t j=0; j<6; ++j)
+			B(i,j) = U(i,j);
 
-	SI *= sig2fwhm*sig2fwhm;
+	// collimator covariance matrix G, [pop75], Appendix 1
+	t_real G[8];
+	std::copy(inv.G, inv.G+8, G);
 
-	t_mat S;
-	if(!tl::inverse(SI, S))
+	if(pop.bGuide)
 	{
-		res.bOk = false;
-		res.strErr = "S matrix cannot be inverted.";
-		return res;
+		const angle coll_h_pre_mono = lam*(pop.guide_div_h/angs);
+		const angle coll_v_pre_mono = lam*(pop.guide_div_v/angs);
+
+		G[0] = t_real(1)/(coll_h_pre_mono*coll_h_pre_mono /rads/rads);
+		G[2] = t_real(1)/(coll_v_pre_mono*coll_v_pre_mono /rads/rads);
 	}
 
+	const angle sample_mosaic_spread = pop.sample_mosaic;
+
+	// A matrix, [pop75], Appendix 1
+	t_mat_fix<t_real, 6, 8> A = fix_zero_matrix<t_real, 6, 8>();
+	A(0,0) = t_real(0.5) * pt.ki*angs * units::cos(thetam)/units::sin(thetam);
+	A(0,1) = t_real(-0.5) * pt.ki*angs * units::cos(thetam)/units::sin(thetam);
+	A(2,3) = A(1,1) = pt.ki * angs;
+	A(3,4) = t_real(0.5) * pt.kf*angs * units::cos(thetaa)/units::sin(thetaa);
+	A(3,5) = t_real(-0.5) * pt.kf*angs * units::cos(thetaa)/units::sin(thetaa);
+	A(5,6) = A(4,4) = pt.kf * angs;
+
 
 	// --------------------------------------------------------------------
 	// mono/ana focus
@@ -208,25 +220,19 @@ ResoResults calc_pop(const PopParams& pop)
 	if(pop.bAnaIsCurvedV) inv_ana_curvv = t_real(1)/ana_curvv;
 
 
-	const auto tupScFact = get_scatter_factors(pop.flags, pop.thetam, pop.ki, pop.thetaa, pop.kf);
+	const auto tupScFact = get_scatter_factors(pop.flags, pt.thetam, pt.ki, pt.thetaa, pt.kf);
 
 	t_real dmono_refl = pop.dmono_refl * std::get<0>(tupScFact);
 	t_real dana_effic = pop.dana_effic * std::get<1>(tupScFact);
-	if(pop.mono_refl_curve) dmono_refl *= (*pop.mono_refl_curve)(pop.ki);
-	if(pop.ana_effic_curve) dana_effic *= (*pop.ana_effic_curve)(pop.kf);
+	if(pop.mono_refl_curve) dmono_refl *= (*pop.mono_refl_curve)(pt.ki);
+	if(pop.ana_effic_curve) dana_effic *= (*pop.ana_effic_curve)(pt.kf);
 	t_real dxsec = std::get<2>(tupScFact);
-
-
-	//if(pop.bMonoIsCurvedH) tl::log_debug("mono curv h: ", mono_curvh);
-	//if(pop.bMonoIsCurvedV) tl::log_debug("mono curv v: ", mono_curvv);
-	//if(pop.bAnaIsCurvedH) tl::log_debug("ana curv h: ", ana_curvh);
-	//if(pop.bAnaIsCurvedV) tl::log_debug("ana curv v: ", ana_curvv);
 	// --------------------------------------------------------------------
 
 
 
 	// T matrix to transform the mosaic cov. matrix, [pop75], Appendix 2
-	t_mat T = ublas::zero_matrix<t_real>(4,13);
+	t_mat_fix<t_real, 4, 13> T = fix_zero_matrix<t_real, 4, 13>();
 	T(0,0) = t_real(-0.5) / (pop.dist_src_mono / cm);
 	T(0,2) = t_real(0.5) * units::cos(thetam) *
 		(t_real(1)/(pop.dist_mono_sample/cm) - t_real(1)/(pop.dist_src_mono/cm));
@@ -259,7 +265,7 @@ ResoResults calc_pop(const PopParams& pop)
 
 
 	// D matrix to transform the spatial and the mosaic cov. matrices, [pop75], Appendix 2
-	t_mat D = ublas::zero_matrix<t_real>(8,13);
+	t_mat_fix<t_real, 8, 13> D = fix_zero_matrix<t_real, 8, 13>();
 	D(0,0) = t_real(-1) / (pop.dist_src_mono/cm);
 	D(0,2) = -cos(thetam) / (pop.dist_src_mono/cm);
 	D(0,3) = sin(thetam) / (pop.dist_src_mono/cm);
@@ -284,66 +290,115 @@ ResoResults calc_pop(const PopParams& pop)
 	D(7,12) = t_real(1) / (pop.dist_ana_det/cm);
 
 
-	// [pop75], equ. 20
+	// [pop75], equ. 20: K = S + T^t F T
 	// [T] = 1/cm, [F] = 1/rad^2, [pop75], equ. 15
-	t_mat K = S + tl::transform(F, T, 1);
-	t_mat Ki;
-	if(!tl::inverse(K, Ki))
+	// S and F are diagonal, so K is inverted via the woodbury identity:
+	// K^(-1) = S^(-1) - S^(-1) T^t W^(-1) T S^(-1), with W = F^(-1) + T S^(-1) T^t
+	t_mat_fix<t_real, 4, 13> TSi;
+	t_mat_fix<t_real, 8, 13> DSi;
+	for(std::size_t j=0; j<13; ++j)
+	{
+		for(std::size_t i=0; i<4; ++i)
+			TSi(i,j) = T(i,j) * inv.SI[j];
+		for(std::size_t i=0; i<8; ++i)
+			DSi(i,j) = D(i,j) * inv.SI[j];
+	}
+
+	t_mat4 W;
+	for(std::size_t i=0; i<4; ++i)
+	{
+		for(std::size_t j=0; j<4; ++j)
+		{
+			t_real dSum = (i==j ? inv.Fi[i] : t_real(0));
+			for(std::size_t k=0; k<13; ++k)
+				dSum += TSi(i,k) * T(j,k);
+			W(i,j) = dSum;
+		}
+	}
+
+	t_mat4 Wi;
+	if(!fix_inverse(W, Wi))
 	{
 		res.bOk = false;
 		res.strErr = "Matrix K cannot be inverted.";
-		return res;
+		return;
 	}
 
-	// [pop75], equ. 17
-	t_mat Hi = tl::transform_inv(Ki, D, 1);
-	t_mat H;
-	if(!tl::inverse(Hi, H))
+	// [pop75], equ. 17: H^(-1) = D K^(-1) D^t = D S^(-1) D^t - X W^(-1) X^t, with X = D S^(-1) T^t
+	t_mat8 DSiDt;
+	t_mat_fix<t_real, 8, 4> X;
+	for(std::size_t i=0; i<8; ++i)
+	{
+		for(std::size_t j=0; j<8; ++j)
+		{
+			t_real dSum = t_real(0);
+			for(std::size_t k=0; k<13; ++k)
+				dSum += DSi(i,k) * D(j,k);
+			DSiDt(i,j) = dSum;
+		}
+
+		for(std::size_t j=0; j<4; ++j)
+		{
+			t_real dSum = t_real(0);
+			for(std::size_t k=0; k<13; ++k)
+				dSum += DSi(i,k) * T(j,k);
+			X(i,j) = dSum;
+		}
+	}
+
+	t_mat8 Hi = DSiDt;
+	const t_mat8 XWiXt = fix_transform_inv(Wi, X);
+	for(std::size_t i=0; i<8; ++i)
+		for(std::size_t j=0; j<8; ++j)
+			Hi(i,j) -= XWiXt(i,j);
+
+	t_mat8 H;
+	if(!fix_inverse(Hi, H))
 	{
 		res.bOk = false;
 		res.strErr = "Matrix H^(-1) cannot be inverted.";
-		return res;
+		return;
 	}
 
-	t_mat H_G = H + G;
-	t_mat H_Gi;
-	if(!tl::inverse(H_G, H_Gi))
+	t_mat8 H_G = H;
+	for(std::size_t i=0; i<8; ++i)
+		H_G(i,i) += G[i];
+
+	t_mat8 H_Gi;
+	if(!fix_inverse(H_G, H_Gi))
 	{
 		res.bOk = false;
 		res.strErr = "Matrix H+G cannot be inverted.";
-		return res;
+		return;
 	}
 
-	t_mat BA = ublas::prod(B, A);
-	t_mat ABt = ublas::prod(ublas::trans(A), ublas::trans(B));
-	t_mat H_GiABt = ublas::prod(H_Gi, ABt);
-	t_mat cov = ublas::prod(BA, H_GiABt);
+	const t_mat_fix<t_real, 4, 8> BA = fix_prod(B, A);
+	t_mat4 cov = fix_transform_inv(H_Gi, BA);
 
-	cov(1,1) += pop.Q*pop.Q*angs*angs * pop.sample_mosaic*pop.sample_mosaic /rads/rads;
-	cov(2,2) += pop.Q*pop.Q*angs*angs * sample_mosaic_spread*sample_mosaic_spread /rads/rads;
+	cov(1,1) += pt.Q*pt.Q*angs*angs * pop.sample_mosaic*pop.sample_mosaic /rads/rads;
+	cov(2,2) += pt.Q*pt.Q*angs*angs * sample_mosaic_spread*sample_mosaic_spread /rads/rads;
 
-	if(!tl::inverse(cov, res.reso))
+	t_mat4 reso;
+	if(!fix_inverse(cov, reso))
 	{
 		res.bOk = false;
 		res.strErr = "Covariance matrix cannot be inverted.";
-		return res;
+		return;
 	}
 
 
 	// -------------------------------------------------------------------------
 
 
-	res.reso *= sig2fwhm*sig2fwhm;
-	res.reso_v = ublas::zero_vector<t_real>(4);
-	res.reso_s = 0.;
+	reso *= sig2fwhm*sig2fwhm;
 
+	// mirror Q_perp
 	if(pop.dsample_sense < 0.)
-	{
-		// mirror Q_perp
-		t_mat matMirror = tl::mirror_matrix<t_mat>(res.reso.size1(), 1);
-		res.reso = tl::transform(res.reso, matMirror, true);
-		res.reso_v[1] = -res.reso_v[1];
-	}
+		fix_mirror(reso, 1);
+
+	res.reso = reso;
+	res.reso_v = ublas::zero_vector<t_real>(4);
+	res.reso_s = 0.;
 
 
 	res.dResVol = tl::get_ellipsoid_volume(res.reso);
@@ -353,20 +408,21 @@ ResoResults calc_pop(const PopParams& pop)
 	{
 		// resolution volume, [pop75], equ. 13a & 16
 		// [D] = 1/cm, [SI] = cm^2
-		t_mat DSiDt = tl::transform_inv(SI, D, 1);
-		t_mat DSiDti;
-		if(!tl::inverse(DSiDt, DSiDti))
+		t_mat8 DSiDti;
+		if(!fix_inverse(DSiDt, DSiDti))
 		{
 			res.bOk = false;
 			res.strErr = "R0 factor cannot be calculated.";
-			return res;
+			return;
 		}
-		DSiDti += G;
+		for(std::size_t i=0; i<8; ++i)
+			DSiDti(i,i) += G[i];
 
-		t_real dDetS = tl::determinant(S);
-		t_real dDetF = tl::determinant(F);
-		t_real dDetK = tl::determinant(K);
-		t_real dDetDSiDti = tl::determinant(DSiDti);
+		// det(K) = det(S) det(F) det(W)
+		t_real dDetS = inv.dDetS;
+		t_real dDetF = inv.dDetF;
+		t_real dDetK = dDetS * dDetF * fix_determinant(W);
+		t_real dDetDSiDti = fix_determinant(DSiDti);
 
 		// [pop75], equs. 13a & 16
 		res.dR0 = dmono_refl*dana_effic * t_real((2.*pi)*(2.*pi)*(2.*pi)*(2.*pi));
@@ -384,17 +440,54 @@ ResoResults calc_pop(const PopParams& pop)
 	}
 
 	// Bragg widths
-	const std::vector<t_real> vecFwhms = calc_bragg_fwhms(res.reso);
-	std::copy(vecFwhms.begin(), vecFwhms.end(), res.dBraggFWHMs);
+	for(std::size_t i=0; i<4; ++i)
+		res.dBraggFWHMs[i] = sig2fwhm/std::sqrt(reso(i,i));
 
 
 	if(tl::is_nan_or_inf(res.dR0) || tl::is_nan_or_inf(res.reso))
 	{
 		res.strErr = "Invalid result.";
 		res.bOk = false;
-		return res;
+		return;
 	}
 
+	res.strErr = "";
 	res.bOk = true;
-	return res;
+}
+
+
+/**
+ * popovici resolution at all scan points,
+ * the collimation, mosaic and geometry matrices are only set up once
+ */
+void calc_pop_batch(const PopParams& pop,
+	const std::vector<ResoScanPoint>& vecPts, std::vector<ResoResults>& vecRes)
+{
+	vecRes.resize(vecPts.size());
+
+	PopInvariants inv;
+	ResoResults resInv;
+	if(!calc_pop_invariants(pop, inv, resInv))
+	{
+		for(ResoResults& res : vecRes)
+			res = resInv;
+		return;
+	}
+
+	for(std::size_t iPt=0; iPt<vecPts.size(); ++iPt)
+	{
+		// the result does not depend on the sample position
+		if(iPt > 0 && vecPts[iPt].SameKinematics(vecPts[iPt-1]))
+			vecRes[iPt] = vecRes[iPt-1];
+		else
+			calc_pop_point(pop, inv, vecPts[iPt], vecRes[iPt]);
+	}
+}
+
+
+ResoResults calc_pop(const PopParams& pop)
+{
+	std::vector<ResoResults> vecRes;
+	calc_pop_batch(pop, { get_scan_point(pop) }, vecRes);
+	return vecRes[0];
 }
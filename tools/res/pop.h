@@ -63,5 +63,7 @@ struct PopParams : public CNParams
 
 
 extern ResoResults calc_pop(const PopParams& pop);
+extern void calc_pop_batch(const PopParams& pop,
+	const std::vector<ResoScanPoint>& vecPts, std::vector<ResoResults>& vecRes);
 
 #endif
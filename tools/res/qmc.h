@@ -0,0 +1,234 @@
+/**
+ * quasi-monte carlo sequences
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __QMC_SEQ_H__
+#define __QMC_SEQ_H__
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+#include "tlibs/math/math.h"
+#include "tlibs/math/rand.h"
+#include "philox.h"
+
+
+/**
+ * inverse of the standard normal cumulative distribution function
+ * (rational approximation by P. J. Acklam, refined by one Halley step)
+ */
+template<class t_real = double>
+t_real norm_quantile(t_real p)
+{
+	static const t_real a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+		1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+	static const t_real b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+		6.680131188771972e+01, -1.328068155288572e+01 };
+	static const t_real c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+		-2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+	static const t_real d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+		3.754408661907416e+00 };
+	const t_real p_low = 0.02425;
+
+	if(p <= t_real(0))
+		return -std::numeric_limits<t_real>::infinity();
+	if(p >= t_real(1))
+		return std::numeric_limits<t_real>::infinity();
+
+	t_real x;
+	if(p < p_low)
+	{
+		const t_real q = std::sqrt(-t_real(2)*std::log(p));
+		x = (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+			((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + t_real(1));
+	}
+	else if(p <= t_real(1) - p_low)
+	{
+		const t_real q = p - t_real(0.5);
+		const t_real r = q*q;
+		x = (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5])*q /
+			(((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + t_real(1));
+	}
+	else
+	{
+		const t_real q = std::sqrt(-t_real(2)*std::log(t_real(1) - p));
+		x = -(((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+			((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + t_real(1));
+	}
+
+	// refinement to full precision
+	const t_real e = t_real(0.5) * std::erfc(-x/std::sqrt(t_real(2))) - p;
+	const t_real u = e * std::sqrt(t_real(2)*tl::get_pi<t_real>()) * std::exp(x*x/t_real(2));
+	x -= u / (t_real(1) + x*u/t_real(2));
+
+	return x;
+}
+
+
+/**
+ * scrambled sobol sequence with the direction numbers by Joe and Kuo;
+ * the scrambling (random linear matrix scrambling and digital shift) keeps
+ * the low discrepancy, but makes the estimates unbiased and independent between scramblings
+ */
+template<class t_real = double>
+class SobolSeq
+{
+public:
+	static constexpr unsigned MAX_DIM = 8;
+	static constexpr unsigned BITS = 32;
+
+protected:
+	unsigned m_iDim = 0;
+	std::uint32_t m_dirs[MAX_DIM][BITS];
+	std::uint32_t m_shift[MAX_DIM];
+
+protected:
+	static std::uint32_t rand_bits()
+	{
+		const t_real dMax = t_real(std::uint64_t(1) << BITS);
+		t_real dRnd = tl::rand_real<t_real>(t_real(0), dMax);
+		if(dRnd >= dMax) dRnd = t_real(0);
+		return std::uint32_t(dRnd);
+	}
+
+	static unsigned parity(std::uint32_t i)
+	{
+		i ^= i >> 16;
+		i ^= i >> 8;
+		i ^= i >> 4;
+		i ^= i >> 2;
+		i ^= i >> 1;
+		return i & 1;
+	}
+
+public:
+	/**
+	 * sequence with iDim dimensions, scrambled if bScramble is set,
+	 * using sub-stream iSub of pStream for the scrambling if given
+	 */
+	SobolSeq(unsigned iDim, bool bScramble = true,
+		const PhiloxStream* pStream = nullptr, std::uint32_t iSub = 0)
+		: m_iDim(iDim < MAX_DIM ? iDim : MAX_DIM)
+	{
+		// primitive polynomials (degree s, coefficients a) and initial direction numbers m
+		static const unsigned s[MAX_DIM] = { 0, 1, 2, 3, 3, 4, 4, 5 };
+		static const unsigned a[MAX_DIM] = { 0, 0, 1, 1, 2, 1, 4, 2 };
+		static const std::uint32_t m[MAX_DIM][5] =
+		{
+			{ 0, 0, 0, 0, 0 },
+			{ 1, 0, 0, 0, 0 },
+			{ 1, 3, 0, 0, 0 },
+			{ 1, 3, 1, 0, 0 },
+			{ 1, 1, 1, 0, 0 },
+			{ 1, 1, 3, 3, 0 },
+			{ 1, 3, 5, 13, 0 },
+			{ 1, 1, 5, 5, 17 },
+		};
+
+		for(unsigned iBit=0; iBit<BITS; ++iBit)
+			m_dirs[0][iBit] = std::uint32_t(1) << (BITS-1-iBit);
+
+		for(unsigned iDim=1; iDim<MAX_DIM; ++iDim)
+		{
+			std::uint32_t *v = m_dirs[iDim];
+			const unsigned deg = s[iDim];
+
+			for(unsigned iBit=0; iBit<BITS; ++iBit)
+			{
+				if(iBit < deg)
+				{
+					v[iBit] = m[iDim][iBit] << (BITS-1-iBit);
+					continue;
+				}
+
+				v[iBit] = v[iBit-deg] ^ (v[iBit-deg] >> deg);
+				for(unsigned iCoeff=1; iCoeff<deg; ++iCoeff)
+				{
+					if((a[iDim] >> (deg-1-iCoeff)) & 1)
+						v[iBit] ^= v[iBit-iCoeff];
+				}
+			}
+		}
+
+		for(unsigned iDim=0; iDim<MAX_DIM; ++iDim)
+			m_shift[iDim] = 0;
+
+		if(bScramble)
+			Scramble(pStream, iSub);
+	}
+
+	/**
+	 * multiplies the direction numbers with random lower-triangular binary matrices
+	 * (with the most significant digit first) and draws a random digital shift;
+	 * the random bits are taken from sub-stream iSub of pStream if given
+	 */
+	void Scramble(const PhiloxStream* pStream = nullptr, std::uint32_t iSub = 0)
+	{
+		std::uint32_t iRnd = 0;
+		std::uint32_t uBits[4];
+		auto next_bits = [pStream, iSub, &iRnd, &uBits]() -> std::uint32_t
+		{
+			if(!pStream)
+				return rand_bits();
+
+			if(iRnd % 4 == 0)
+				pStream->GetBits(iRnd / 4, iSub, uBits);
+			return uBits[iRnd++ % 4];
+		};
+
+		for(unsigned iDim=0; iDim<m_iDim; ++iDim)
+		{
+			std::uint32_t rows[BITS];
+			for(unsigned iRow=0; iRow<BITS; ++iRow)
+			{
+				// digits 0 ... iRow of the row, digit iRow (the diagonal) is set
+				const std::uint32_t uDiag = std::uint32_t(1) << (BITS-1-iRow);
+				const std::uint32_t uMask = ~(uDiag - 1);
+				rows[iRow] = (next_bits() & uMask) | uDiag;
+			}
+
+			for(unsigned iBit=0; iBit<BITS; ++iBit)
+			{
+				std::uint32_t uDir = 0;
+				for(unsigned iRow=0; iRow<BITS; ++iRow)
+					uDir |= std::uint32_t(parity(rows[iRow] & m_dirs[iDim][iBit])) << (BITS-1-iRow);
+				m_dirs[iDim][iBit] = uDir;
+			}
+
+			m_shift[iDim] = next_bits();
+		}
+	}
+
+	unsigned GetDim() const { return m_iDim; }
+
+	/**
+	 * coordinate iDim of point iIdx in (0, 1), in gray-code order
+	 */
+	t_real Get(std::uint64_t iIdx, unsigned iDim) const
+	{
+		std::uint64_t iGray = iIdx ^ (iIdx >> 1);
+		std::uint32_t uVal = m_shift[iDim];
+		for(unsigned iBit=0; iBit<BITS && iGray; ++iBit, iGray >>= 1)
+		{
+			if(iGray & 1)
+				uVal ^= m_dirs[iDim][iBit];
+		}
+
+		return (t_real(uVal) + t_real(0.5)) / t_real(std::uint64_t(1) << BITS);
+	}
+
+	/**
+	 * coordinate iDim of point iIdx transformed to a standard-normal deviate
+	 */
+	t_real GetNormal(std::uint64_t iIdx, unsigned iDim) const
+	{
+		return norm_quantile<t_real>(Get(iIdx, iDim));
+	}
+};
+
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * quadrature of the resolution function
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @date oct-2026
+ * @license GPLv2
+ */
+
+#ifndef __RESO_QUAD_H__
+#define __RESO_QUAD_H__
+
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "mc.h"
+
+
+// maximum number of quadrature nodes per dimension
+#define RESO_QUAD_MAX_ORDER	20
+
+
+/**
+ * gauss-hermite nodes and weights for the standard normal distribution,
+ * i.e. sum_i w_i f(x_i) approximates the expectation value of f(x) for x ~ N(0, 1)
+ * (newton iteration on the normalised hermite polynomials, see Numerical Recipes, ch. 4.6)
+ */
+template<class t_real = double>
+void gauss_hermite(unsigned iOrder, std::vector<t_real>& vecNodes, std::vector<t_real>& vecWeights)
+{
+	vecNodes.resize(iOrder);
+	vecWeights.resize(iOrder);
+	if(!iOrder)
+		return;
+
+	const t_real dPi = tl::get_pi<t_real>();
+	const t_real dPiM4 = std::pow(dPi, t_real(-0.25));
+	const t_real dEps = t_real(100)*std::numeric_limits<t_real>::epsilon();
+	const t_real n = t_real(iOrder);
+
+	t_real z = 0;
+	for(unsigned i=0; i<(iOrder+1)/2; ++i)
+	{
+		// initial guesses for the roots, from the largest one downwards
+		if(i == 0)
+			z = std::sqrt(t_real(2)*n + t_real(1)) - t_real(1.85575)*std::pow(t_real(2)*n + t_real(1), -t_real(1)/t_real(6));
+		else if(i == 1)
+			z -= t_real(1.14)*std::pow(n, t_real(0.426)) / z;
+		else if(i == 2)
+			z = t_real(1.86)*z - t_real(0.86)*vecNodes[0];
+		else if(i == 3)
+			z = t_real(1.91)*z - t_real(0.91)*vecNodes[1];
+		else
+			z = t_real(2)*z - vecNodes[i-2];
+
+		t_real dDeriv = 0;
+		for(int iIter=0; iIter<100; ++iIter)
+		{
+			t_real p1 = dPiM4, p2 = 0;
+			for(unsigned j=0; j<iOrder; ++j)
+			{
+				const t_real p3 = p2;
+				p2 = p1;
+				p1 = z*std::sqrt(t_real(2)/t_real(j+1))*p2 - std::sqrt(t_real(j)/t_real(j+1))*p3;
+			}
+
+			dDeriv = std::sqrt(t_real(2)*n) * p2;
+			const t_real zOld = z;
+			z = zOld - p1/dDeriv;
+			if(std::abs(z - zOld) <= dEps*std::max(std::abs(z), t_real(1)))
+				break;
+		}
+
+		vecNodes[i] = z;
+		vecNodes[iOrder-1-i] = -z;
+		vecWeights[i] = vecWeights[iOrder-1-i] = t_real(2) / (dDeriv*dDeriv);
+	}
+
+	if(iOrder % 2)
+		vecNodes[iOrder/2] = t_real(0);
+
+	// scale from the weight function exp(-x^2) to the normal distribution
+	for(unsigned i=0; i<iOrder; ++i)
+	{
+		vecNodes[i] *= std::sqrt(t_real(2));
+		vecWeights[i] /= std::sqrt(dPi);
+	}
+}
+
+
+/**
+ * generates the nodes of a product gauss-hermite quadrature of order iOrder
+ * in the principal-axis frame of the ellipsoid as neutrons in the range [iOffs, iOffs+iOrder^4)
+ * of the batch, the weights (summing to 1) are written to the same range of vecWeights
+ * @see mc_neutrons_batch
+ */
+template<class t_mat = ublas::matrix<double>>
+void quad_neutrons_batch(const Ellipsoid4d<typename t_mat::value_type>& ell4d,
+	unsigned iOrder, const McNeutronOpts<t_mat>& opts,
+	McNeutronBatch<typename t_mat::value_type>& batch,
+	std::vector<typename t_mat::value_type>& vecWeights, std::size_t iOffs = 0)
+{
+	using t_real = typename t_mat::value_type;
+
+	std::vector<t_real> vecNodes, vecNodeWeights;
+	gauss_hermite<t_real>(iOrder, vecNodes, vecNodeWeights);
+
+	const std::size_t iNum = std::size_t(iOrder)*iOrder*iOrder*iOrder;
+	if(batch.size() < iOffs + iNum)
+		batch.resize(iOffs + iNum);
+	if(vecWeights.size() < iOffs + iNum)
+		vecWeights.resize(iOffs + iNum);
+
+	std::size_t iCur = iOffs;
+	for(unsigned i0=0; i0<iOrder; ++i0)
+	for(unsigned i1=0; i1<iOrder; ++i1)
+	for(unsigned i2=0; i2<iOrder; ++i2)
+	for(unsigned i3=0; i3<iOrder; ++i3)
+	{
+		batch.vecH[iCur] = vecNodes[i0];
+		batch.vecK[iCur] = vecNodes[i1];
+		batch.vecL[iCur] = vecNodes[i2];
+		batch.vecE[iCur] = vecNodes[i3];
+		vecWeights[iCur] = vecNodeWeights[i0] * vecNodeWeights[i1] *
+			vecNodeWeights[i2] * vecNodeWeights[i3];
+		++iCur;
+	}
+
+	t_real matTrafo[4*4], vecOffs[4];
+	mc_neutron_trafo<t_mat>(ell4d, opts, matTrafo, vecOffs);
+	mc_neutrons_apply_trafo<t_real>(matTrafo, vecOffs, batch, batch, iOffs, iNum);
+}
+
+
+#endif
@@ -11,6 +11,7 @@
 #include "viol.h"
 #include "ellipse.h"
 #include "helper.h"
+#include "fixedmat.h"
 
 #include "tlibs/math/linalg.h"
 #include "tlibs/math/geo.h"
@@ -264,21 +265,30 @@ ResoResults calc_viol(const ViolParams& params)
 
 	// --------------------------------------------------------------------
 	// formulas 10 & 11 in [viol14]
-	t_mat matSigSq = tl::diag_matrix({
+	const t_real dSigs[] = {
 		st*st /sec/sec, stm*stm /sec/sec,
 		slp*slp /meter/meter, slm*slm /meter/meter, sls*sls /meter/meter,
 		s2ti*s2ti /rads/rads, sphi*sphi /rads/rads,
-		s2tf*s2tf /rads/rads, sphf*sphf /rads/rads });
+		s2tf*s2tf /rads/rads, sphf*sphf /rads/rads };
 
-	std::size_t N = matSigSq.size1();
-	t_mat matJacobiInstr(4, N, t_real(0));
+	constexpr std::size_t N = sizeof(dSigs) / sizeof(*dSigs);
+	t_mat_fix<t_real, N> matSigSq = fix_zero_matrix<t_real, N>();
+	for(std::size_t i=0; i<N; ++i)
+		matSigSq(i,i) = dSigs[i];
+
+	t_mat_fix<t_real, 4, N> matJacobiInstr = fix_zero_matrix<t_real, 4, N>();
 	for(std::size_t iDeriv=0; iDeriv<vecQderivs.size(); ++iDeriv)
-		tl::set_column(matJacobiInstr, iDeriv, vecQderivs[iDeriv]());
+	{
+		const t_vec vecDeriv = vecQderivs[iDeriv]();
+		for(std::size_t i=0; i<vecDeriv.size(); ++i)
+			matJacobiInstr(i, iDeriv) = vecDeriv[i];
+	}
 	for(std::size_t iDeriv=0; iDeriv<vecEderivs.size(); ++iDeriv)
 		matJacobiInstr(3, iDeriv) = vecEderivs[iDeriv]();
 
-	t_mat matSigQE = tl::transform_inv(matSigSq, matJacobiInstr, true);
-	if(!tl::inverse(matSigQE, res.reso))
+	const t_mat_fix<t_real, 4> matSigQE = fix_transform_inv(matSigSq, matJacobiInstr);
+	t_mat_fix<t_real, 4> matReso;
+	if(!fix_inverse(matSigQE, matReso))
 	{
 		res.bOk = false;
 		res.strErr = "Jacobi matrix cannot be inverted.";
@@ -288,18 +298,18 @@ ResoResults calc_viol(const ViolParams& params)
 #ifndef NDEBUG
 	tl::log_debug("J_instr = ", matJacobiInstr);
 	tl::log_debug("J_QE = ", matSigQE);
-	tl::log_debug("Reso = ", res.reso);
+	tl::log_debug("Reso = ", matReso);
 #endif
 	// --------------------------------------------------------------------
 
 	// transform from  (ki, ki_perp, Qz)  to  (Q_perp, Q_para, Q_z)  system
-	t_mat matKiQ = tl::rotation_matrix_2d(-params.angle_ki_Q / rads);
-	matKiQ.resize(4,4, true);
-	matKiQ(2,2) = matKiQ(3,3) = 1.;
-	matKiQ(2,0) = matKiQ(2,1) = matKiQ(2,3) = matKiQ(3,0) = matKiQ(3,1) =
-	matKiQ(3,2) = matKiQ(0,2) = matKiQ(0,3) = matKiQ(1,2) = matKiQ(1,3) = 0.;
+	const t_real dAngleKiQ = -params.angle_ki_Q / rads;
+	t_mat_fix<t_real, 4> matKiQ = fix_unit_matrix<t_real, 4>();
+	matKiQ(0,0) = matKiQ(1,1) = std::cos(dAngleKiQ);
+	matKiQ(1,0) = std::sin(dAngleKiQ);
+	matKiQ(0,1) = -matKiQ(1,0);
 
-	res.reso = tl::transform(res.reso, matKiQ, true);
+	res.reso = fix_transform(matReso, matKiQ);
 	//res.reso *= tl::get_SIGMA2FWHM<t_real>()*tl::get_SIGMA2FWHM<t_real>();
 
 	res.dResVol = tl::get_ellipsoid_volume(res.reso);
@@ -166,6 +166,18 @@ ScatteringTriangle::~ScatteringTriangle()
 {
 	m_bUpdate = m_bReady = 0;
 	ClearPeaks();
+
+	for(RecipPeak*& pPeak : m_vecPeaks)
+	{
+		if(pPeak)
+		{
+			m_scene.removeItem(pPeak);
+			delete pPeak;
+			pPeak = 0;
+		}
+	}
+	m_vecPeaks.clear();
+	m_vecUnusedPeaks.clear();
 }
 
 
@@ -195,8 +207,14 @@ void ScatteringTriangle::nodeMoved(const ScatteringTriangleNode* pNode)
 
 QRectF ScatteringTriangle::boundingRect() const
 {
-	return QRectF(-100.*m_dZoom*g_dFontSize, -100.*m_dZoom*g_dFontSize,
+	QRectF rect(-100.*m_dZoom*g_dFontSize, -100.*m_dZoom*g_dFontSize,
 		200.*m_dZoom*g_dFontSize, 200.*m_dZoom*g_dFontSize);
+
+	// the BZs are drawn around the peaks
+	if(m_vecPlanePeaks.size())
+		rect |= QRectF(m_rectLattice.topLeft()*m_dZoom, m_rectLattice.bottomRight()*m_dZoom);
+
+	return rect;
 }
 
 
@@ -274,7 +292,7 @@ void ScatteringTriangle::paint(QPainter *pPainter, const QStyleOptionGraphicsIte
 
 
 	// Brillouin zone
-	if(m_bShowBZ && (m_bz.IsValid() || m_bz3.IsValid()))
+	if(m_bShowBZ && (m_pbz->IsValid() || m_pbz3->IsValid()))
 	{
 		pPainter->setPen(penGray);
 
@@ -282,7 +300,7 @@ void ScatteringTriangle::paint(QPainter *pPainter, const QStyleOptionGraphicsIte
 		std::vector<QPointF> vecBZ3;
 
 		// use 3d BZ code
-		if(g_b3dBZ && m_bz3.IsValid())
+		if(g_b3dBZ && m_pbz3->IsValid())
 		{
 			// convert vertices to QPointFs
 			vecBZ3.reserve(m_vecBZ3Verts.size());
@@ -290,18 +308,22 @@ void ScatteringTriangle::paint(QPainter *pPainter, const QStyleOptionGraphicsIte
 				vecBZ3.push_back(vec_to_qpoint(vecVert * m_dScaleFactor * m_dZoom));
 		}
 		// use 2d BZ code
-		else if(m_bz.IsValid())
+		else if(m_pbz->IsValid())
 		{
-			vecCentral2d = m_bz.GetCentralReflex() * m_dScaleFactor*m_dZoom;
+			vecCentral2d = m_pbz->GetCentralReflex() * m_dScaleFactor*m_dZoom;
 		}
 
 		for(const RecipPeak* pPeak : m_vecPeaks)
 		{
+			// only the peaks near the visible region have an active item
+			if(!pPeak->isVisible())
+				continue;
+
 			QPointF peakPos = pPeak->pos();
 			peakPos *= m_dZoom;
 
 			// use 3d BZ code
-			if(g_b3dBZ && m_bz3.IsValid())
+			if(g_b3dBZ && m_pbz3->IsValid())
 			{
 				std::vector<QPointF> vecBZ3_peak = vecBZ3;
 				for(auto& vecVert : vecBZ3_peak)
@@ -309,9 +331,9 @@ void ScatteringTriangle::paint(QPainter *pPainter, const QStyleOptionGraphicsIte
 				pPainter->drawPolygon(vecBZ3_peak.data(), vecBZ3_peak.size());
 			}
 			// use 2d BZ code
-			else if(m_bz.IsValid())
+			else if(m_pbz->IsValid())
 			{
-				const tl::Brillouin2D<t_real>::t_vertices<t_real>& verts = m_bz.GetVertices();
+				const tl::Brillouin2D<t_real>::t_vertices<t_real>& verts = m_pbz->GetVertices();
 				for(const tl::Brillouin2D<t_real>::t_vecpair<t_real>& vertpair : verts)
 				{
 					const t_vec& vec1 = vertpair.first * m_dScaleFactor * m_dZoom;
@@ -973,25 +995,47 @@ static inline std::string print_complex(const std::complex<T>& c)
 
 void ScatteringTriangle::CalcPeaks(const xtl::LatticeCommon<t_real>& recipcommon, bool bIsPowder)
 {
-	ClearPeaks();
-	m_vecPowderLines.clear();
-	m_vecPowderLineWidths.clear();
-	m_kdLattice.Unload();
+	SetPeaks(CalcRecipPeaks(recipcommon, bIsPowder,
+		m_iMaxPeaks, m_dPlaneDistTolerance, m_bShowAllPeaks));
+}
 
-	m_lattice = recipcommon.lattice;
-	m_recip = recipcommon.recip;
-	m_plane = recipcommon.plane;
-	m_matPlane = recipcommon.matPlane;
-	m_matPlaneRlu = recipcommon.matPlaneRLU;
-	m_matPlane_inv = recipcommon.matPlane_inv;
+
+/**
+ * calculates the peaks, BZs and powder lines without touching the scene,
+ * this can run in a background thread
+ * @return nullptr if cancelled via pStop
+ */
+std::unique_ptr<RecipPeaks> ScatteringTriangle::CalcRecipPeaks(
+	const xtl::LatticeCommon<t_real>& recipcommon, bool bIsPowder,
+	int iMaxPeaksSetting, t_real dPlaneDistTolerance, bool bShowAllPeaks,
+	const std::atomic<bool>* pStop)
+{
+	std::unique_ptr<RecipPeaks> pPeaks(new RecipPeaks());
+	RecipPeaks& peaks = *pPeaks;
+
+	peaks.lattice = recipcommon.lattice;
+	peaks.recip = recipcommon.recip;
+	peaks.plane = recipcommon.plane;
+	peaks.matPlane = recipcommon.matPlane;
+	peaks.matPlaneRlu = recipcommon.matPlaneRLU;
+	peaks.matPlane_inv = recipcommon.matPlane_inv;
+
+	peaks.pkdLattice.reset(new tl::Kd<t_real>());
+	peaks.pbz.reset(new tl::Brillouin2D<t_real>());
+	peaks.pbz3.reset(new tl::Brillouin3D<t_real>());
+
+	const tl::Lattice<t_real>& recip = peaks.recip;
+	const tl::Plane<t_real>& plane = peaks.plane;
+	tl::Brillouin2D<t_real>& bz = *peaks.pbz;
+	tl::Brillouin3D<t_real>& bz3 = *peaks.pbz3;
 
 	tl::Powder<int, t_real_glob> powder;
-	powder.SetRecipLattice(&m_recip);
+	powder.SetRecipLattice(&recip);
 
-	m_bz.SetEpsilon(g_dEps);
-	m_bz.SetMaxNN(g_iMaxNN);
-	m_bz3.SetEpsilon(g_dEps);
-	m_bz3.SetMaxNN(g_iMaxNN);
+	bz.SetEpsilon(g_dEps);
+	bz.SetMaxNN(g_iMaxNN);
+	bz3.SetEpsilon(g_dEps);
+	bz3.SetMaxNN(g_iMaxNN);
 
 	// -------------------------------------------------------------------------
 	// central peak for BZ calculation
@@ -1025,171 +1069,191 @@ void ScatteringTriangle::CalcPeaks(const xtl::LatticeCommon<t_real>& recipcommon
 	// -------------------------------------------------------------------------
 
 
-	static const std::string strAA = tl::get_spec_char_utf8("AA") +
-		tl::get_spec_char_utf8("sup-") +
-		tl::get_spec_char_utf8("sup1");
-	static const std::string strSup2 = tl::get_spec_char_utf8("sup2");
-
-	static const QColor colPeakAllowed = Qt::red;
-	static const QColor colPeakForbidden(0xaa, 0xaa, 0xaa);
-	static const QColor colPeakOrigin = Qt::darkGreen;
-
 	std::list<std::vector<t_real>> lstPeaksForKd;
 	t_real dMinF = std::numeric_limits<t_real>::max(), dMaxF = -1.;
 
 	const int iMaxNN = g_iMaxNN <= 4 ? 2 : g_iMaxNN-2;	// TODO
+	const int iMaxPeaks = bIsPowder ? iMaxPeaksSetting/2 : iMaxPeaksSetting;
+
+	// -------------------------------------------------------------------------
+	// peaks for 3d calculation of 1st BZ
+	if(!bIsPowder && g_b3dBZ)
+	{
+		for(int ih=std::max(veciCent[0]-iMaxNN, -iMaxPeaks); ih<=std::min(veciCent[0]+iMaxNN, iMaxPeaks); ++ih)
+		for(int ik=std::max(veciCent[1]-iMaxNN, -iMaxPeaks); ik<=std::min(veciCent[1]+iMaxNN, iMaxPeaks); ++ik)
+		for(int il=std::max(veciCent[2]-iMaxNN, -iMaxPeaks); il<=std::min(veciCent[2]+iMaxNN, iMaxPeaks); ++il)
+		{
+			if(recipcommon.pSpaceGroup && !recipcommon.pSpaceGroup->HasGenReflection(ih, ik, il))
+				continue;
+
+			const t_vec vecPeakHKL = tl::make_vec<t_vec>({t_real(ih), t_real(ik), t_real(il)});
+			const t_vec vecPeak = recip.GetPos(vecPeakHKL[0], vecPeakHKL[1], vecPeakHKL[2]);
+
+			if(ih==veciCent[0] && ik==veciCent[1] && il==veciCent[2])
+				bz3.SetCentralReflex(vecPeak, &vecPeakHKL);
+			else
+				bz3.AddReflex(vecPeak, &vecPeakHKL);
+		}
+	}
+	// -------------------------------------------------------------------------
+
+
+	// -------------------------------------------------------------------------
+	// the distance of a peak to the scattering plane is linear in (h, k, l):
+	// dDist = dDist0 + sum_i dDistHKL[i]*hkl[i]
+	t_vec vecNorm = plane.GetNorm();
+	vecNorm /= ublas::norm_2(vecNorm);
+	const t_real dDist0 = -ublas::inner_prod(vecNorm,
+		plane.GetDroppedPerp(tl::make_vec<t_vec>({0., 0., 0.})));
+
+	t_real dDistHKL[3];
+	t_real dCellDiag = 0.;
+	for(int i=0; i<3; ++i)
+	{
+		t_vec vecHKL = tl::make_vec<t_vec>({0., 0., 0.});
+		vecHKL[i] = 1.;
+		const t_vec vecAxis = recip.GetPos(vecHKL[0], vecHKL[1], vecHKL[2]);
+
+		dDistHKL[i] = ublas::inner_prod(vecNorm, vecAxis);
+		dCellDiag += ublas::norm_2(vecAxis);
+	}
+
+	// single crystal: only visit the lattice layers near the plane, i.e. the
+	// peaks in the plane and the ones which can be nearest to a point in the plane
+	// (the kd tree is only queried for positions in the plane).
+	// any point is at most half the longest cell diagonal away from a lattice point.
+	// powder: visit all peaks.
+	const t_real dSlab = std::max(dPlaneDistTolerance, 0.5*dCellDiag);
+
+	// the inner loop runs along the axis that is steepest w.r.t. the plane
+	int iInner = 2;
+	if(!bIsPowder)
+	{
+		for(int i=0; i<3; ++i)
+			if(std::abs(dDistHKL[i]) > std::abs(dDistHKL[iInner]))
+				iInner = i;
+	}
+	const int iOuter0 = iInner==0 ? 1 : 0;
+	const int iOuter1 = iInner==2 ? 1 : 2;
+	// -------------------------------------------------------------------------
+
+
 	// iterate over all bragg peaks
-	const int iMaxPeaks = bIsPowder ? m_iMaxPeaks/2 : m_iMaxPeaks;
-	for(int ih=-iMaxPeaks; ih<=iMaxPeaks; ++ih)
-		for(int ik=-iMaxPeaks; ik<=iMaxPeaks; ++ik)
-			for(int il=-iMaxPeaks; il<=iMaxPeaks; ++il)
-			{
-				const t_real h=t_real(ih); const t_real k=t_real(ik); const t_real l=t_real(il);
-				const t_vec vecPeakHKL = tl::make_vec<t_vec>({h,k,l});
+	int iHKL[3];
+	for(iHKL[iOuter0]=-iMaxPeaks; iHKL[iOuter0]<=iMaxPeaks; ++iHKL[iOuter0])
+	for(iHKL[iOuter1]=-iMaxPeaks; iHKL[iOuter1]<=iMaxPeaks; ++iHKL[iOuter1])
+	{
+		if(pStop && pStop->load())
+			return nullptr;
 
-				bool bHasRefl = 1;
-				bool bHasGenRefl = 1;
+		int iInnerMin = -iMaxPeaks, iInnerMax = iMaxPeaks;
+		if(!bIsPowder)
+		{
+			const t_real dDistOuter = dDist0 + dDistHKL[iOuter0]*t_real(iHKL[iOuter0]) +
+				dDistHKL[iOuter1]*t_real(iHKL[iOuter1]);
+			const t_real dInner0 = (-dSlab - dDistOuter) / dDistHKL[iInner];
+			const t_real dInner1 = (dSlab - dDistOuter) / dDistHKL[iInner];
 
-				if(recipcommon.pSpaceGroup)
-				{
-					bHasRefl = recipcommon.pSpaceGroup->HasReflection(ih, ik, il);
-					bHasGenRefl = recipcommon.pSpaceGroup->HasGenReflection(ih, ik, il);
-				}
+			iInnerMin = std::max(iInnerMin, int(std::floor(std::min(dInner0, dInner1))));
+			iInnerMax = std::min(iInnerMax, int(std::ceil(std::max(dInner0, dInner1))));
+		}
 
-				if(!bHasGenRefl)
-					continue;
+		for(iHKL[iInner]=iInnerMin; iHKL[iInner]<=iInnerMax; ++iHKL[iInner])
+		{
+			const int ih = iHKL[0], ik = iHKL[1], il = iHKL[2];
+			const t_real h=t_real(ih); const t_real k=t_real(ik); const t_real l=t_real(il);
 
-				t_vec vecPeak = m_recip.GetPos(h,k,l);
-				//t_vec vecPeak = matB * tl::make_vec({h,k,l});
-				//const t_real dG = ublas::norm_2(vecPeak);
+			if(recipcommon.pSpaceGroup && !recipcommon.pSpaceGroup->HasGenReflection(ih, ik, il))
+				continue;
 
+			t_vec vecPeak = recip.GetPos(h,k,l);
 
-				// add peak in 1/A and rlu units (only 1/A vectors are used for kd calculation)
+			// add peak in 1/A and rlu units (only 1/A vectors are used for kd calculation)
+			if(!bIsPowder)
+			{
 				lstPeaksForKd.push_back(std::vector<t_real>
 					{ vecPeak[0],vecPeak[1],vecPeak[2], h,k,l/*, dF*/ });
+			}
 
-				// add peaks for 3d calculation of 1st BZ
-				if(g_b3dBZ && bHasGenRefl)
-				{
-					if(ih==veciCent[0] && ik==veciCent[1] && il==veciCent[2])
-						m_bz3.SetCentralReflex(vecPeak, &vecPeakHKL);
-					else if(std::abs(ih-veciCent[0]) <= iMaxNN &&
-						std::abs(ik-veciCent[1]) <= iMaxNN &&
-						std::abs(il-veciCent[2]) <= iMaxNN)
-						m_bz3.AddReflex(vecPeak, &vecPeakHKL);
-				}
+			t_real dDist = 0.;
+			t_vec vecDropped = plane.GetDroppedPerp(vecPeak, &dDist);
+			bool bInPlane = tl::float_equal<t_real>(dDist, 0., dPlaneDistTolerance);
+			if(!bInPlane && !bIsPowder)
+				continue;
 
-				t_real dDist = 0.;
-				t_vec vecDropped = m_plane.GetDroppedPerp(vecPeak, &dDist);
-				bool bInPlane = tl::float_equal<t_real>(dDist, 0., m_dPlaneDistTolerance);
+			bool bHasRefl = 1;
+			if(recipcommon.pSpaceGroup)
+				bHasRefl = recipcommon.pSpaceGroup->HasReflection(ih, ik, il);
 
-				// --------------------------------------------------------------------
-				// structure factors
-				std::complex<t_real> cF(-1., -1.);
-				t_real dF = -1., dFsq = -1.;
+			// --------------------------------------------------------------------
+			// structure factors, only needed for peaks in the plane or for powder lines
+			std::complex<t_real> cF(-1., -1.);
+			t_real dF = -1., dFsq = -1.;
 
-				if(bHasRefl && recipcommon.CanCalcStructFact() && (bInPlane || bIsPowder))
-				{
-					std::tie(cF, dF, dFsq) =
-						recipcommon.GetStructFact(vecPeak);
+			if(bHasRefl && recipcommon.CanCalcStructFact())
+			{
+				std::tie(cF, dF, dFsq) =
+					recipcommon.GetStructFact(vecPeak);
 
-					//dFsq *= tl::lorentz_factor(dAngle);
-					tl::set_eps_0(dFsq, g_dEpsGfx);
+				//dFsq *= tl::lorentz_factor(dAngle);
+				tl::set_eps_0(dFsq, g_dEpsGfx);
 
-					tl::set_eps_0(dF, g_dEpsGfx);
-					dMinF = std::min(dF, dMinF);
-					dMaxF = std::max(dF, dMaxF);
-				}
-				// --------------------------------------------------------------------
+				tl::set_eps_0(dF, g_dEpsGfx);
+				dMinF = std::min(dF, dMinF);
+				dMaxF = std::max(dF, dMaxF);
+			}
+			// --------------------------------------------------------------------
 
-				t_vec vecCoord = ublas::prod(m_matPlane_inv, vecDropped);
+			// in scattering plane?
+			// (000), i.e. direct beam, also needed for powder
+			if(bInPlane && (!bIsPowder || (ih==0 && ik==0 && il==0)))
+			{
+				t_vec vecCoord = ublas::prod(peaks.matPlane_inv, vecDropped);
 				t_real dX = vecCoord[0];
 				t_real dY = -vecCoord[1];
 
-				// in scattering plane?
-				if(bInPlane)
+				if(bHasRefl || bShowAllPeaks)
 				{
-					// (000), i.e. direct beam, also needed for powder
-					if(!bIsPowder || (ih==0 && ik==0 && il==0))
+					RecipPeakInfo peak;
+					peak.ih = ih; peak.ik = ik; peak.il = il;
+					peak.dX = dX; peak.dY = dY;
+					peak.bHasRefl = bHasRefl;
+					peak.cF = cF; peak.dF = dF; peak.dFsq = dFsq;
+					peaks.vecPlanePeaks.push_back(peak);
+				}
+
+				// add peaks for 2d approximation of 1st BZ
+				if(!g_b3dBZ)
+				{
+					t_vec vecN = tl::make_vec({dX, dY});
+					if(ih==veciCent[0] && ik==veciCent[1] && il==veciCent[2])
 					{
-						if(bHasRefl || m_bShowAllPeaks)
-						{
-							RecipPeak *pPeak = new RecipPeak();
-							if(ih==0 && ik==0 && il==0)
-								pPeak->SetColor(bHasRefl ? colPeakOrigin : colPeakForbidden);
-							else
-								pPeak->SetColor(bHasRefl ? colPeakAllowed : colPeakForbidden);
-							
-							pPeak->setPos(dX * m_dScaleFactor, dY * m_dScaleFactor);
-							if(dF >= 0.) pPeak->SetRadius(dF);
-							pPeak->setData(TRIANGLE_NODE_TYPE_KEY, NODE_BRAGG);
-
-							std::ostringstream ostrLabel, ostrTip;
-							ostrLabel.precision(g_iPrecGfx);
-							ostrTip.precision(g_iPrec);
-
-							ostrLabel << "(" << ih << " " << ik << " " << il << ")";
-							ostrTip << "G = (" << ih << " " << ik << " " << il << ") rlu";
-
-							tl::set_eps_0(vecPeak, g_dEps);
-							ostrTip << "\nG = (" << vecPeak[0] << ", "
-								<< vecPeak[1] << ", "
-								<< vecPeak[2] << ") " << strAA;
-
-							if(dFsq > -1.)
-							{
-								if(g_bShowFsq)
-									ostrLabel << "\nS = " << dFsq;
-								else
-									ostrLabel << "\nF = " << dF;
-
-								ostrTip << "\nF = " << print_complex<t_real>(cF) << " fm";
-								ostrTip << "\nS = " << dFsq << " fm" << strSup2;
-							}
-							else if(!bHasRefl)
-							{
-								pPeak->SetPeakAllowed(0);
-								ostrTip << "\nStructurally forbidden reflection.";
-							}
-							
-
-							pPeak->SetLabel(ostrLabel.str().c_str());
-
-							//ostrTip << "\ndistance to plane: " << dDist << " " << strAA;
-							pPeak->setToolTip(QString::fromUtf8(ostrTip.str().c_str(), ostrTip.str().length()));
-
-							m_vecPeaks.push_back(pPeak);
-							m_scene.addItem(pPeak);
-						}
-
-
-						// add peaks for 2d approximation of 1st BZ
-						if(!g_b3dBZ && bHasGenRefl)
-						{
-							t_vec vecN = tl::make_vec({dX, dY});
-							if(ih==veciCent[0] && ik==veciCent[1] && il==veciCent[2])
-							{
-								m_bz.SetCentralReflex(vecN, &vecPeakHKL);
-							}
-							else if(std::abs(ih-veciCent[0])<=2 && std::abs(ik-veciCent[1])<=2
-								&& std::abs(il-veciCent[2])<=2)
-							{
-								m_bz.AddReflex(vecN, &vecPeakHKL);
-							}
-						}
+						const t_vec vecPeakHKL = tl::make_vec<t_vec>({h,k,l});
+						bz.SetCentralReflex(vecN, &vecPeakHKL);
+					}
+					else if(std::abs(ih-veciCent[0])<=2 && std::abs(ik-veciCent[1])<=2
+						&& std::abs(il-veciCent[2])<=2)
+					{
+						const t_vec vecPeakHKL = tl::make_vec<t_vec>({h,k,l});
+						bz.AddReflex(vecN, &vecPeakHKL);
 					}
 				}
-
-				if(bIsPowder)
-					powder.AddPeak(ih, ik, il, dF);
 			}
 
+			if(bIsPowder)
+				powder.AddPeak(ih, ik, il, dF);
+		}
+	}
+
 	// single crystal
 	if(!bIsPowder)
 	{
+		if(pStop && pStop->load())
+			return nullptr;
+
 		if(g_b3dBZ)
 		{
-			m_bz3.CalcBZ(get_max_threads());
+			bz3.CalcBZ(get_max_threads());
 
 			// ----------------------------------------------------------------
 			// calculate points of high symmetry
@@ -1205,70 +1269,68 @@ void ScatteringTriangle::CalcPeaks(const xtl::LatticeCommon<t_real>& recipcommon
 
 			for(const t_vec& vecSymmDir : vecSymmDirs)
 			{
-				const t_vec vecSymmDirInvA = m_recip.GetPos(vecSymmDir[0], vecSymmDir[1], vecSymmDir[2]);
-				tl::Line<t_real> lineSymmDir(m_bz3.GetCentralReflex(), vecSymmDirInvA);
-				std::vector<t_vec> vecSymmIntersects = m_bz3.GetIntersection(lineSymmDir);
+				const t_vec vecSymmDirInvA = recip.GetPos(vecSymmDir[0], vecSymmDir[1], vecSymmDir[2]);
+				tl::Line<t_real> lineSymmDir(bz3.GetCentralReflex(), vecSymmDirInvA);
+				std::vector<t_vec> vecSymmIntersects = bz3.GetIntersection(lineSymmDir);
 				for(t_vec& vecSymmIntersect : vecSymmIntersects)
-					m_vecBZ3SymmPts.emplace_back(std::move(vecSymmIntersect));
+					peaks.vecBZ3SymmPts.emplace_back(std::move(vecSymmIntersect));
 			}
 			// ----------------------------------------------------------------
 
 			// ----------------------------------------------------------------
 			// calculate intersection with scattering plane
-			tl::Plane<t_real> planeBZ3 = tl::Plane<t_real>(m_bz3.GetCentralReflex(),
-				m_plane.GetNorm());
+			tl::Plane<t_real> planeBZ3 = tl::Plane<t_real>(bz3.GetCentralReflex(),
+				plane.GetNorm());
 
-			std::tie(std::ignore, m_vecBZ3VertsUnproj) = m_bz3.GetIntersection(planeBZ3);
+			std::tie(std::ignore, peaks.vecBZ3VertsUnproj) = bz3.GetIntersection(planeBZ3);
 
-			for(const t_vec& _vecBZ3Vert : m_vecBZ3VertsUnproj)
+			for(const t_vec& _vecBZ3Vert : peaks.vecBZ3VertsUnproj)
 			{
-				t_vec vecBZ3Vert = ublas::prod(m_matPlane_inv, _vecBZ3Vert - m_bz3.GetCentralReflex());
+				t_vec vecBZ3Vert = ublas::prod(peaks.matPlane_inv, _vecBZ3Vert - bz3.GetCentralReflex());
 				vecBZ3Vert.resize(2, true);
 				vecBZ3Vert[1] = -vecBZ3Vert[1];
 
-				m_vecBZ3Verts.push_back(vecBZ3Vert);
+				peaks.vecBZ3Verts.push_back(vecBZ3Vert);
 			}
 			// ----------------------------------------------------------------
 		}
 		else
 		{
-			m_bz.CalcBZ();
+			bz.CalcBZ();
 		}
 
-		m_kdLattice.Load(lstPeaksForKd, 3);
+		peaks.pkdLattice->Load(lstPeaksForKd, 3);
 	}
 
-	// single crystal peaks
-	if(dMaxF >= 0.)
+	peaks.dMinF = dMinF;
+	peaks.dMaxF = dMaxF;
+
+	if(peaks.vecPlanePeaks.size())
 	{
-		bool bValidStructFacts = !tl::float_equal(dMinF, dMaxF, g_dEpsGfx);
-		for(RecipPeak *pPeak : m_vecPeaks)
+		t_real dXMin = std::numeric_limits<t_real>::max(), dXMax = -dXMin;
+		t_real dYMin = dXMin, dYMax = -dXMin;
+		for(const RecipPeakInfo& peak : peaks.vecPlanePeaks)
 		{
-			if(bValidStructFacts)
-			{
-				t_real dFScale = (pPeak->GetRadius()-dMinF) / (dMaxF-dMinF);
-				pPeak->SetRadius(tl::lerp(MIN_PEAK_SIZE, MAX_PEAK_SIZE, dFScale));
-			}
-			else
-			{
-				pPeak->SetRadius(DEF_PEAK_SIZE);
-			}
+			dXMin = std::min(dXMin, peak.dX); dXMax = std::max(dXMax, peak.dX);
+			dYMin = std::min(dYMin, peak.dY); dYMax = std::max(dYMax, peak.dY);
 		}
+
+		peaks.rectLattice = QRectF(QPointF(dXMin, dYMin), QPointF(dXMax, dYMax));
 	}
 
 	// powder lines
 	if(bIsPowder)
 	{
 		using t_line = typename decltype(powder)::t_peak;
-		m_vecPowderLines = powder.GetUniquePeaksSumF();
-		m_vecPowderLineWidths.reserve(m_vecPowderLines.size());
+		peaks.vecPowderLines = powder.GetUniquePeaksSumF();
+		peaks.vecPowderLineWidths.reserve(peaks.vecPowderLines.size());
 
 		t_real dMinFLine = 0.;
 		t_real dMaxFLine = 0.;
 
 		if(dMaxF >= 0.)
 		{
-			auto minmaxiters = std::minmax_element(m_vecPowderLines.begin(), m_vecPowderLines.end(),
+			auto minmaxiters = std::minmax_element(peaks.vecPowderLines.begin(), peaks.vecPowderLines.end(),
 				[](const t_line& line1, const t_line& line2) -> bool
 				{
 					return std::get<4>(line1) < std::get<4>(line2);
@@ -1278,25 +1340,223 @@ void ScatteringTriangle::CalcPeaks(const xtl::LatticeCommon<t_real>& recipcommon
 		}
 
 		bool bValidStructFacts = !tl::float_equal(dMinFLine, dMaxFLine, g_dEpsGfx);
-		for(t_line& line : m_vecPowderLines)
+		for(t_line& line : peaks.vecPowderLines)
 		{
 			if(bValidStructFacts)
 			{
 				t_real dFScale = (std::get<4>(line)-dMinFLine) / (dMaxFLine-dMinFLine);
-				m_vecPowderLineWidths.push_back(tl::lerp(MIN_PEAK_SIZE, MAX_PEAK_SIZE, dFScale));
+				peaks.vecPowderLineWidths.push_back(tl::lerp(MIN_PEAK_SIZE, MAX_PEAK_SIZE, dFScale));
 			}
 			else
 			{
-				m_vecPowderLineWidths.push_back(1.);
+				peaks.vecPowderLineWidths.push_back(1.);
 			}
 		}
 	}
 
+	return pPeaks;
+}
+
+
+/**
+ * swaps in the results of CalcRecipPeaks
+ */
+void ScatteringTriangle::SetPeaks(std::unique_ptr<RecipPeaks> pPeaks)
+{
+	ClearPeaks();
+	if(!pPeaks)
+	{
+		this->update();
+		return;
+	}
+
+	m_lattice = std::move(pPeaks->lattice);
+	m_recip = std::move(pPeaks->recip);
+	m_plane = std::move(pPeaks->plane);
+	m_matPlane = std::move(pPeaks->matPlane);
+	m_matPlaneRlu = std::move(pPeaks->matPlaneRlu);
+	m_matPlane_inv = std::move(pPeaks->matPlane_inv);
+
+	m_vecPlanePeaks = std::move(pPeaks->vecPlanePeaks);
+	m_dMinF = pPeaks->dMinF;
+	m_dMaxF = pPeaks->dMaxF;
+
+	m_vecPowderLines = std::move(pPeaks->vecPowderLines);
+	m_vecPowderLineWidths = std::move(pPeaks->vecPowderLineWidths);
+
+	std::swap(m_pkdLattice, pPeaks->pkdLattice);
+	std::swap(m_pbz, pPeaks->pbz);
+	std::swap(m_pbz3, pPeaks->pbz3);
+	m_vecBZ3VertsUnproj = std::move(pPeaks->vecBZ3VertsUnproj);
+	m_vecBZ3Verts = std::move(pPeaks->vecBZ3Verts);
+	m_vecBZ3SymmPts = std::move(pPeaks->vecBZ3SymmPts);
+
+	// the graphics items are only created near the visible region
+	prepareGeometryChange();
+	if(m_vecPlanePeaks.size())
+	{
+		m_rectLattice = QRectF(pPeaks->rectLattice.topLeft() * m_dScaleFactor,
+			pPeaks->rectLattice.bottomRight() * m_dScaleFactor);
+	}
+	UpdatePeakItems();
+
 	m_scene.emitAllParams();
 	this->update();
 }
 
 
+/**
+ * creates the graphics items of the in-plane peaks near the visible region
+ * and recycles the ones of the peaks which are no longer near it
+ */
+void ScatteringTriangle::UpdatePeakItems()
+{
+	QRectF rectPeaks;
+	if(!m_rectVisible.isNull())
+	{
+		// keep a margin of half the visible region around it, so that
+		// small scrolling or zooming does not need any new items
+		const t_real dMargin = 0.5 * std::max(m_rectVisible.width(), m_rectVisible.height());
+		rectPeaks = m_rectVisible.adjusted(-dMargin, -dMargin, dMargin, dMargin);
+	}
+
+	auto is_near = [this, &rectPeaks](const RecipPeakInfo& peak) -> bool
+	{
+		return rectPeaks.isNull() ||
+			rectPeaks.contains(peak.dX*m_dScaleFactor, peak.dY*m_dScaleFactor);
+	};
+
+	// first release the items which are not needed anymore...
+	for(RecipPeakInfo& peak : m_vecPlanePeaks)
+	{
+		if(peak.pItem && !is_near(peak))
+		{
+			peak.pItem->setVisible(0);
+			m_vecUnusedPeaks.push_back(peak.pItem);
+			peak.pItem = nullptr;
+		}
+	}
+
+	// ...then assign them to the newly visible peaks
+	for(RecipPeakInfo& peak : m_vecPlanePeaks)
+	{
+		if(peak.pItem || !is_near(peak))
+			continue;
+
+		if(m_vecUnusedPeaks.size())
+		{
+			peak.pItem = m_vecUnusedPeaks.back();
+			m_vecUnusedPeaks.pop_back();
+		}
+		else
+		{
+			peak.pItem = new RecipPeak();
+			peak.pItem->setData(TRIANGLE_NODE_TYPE_KEY, NODE_BRAGG);
+			m_vecPeaks.push_back(peak.pItem);
+			m_scene.addItem(peak.pItem);
+		}
+
+		SetupPeakItem(peak);
+	}
+
+	m_rectPeaks = rectPeaks;
+}
+
+
+void ScatteringTriangle::SetupPeakItem(RecipPeakInfo& peak)
+{
+	static const std::string strAA = tl::get_spec_char_utf8("AA") +
+		tl::get_spec_char_utf8("sup-") +
+		tl::get_spec_char_utf8("sup1");
+	static const std::string strSup2 = tl::get_spec_char_utf8("sup2");
+
+	static const QColor colPeakAllowed = Qt::red;
+	static const QColor colPeakForbidden(0xaa, 0xaa, 0xaa);
+	static const QColor colPeakOrigin = Qt::darkGreen;
+
+	RecipPeak *pPeak = peak.pItem;
+	const int ih = peak.ih, ik = peak.ik, il = peak.il;
+
+	if(ih==0 && ik==0 && il==0)
+		pPeak->SetColor(peak.bHasRefl ? colPeakOrigin : colPeakForbidden);
+	else
+		pPeak->SetColor(peak.bHasRefl ? colPeakAllowed : colPeakForbidden);
+
+	pPeak->setPos(peak.dX * m_dScaleFactor, peak.dY * m_dScaleFactor);
+
+	// scale the radius to the range of the structure factors
+	t_real dRadius = peak.dF >= 0. ? peak.dF : DEF_PEAK_SIZE;
+	if(m_dMaxF >= 0.)
+	{
+		if(!tl::float_equal(m_dMinF, m_dMaxF, g_dEpsGfx))
+		{
+			t_real dFScale = (dRadius-m_dMinF) / (m_dMaxF-m_dMinF);
+			dRadius = tl::lerp(MIN_PEAK_SIZE, MAX_PEAK_SIZE, dFScale);
+		}
+		else
+		{
+			dRadius = DEF_PEAK_SIZE;
+		}
+	}
+	pPeak->SetRadius(dRadius);
+
+	std::ostringstream ostrLabel, ostrTip;
+	ostrLabel.precision(g_iPrecGfx);
+	ostrTip.precision(g_iPrec);
+
+	ostrLabel << "(" << ih << " " << ik << " " << il << ")";
+	ostrTip << "G = (" << ih << " " << ik << " " << il << ") rlu";
+
+	t_vec vecPeak = m_recip.GetPos(t_real(ih), t_real(ik), t_real(il));
+	tl::set_eps_0(vecPeak, g_dEps);
+	ostrTip << "\nG = (" << vecPeak[0] << ", "
+		<< vecPeak[1] << ", "
+		<< vecPeak[2] << ") " << strAA;
+
+	pPeak->SetPeakAllowed(1);
+	if(peak.dFsq > -1.)
+	{
+		if(g_bShowFsq)
+			ostrLabel << "\nS = " << peak.dFsq;
+		else
+			ostrLabel << "\nF = " << peak.dF;
+
+		ostrTip << "\nF = " << print_complex<t_real>(peak.cF) << " fm";
+		ostrTip << "\nS = " << peak.dFsq << " fm" << strSup2;
+	}
+	else if(!peak.bHasRefl)
+	{
+		pPeak->SetPeakAllowed(0);
+		ostrTip << "\nStructurally forbidden reflection.";
+	}
+
+	pPeak->SetLabel(ostrLabel.str().c_str());
+
+	//ostrTip << "\ndistance to plane: " << dDist << " " << strAA;
+	pPeak->setToolTip(QString::fromUtf8(ostrTip.str().c_str(), ostrTip.str().length()));
+	pPeak->setVisible(1);
+	pPeak->update();
+}
+
+
+/**
+ * sets the visible scene region, the peak items are only updated
+ * if it leaves the region they already cover
+ */
+void ScatteringTriangle::SetVisibleRect(const QRectF& rect)
+{
+	m_rectVisible = rect;
+
+	if(rect.isNull() && m_rectPeaks.isNull())
+		return;
+	if(!rect.isNull() && !m_rectPeaks.isNull() && m_rectPeaks.contains(rect))
+		return;
+
+	UpdatePeakItems();
+	this->update();
+}
+
+
 t_vec ScatteringTriangle::GetHKLFromPlanePos(t_real x, t_real y) const
 {
 	if(!HasPeaks())
@@ -1363,22 +1623,29 @@ t_vec ScatteringTriangle::GetKfVecPlane() const
 
 void ScatteringTriangle::ClearPeaks()
 {
-	m_bz.Clear();
-	m_bz3.Clear();
+	m_pbz->Clear();
+	m_pbz3->Clear();
+	m_pkdLattice->Unload();
+	m_vecPowderLines.clear();
+	m_vecPowderLineWidths.clear();
 	m_vecBZ3VertsUnproj.clear();
 	m_vecBZ3Verts.clear();
 	m_vecBZ3SymmPts.clear();
 
-	for(RecipPeak*& pPeak : m_vecPeaks)
+	// keep the graphics items for the next peaks
+	for(RecipPeakInfo& peak : m_vecPlanePeaks)
 	{
-		if(pPeak)
+		if(peak.pItem)
 		{
-			m_scene.removeItem(pPeak);
-			delete pPeak;
-			pPeak = 0;
+			peak.pItem->setVisible(0);
+			m_vecUnusedPeaks.push_back(peak.pItem);
 		}
 	}
-	m_vecPeaks.clear();
+	m_vecPlanePeaks.clear();
+	m_rectPeaks = QRectF();
+
+	prepareGeometryChange();
+	m_rectLattice = QRectF();
 }
 
 
@@ -1437,7 +1704,8 @@ get_nearest_node(const QPointF& pt,
 	for(int iNode=0; iNode<nodes.size(); ++iNode)
 	{
 		const QGraphicsItem *pNode = nodes[iNode];
-		if(pNode == pCurItem || pNode->data(TRIANGLE_NODE_TYPE_KEY)!=NODE_BRAGG)
+		if(pNode == pCurItem || pNode->data(TRIANGLE_NODE_TYPE_KEY)!=NODE_BRAGG ||
+			!pNode->isVisible())
 			continue;
 
 		t_real dLen = QLineF(pt, pNode->scenePos()).length();
@@ -1814,6 +2082,13 @@ void ScatteringTriangleScene::scaleChanged(t_real dTotalScale)
 }
 
 
+void ScatteringTriangleScene::visibleRectChanged(const QRectF& rect)
+{
+	if(!m_pTri) return;
+	m_pTri->SetVisibleRect(rect);
+}
+
+
 void ScatteringTriangleScene::mousePressEvent(QGraphicsSceneMouseEvent *pEvt)
 {
 	m_bMousePressed = 1;
@@ -2073,6 +2348,27 @@ void ScatteringTriangleView::DoZoom(t_real_glob dDelta)
 
 	m_dTotalScale *= dScale;
 	emit scaleChanged(m_dTotalScale);
+	EmitVisibleRect();
+}
+
+
+void ScatteringTriangleView::EmitVisibleRect()
+{
+	emit visibleRectChanged(mapToScene(viewport()->rect()).boundingRect());
+}
+
+
+void ScatteringTriangleView::resizeEvent(QResizeEvent *pEvt)
+{
+	QGraphicsView::resizeEvent(pEvt);
+	EmitVisibleRect();
+}
+
+
+void ScatteringTriangleView::scrollContentsBy(int iDx, int iDy)
+{
+	QGraphicsView::scrollContentsBy(iDx, iDy);
+	EmitVisibleRect();
 }
 
 
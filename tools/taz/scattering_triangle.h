@@ -9,6 +9,8 @@
 #define __TAZ_SCATT_TRIAG_H__
 
 #include <memory>
+#include <complex>
+#include <atomic>
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QGraphicsItem>
@@ -104,6 +106,49 @@ class RecipPeak : public QGraphicsItem
 };
 
 
+/**
+ * bragg peak in the scattering plane,
+ * its graphics item only exists while the peak is near the visible region
+ */
+struct RecipPeakInfo
+{
+	int ih = 0, ik = 0, il = 0;
+	t_real_glob dX = 0., dY = 0.;		// position in the plane in 1/A
+
+	bool bHasRefl = 1;
+	std::complex<t_real_glob> cF{-1., -1.};
+	t_real_glob dF = -1., dFsq = -1.;
+
+	RecipPeak *pItem = nullptr;
+};
+
+
+/**
+ * peaks, BZs and powder lines of a reciprocal lattice,
+ * they are calculated without the scene, e.g. in a background thread
+ * @see ScatteringTriangle::CalcRecipPeaks
+ */
+struct RecipPeaks
+{
+	tl::Lattice<t_real_glob> lattice, recip;
+	ublas::matrix<t_real_glob> matPlane, matPlaneRlu, matPlane_inv;
+	tl::Plane<t_real_glob> plane;
+
+	std::vector<RecipPeakInfo> vecPlanePeaks;
+	t_real_glob dMinF = -1., dMaxF = -1.;
+	QRectF rectLattice;			// extent of the in-plane peaks in 1/A
+
+	std::vector<typename tl::Powder<int,t_real_glob>::t_peak> vecPowderLines;
+	std::vector<t_real_glob> vecPowderLineWidths;
+
+	std::unique_ptr<tl::Kd<t_real_glob>> pkdLattice;
+	std::unique_ptr<tl::Brillouin2D<t_real_glob>> pbz;
+	std::unique_ptr<tl::Brillouin3D<t_real_glob>> pbz3;
+	std::vector<ublas::vector<t_real_glob>> vecBZ3VertsUnproj, vecBZ3Verts;
+	std::vector<ublas::vector<t_real_glob>> vecBZ3SymmPts;
+};
+
+
 class ScatteringTriangleScene;
 class ScatteringTriangle : public QGraphicsItem
 {
@@ -126,15 +171,23 @@ class ScatteringTriangle : public QGraphicsItem
 		tl::Lattice<t_real_glob> m_lattice, m_recip;
 		ublas::matrix<t_real_glob> m_matPlane, m_matPlaneRlu, m_matPlane_inv;
 		tl::Plane<t_real_glob> m_plane;
-		std::vector<RecipPeak*> m_vecPeaks;
+
+		std::vector<RecipPeakInfo> m_vecPlanePeaks;
+		t_real_glob m_dMinF = -1., m_dMaxF = -1.;
+		QRectF m_rectLattice;			// extent of the in-plane peaks
+
+		// graphics items of the peaks, unused ones are hidden and recycled
+		std::vector<RecipPeak*> m_vecPeaks, m_vecUnusedPeaks;
+		QRectF m_rectVisible;			// visible scene region, null: everything
+		QRectF m_rectPeaks;			// region covered by the peak items, null: everything
 
 		std::vector<t_powderline> m_vecPowderLines;
 		std::vector<t_real_glob> m_vecPowderLineWidths;
-		tl::Kd<t_real_glob> m_kdLattice;
+		std::unique_ptr<tl::Kd<t_real_glob>> m_pkdLattice{new tl::Kd<t_real_glob>()};
 
 		bool m_bShowBZ = 1;
-		tl::Brillouin2D<t_real_glob> m_bz;
-		tl::Brillouin3D<t_real_glob> m_bz3;
+		std::unique_ptr<tl::Brillouin2D<t_real_glob>> m_pbz{new tl::Brillouin2D<t_real_glob>()};
+		std::unique_ptr<tl::Brillouin3D<t_real_glob>> m_pbz3{new tl::Brillouin3D<t_real_glob>()};
 		std::vector<ublas::vector<t_real_glob>> m_vecBZ3VertsUnproj, m_vecBZ3Verts;
 		std::vector<ublas::vector<t_real_glob>> m_vecBZ3SymmPts;
 
@@ -147,6 +200,9 @@ class ScatteringTriangle : public QGraphicsItem
 	protected:
 		virtual QRectF boundingRect() const override;
 
+		void UpdatePeakItems();
+		void SetupPeakItem(RecipPeakInfo& peak);
+
 	public:
 		ScatteringTriangle(ScatteringTriangleScene& scene);
 		virtual ~ScatteringTriangle();
@@ -179,11 +235,21 @@ class ScatteringTriangle : public QGraphicsItem
 		void SetMonoTwoTheta(t_real_glob dTT, t_real_glob dMonoD);
 
 	public:
-		bool HasPeaks() const { return m_vecPeaks.size()!=0 && m_recip.IsInited(); }
+		bool HasPeaks() const { return m_vecPlanePeaks.size()!=0 && m_recip.IsInited(); }
 		void ClearPeaks();
 		void CalcPeaks(const xtl::LatticeCommon<t_real_glob>& recipcommon, bool bIsPowder=0);
 
+		static std::unique_ptr<RecipPeaks> CalcRecipPeaks(
+			const xtl::LatticeCommon<t_real_glob>& recipcommon, bool bIsPowder,
+			int iMaxPeaks, t_real_glob dPlaneDistTolerance, bool bShowAllPeaks,
+			const std::atomic<bool>* pStop = nullptr);
+		void SetPeaks(std::unique_ptr<RecipPeaks> pPeaks);
+
+		void SetVisibleRect(const QRectF& rect);
+		const QRectF& GetVisibleRect() const { return m_rectVisible; }
+
 		void SetPlaneDistTolerance(t_real_glob dTol) { m_dPlaneDistTolerance = dTol; }
+		t_real_glob GetPlaneDistTolerance() const { return m_dPlaneDistTolerance; }
 		void SetMaxPeaks(int iMax) { m_iMaxPeaks = iMax; }
 		unsigned int GetMaxPeaks() const { return m_iMaxPeaks; }
 		void SetZoom(t_real_glob dZoom);
@@ -193,12 +259,13 @@ class ScatteringTriangle : public QGraphicsItem
 		void SetCoordAxesVisible(bool bVisible);
 		void SetBZVisible(bool bVisible);
 		void SetAllPeaksVisible(bool bVisible);
+		bool GetAllPeaksVisible() const { return m_bShowAllPeaks; }
 		void SetEwaldSphereVisible(EwaldSphere iEw);
 
 		const std::vector<t_powderline>& GetPowder() const { return m_vecPowderLines; }
-		const tl::Kd<t_real_glob>& GetKdLattice() const { return m_kdLattice; }
+		const tl::Kd<t_real_glob>& GetKdLattice() const { return *m_pkdLattice; }
 
-		const tl::Brillouin3D<t_real_glob>& GetBZ3D() const { return m_bz3; }
+		const tl::Brillouin3D<t_real_glob>& GetBZ3D() const { return *m_pbz3; }
 		const std::vector<ublas::vector<t_real_glob>>& GetBZ3DPlaneVerts() const { return m_vecBZ3VertsUnproj; }
 		const std::vector<ublas::vector<t_real_glob>>& GetBZ3DSymmVerts() const { return m_vecBZ3SymmPts; }
 
@@ -277,6 +344,7 @@ class ScatteringTriangleScene : public QGraphicsScene
 	public slots:
 		void tasChanged(const TriangleOptions& opts);
 		void scaleChanged(t_real_glob dTotalScale);
+		void visibleRectChanged(const QRectF& rect);
 
 		void setSnapq(bool bSnap);
 		bool getSnapq() const { return m_bSnapq; }
@@ -319,7 +387,11 @@ class ScatteringTriangleView : public QGraphicsView
 		t_real_glob m_dTotalScale = 1.;
 
 		void DoZoom(t_real_glob delta);
+		void EmitVisibleRect();
+
 		virtual void wheelEvent(QWheelEvent* pEvt) override;
+		virtual void resizeEvent(QResizeEvent *pEvt) override;
+		virtual void scrollContentsBy(int iDx, int iDy) override;
 		virtual void keyPressEvent(QKeyEvent *pEvt) override;
 		virtual void keyReleaseEvent(QKeyEvent *pEvt) override;
 		virtual bool event(QEvent *pEvt) override;
@@ -330,6 +402,7 @@ class ScatteringTriangleView : public QGraphicsView
 
 	signals:
 		void scaleChanged(t_real_glob dTotalScale);
+		void visibleRectChanged(const QRectF& rect);
 };
 
 #endif
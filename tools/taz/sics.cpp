@@ -12,6 +12,7 @@
 #include "tlibs/time/chrono.h"
 #include "libs/globals.h"
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 
 using t_real = t_real_glob;
 
@@ -88,12 +89,28 @@ SicsCache::SicsCache(QSettings* pSettings) : m_pSettings(pSettings)
 		m_strYDat
 	});
 
-	m_strAllKeys = "pr ";
+	// motors which can be moving during a scan
+	m_vecInterestKeys = std::vector<std::string>
+	({
+		m_strSampleTheta, m_strSample2Theta,
+		m_strMonoTheta, m_strMono2Theta,
+		m_strAnaTheta, m_strAna2Theta,
+	});
+
 	for(const std::string& strKey : vecKeys)
-		m_strAllKeys += strKey + " ";
-	m_strAllKeys += "\n";
+	{
+		if(strKey == "") continue;
+		m_vecPollKeys.push_back(strKey);
+		m_mapPollKeys[strKey] = SicsPollKey();
+	}
 	for(const std::string& strKey : vecKeysLine)
-		m_strAllKeys += strKey + "\n";
+		m_strLineKeys += strKey + "\n";
+	for(const std::string& strKey : m_vecInterestKeys)
+	{
+		auto iter = m_mapPollKeys.find(strKey);
+		if(iter != m_mapPollKeys.end())
+			iter->second.bInterest = 1;
+	}
 
 	m_tcp.add_connect(boost::bind(&SicsCache::slot_connected, this, _1, _2));
 	m_tcp.add_disconnect(boost::bind(&SicsCache::slot_disconnected, this, _1, _2));
@@ -110,6 +127,10 @@ void SicsCache::connect(const std::string& strHost, const std::string& strPort,
 {
 	if(m_pSettings && m_pSettings->contains("net/poll"))
 		m_iPollRate = m_pSettings->value("net/poll").value<unsigned int>();
+	if(m_pSettings && m_pSettings->contains("net/poll_max_interval"))
+		m_iMaxPollInterval = std::max(1u, m_pSettings->value("net/poll_max_interval").value<unsigned int>());
+	if(m_pSettings)
+		m_bUseInterest = m_pSettings->value("net/sics_interest", true).toBool();
 
 	refresh();
 	m_mapCache.clear();
@@ -141,6 +162,83 @@ void SicsCache::refresh()
 	m_mapCache.clear();
 	m_triagCache.clear();
 	m_crysCache.clear();
+
+	// query everything again
+	std::lock_guard<std::mutex> lock(m_mtxPoll);
+	for(auto& pair : m_mapPollKeys)
+	{
+		const bool bInterest = pair.second.bInterest;
+		const bool bSubscribed = pair.second.bSubscribed;
+		pair.second = SicsPollKey();
+		pair.second.bInterest = bInterest;
+		pair.second.bSubscribed = bSubscribed;
+	}
+}
+
+/**
+ * "pr" query for all devices whose polling interval has passed
+ */
+std::string SicsCache::get_due_keys(unsigned long iTick)
+{
+	std::string strKeys;
+
+	std::lock_guard<std::mutex> lock(m_mtxPoll);
+	for(const std::string& strKey : m_vecPollKeys)
+	{
+		SicsPollKey& key = m_mapPollKeys[strKey];
+		if(iTick < key.iNextTick)
+			continue;
+
+		strKeys += strKey + " ";
+		key.iNextTick = iTick + key.iInterval;
+	}
+
+	if(strKeys == "")
+		return "";
+	return "pr " + strKeys + "\n";
+}
+
+/**
+ * adapts the polling interval of a device to how often it changes
+ * @return false if the value is the same as before
+ */
+bool SicsCache::update_poll_key(const std::string& strKey, const std::string& strVal, bool bPushed)
+{
+	std::lock_guard<std::mutex> lock(m_mtxPoll);
+	auto iter = m_mapPollKeys.find(strKey);
+	if(iter == m_mapPollKeys.end())
+		return true;
+
+	SicsPollKey& key = iter->second;
+	const bool bChanged = (key.strLastVal != strVal);
+	key.strLastVal = strVal;
+	if(bPushed)
+		key.bSubscribed = 1;
+
+	if(key.bSubscribed)
+	{
+		// only poll occasionally in case a notification was lost
+		key.iInterval = m_iMaxPollInterval;
+	}
+	else if(bChanged)
+	{
+		// device is moving: poll it again with the next query
+		key.iInterval = 1;
+		key.iNextTick = 0;
+	}
+	else if(key.bInterest)
+	{
+		// motor without a confirmed subscription (e.g. the server does not support
+		// "interest"): keep polling it at the full rate, it may start moving anytime
+		key.iInterval = 1;
+	}
+	else
+	{
+		// device is static: back off
+		key.iInterval = std::min(key.iInterval*2, m_iMaxPollInterval);
+	}
+
+	return bChanged;
 }
 
 void SicsCache::start_poller()
@@ -156,10 +254,25 @@ void SicsCache::start_poller()
 			std::this_thread::sleep_for(std::chrono::milliseconds(200));
 		}
 
-		while(m_bPollerActive.load())
+		// request change notifications for the motors,
+		// servers not supporting this reply with an error, which is ignored;
+		// the motors are then still polled at the full rate, see update_poll_key
+		if(m_bUseInterest)
 		{
-			// query all known keys
-			m_tcp.write(m_strAllKeys);
+			std::string strInterest;
+			for(const std::string& strKey : m_vecInterestKeys)
+			{
+				if(strKey != "")
+					strInterest += strKey + " interest\n";
+			}
+			if(strInterest != "")
+				m_tcp.write(strInterest);
+		}
+
+		for(unsigned long iTick=0; m_bPollerActive.load(); ++iTick)
+		{
+			// query the devices which are due and all per-line keys (counters and scan data)
+			m_tcp.write(get_due_keys(iTick) + m_strLineKeys);
 			std::this_thread::sleep_for(std::chrono::milliseconds(m_iPollRate));
 		}
 	});
@@ -272,12 +385,25 @@ void SicsCache::slot_receive(const std::string& str)
 		return;
 	}
 
-	const std::string strKey = tl::str_to_lower(pairKeyVal.first);
+	std::string strKey = tl::str_to_lower(pairKeyVal.first);
 	const std::string& strVal = pairKeyVal.second;
 
 	if(strVal.length() == 0)
 		return;
 
+	// notification from "<motor> interest" has the form "<motor>.position = <value>"
+	bool bPushed = 0;
+	if(tl::str_contains(strKey, std::string(".position"), 0))
+	{
+		std::string strDev = get_firstword(strKey, std::string("."));
+		if(m_mapPollKeys.find(strDev) != m_mapPollKeys.end())
+		{
+			strKey = strDev;
+			bPushed = 1;
+		}
+	}
+	const bool bChanged = update_poll_key(strKey, strVal, bPushed);
+
 	CacheVal cacheval;
 	cacheval.strVal = tl::str_to_upper(strVal);
 	cacheval.dTimestamp = tl::epoch<t_real>();
@@ -313,8 +439,16 @@ void SicsCache::slot_receive(const std::string& str)
 	m_mapCache[strKey] = cacheval;
 	emit updated_cache_value(strKey, cacheval);
 
-	remove_old_vars();
-	update_live_plot();
+	// only scan data is needed for the live plot
+	if(tl::begins_with(strKey, std::string("scan."), 0) || strKey == m_strYDatReplyKey)
+	{
+		remove_old_vars();
+		update_live_plot();
+	}
+
+	// nothing to recalculate
+	if(!bChanged)
+		return;
 
 	CrystalOptions crys;
 	TriangleOptions triag;
@@ -16,6 +16,26 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
+
+
+/**
+ * polling state of a device
+ */
+struct SicsPollKey
+{
+	// polling interval and next poll in units of the base polling rate
+	unsigned int iInterval = 1;
+	unsigned long iNextTick = 0;
+
+	// last received value
+	std::string strLastVal;
+
+	// change notifications are requested for this device
+	bool bInterest = 0;
+	// the server sends the changes of this device by itself
+	bool bSubscribed = 0;
+};
 
 
 class SicsCache : public NetCache
@@ -24,15 +44,27 @@ class SicsCache : public NetCache
 		QSettings* m_pSettings = 0;
 
 		tl::TcpTxtClient<> m_tcp;
-		std::string m_strAllKeys;
 		t_mapCacheVal m_mapCache;
 
+		// devices which are queried together using "pr"
+		std::vector<std::string> m_vecPollKeys;
+		// queries which have to be sent on separate lines
+		std::string m_strLineKeys;
+		// motors for which change notifications are requested
+		std::vector<std::string> m_vecInterestKeys;
+
+		std::map<std::string, SicsPollKey> m_mapPollKeys;
+		std::mutex m_mtxPoll;
+
 		std::string m_strUser, m_strPass;
 
 		std::atomic<bool> m_bPollerActive;
 		std::thread *m_pthPoller = nullptr;
 
 		unsigned int m_iPollRate = 750;
+		// devices which do not change are polled at most this many times slower
+		unsigned int m_iMaxPollInterval = 16;
+		bool m_bUseInterest = 1;
 
 	protected:
 		// endpoints of the TcpClient signals
@@ -41,6 +73,8 @@ class SicsCache : public NetCache
 		void slot_receive(const std::string& str);
 
 		void start_poller();
+		std::string get_due_keys(unsigned long iTick);
+		bool update_poll_key(const std::string& strKey, const std::string& strVal, bool bPushed);
 
 	protected:
 		void remove_old_vars();
@@ -84,6 +84,33 @@ struct TriangleOptions
 		dTheta = dTwoTheta = dAnaTwoTheta = dMonoTwoTheta =
 			dMonoD = dAnaD = dAngleKiVec0 = t_real_glob(0);
 	}
+
+	/**
+	 * takes over the changed values of a later update
+	 * @return number of changed values which were superseded by op
+	 */
+	unsigned merge(const TriangleOptions& op)
+	{
+		unsigned iSuperseded = 0;
+		auto merge_val = [&iSuperseded](bool& bChanged, t_real_glob& dVal,
+			bool bChangedOp, t_real_glob dValOp)
+		{
+			if(!bChangedOp) return;
+			if(bChanged) ++iSuperseded;
+			bChanged = 1;
+			dVal = dValOp;
+		};
+
+		merge_val(bChangedTheta, dTheta, op.bChangedTheta, op.dTheta);
+		merge_val(bChangedTwoTheta, dTwoTheta, op.bChangedTwoTheta, op.dTwoTheta);
+		merge_val(bChangedAnaTwoTheta, dAnaTwoTheta, op.bChangedAnaTwoTheta, op.dAnaTwoTheta);
+		merge_val(bChangedMonoTwoTheta, dMonoTwoTheta, op.bChangedMonoTwoTheta, op.dMonoTwoTheta);
+		merge_val(bChangedMonoD, dMonoD, op.bChangedMonoD, op.dMonoD);
+		merge_val(bChangedAnaD, dAnaD, op.bChangedAnaD, op.dAnaD);
+		merge_val(bChangedAngleKiVec0, dAngleKiVec0, op.bChangedAngleKiVec0, op.dAngleKiVec0);
+
+		return iSuperseded;
+	}
 };
 
 struct CrystalOptions
@@ -124,6 +151,41 @@ struct CrystalOptions
 			dLattice[i] = dLatticeAngles[i] = dPlane1[i] = dPlane2[i] = t_real_glob(0);
 		}
 	}
+
+	/**
+	 * takes over the changed values of a later update
+	 * @return number of changed values which were superseded by op
+	 */
+	unsigned merge(const CrystalOptions& op)
+	{
+		unsigned iSuperseded = 0;
+		auto merge_arr = [&iSuperseded](bool& bChanged, t_real_glob* pVal,
+			bool bChangedOp, const t_real_glob* pValOp)
+		{
+			if(!bChangedOp) return;
+			if(bChanged) ++iSuperseded;
+			bChanged = 1;
+			for(int i=0; i<3; ++i)
+				pVal[i] = pValOp[i];
+		};
+		auto merge_str = [&iSuperseded](bool& bChanged, std::string& strVal,
+			bool bChangedOp, const std::string& strValOp)
+		{
+			if(!bChangedOp) return;
+			if(bChanged) ++iSuperseded;
+			bChanged = 1;
+			strVal = strValOp;
+		};
+
+		merge_arr(bChangedLattice, dLattice, op.bChangedLattice, op.dLattice);
+		merge_arr(bChangedLatticeAngles, dLatticeAngles, op.bChangedLatticeAngles, op.dLatticeAngles);
+		merge_arr(bChangedPlane1, dPlane1, op.bChangedPlane1, op.dPlane1);
+		merge_arr(bChangedPlane2, dPlane2, op.bChangedPlane2, op.dPlane2);
+		merge_str(bChangedSpacegroup, strSpacegroup, op.bChangedSpacegroup, op.strSpacegroup);
+		merge_str(bChangedSampleName, strSampleName, op.bChangedSampleName, op.strSampleName);
+
+		return iSuperseded;
+	}
 };
 
 
@@ -231,6 +231,11 @@ TazDlg::TazDlg(QWidget* pParent, const std::string& strLogFile)
 		QObject::connect(m_pviewTof, SIGNAL(scaleChanged(t_real_glob)),
 			&m_sceneTof, SLOT(scaleChanged(t_real_glob)));
 
+	// visible region of the reciprocal lattice
+	if(m_pviewRecip)
+		QObject::connect(m_pviewRecip, SIGNAL(visibleRectChanged(const QRectF&)),
+			&m_sceneRecip, SLOT(visibleRectChanged(const QRectF&)));
+
 	// parameter dialogs
 	QObject::connect(&m_sceneRecip, SIGNAL(paramsChanged(const RecipParams&)),
 		&m_dlgRecipParam, SLOT(paramsChanged(const RecipParams&)));
@@ -252,6 +257,7 @@ TazDlg::TazDlg(QWidget* pParent, const std::string& strLogFile)
 		this, SLOT(VarsChanged(const CrystalOptions&, const TriangleOptions&)));
 	QObject::connect(&m_sceneRecip, SIGNAL(paramsChanged(const RecipParams&)),
 		m_pGotoDlg, SLOT(RecipParamsChanged(const RecipParams&)));
+	m_pGotoDlg->SetDeadAngles(&m_vecDeadAngles);
 
 	QObject::connect(&m_sceneRecip, SIGNAL(paramsChanged(const RecipParams&)),
 		this, SLOT(recipParamsChanged(const RecipParams&)));
@@ -263,12 +269,12 @@ TazDlg::TazDlg(QWidget* pParent, const std::string& strLogFile)
 	for(QLineEdit* pEdit : m_vecEdits_real)
 	{
 		QObject::connect(pEdit, SIGNAL(textEdited(const QString&)), this, SLOT(CheckCrystalType()));
-		QObject::connect(pEdit, SIGNAL(textEdited(const QString&)), this, SLOT(CalcPeaks()));
+		QObject::connect(pEdit, SIGNAL(textEdited(const QString&)), this, SLOT(CalcPeaksAsync()));
 	}
 
 	for(QLineEdit* pEdit : m_vecEdits_plane)
 	{
-		QObject::connect(pEdit, SIGNAL(textEdited(const QString&)), this, SLOT(CalcPeaks()));
+		QObject::connect(pEdit, SIGNAL(textEdited(const QString&)), this, SLOT(CalcPeaksAsync()));
 	}
 
 	//for(QDoubleSpinBox* pSpin : m_vecSpinBoxesSample)
@@ -783,6 +789,9 @@ TazDlg::TazDlg(QWidget* pParent, const std::string& strLogFile)
 	QObject::connect(pNetRefresh, SIGNAL(triggered()), this, SLOT(NetRefresh()));
 	QObject::connect(pNetCache, SIGNAL(triggered()), this, SLOT(ShowNetCache()));
 	QObject::connect(pNetScanMon, SIGNAL(triggered()), this, SLOT(ShowNetScanMonitor()));
+
+	m_timerNetVars.setSingleShot(1);
+	QObject::connect(&m_timerNetVars, SIGNAL(timeout()), this, SLOT(ApplyNetVars()));
 #endif
 
 	QObject::connect(pSgList, SIGNAL(triggered()), this, SLOT(ShowSgListDlg()));
@@ -924,6 +933,7 @@ TazDlg::TazDlg(QWidget* pParent, const std::string& strLogFile)
 TazDlg::~TazDlg()
 {
 	//log_debug("In ", __func__, ".");
+	CancelPeaksJobs(1);
 	Disconnect();
 	DeleteDialogs();
 
@@ -1121,7 +1131,10 @@ void TazDlg::ShowTofDlg()
 void TazDlg::InitGoto()
 {
 	if(!m_pGotoDlg)
+	{
 		m_pGotoDlg = new GotoDlg(this, &m_settings);
+		m_pGotoDlg->SetDeadAngles(&m_vecDeadAngles);
+	}
 }
 
 
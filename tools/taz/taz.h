@@ -22,9 +22,15 @@
 #include <QSettings>
 #include <QVariant>
 #include <QSignalMapper>
+#include <QTimer>
 
 #include <string>
 #include <vector>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <future>
 
 #include "ui/ui_taz.h"
 #include "scattering_triangle.h"
@@ -131,6 +137,15 @@ class TazDlg : public QMainWindow, Ui::TazDlg
 
 		// reciprocal lattice
 		xtl::LatticeCommon<t_real_glob> m_latticecommon;
+
+		// background calculation of the reciprocal peaks, only the newest job is used
+		unsigned int m_iPeaksJob = 0;
+		std::shared_ptr<std::atomic<bool>> m_pStopPeaksJob;
+		std::list<std::future<void>> m_lstPeaksJobs;
+		std::mutex m_mtxPeaksJob;
+		std::unique_ptr<RecipPeaks> m_pPeaksJobResult;
+		unsigned int m_iPeaksJobResult = 0;
+
 		ScatteringTriangleView *m_pviewRecip = nullptr;
 		ScatteringTriangleScene m_sceneRecip;
 		ProjLatticeView *m_pviewProjRecip = nullptr;
@@ -183,6 +198,12 @@ class TazDlg : public QMainWindow, Ui::TazDlg
 		NetCache *m_pNetCache = nullptr;
 		NetCacheDlg *m_pNetCacheDlg = nullptr;
 		ScanMonDlg *m_pScanMonDlg = nullptr;
+
+		// instrument updates are collected for "net/update_window" ms and applied together
+		QTimer m_timerNetVars;
+		CrystalOptions m_crysNet;
+		TriangleOptions m_triagNet;
+		unsigned m_iNetVarsReceived = 0, m_iNetVarsMerged = 0, m_iNetVarsApplied = 0;
 #endif
 
 #if !defined NO_3D
@@ -223,8 +244,13 @@ class TazDlg : public QMainWindow, Ui::TazDlg
 		void ExportSceneSVG(QGraphicsScene& scene);
 		void emitSampleParams();
 
+		void CancelPeaksJobs(bool bWait=0);
+		void RecipPeaksChanged();
+
 	protected slots:
-		void CalcPeaks();
+		void CalcPeaks(bool bAsync=0);
+		void CalcPeaksAsync() { CalcPeaks(1); }
+		void PeaksCalculated();
 		void CalcPeaksRecip();
 		void UpdateDs();
 
@@ -326,6 +352,8 @@ class TazDlg : public QMainWindow, Ui::TazDlg
 		void Connected(const QString& strHost, const QString& strSrv);
 		void Disconnected();
 		void VarsChanged(const CrystalOptions& crys, const TriangleOptions& triag);
+		void NetVarsChanged(const CrystalOptions& crys, const TriangleOptions& triag);
+		void ApplyNetVars();
 
 		void RecipCoordsChanged(t_real_glob dh, t_real_glob dk, t_real_glob dl,
 			bool bHasNearest, t_real_glob dNearestH, t_real_glob dNearestK, t_real_glob dNearestL);
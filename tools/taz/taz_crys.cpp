@@ -10,6 +10,7 @@
 #include "tlibs/string/spec_char.h"
 #include "tlibs/helper/exception.h"
 #include <boost/algorithm/string.hpp>
+#include <chrono>
 
 
 using t_real = t_real_glob;
@@ -113,7 +114,7 @@ void TazDlg::CalcPeaksRecip()
 		editGamma->setText(dtoqstr(tl::r2d(recip.GetGamma()), g_iPrec));
 
 		m_bUpdateRecipEdits = 0;
-		CalcPeaks();
+		CalcPeaks(1);
 		m_bUpdateRecipEdits = 1;
 	}
 	catch(const std::exception& ex)
@@ -122,11 +123,18 @@ void TazDlg::CalcPeaksRecip()
 	}
 }
 
-void TazDlg::CalcPeaks()
+/**
+ * calculates the lattice, the heavy part for the reciprocal lattice view
+ * (peaks, BZs, kd tree, powder lines) runs in the background if bAsync is set
+ */
+void TazDlg::CalcPeaks(bool bAsync)
 {
 	if(!m_bReady || !m_sceneRecip.GetTriangle() || !m_sceneRealLattice.GetLattice())
 		return;
 
+	// results of running jobs are stale now
+	CancelPeaksJobs();
+
 	try
 	{
 		const bool bPowder = checkPowder->isChecked();
@@ -303,26 +311,47 @@ void TazDlg::CalcPeaks()
 		m_latticecommon = xtl::LatticeCommon<t_real_glob>();
 		if(m_latticecommon.Calc(lattice, recip, planeRLU, planeRealFrac, pSpaceGroup, &m_vecAtoms))
 		{
-			m_sceneRecip.GetTriangle()->CalcPeaks(m_latticecommon, bPowder);
-			if(m_sceneRecip.getSnapq())
-				m_sceneRecip.GetTriangle()->SnapToNearestPeak(m_sceneRecip.GetTriangle()->GetNodeGq());
-			m_sceneRecip.emitUpdate();
-
-			m_sceneProjRecip.GetLattice()->CalcPeaks(m_latticecommon, true);
-			m_sceneRealLattice.GetLattice()->CalcPeaks(m_latticecommon);
-
-#ifndef NO_3D
-			if(m_pRecip3d)
-				m_pRecip3d->CalcPeaks(m_latticecommon);
-			if(m_pReal3d)
-				m_pReal3d->CalcPeaks(m_sceneRealLattice.GetLattice()->GetWS3D(),
-					m_latticecommon);
-			if(m_pBZ3d)
-				m_pBZ3d->RenderBZ(m_sceneRecip.GetTriangle()->GetBZ3D(),
-					m_latticecommon,
-					&m_sceneRecip.GetTriangle()->GetBZ3DPlaneVerts(),
-					&m_sceneRecip.GetTriangle()->GetBZ3DSymmVerts());
-#endif
+			ScatteringTriangle *pTri = m_sceneRecip.GetTriangle();
+
+			if(bAsync)
+			{
+				const unsigned int iJob = m_iPeaksJob;
+				std::shared_ptr<std::atomic<bool>> pStop = m_pStopPeaksJob;
+				const xtl::LatticeCommon<t_real_glob> latticecommon = m_latticecommon;
+				const int iMaxPeaks = int(pTri->GetMaxPeaks());
+				const t_real dPlaneDistTolerance = pTri->GetPlaneDistTolerance();
+				const bool bAllPeaks = pTri->GetAllPeaksVisible();
+
+				m_lstPeaksJobs.emplace_back(get_task_pool().Submit(
+					[this, iJob, pStop, latticecommon, bPowder, iMaxPeaks, dPlaneDistTolerance, bAllPeaks]()
+				{
+					std::unique_ptr<RecipPeaks> pPeaks;
+					try
+					{
+						pPeaks = ScatteringTriangle::CalcRecipPeaks(latticecommon, bPowder,
+							iMaxPeaks, dPlaneDistTolerance, bAllPeaks, pStop.get());
+					}
+					catch(const std::exception& ex)
+					{
+						tl::log_err(ex.what());
+					}
+
+					if(pStop->load())
+						return;
+
+					{
+						std::lock_guard<std::mutex> lock(m_mtxPeaksJob);
+						m_pPeaksJobResult = std::move(pPeaks);
+						m_iPeaksJobResult = iJob;
+					}
+					QMetaObject::invokeMethod(this, "PeaksCalculated", Qt::QueuedConnection);
+				}));
+			}
+			else
+			{
+				pTri->CalcPeaks(m_latticecommon, bPowder);
+				RecipPeaksChanged();
+			}
 		}
 		else
 		{
@@ -338,6 +367,99 @@ void TazDlg::CalcPeaks()
 	}
 }
 
+
+/**
+ * swaps in the results of the newest background job
+ */
+void TazDlg::PeaksCalculated()
+{
+	std::unique_ptr<RecipPeaks> pPeaks;
+	{
+		std::lock_guard<std::mutex> lock(m_mtxPeaksJob);
+		if(m_iPeaksJobResult != m_iPeaksJob)
+			return;
+
+		pPeaks = std::move(m_pPeaksJobResult);
+		m_iPeaksJobResult = 0;
+	}
+
+	// failed calculation
+	if(!pPeaks)
+	{
+		m_sceneRecip.GetTriangle()->ClearPeaks();
+		return;
+	}
+
+	try
+	{
+		m_sceneRecip.GetTriangle()->SetPeaks(std::move(pPeaks));
+		RecipPeaksChanged();
+	}
+	catch(const std::exception& ex)
+	{
+		m_sceneRecip.GetTriangle()->ClearPeaks();
+		tl::log_err(ex.what());
+	}
+}
+
+
+/**
+ * stops the running background jobs and starts a new job id;
+ * bWait: also wait until they have finished
+ */
+void TazDlg::CancelPeaksJobs(bool bWait)
+{
+	if(m_pStopPeaksJob)
+		m_pStopPeaksJob->store(true);
+	m_pStopPeaksJob = std::make_shared<std::atomic<bool>>(false);
+	++m_iPeaksJob;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtxPeaksJob);
+		m_pPeaksJobResult.reset();
+		m_iPeaksJobResult = 0;
+	}
+
+	// forget the finished jobs
+	for(auto iter = m_lstPeaksJobs.begin(); iter != m_lstPeaksJobs.end();)
+	{
+		if(bWait)
+			iter->wait();
+
+		if(iter->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			iter = m_lstPeaksJobs.erase(iter);
+		else
+			++iter;
+	}
+}
+
+
+/**
+ * updates the other lattice views after the reciprocal peaks have changed
+ */
+void TazDlg::RecipPeaksChanged()
+{
+	if(m_sceneRecip.getSnapq())
+		m_sceneRecip.GetTriangle()->SnapToNearestPeak(m_sceneRecip.GetTriangle()->GetNodeGq());
+	m_sceneRecip.emitUpdate();
+
+	m_sceneProjRecip.GetLattice()->CalcPeaks(m_latticecommon, true);
+	m_sceneRealLattice.GetLattice()->CalcPeaks(m_latticecommon);
+
+#ifndef NO_3D
+	if(m_pRecip3d)
+		m_pRecip3d->CalcPeaks(m_latticecommon);
+	if(m_pReal3d)
+		m_pReal3d->CalcPeaks(m_sceneRealLattice.GetLattice()->GetWS3D(),
+			m_latticecommon);
+	if(m_pBZ3d)
+		m_pBZ3d->RenderBZ(m_sceneRecip.GetTriangle()->GetBZ3D(),
+			m_latticecommon,
+			&m_sceneRecip.GetTriangle()->GetBZ3DPlaneVerts(),
+			&m_sceneRecip.GetTriangle()->GetBZ3DSymmVerts());
+#endif
+}
+
 void TazDlg::VarsChanged(const CrystalOptions& crys, const TriangleOptions& triag)
 {
 	// update crystal
@@ -63,7 +63,13 @@ void TazDlg::ExportRecip()
 
 	const t_real dZoom = pTri->GetZoom();
 	pTri->SetZoom(1.);
+
+	// export all peaks, not only the ones near the visible region
+	const QRectF rectVisible = pTri->GetVisibleRect();
+	pTri->SetVisibleRect(QRectF());
 	ExportSceneSVG(m_sceneRecip);
+	pTri->SetVisibleRect(rectVisible);
+
 	pTri->SetZoom(dZoom);
 }
 
@@ -46,7 +46,7 @@ void TazDlg::ConnectTo(int iSys, const QString& _strHost, const QString& _strPor
 
 
 	QObject::connect(m_pNetCache, SIGNAL(vars_changed(const CrystalOptions&, const TriangleOptions&)),
-		this, SLOT(VarsChanged(const CrystalOptions&, const TriangleOptions&)));
+		this, SLOT(NetVarsChanged(const CrystalOptions&, const TriangleOptions&)));
 	QObject::connect(m_pNetCache, SIGNAL(connected(const QString&, const QString&)),
 		this, SLOT(Connected(const QString&, const QString&)));
 	QObject::connect(m_pNetCache, SIGNAL(disconnected()),
@@ -60,6 +60,11 @@ void TazDlg::ConnectTo(int iSys, const QString& _strHost, const QString& _strPor
 	m_pNetCacheDlg->ClearAll();
 	m_pScanMonDlg->ClearPlot();
 
+	m_crysNet.clear();
+	m_triagNet.clear();
+	m_iNetVarsReceived = m_iNetVarsMerged = m_iNetVarsApplied = 0;
+	m_pNetCacheDlg->UpdateStats(0, 0, 0);
+
 	QObject::connect(m_pNetCache, SIGNAL(updated_cache_value(const std::string&, const CacheVal&)),
 		m_pNetCacheDlg, SLOT(UpdateValue(const std::string&, const CacheVal&)));
 	QObject::connect(m_pNetCache, SIGNAL(updated_cache_value(const std::string&, const CacheVal&)),
@@ -81,7 +86,7 @@ void TazDlg::Disconnect()
 		m_pNetCache->disconnect();
 
 		QObject::disconnect(m_pNetCache, SIGNAL(vars_changed(const CrystalOptions&, const TriangleOptions&)),
-			this, SLOT(VarsChanged(const CrystalOptions&, const TriangleOptions&)));
+			this, SLOT(NetVarsChanged(const CrystalOptions&, const TriangleOptions&)));
 		QObject::disconnect(m_pNetCache, SIGNAL(connected(const QString&, const QString&)),
 			this, SLOT(Connected(const QString&, const QString&)));
 		QObject::disconnect(m_pNetCache, SIGNAL(disconnected()),
@@ -94,6 +99,13 @@ void TazDlg::Disconnect()
 		m_pNetCache = nullptr;
 	}
 
+	// apply the last updates which are still waiting
+	if(m_timerNetVars.isActive())
+	{
+		m_timerNetVars.stop();
+		ApplyNetVars();
+	}
+
 	// re-enable manual node movement
 	if(m_sceneReal.GetTasLayout()) m_sceneReal.GetTasLayout()->AllowMouseMove(1);
 	if(m_sceneTof.GetTofLayout()) m_sceneTof.GetTofLayout()->AllowMouseMove(1);
@@ -102,10 +114,64 @@ void TazDlg::Disconnect()
 	statusBar()->showMessage("Disconnected.", DEFAULT_MSG_TIMEOUT);
 }
 
+/**
+ * collects the changes sent by the instrument server,
+ * they are applied all at once after the update window has passed
+ */
+void TazDlg::NetVarsChanged(const CrystalOptions& crys, const TriangleOptions& triag)
+{
+	if(!crys.IsAnythingChanged() && !triag.IsAnythingChanged())
+		return;
+
+	++m_iNetVarsReceived;
+	m_iNetVarsMerged += m_crysNet.merge(crys);
+	m_iNetVarsMerged += m_triagNet.merge(triag);
+
+	const int iWindow = m_settings.value("net/update_window", 100).toInt();
+	if(iWindow <= 0)
+	{
+		m_timerNetVars.stop();
+		ApplyNetVars();
+	}
+	else if(!m_timerNetVars.isActive())
+	{
+		// the window starts with the first change, later ones do not delay it further
+		m_timerNetVars.start(iWindow);
+	}
+	else if(m_pNetCacheDlg)
+	{
+		m_pNetCacheDlg->UpdateStats(m_iNetVarsReceived, m_iNetVarsApplied, m_iNetVarsMerged);
+	}
+}
+
+/**
+ * applies the collected changes as one update
+ */
+void TazDlg::ApplyNetVars()
+{
+	if(m_crysNet.IsAnythingChanged() || m_triagNet.IsAnythingChanged())
+	{
+		// VarsChanged may modify the options
+		CrystalOptions crys = m_crysNet;
+		TriangleOptions triag = m_triagNet;
+		m_crysNet.clear();
+		m_triagNet.clear();
+
+		++m_iNetVarsApplied;
+		VarsChanged(crys, triag);
+	}
+
+	if(m_pNetCacheDlg)
+		m_pNetCacheDlg->UpdateStats(m_iNetVarsReceived, m_iNetVarsApplied, m_iNetVarsMerged);
+}
+
 void TazDlg::ShowNetCache()
 {
 	if(!m_pNetCacheDlg)
+	{
 		m_pNetCacheDlg = new NetCacheDlg(this, &m_settings);
+		m_pNetCacheDlg->UpdateStats(m_iNetVarsReceived, m_iNetVarsApplied, m_iNetVarsMerged);
+	}
 
 	focus_dlg(m_pNetCacheDlg);
 }
@@ -14,3 +14,5 @@ void TazDlg::ShowNetCache() {}
 void TazDlg::NetRefresh() {}
 void TazDlg::Connected(const QString& strHost, const QString& strSrv) {}
 void TazDlg::Disconnected() {}
+void TazDlg::NetVarsChanged(const CrystalOptions& crys, const TriangleOptions& triag) {}
+void TazDlg::ApplyNetVars() {}
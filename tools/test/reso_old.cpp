@@ -0,0 +1,1053 @@
+/**
+ * reference (pre fixed-size matrix) versions of the cn, pop and eck
+ * calculations, as in tools/res/{cn,pop,eck}.cpp before they were
+ * switched to t_mat_fix; only used by tst_resofix.cpp
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @license GPLv2
+ */
+
+#include "tools/res/cn.h"
+#include "tools/res/pop.h"
+#include "tools/res/eck.h"
+#include "tools/res/r0.h"
+#include "tools/res/ellipse.h"
+#include "tools/res/helper.h"
+
+#include "tlibs/math/geo.h"
+#include "tlibs/math/linalg.h"
+#include "tlibs/math/math.h"
+#include "tlibs/log/log.h"
+
+#include <tuple>
+#include <future>
+#include <string>
+#include <iostream>
+
+
+typedef t_real_reso t_real;
+typedef ublas::matrix<t_real> t_mat;
+typedef ublas::vector<t_real> t_vec;
+
+using angle = tl::t_angle_si<t_real>;
+using wavenumber = tl::t_wavenumber_si<t_real>;
+using energy = tl::t_energy_si<t_real>;
+using length = tl::t_length_si<t_real>;
+using inv_length = tl::t_length_inverse_si<t_real>;
+
+static const auto angs = tl::get_one_angstrom<t_real>();
+static const auto rads = tl::get_one_radian<t_real>();
+static const auto meV = tl::get_one_meV<t_real>();
+static const auto cm = tl::get_one_centimeter<t_real>();
+static const auto sec = tl::get_one_second<t_real>();
+static const auto secs = tl::get_one_second<t_real>();
+static const auto mn = tl::get_m_n<t_real>();
+static const auto hbar = tl::get_hbar<t_real>();
+static const t_real pi = tl::get_pi<t_real>();
+static const t_real sig2fwhm = tl::get_SIGMA2FWHM<t_real>();
+
+
+// ----------------------------------------------------------------------------
+// cn
+
+
+/**
+ * transformation matrix -> [mit84], equ. A.15
+ *
+ * (  Ti11   Ti12      0   Tf11   Tf12      0 )   ( dki_x )   ( dQ_x  )
+ * (  Ti12   Ti22      0   Tf12   Tf22      0 )   ( dki_y )   ( dQ_y  )
+ * (     0      0      1      0      0     -1 ) * ( dki_z ) = ( dQ_z  )
+ * ( 2ki*c      0      0 -2kf*c      0      0 )   ( dkf_x )   ( dE    )
+ * (     1      0      0      0      0      0 )   ( dkf_y )   ( dki_x )
+ * (     0      0      1      0      0      0 )   ( dkf_z )   ( dki_z )
+ *
+ * e.g. E ~ ki^2 - kf^2
+ * dE ~ 2ki*dki - 2kf*dkf
+ */
+static t_mat get_trafo_dkidkf_dQdE_old(const angle& ki_Q, const angle& kf_Q,
+	const wavenumber& ki, const wavenumber& kf)
+{
+	t_mat Ti = tl::rotation_matrix_2d(ki_Q/rads);
+	t_mat Tf = -tl::rotation_matrix_2d(kf_Q/rads);
+
+	t_mat U = ublas::zero_matrix<t_real>(6,6);
+	tl::submatrix_copy(U, Ti, 0, 0);
+	tl::submatrix_copy(U, Tf, 0, 3);
+	U(2,2) = 1.; U(2,5) = -1.;
+	U(3,0) = +t_real(2)*ki * tl::get_KSQ2E<t_real>() * angs;
+	U(3,3) = -t_real(2)*kf * tl::get_KSQ2E<t_real>() * angs;
+	U(4,0) = 1.; U(5,2) = 1.;
+	//tl::log_info("Trafo matrix (CN) = ", U);
+
+	return U;
+}
+
+
+ResoResults calc_cn_old(const CNParams& cn)
+{
+	ResoResults res;
+
+	res.Q_avg.resize(4);
+	res.Q_avg[0] = cn.Q * angs;
+	res.Q_avg[1] = 0.;
+	res.Q_avg[2] = 0.;
+	res.Q_avg[3] = cn.E / meV;
+
+	angle coll_h_pre_mono = cn.coll_h_pre_mono;
+	angle coll_v_pre_mono = cn.coll_v_pre_mono;
+
+	// use the same as the horizontal mosaics for now
+	angle mono_mosaic_v = cn.mono_mosaic;
+	angle ana_mosaic_v = cn.ana_mosaic;
+
+	/*const length lam = tl::k2lam(cn.ki);
+	if(cn.bGuide)
+	{
+		coll_h_pre_mono = lam*(cn.guide_div_h/angs);
+		coll_v_pre_mono = lam*(cn.guide_div_v/angs);
+	}*/
+
+	angle thetaa = cn.thetaa * cn.dana_sense;
+	angle thetam = cn.thetam * cn.dmono_sense;
+	angle ki_Q = cn.angle_ki_Q;
+	angle kf_Q = cn.angle_kf_Q;
+
+	ki_Q *= cn.dsample_sense;
+	kf_Q *= cn.dsample_sense;
+
+	t_mat U = get_trafo_dkidkf_dQdE_old(ki_Q, kf_Q, cn.ki, cn.kf);
+
+	// V matrix -> [mit84], equ. A.16
+	t_mat V(6,6);
+	if(!tl::inverse(U, V))
+	{
+		res.bOk = false;
+		res.strErr = "Transformation matrix cannot be inverted.";
+		return res;
+	}
+	// -------------------------------------------------------------------------
+
+
+	const auto tupScFact = get_scatter_factors(cn.flags, cn.thetam, cn.ki, cn.thetaa, cn.kf);
+
+	t_real dmono_refl = cn.dmono_refl * std::get<0>(tupScFact);
+	t_real dana_effic = cn.dana_effic * std::get<1>(tupScFact);
+	if(cn.mono_refl_curve) dmono_refl *= (*cn.mono_refl_curve)(cn.ki);
+	if(cn.ana_effic_curve) dana_effic *= (*cn.ana_effic_curve)(cn.kf);
+	t_real dxsec = std::get<2>(tupScFact);
+
+
+	// -------------------------------------------------------------------------
+	// resolution matrix, [mit84], equ. A.5
+	t_mat M = ublas::zero_matrix<t_real>(6,6);
+
+	auto calc_mono_ana_res =
+		[](angle theta, wavenumber k,
+		angle mosaic, angle mosaic_v,
+		angle coll1, angle coll2,
+		angle coll1_v, angle coll2_v) -> std::pair<t_mat, t_real>
+	{
+		// horizontal part
+		t_vec vecMos(2);
+		vecMos[0] = units::tan(theta);
+		vecMos[1] = 1.;
+		vecMos /= k*angs * mosaic/rads;
+
+		t_vec vecColl1(2);
+		vecColl1[0] = 2.*units::tan(theta);
+		vecColl1[1] = 1.;
+		vecColl1 /= (k*angs * coll1/rads);
+
+		t_vec vecColl2(2);
+		vecColl2[0] = 0;
+		vecColl2[1] = 1.;
+		vecColl2 /= (k*angs * coll2/rads);
+
+		t_mat matHori = ublas::outer_prod(vecMos, vecMos) +
+			ublas::outer_prod(vecColl1, vecColl1) +
+			ublas::outer_prod(vecColl2, vecColl2);
+
+		// vertical part, [mit84], equ. A.9 & A.13
+		t_real dVert = t_real(1)/(k*k * angs*angs) * rads*rads *
+		(
+			t_real(1) / (coll2_v * coll2_v) +
+			t_real(1) / ((t_real(2)*units::sin(theta) * mosaic_v) *
+				(t_real(2)*units::sin(theta) * mosaic_v) +
+				coll1_v * coll1_v)
+		);
+
+		return std::pair<t_mat, t_real>(matHori, dVert);
+	};
+
+	std::launch lpol = /*std::launch::deferred |*/ std::launch::async;
+	std::future<std::pair<t_mat, t_real>> futMono
+		= std::async(lpol, calc_mono_ana_res,
+			thetam, cn.ki,
+			cn.mono_mosaic, mono_mosaic_v,
+			cn.coll_h_pre_mono, cn.coll_h_pre_sample,
+			cn.coll_v_pre_mono, cn.coll_v_pre_sample);
+	std::future<std::pair<t_mat, t_real>> futAna
+		= std::async(lpol, calc_mono_ana_res,
+			-thetaa, cn.kf,
+			cn.ana_mosaic, ana_mosaic_v,
+			cn.coll_h_post_ana, cn.coll_h_post_sample,
+			cn.coll_v_post_ana, cn.coll_v_post_sample);
+
+	t_mat matMonoH, matAnaH;
+	t_real dMonoV, dAnaV;
+	std::tie(matMonoH, dMonoV) = futMono.get();
+	std::tie(matAnaH, dAnaV) = futAna.get();
+
+	tl::submatrix_copy(M, matMonoH, 0, 0);
+	tl::submatrix_copy(M, matAnaH, 3, 3);
+	M(2,2) = dMonoV;
+	M(5,5) = dAnaV;
+	// -------------------------------------------------------------------------
+
+
+	t_mat N = tl::transform(M, V, 1);
+
+	N = quadric_proj(N, 5);
+	N = quadric_proj(N, 4);
+
+	t_vec vec1 = tl::get_column<t_vec>(N, 1);
+	res.reso = N - ublas::outer_prod(vec1,vec1)
+		/ (1./((cn.sample_mosaic/rads * cn.Q*angs)
+		* (cn.sample_mosaic/rads * cn.Q*angs)) + N(1,1));
+	res.reso(2,2) = N(2,2);
+	res.reso *= sig2fwhm*sig2fwhm;
+
+	res.reso_v = ublas::zero_vector<t_real>(4);
+	res.reso_s = 0.;
+
+	if(cn.dsample_sense < 0.)
+	{
+		// mirror Q_perp
+		t_mat matMirror = tl::mirror_matrix<t_mat>(res.reso.size1(), 1);
+		res.reso = tl::transform(res.reso, matMirror, true);
+		res.reso_v[1] = -res.reso_v[1];
+	}
+
+	// -------------------------------------------------------------------------
+
+
+	res.dResVol = tl::get_ellipsoid_volume(res.reso);
+	res.dR0 = chess_R0(cn.ki,cn.kf, thetam, thetaa, cn.twotheta, cn.mono_mosaic,
+		cn.ana_mosaic, cn.coll_v_pre_mono, cn.coll_v_post_ana, dmono_refl, dana_effic);
+	res.dR0 *= dxsec;
+
+	// Bragg widths
+	const std::vector<t_real> vecFwhms = calc_bragg_fwhms(res.reso);
+	std::copy(vecFwhms.begin(), vecFwhms.end(), res.dBraggFWHMs);
+
+	if(tl::is_nan_or_inf(res.dR0) || tl::is_nan_or_inf(res.reso))
+	{
+		res.strErr = "Invalid result.";
+		res.bOk = false;
+		return res;
+	}
+
+	res.bOk = true;
+	return res;
+}
+
+
+// ----------------------------------------------------------------------------
+// pop
+
+
+ResoResults calc_pop_old(const PopParams& pop)
+{
+	ResoResults res;
+
+	res.Q_avg.resize(4);
+	res.Q_avg[0] = pop.Q * angs;
+	res.Q_avg[1] = 0.;
+	res.Q_avg[2] = 0.;
+	res.Q_avg[3] = pop.E / meV;
+
+
+	length lam = tl::k2lam(pop.ki);
+	angle twotheta = pop.twotheta;
+	angle thetaa = pop.thetaa * pop.dana_sense;
+	angle thetam = pop.thetam * pop.dmono_sense;
+	angle ki_Q = pop.angle_ki_Q;
+	angle kf_Q = pop.angle_kf_Q;
+	//kf_Q = ki_Q + twotheta;
+
+	twotheta *= pop.dsample_sense;
+	ki_Q *= pop.dsample_sense;
+	kf_Q *= pop.dsample_sense;
+
+	// B matrix, [pop75], Appendix 1 -> U matrix in CN
+	t_mat B = get_trafo_dkidkf_dQdE_old(ki_Q, kf_Q, pop.ki, pop.kf);
+	B.resize(4,6, true);
+
+	angle coll_h_pre_mono = pop.coll_h_pre_mono;
+	angle coll_v_pre_mono = pop.coll_v_pre_mono;
+
+	if(pop.bGuide)
+	{
+		coll_h_pre_mono = lam*(pop.guide_div_h/angs);
+		coll_v_pre_mono = lam*(pop.guide_div_v/angs);
+	}
+
+
+	// collimator covariance matrix G, [pop75], Appendix 1
+	t_mat G = tl::diag_matrix({
+		t_real(1)/(coll_h_pre_mono*coll_h_pre_mono /rads/rads),
+		t_real(1)/(pop.coll_h_pre_sample*pop.coll_h_pre_sample /rads/rads),
+
+		t_real(1)/(coll_v_pre_mono*coll_v_pre_mono /rads/rads),
+		t_real(1)/(pop.coll_v_pre_sample*pop.coll_v_pre_sample /rads/rads),
+
+		t_real(1)/(pop.coll_h_post_sample*pop.coll_h_post_sample /rads/rads),
+		t_real(1)/(pop.coll_h_post_ana*pop.coll_h_post_ana /rads/rads),
+
+		t_real(1)/(pop.coll_v_post_sample*pop.coll_v_post_sample /rads/rads),
+		t_real(1)/(pop.coll_v_post_ana*pop.coll_v_post_ana /rads/rads)
+	});
+
+
+	const angle mono_mosaic_spread = pop.mono_mosaic;
+	const angle ana_mosaic_spread = pop.ana_mosaic;
+	const angle sample_mosaic_spread = pop.sample_mosaic;
+
+	// crystal mosaic covariance matrix F, [pop75], Appendix 1
+	t_mat F = tl::diag_matrix(
+	{
+		t_real(1)/(pop.mono_mosaic*pop.mono_mosaic /rads/rads),
+		t_real(1)/(mono_mosaic_spread*mono_mosaic_spread /rads/rads),
+		t_real(1)/(pop.ana_mosaic*pop.ana_mosaic /rads/rads),
+		t_real(1)/(ana_mosaic_spread*ana_mosaic_spread /rads/rads)
+	});
+
+	// C matrix, [pop75], Appendix 1
+	t_mat C = ublas::zero_matrix<t_real>(4,8);
+	C(2,5) = C(2,4) = C(0,1) = C(0,0) = 0.5;
+	C(1,2) = t_real(0.5)/units::sin(thetam);
+	C(1,3) /*C(2,2)*/ = t_real(-0.5)/units::sin(thetam);	// Popovici says C(2,2), not C(1,3)
+	C(3,6) = t_real(0.5)/units::sin(thetaa);
+	C(3,7) = t_real(-0.5)/units::sin(thetaa);
+
+	// A matrix, [pop75], Appendix 1
+	t_mat A = ublas::zero_matrix<t_real>(6,8);
+	A(0,0) = t_real(0.5) * pop.ki*angs * units::cos(thetam)/units::sin(thetam);
+	A(0,1) = t_real(-0.5) * pop.ki*angs * units::cos(thetam)/units::sin(thetam);
+	A(2,3) = A(1,1) = pop.ki * angs;
+	A(3,4) = t_real(0.5) * pop.kf*angs * units::cos(thetaa)/units::sin(thetaa);
+	A(3,5) = t_real(-0.5) * pop.kf*angs * units::cos(thetaa)/units::sin(thetaa);
+	A(5,6) = A(4,4) = pop.kf * angs;
+
+
+
+	// covariance matrix of component geometries, S, [pop75], Appendix 2
+	// source
+	t_real dMult = 1./12.;
+	if(!pop.bSrcRect) dMult = 1./16.;
+	t_real dSiSrc[] =
+	{
+		dMult * pop.src_w*pop.src_w /cm/cm,
+		dMult * pop.src_h*pop.src_h /cm/cm
+	};
+
+	// mono
+	t_real dSiMono[] =
+	{
+		t_real(1./12.) * pop.mono_thick*pop.mono_thick /cm/cm,
+		t_real(1./12.) * pop.mono_w*pop.mono_w /cm/cm,
+		t_real(1./12.) * pop.mono_h*pop.mono_h /cm/cm
+	};
+
+	// sample
+	dMult = 1./12.;
+	if(!pop.bSampleCub) dMult = 1./16.;
+	t_real dSiSample[] =
+	{
+		dMult * pop.sample_w_perpq *pop.sample_w_perpq /cm/cm,
+		dMult * pop.sample_w_q*pop.sample_w_q /cm/cm,
+		t_real(1./12.) * pop.sample_h*pop.sample_h /cm/cm
+	};
+
+	// ana
+	t_real dSiAna[] =
+	{
+		t_real(1./12.) * pop.ana_thick*pop.ana_thick /cm/cm,
+		t_real(1./12.) * pop.ana_w*pop.ana_w /cm/cm,
+		t_real(1./12.) * pop.ana_h*pop.ana_h /cm/cm
+	};
+
+	// det
+	dMult = 1./12.;
+	if(!pop.bDetRect) dMult = 1./16.;
+	t_real dSiDet[] =
+	{
+		dMult * pop.det_w*pop.det_w /cm/cm,
+		dMult * pop.det_h*pop.det_h /cm/cm
+	};
+
+	t_mat SI = tl::diag_matrix({dSiSrc[0], dSiSrc[1],
+		dSiMono[0], dSiMono[1], dSiMono[2],
+		dSiSample[0], dSiSample[1], dSiSample[2],
+		dSiAna[0], dSiAna[1], dSiAna[2],
+		dSiDet[0], dSiDet[1]});
+
+	SI *= sig2fwhm*sig2fwhm;
+
+	t_mat S;
+	if(!tl::inverse(SI, S))
+	{
+		res.bOk = false;
+		res.strErr = "S matrix cannot be inverted.";
+		return res;
+	}
+
+
+	// --------------------------------------------------------------------
+	// mono/ana focus
+	length mono_curvh = pop.mono_curvh, mono_curvv = pop.mono_curvv;
+	length ana_curvh = pop.ana_curvh, ana_curvv = pop.ana_curvv;
+
+	if(pop.bMonoIsOptimallyCurvedH) mono_curvh = tl::foc_curv(pop.dist_src_mono, pop.dist_mono_sample, units::abs(t_real(2)*thetam), false);
+	if(pop.bMonoIsOptimallyCurvedV) mono_curvv = tl::foc_curv(pop.dist_src_mono, pop.dist_mono_sample, units::abs(t_real(2)*thetam), true);
+	if(pop.bAnaIsOptimallyCurvedH) ana_curvh = tl::foc_curv(pop.dist_sample_ana, pop.dist_ana_det, units::abs(t_real(2)*thetaa), false);
+	if(pop.bAnaIsOptimallyCurvedV) ana_curvv = tl::foc_curv(pop.dist_sample_ana, pop.dist_ana_det, units::abs(t_real(2)*thetaa), true);
+
+	mono_curvh *= pop.dmono_sense; mono_curvv *= pop.dmono_sense;
+	ana_curvh *= pop.dana_sense; ana_curvv *= pop.dana_sense;
+
+	inv_length inv_mono_curvh = t_real(0)/cm, inv_mono_curvv = t_real(0)/cm;
+	inv_length inv_ana_curvh = t_real(0)/cm, inv_ana_curvv = t_real(0)/cm;
+
+	if(pop.bMonoIsCurvedH) inv_mono_curvh = t_real(1)/mono_curvh;
+	if(pop.bMonoIsCurvedV) inv_mono_curvv = t_real(1)/mono_curvv;
+	if(pop.bAnaIsCurvedH) inv_ana_curvh = t_real(1)/ana_curvh;
+	if(pop.bAnaIsCurvedV) inv_ana_curvv = t_real(1)/ana_curvv;
+
+
+	const auto tupScFact = get_scatter_factors(pop.flags, pop.thetam, pop.ki, pop.thetaa, pop.kf);
+
+	t_real dmono_refl = pop.dmono_refl * std::get<0>(tupScFact);
+	t_real dana_effic = pop.dana_effic * std::get<1>(tupScFact);
+	if(pop.mono_refl_curve) dmono_refl *= (*pop.mono_refl_curve)(pop.ki);
+	if(pop.ana_effic_curve) dana_effic *= (*pop.ana_effic_curve)(pop.kf);
+	t_real dxsec = std::get<2>(tupScFact);
+
+
+	//if(pop.bMonoIsCurvedH) tl::log_debug("mono curv h: ", mono_curvh);
+	//if(pop.bMonoIsCurvedV) tl::log_debug("mono curv v: ", mono_curvv);
+	//if(pop.bAnaIsCurvedH) tl::log_debug("ana curv h: ", ana_curvh);
+	//if(pop.bAnaIsCurvedV) tl::log_debug("ana curv v: ", ana_curvv);
+	// --------------------------------------------------------------------
+
+
+
+	// T matrix to transform the mosaic cov. matrix, [pop75], Appendix 2
+	t_mat T = ublas::zero_matrix<t_real>(4,13);
+	T(0,0) = t_real(-0.5) / (pop.dist_src_mono / cm);
+	T(0,2) = t_real(0.5) * units::cos(thetam) *
+		(t_real(1)/(pop.dist_mono_sample/cm) - t_real(1)/(pop.dist_src_mono/cm));
+	T(0,3) = t_real(0.5) * units::sin(thetam) *
+		(t_real(1)/(pop.dist_src_mono/cm) + t_real(1)/(pop.dist_mono_sample/cm) -
+		t_real(2)*inv_mono_curvh*cm/(units::sin(thetam)));
+	T(0,5) = t_real(0.5) * units::sin(t_real(0.5)*twotheta) / (pop.dist_mono_sample/cm);
+	T(0,6) = t_real(0.5) * units::cos(t_real(0.5)*twotheta) / (pop.dist_mono_sample/cm);
+	T(1,1) = t_real(-0.5)/(pop.dist_src_mono/cm * units::sin(thetam));
+	T(1,4) = t_real(0.5) * (t_real(1)/(pop.dist_src_mono/cm) +
+		t_real(1)/(pop.dist_mono_sample/cm) -
+		t_real(2)*units::sin(thetam)*inv_mono_curvv*cm)
+		/ (units::sin(thetam));
+	T(1,7) = t_real(-0.5)/(pop.dist_mono_sample/cm * units::sin(thetam));
+	T(2,5) = t_real(0.5)*units::sin(t_real(0.5)*twotheta) / (pop.dist_sample_ana/cm);
+	T(2,6) = t_real(-0.5)*units::cos(t_real(0.5)*twotheta) / (pop.dist_sample_ana/cm);
+	T(2,8) = t_real(0.5)*units::cos(thetaa) * (t_real(1)/(pop.dist_ana_det/cm) -
+		t_real(1)/(pop.dist_sample_ana/cm));
+	T(2,9) = t_real(0.5)*units::sin(thetaa) * (
+		t_real(1)/(pop.dist_sample_ana/cm) +
+		t_real(1)/(pop.dist_ana_det/cm) -
+		t_real(2)*inv_ana_curvh*cm / (units::sin(thetaa)));
+	T(2,11) = t_real(0.5)/(pop.dist_ana_det/cm);
+	T(3,7) = t_real(-0.5)/(pop.dist_sample_ana/cm*units::sin(thetaa));
+	T(3,10) = t_real(0.5)*(1./(pop.dist_sample_ana/cm) +
+		t_real(1)/(pop.dist_ana_det/cm) -
+		t_real(2)*units::sin(thetaa)*inv_ana_curvv*cm)
+		/ (units::sin(thetaa));
+	T(3,12) = t_real(-0.5)/(pop.dist_ana_det/cm*units::sin(thetaa));
+
+
+	// D matrix to transform the spatial and the mosaic cov. matrices, [pop75], Appendix 2
+	t_mat D = ublas::zero_matrix<t_real>(8,13);
+	D(0,0) = t_real(-1) / (pop.dist_src_mono/cm);
+	D(0,2) = -cos(thetam) / (pop.dist_src_mono/cm);
+	D(0,3) = sin(thetam) / (pop.dist_src_mono/cm);
+	D(1,2) = cos(thetam) / (pop.dist_mono_sample/cm);
+	D(1,3) = sin(thetam) / (pop.dist_mono_sample/cm);
+	D(1,5) = sin(t_real(0.5)*twotheta) / (pop.dist_mono_sample/cm);
+	D(1,6) = cos(t_real(0.5)*twotheta) / (pop.dist_mono_sample/cm);
+	D(2,1) = t_real(-1) / (pop.dist_src_mono/cm);
+	D(2,4) = t_real(1) / (pop.dist_src_mono/cm);
+	D(3,4) = t_real(-1) / (pop.dist_mono_sample/cm);
+	D(3,7) = t_real(1) / (pop.dist_mono_sample/cm);
+	D(4,5) = sin(t_real(0.5)*twotheta) / (pop.dist_sample_ana/cm);
+	D(4,6) = -cos(t_real(0.5)*twotheta) / (pop.dist_sample_ana/cm);
+	D(4,8) = -cos(thetaa) / (pop.dist_sample_ana/cm);
+	D(4,9) = sin(thetaa) / (pop.dist_sample_ana/cm);
+	D(5,8) = cos(thetaa) / (pop.dist_ana_det/cm);
+	D(5,9) = sin(thetaa) / (pop.dist_ana_det/cm);
+	D(5,11) = t_real(1) / (pop.dist_ana_det/cm);
+	D(6,7) = t_real(-1) / (pop.dist_sample_ana/cm);
+	D(6,10) = t_real(1) / (pop.dist_sample_ana/cm);
+	D(7,10) = t_real(-1) / (pop.dist_ana_det/cm);
+	D(7,12) = t_real(1) / (pop.dist_ana_det/cm);
+
+
+	// [pop75], equ. 20
+	// [T] = 1/cm, [F] = 1/rad^2, [pop75], equ. 15
+	t_mat K = S + tl::transform(F, T, 1);
+	t_mat Ki;
+	if(!tl::inverse(K, Ki))
+	{
+		res.bOk = false;
+		res.strErr = "Matrix K cannot be inverted.";
+		return res;
+	}
+
+	// [pop75], equ. 17
+	t_mat Hi = tl::transform_inv(Ki, D, 1);
+	t_mat H;
+	if(!tl::inverse(Hi, H))
+	{
+		res.bOk = false;
+		res.strErr = "Matrix H^(-1) cannot be inverted.";
+		return res;
+	}
+
+	t_mat H_G = H + G;
+	t_mat H_Gi;
+	if(!tl::inverse(H_G, H_Gi))
+	{
+		res.bOk = false;
+		res.strErr = "Matrix H+G cannot be inverted.";
+		return res;
+	}
+
+	t_mat BA = ublas::prod(B, A);
+	t_mat ABt = ublas::prod(ublas::trans(A), ublas::trans(B));
+	t_mat H_GiABt = ublas::prod(H_Gi, ABt);
+	t_mat cov = ublas::prod(BA, H_GiABt);
+
+	cov(1,1) += pop.Q*pop.Q*angs*angs * pop.sample_mosaic*pop.sample_mosaic /rads/rads;
+	cov(2,2) += pop.Q*pop.Q*angs*angs * sample_mosaic_spread*sample_mosaic_spread /rads/rads;
+
+	if(!tl::inverse(cov, res.reso))
+	{
+		res.bOk = false;
+		res.strErr = "Covariance matrix cannot be inverted.";
+		return res;
+	}
+
+
+	// -------------------------------------------------------------------------
+
+
+	res.reso *= sig2fwhm*sig2fwhm;
+	res.reso_v = ublas::zero_vector<t_real>(4);
+	res.reso_s = 0.;
+
+	if(pop.dsample_sense < 0.)
+	{
+		// mirror Q_perp
+		t_mat matMirror = tl::mirror_matrix<t_mat>(res.reso.size1(), 1);
+		res.reso = tl::transform(res.reso, matMirror, true);
+		res.reso_v[1] = -res.reso_v[1];
+	}
+
+
+	res.dResVol = tl::get_ellipsoid_volume(res.reso);
+	res.dR0 = 0.;
+	const t_real pi = tl::get_pi<t_real>();
+	if(pop.flags & CALC_R0)
+	{
+		// resolution volume, [pop75], equ. 13a & 16
+		// [D] = 1/cm, [SI] = cm^2
+		t_mat DSiDt = tl::transform_inv(SI, D, 1);
+		t_mat DSiDti;
+		if(!tl::inverse(DSiDt, DSiDti))
+		{
+			res.bOk = false;
+			res.strErr = "R0 factor cannot be calculated.";
+			return res;
+		}
+		DSiDti += G;
+
+		t_real dDetS = tl::determinant(S);
+		t_real dDetF = tl::determinant(F);
+		t_real dDetK = tl::determinant(K);
+		t_real dDetDSiDti = tl::determinant(DSiDti);
+
+		// [pop75], equs. 13a & 16
+		res.dR0 = dmono_refl*dana_effic * t_real((2.*pi)*(2.*pi)*(2.*pi)*(2.*pi));
+		res.dR0 *= std::sqrt(dDetS*dDetF/(dDetK * dDetDSiDti));
+		res.dR0 /= t_real(8.*pi*8.*pi) * units::sin(thetam)*units::sin(thetaa);
+		res.dR0 *= dxsec;
+
+		// rest of the prefactors, equ. 1 in [pop75], together with the mono and and ana reflectivities
+		// (defining the resolution volume) these give the same correction as in [mit84] equ. A.57
+		// NOTE: these factors are not needed, because the normalisation of the 4d gaussian distribution
+		// is already taken care of in the MC step by the employed std::normal_distribution function
+		//res.dR0 *= std::sqrt(std::abs(tl::determinant(res.reso))) / (2.*pi*2.*pi);
+		// except for the (unimportant) prefactors this is the same as dividing by the resolution volume
+		//res.dR0 /= res.dResVol * pi * t_real(3.);
+	}
+
+	// Bragg widths
+	const std::vector<t_real> vecFwhms = calc_bragg_fwhms(res.reso);
+	std::copy(vecFwhms.begin(), vecFwhms.end(), res.dBraggFWHMs);
+
+
+	if(tl::is_nan_or_inf(res.dR0) || tl::is_nan_or_inf(res.reso))
+	{
+		res.strErr = "Invalid result.";
+		res.bOk = false;
+		return res;
+	}
+
+	res.bOk = true;
+	return res;
+}
+
+
+// ----------------------------------------------------------------------------
+// eck
+
+
+static std::tuple<t_mat, t_vec, t_real, t_real, t_real>
+get_mono_vals(const length& src_w, const length& src_h,
+	const length& mono_w, const length& mono_h,
+	const length& dist_src_mono, const length& dist_mono_sample,
+	const wavenumber& ki, const angle& thetam,
+	const angle& coll_h_pre_mono, const angle& coll_h_pre_sample,
+	const angle& coll_v_pre_mono, const angle& coll_v_pre_sample,
+	const angle& mono_mosaic, const angle& mono_mosaic_v,
+	const inv_length& inv_mono_curvh, const inv_length& inv_mono_curvv,
+	const length& pos_x , const length& pos_y, const length& pos_z,
+	t_real dRefl)
+{
+	// A matrix: formula 26 in [eck14]
+	t_mat A = ublas::identity_matrix<t_real>(3);
+	{
+		const auto A_t0 = t_real(1) / mono_mosaic;
+		const auto A_tx = inv_mono_curvh*dist_mono_sample / units::abs(units::sin(thetam));
+		const auto A_t1 = A_t0*A_tx;
+
+		A(0,0) = t_real(0.5)*sig2fwhm*sig2fwhm / (ki*angs*ki*angs) *
+			units::tan(thetam)*units::tan(thetam) *
+		(
+/*a*/			+ units::pow<2>(t_real(2)/coll_h_pre_mono) *rads*rads
+/*b*/			+ units::pow<2>(t_real(2)*dist_src_mono/src_w)
+/*c*/			+ A_t0*A_t0 *rads*rads
+		);
+		A(0,1) = A(1,0) = t_real(0.5)*sig2fwhm*sig2fwhm / (ki*angs*ki*angs)
+			* units::tan(thetam) *
+		(
+/*w*/			+ t_real(2)*tl::my_units_pow2(t_real(1)/coll_h_pre_mono) *rads*rads
+/*x*/			+ t_real(2)*dist_src_mono*(dist_src_mono-dist_mono_sample)/(src_w*src_w)
+/*y*/			+ A_t0*A_t0 * rads*rads
+/*z*/			- A_t0*A_t1 *rads*rads
+		);
+		A(1,1) = t_real(0.5)*sig2fwhm*sig2fwhm / (ki*angs*ki*angs) *
+		(
+/*1*/			+ units::pow<2>(t_real(1)/coll_h_pre_mono) *rads*rads
+/*2*/			+ units::pow<2>(t_real(1)/coll_h_pre_sample) *rads*rads
+/*3*/			+ units::pow<2>((dist_src_mono-dist_mono_sample)/src_w)
+/*4*/			+ units::pow<2>(dist_mono_sample/(mono_w*units::abs(units::sin(thetam))))
+
+/*5*/			+ A_t0*A_t0 *rads*rads
+/*6*/			- t_real(2)*A_t0*A_t1 *rads*rads
+/*7*/			+ A_t1*A_t1 *rads*rads
+		);
+	}
+
+	// Av matrix: formula 38 in [eck14]
+	// some typos in paper leading to the (false) result of a better Qz resolution when focusing
+	// => trying to match terms in Av with corresponding terms in A
+	// corresponding pre-mono terms commented out in Av, as they are not considered there
+	t_mat Av(2,2);
+	{
+		const auto Av_t0 = t_real(0.5) / (mono_mosaic_v*units::abs(units::sin(thetam)));
+		const auto Av_t1 = inv_mono_curvv*dist_mono_sample / mono_mosaic_v;
+
+		Av(0,0) = t_real(0.5)*sig2fwhm*sig2fwhm / (ki*angs*ki*angs) *
+		(
+/*1*/	//		+ units::pow<2>(t_real(1)/coll_v_pre_mono) *rads*rads	// missing in paper?
+/*2*/			+ units::pow<2>(t_real(1)/coll_v_pre_sample) *rads*rads
+/*~3*/			+ units::pow<2>(dist_mono_sample/src_h)
+/*4*/			+ units::pow<2>(dist_mono_sample/mono_h)
+
+/*5*/			+ Av_t0*Av_t0 * rads*rads 				// typo in paper?
+/*6*/			- t_real(2)*Av_t0*Av_t1 * rads*rads
+/*7*/			+ Av_t1*Av_t1 * rads*rads 				// missing in paper?
+		);
+		Av(0,1) = Av(1,0) = t_real(0.5)*sig2fwhm*sig2fwhm / (ki*angs*ki*angs) *
+		(
+/*w*/	//		- units::pow<2>(1./coll_v_pre_mono) *rads*rads		// missing in paper?
+/*~x*/			+ dist_src_mono*dist_mono_sample/(src_h*src_h)
+/*y*/			- Av_t0*Av_t0 * rads*rads
+/*z*/			+ Av_t0*Av_t1 * rads*rads
+		);
+		Av(1,1) = t_real(0.5)*sig2fwhm*sig2fwhm / (ki*angs*ki*angs) *
+		(
+/*a*/			+ units::pow<2>(t_real(1)/(coll_v_pre_mono)) *rads*rads
+/*b*/			+ units::pow<2>(dist_src_mono/src_h)
+/*c*/			+ Av_t0*Av_t0 *rads*rads
+		);
+	}
+
+	// B vector: formula 27 in [eck14]
+	t_vec B(3);
+	{
+		const auto B_t0 = inv_mono_curvh / (mono_mosaic*mono_mosaic*units::abs(units::sin(thetam)));
+
+		B(0) = sig2fwhm*sig2fwhm * pos_y / (ki*angs) * units::tan(thetam) *
+		(
+/*i*/			+ t_real(2)*dist_src_mono / (src_w*src_w)
+/*j*/			+ B_t0 *rads*rads
+		);
+		B(1) = sig2fwhm*sig2fwhm * pos_y / (ki*angs) *
+		(
+/*r*/			- dist_mono_sample / (units::pow<2>(mono_w*units::abs(units::sin(thetam))))
+/*s*/			+ B_t0 * rads*rads
+/*t*/			- B_t0 * rads*rads * inv_mono_curvh*dist_mono_sample /
+					(units::abs(units::sin(thetam)))
+/*u*/			+ (dist_src_mono-dist_mono_sample) / (src_w*src_w)
+		);
+	}
+
+	// Bv vector: formula 39 in [eck14]
+	t_vec Bv(2);
+	{
+		const auto Bv_t0 = inv_mono_curvv/(mono_mosaic_v*mono_mosaic_v);
+
+		Bv(0) = sig2fwhm*sig2fwhm * pos_z / (ki*angs) * t_real(-1.) *
+		(
+/*r*/			+ dist_mono_sample / (mono_h*mono_h)	// typo in paper?
+/*~s*/			- t_real(0.5)*Bv_t0 *rads*rads / units::abs(units::sin(thetam))
+/*~t*/			+ Bv_t0 * rads*rads * inv_mono_curvv*dist_mono_sample
+/*~u*/			+ dist_mono_sample / (src_h*src_h)		// typo in paper?
+		);
+		Bv(1) = sig2fwhm*sig2fwhm * pos_z / (ki*angs) * t_real(-1.) *
+		(
+/*i*/			+ dist_src_mono / (src_h*src_h)			// typo in paper?
+/*j*/			+ t_real(0.5)*Bv_t0/units::abs(units::sin(thetam)) * rads*rads
+		);
+	}
+
+
+	// C scalar: formula 28 in [eck14]
+	t_real C = t_real(0.5)*sig2fwhm*sig2fwhm * pos_y*pos_y *
+	(
+		t_real(1)/(src_w*src_w) +
+		units::pow<2>(t_real(1)/(mono_w*units::abs(units::sin(thetam)))) +
+		units::pow<2>(inv_mono_curvh/(mono_mosaic * units::abs(units::sin(thetam)))) *rads*rads
+	);
+
+	// Cv scalar: formula 40 in [eck14]
+	t_real Cv = t_real(0.5)*sig2fwhm*sig2fwhm * pos_z*pos_z *
+	(
+		t_real(1)/(src_h*src_h) +
+		t_real(1)/(mono_h*mono_h) +
+		units::pow<2>(inv_mono_curvv/mono_mosaic_v) *rads*rads
+	);
+
+
+	// z components, [eck14], equ. 42
+	A(2,2) = Av(0,0) - Av(0,1)*Av(0,1)/Av(1,1);
+	B[2] = Bv[0] - Bv[1]*Av(0,1)/Av(1,1);
+	t_real D = Cv - t_real(0.25)*Bv[1]/Av(1,1);
+
+
+	// [eck14], equ. 54
+	t_real refl = dRefl * std::sqrt(pi / (Av(1,1) /* * A(1,1) */));	// check: typo in paper?
+
+
+	return std::make_tuple(A, B, C, D, refl);
+}
+
+
+ResoResults calc_eck_old(const EckParams& eck)
+{
+	angle twotheta = eck.twotheta * eck.dsample_sense;
+	angle thetaa = eck.thetaa * eck.dana_sense;
+	angle thetam = eck.thetam * eck.dmono_sense;
+	angle ki_Q = eck.angle_ki_Q * eck.dsample_sense;
+	angle kf_Q = eck.angle_kf_Q * eck.dsample_sense;
+	//kf_Q = ki_Q + twotheta;
+
+
+	// --------------------------------------------------------------------
+	// mono/ana focus
+	length mono_curvh = eck.mono_curvh, mono_curvv = eck.mono_curvv;
+	length ana_curvh = eck.ana_curvh, ana_curvv = eck.ana_curvv;
+
+	if(eck.bMonoIsOptimallyCurvedH) mono_curvh = tl::foc_curv(eck.dist_src_mono, eck.dist_mono_sample, units::abs(t_real(2)*thetam), false);
+	if(eck.bMonoIsOptimallyCurvedV) mono_curvv = tl::foc_curv(eck.dist_src_mono, eck.dist_mono_sample, units::abs(t_real(2)*thetam), true);
+	if(eck.bAnaIsOptimallyCurvedH) ana_curvh = tl::foc_curv(eck.dist_sample_ana, eck.dist_ana_det, units::abs(t_real(2)*thetaa), false);
+	if(eck.bAnaIsOptimallyCurvedV) ana_curvv = tl::foc_curv(eck.dist_sample_ana, eck.dist_ana_det, units::abs(t_real(2)*thetaa), true);
+
+	//mono_curvh *= eck.dmono_sense; mono_curvv *= eck.dmono_sense;
+	//ana_curvh *= eck.dana_sense; ana_curvv *= eck.dana_sense;
+
+	inv_length inv_mono_curvh = t_real(0)/cm, inv_mono_curvv = t_real(0)/cm;
+	inv_length inv_ana_curvh = t_real(0)/cm, inv_ana_curvv = t_real(0)/cm;
+
+	if(eck.bMonoIsCurvedH) inv_mono_curvh = t_real(1)/mono_curvh;
+	if(eck.bMonoIsCurvedV) inv_mono_curvv = t_real(1)/mono_curvv;
+	if(eck.bAnaIsCurvedH) inv_ana_curvh = t_real(1)/ana_curvh;
+	if(eck.bAnaIsCurvedV) inv_ana_curvv = t_real(1)/ana_curvv;
+
+	//if(eck.bMonoIsCurvedH) tl::log_debug("mono curv h: ", mono_curvh);
+	//if(eck.bMonoIsCurvedV) tl::log_debug("mono curv v: ", mono_curvv);
+	//if(eck.bAnaIsCurvedH) tl::log_debug("ana curv h: ", ana_curvh);
+	//if(eck.bAnaIsCurvedV) tl::log_debug("ana curv v: ", ana_curvv);
+	// --------------------------------------------------------------------
+
+
+	const length lam = tl::k2lam(eck.ki);
+
+	angle coll_h_pre_mono = eck.coll_h_pre_mono;
+	angle coll_v_pre_mono = eck.coll_v_pre_mono;
+
+	if(eck.bGuide)
+	{
+		coll_h_pre_mono = lam*(eck.guide_div_h/angs);
+		coll_v_pre_mono = lam*(eck.guide_div_v/angs);
+	}
+
+
+	//std::cout << "thetaM = " << t_real(thetam/rads/M_PI*180.) << " deg"<< std::endl;
+	//std::cout << "thetaA = " << t_real(thetaa/rads/M_PI*180.) << " deg"<< std::endl;
+	//std::cout << "ki = " << t_real(eck.ki*angs) << ", kf = " << t_real(eck.kf*angs) << std::endl;
+	//std::cout << "Q = " << t_real(eck.Q*angs) << ", E = " << t_real(eck.E/meV) << std::endl;
+	//std::cout << "kiQ = " << t_real(ki_Q/rads/M_PI*180.) << " deg"<< std::endl;
+	//std::cout << "kfQ = " << t_real(kf_Q/rads/M_PI*180.) << " deg"<< std::endl;
+	//std::cout << "2theta = " << t_real(twotheta/rads/M_PI*180.) << " deg"<< std::endl;
+
+
+	ResoResults res;
+
+	res.Q_avg.resize(4);
+	res.Q_avg[0] = eck.Q*angs;
+	res.Q_avg[1] = 0.;
+	res.Q_avg[2] = 0.;
+	res.Q_avg[3] = eck.E/meV;
+
+
+	// -------------------------------------------------------------------------
+
+	// - if the instruments works in kf=const mode and the scans are counted for
+	//   or normalised to monitor counts no ki^3 or kf^3 factor is needed.
+	// - if the instrument works in ki=const mode the kf^3 factor is needed.
+	const auto tupScFact = get_scatter_factors(eck.flags, eck.thetam, eck.ki, eck.thetaa, eck.kf);
+
+	t_real dmono_refl = eck.dmono_refl * std::get<0>(tupScFact);
+	t_real dana_effic = eck.dana_effic * std::get<1>(tupScFact);
+	if(eck.mono_refl_curve) dmono_refl *= (*eck.mono_refl_curve)(eck.ki);
+	if(eck.ana_effic_curve) dana_effic *= (*eck.ana_effic_curve)(eck.kf);
+	t_real dxsec = std::get<2>(tupScFact);
+
+
+	//--------------------------------------------------------------------------
+	// mono part
+
+	std::launch lpol = /*std::launch::deferred |*/ std::launch::async;
+	std::future<std::tuple<t_mat, t_vec, t_real, t_real, t_real>> futMono
+		= std::async(lpol, get_mono_vals,
+			eck.src_w, eck.src_h,
+			eck.mono_w, eck.mono_h,
+			eck.dist_src_mono, eck.dist_mono_sample,
+			eck.ki, thetam,
+			coll_h_pre_mono, eck.coll_h_pre_sample,
+			coll_v_pre_mono, eck.coll_v_pre_sample,
+			eck.mono_mosaic, eck.mono_mosaic_v,
+			inv_mono_curvh, inv_mono_curvv,
+			eck.pos_x , eck.pos_y, eck.pos_z,
+			dmono_refl);
+
+	//--------------------------------------------------------------------------
+
+
+	//--------------------------------------------------------------------------
+	// ana part
+
+	// equ 43 in [eck14]
+	length pos_y2 = - eck.pos_x*units::sin(twotheta)
+		+ eck.pos_y*units::cos(twotheta);
+	std::future<std::tuple<t_mat, t_vec, t_real, t_real, t_real>> futAna
+		= std::async(lpol, get_mono_vals,
+			eck.det_w, eck.det_h,
+			eck.ana_w, eck.ana_h,
+			eck.dist_ana_det, eck.dist_sample_ana,
+			eck.kf, -thetaa,
+			eck.coll_h_post_ana, eck.coll_h_post_sample,
+			eck.coll_v_post_ana, eck.coll_v_post_sample,
+			eck.ana_mosaic, eck.ana_mosaic_v,
+			inv_ana_curvh, inv_ana_curvv,
+			eck.pos_x, pos_y2, eck.pos_z,
+			dana_effic);
+
+	//--------------------------------------------------------------------------
+	// get mono & ana results
+
+	std::tuple<t_mat, t_vec, t_real, t_real, t_real> tupMono = futMono.get();
+	const t_mat& A = std::get<0>(tupMono);
+	const t_vec& B = std::get<1>(tupMono);
+	const t_real& C = std::get<2>(tupMono);
+	const t_real& D = std::get<3>(tupMono);
+	const t_real& dReflM = std::get<4>(tupMono);
+
+	std::tuple<t_mat, t_vec, t_real, t_real, t_real> tupAna = futAna.get();
+	const t_mat& E = std::get<0>(tupAna);
+	const t_vec& F = std::get<1>(tupAna);
+	const t_real& G = std::get<2>(tupAna);
+	const t_real& H = std::get<3>(tupAna);
+	const t_real& dReflA = std::get<4>(tupAna);
+
+	/*std::cout << "A = " << A << std::endl;
+	std::cout << "B = " << B << std::endl;
+	std::cout << "C = " << C << std::endl;
+	std::cout << "D = " << D << std::endl;
+	std::cout << "RM = " << dReflM << std::endl;
+
+	std::cout << "E = " << E << std::endl;
+	std::cout << "F = " << F << std::endl;
+	std::cout << "G = " << G << std::endl;
+	std::cout << "H = " << H << std::endl;
+	std::cout << "RA = " << dReflA << std::endl;*/
+
+	//--------------------------------------------------------------------------
+
+
+	// equ 4 & equ 53 in [eck14]
+	const t_real dE = (eck.ki*eck.ki - eck.kf*eck.kf) / (t_real(2)*eck.Q*eck.Q);
+	const wavenumber kipara = eck.Q*(t_real(0.5)+dE);
+	const wavenumber kfpara = eck.Q-kipara;
+	wavenumber kperp = tl::my_units_sqrt<wavenumber>(units::abs(kipara*kipara - eck.ki*eck.ki));
+	kperp *= eck.dsample_sense;
+
+	const t_real ksq2E = tl::get_KSQ2E<t_real>();
+
+	// trafo, equ 52 in [eck14]
+	t_mat T = ublas::identity_matrix<t_real>(6);
+	T(0,3) = T(1,4) = T(2,5) = -1.;
+	T(3,0) = t_real(2)*ksq2E * kipara * angs;
+	T(3,3) = t_real(2)*ksq2E * kfpara * angs;
+	T(3,1) = t_real(2)*ksq2E * kperp * angs;
+	T(3,4) = t_real(-2)*ksq2E * kperp * angs;
+	T(4,1) = T(5,2) = (0.5 - dE);
+	T(4,4) = T(5,5) = (0.5 + dE);
+	t_mat Tinv;
+	if(!tl::inverse(T, Tinv))
+	{
+		res.bOk = false;
+		res.strErr = "Matrix T cannot be inverted.";
+		return res;
+	}
+	//std::cout << "Trafo matrix (Eck) = " << T << std::endl;
+	//std::cout << "Tinv = " << Tinv << std::endl;
+
+	// equ 54 in [eck14]
+	t_mat Dalph_i = tl::rotation_matrix_3d_z(-ki_Q/rads);
+	t_mat Dalph_f = tl::rotation_matrix_3d_z(-kf_Q/rads);
+	t_mat Arot = tl::transform(A, Dalph_i, 1);
+	t_mat Erot = tl::transform(E, Dalph_f, 1);
+
+	t_mat matAE = ublas::zero_matrix<t_real>(6,6);
+	tl::submatrix_copy(matAE, Arot, 0,0);
+	tl::submatrix_copy(matAE, Erot, 3,3);
+	//std::cout << "AE = " << matAE << std::endl;
+
+	// U1 matrix
+	t_mat U1 = tl::transform(matAE, Tinv, 1);	// typo in paper in quadric trafo in equ 54 (top)?
+	//std::cout << "U1 = " << U1 << std::endl;
+
+	// V1 vector
+	t_vec vecBF = ublas::zero_vector<t_real>(6);
+	t_vec vecBrot = ublas::prod(ublas::trans(Dalph_i), B);
+	t_vec vecFrot = ublas::prod(ublas::trans(Dalph_f), F);
+	tl::subvector_copy(vecBF, vecBrot, 0);
+	tl::subvector_copy(vecBF, vecFrot, 3);
+	t_vec V1 = ublas::prod(vecBF, Tinv);
+
+
+
+	//--------------------------------------------------------------------------
+	// integrate last 2 vars -> equs 57 & 58 in [eck14]
+
+	t_mat U2 = quadric_proj(U1, 5);
+	t_mat U = quadric_proj(U2, 4);
+
+	t_vec V2 = quadric_proj(V1, U1, 5);
+	t_vec V = quadric_proj(V2, U2, 4);
+
+	t_real W = (C + D + G + H) - 0.25*V1[5]/U1(5,5) - 0.25*V2[4]/U2(4,4);
+
+	t_real Z = dReflM*dReflA
+		* std::sqrt(pi/std::abs(U1(5,5)))
+		* std::sqrt(pi/std::abs(U2(4,4)));
+
+	/*std::cout << "U = " << U << std::endl;
+	std::cout << "V = " << V << std::endl;
+	std::cout << "W = " << W << std::endl;
+	std::cout << "Z = " << Z << std::endl;*/
+	//--------------------------------------------------------------------------
+
+
+	// quadratic part of quadric (matrix U)
+	// careful: factor -0.5*... missing in U matrix compared to normal gaussian!
+	res.reso = t_real(2) * U;
+	// linear (vector V) and constant (scalar W) part of quadric
+	res.reso_v = V;
+	res.reso_s = W;
+
+	if(eck.dsample_sense < 0.)
+	{
+		// mirror Q_perp
+		t_mat matMirror = tl::mirror_matrix<t_mat>(res.reso.size1(), 1);
+		res.reso = tl::transform(res.reso, matMirror, true);
+		res.reso_v[1] = -res.reso_v[1];
+	}
+
+	// prefactor and volume
+	res.dResVol = tl::get_ellipsoid_volume(res.reso);
+
+	if(eck.flags & CALC_GENERAL_R0)
+	{
+		// alternate R0 normalisation factor, see [mit84], equ. A.57
+		res.dR0 = mitch_R0<t_real>(dmono_refl, dana_effic,
+			tl::get_ellipsoid_volume(A), tl::get_ellipsoid_volume(E), res.dResVol, false);
+	}
+	else
+	{
+		res.dR0 = Z;
+		// missing volume prefactor to normalise gaussian,
+		// cf. equ. 56 in [eck14] to  equ. 1 in [pop75] and equ. A.57 in [mit84]
+		//res.dR0 /= std::sqrt(std::abs(tl::determinant(res.reso))) / (2.*pi*2.*pi);
+		res.dR0 *= res.dResVol * pi * t_real(3.);
+	}
+
+	res.dR0 *= std::exp(-W);
+	res.dR0 *= dxsec;
+
+	// Bragg widths
+	const std::vector<t_real> vecFwhms = calc_bragg_fwhms(res.reso);
+	std::copy(vecFwhms.begin(), vecFwhms.end(), res.dBraggFWHMs);
+
+	if(tl::is_nan_or_inf(res.dR0) || tl::is_nan_or_inf(res.reso))
+	{
+		res.strErr = "Invalid result.";
+		res.bOk = false;
+		return res;
+	}
+
+	res.bOk = true;
+	return res;
+}
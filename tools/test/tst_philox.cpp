@@ -0,0 +1,200 @@
+/**
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @license GPLv2
+ *
+ * reproducibility and independence of the counter-based random streams
+ * and the scrambled sobol sequences
+ */
+
+// gcc -I../.. -o tst_philox tst_philox.cpp ../../tlibs/log/log.cpp -lstdc++ -lm -std=c++11
+
+#include "tools/res/philox.h"
+#include "tools/res/qmc.h"
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+typedef double t_real;
+
+static const std::size_t NUM = 100000;
+static int g_iFailed = 0;
+
+
+void check(const char* pcWhat, bool bOk, t_real dVal)
+{
+	if(!bOk) ++g_iFailed;
+	std::cout << (bOk ? "  ok    " : "  FAIL  ") << pcWhat << ": " << dVal << std::endl;
+}
+
+
+/**
+ * the first NUM uniform numbers of sub-stream iSub
+ */
+std::vector<t_real> get_uniform(const PhiloxStream& stream, std::uint32_t iSub = 0)
+{
+	std::vector<t_real> vec(NUM);
+	for(std::size_t i=0; i<NUM; i+=4)
+		stream.GetUniform<t_real>(std::uint32_t(i/4), iSub, vec.data()+i);
+	return vec;
+}
+
+/**
+ * number of positions at which the sequences differ
+ */
+std::size_t num_diff(const std::vector<t_real>& vec1, const std::vector<t_real>& vec2)
+{
+	std::size_t iDiff = 0;
+	for(std::size_t i=0; i<vec1.size(); ++i)
+		if(vec1[i] != vec2[i]) ++iDiff;
+	return iDiff;
+}
+
+/**
+ * correlation coefficient of two sequences
+ */
+t_real corr(const std::vector<t_real>& vec1, const std::vector<t_real>& vec2)
+{
+	t_real dMean1 = 0., dMean2 = 0.;
+	for(std::size_t i=0; i<vec1.size(); ++i)
+	{
+		dMean1 += vec1[i];
+		dMean2 += vec2[i];
+	}
+	dMean1 /= t_real(vec1.size());
+	dMean2 /= t_real(vec2.size());
+
+	t_real dCov = 0., dVar1 = 0., dVar2 = 0.;
+	for(std::size_t i=0; i<vec1.size(); ++i)
+	{
+		dCov += (vec1[i]-dMean1) * (vec2[i]-dMean2);
+		dVar1 += (vec1[i]-dMean1) * (vec1[i]-dMean1);
+		dVar2 += (vec2[i]-dMean2) * (vec2[i]-dMean2);
+	}
+	return dCov / std::sqrt(dVar1*dVar2);
+}
+
+
+void tst_philox()
+{
+	// 5 sigma bound for the correlation of independent sequences
+	const t_real dMaxCorr = 5. / std::sqrt(t_real(NUM));
+
+	std::cout << "philox" << std::endl;
+
+	// same seed and stream id -> same numbers
+	const std::vector<t_real> vec = get_uniform(PhiloxStream(1234, 5));
+	check("same seed and stream", num_diff(vec, get_uniform(PhiloxStream(1234, 5))) == 0, 0.);
+	check("same split", num_diff(get_uniform(PhiloxStream(1234).Split(5)),
+		get_uniform(PhiloxStream(1234).Split(5))) == 0, 0.);
+
+	// different seeds, stream ids or sub-streams -> independent numbers
+	const std::vector<std::vector<t_real>> vecOthers =
+	{
+		get_uniform(PhiloxStream(1234, 6)),
+		get_uniform(PhiloxStream(1235, 5)),
+		get_uniform(PhiloxStream(1234, 5), 1),
+		get_uniform(PhiloxStream(1234, 5).Split(0)),
+		get_uniform(PhiloxStream(1234, 5).Split(1)),
+		get_uniform(PhiloxStream(1234, std::uint64_t(5) | (std::uint64_t(1) << 32))),
+	};
+
+	for(const std::vector<t_real>& vecOther : vecOthers)
+	{
+		const t_real dCorr = corr(vec, vecOther);
+		check("different sequence", num_diff(vec, vecOther) > NUM*99/100, t_real(num_diff(vec, vecOther)));
+		check("correlation", std::abs(dCorr) < dMaxCorr, dCorr);
+	}
+
+	// neighbouring elements of one stream
+	const std::vector<t_real> vecShifted(vec.begin()+1, vec.end());
+	const std::vector<t_real> vecCut(vec.begin(), vec.end()-1);
+	const t_real dAutoCorr = corr(vecCut, vecShifted);
+	check("auto-correlation", std::abs(dAutoCorr) < dMaxCorr, dAutoCorr);
+
+	// moments of the uniform and normal numbers
+	t_real dMean = 0., dVar = 0.;
+	for(t_real d : vec) dMean += d;
+	dMean /= t_real(NUM);
+	for(t_real d : vec) dVar += (d-dMean)*(d-dMean);
+	dVar /= t_real(NUM-1);
+	check("uniform mean", std::abs(dMean - 0.5) < 5.*std::sqrt(1./12./t_real(NUM)), dMean);
+	check("uniform variance", std::abs(dVar - 1./12.) < 0.01/12., dVar);
+
+	PhiloxStream stream(1234, 5);
+	t_real dNormMean = 0., dNormVar = 0.;
+	for(std::size_t i=0; i<NUM; i+=4)
+	{
+		t_real dNorm[4];
+		stream.GetNormal<t_real>(std::uint32_t(i/4), 0, dNorm);
+		for(t_real d : dNorm)
+		{
+			dNormMean += d;
+			dNormVar += d*d;
+		}
+	}
+	dNormMean /= t_real(NUM);
+	dNormVar = dNormVar/t_real(NUM) - dNormMean*dNormMean;
+	check("normal mean", std::abs(dNormMean) < 5./std::sqrt(t_real(NUM)), dNormMean);
+	check("normal variance", std::abs(dNormVar - 1.) < 0.02, dNormVar);
+	std::cout << std::endl;
+}
+
+
+std::vector<t_real> get_sobol(const SobolSeq<t_real>& seq, unsigned iDim)
+{
+	std::vector<t_real> vec(NUM);
+	for(std::size_t i=0; i<NUM; ++i)
+		vec[i] = seq.Get(i, iDim);
+	return vec;
+}
+
+
+void tst_sobol()
+{
+	const std::uint32_t iSub = 3;
+	std::cout << "sobol" << std::endl;
+
+	// scrambling from the same stream -> same sequence
+	const PhiloxStream stream(1234, 5);
+	const SobolSeq<t_real> seq(4, true, &stream, iSub);
+	const SobolSeq<t_real> seqSame(4, true, &stream, iSub);
+	const PhiloxStream streamOther = stream.Split(1);
+	const SobolSeq<t_real> seqOther(4, true, &streamOther, iSub);
+
+	for(unsigned iDim=0; iDim<4; ++iDim)
+	{
+		const std::vector<t_real> vec = get_sobol(seq, iDim);
+		check("same scrambling", num_diff(vec, get_sobol(seqSame, iDim)) == 0, t_real(iDim));
+		check("different scrambling", num_diff(vec, get_sobol(seqOther, iDim)) > NUM*99/100, t_real(iDim));
+
+		// the scrambling keeps the stratification: the first 2^m points
+		// have exactly one point in every interval of length 2^-m
+		const std::size_t iPts = 1 << 12;
+		std::vector<int> vecHits(iPts, 0);
+		bool bStrat = true;
+		for(std::size_t i=0; i<iPts; ++i)
+		{
+			if(++vecHits[std::size_t(vec[i] * t_real(iPts))] > 1)
+				bStrat = false;
+		}
+		check("stratification", bStrat, t_real(iDim));
+
+		t_real dMean = 0.;
+		for(std::size_t i=0; i<iPts; ++i)
+			dMean += seq.GetNormal(i, iDim);
+		dMean /= t_real(iPts);
+		check("normal mean", std::abs(dMean) < 1e-2, dMean);
+	}
+}
+
+
+int main()
+{
+	tst_philox();
+	tst_sobol();
+
+	std::cout << (g_iFailed ? "FAILED: " : "all ok, failed: ") << g_iFailed << std::endl;
+	return g_iFailed ? -1 : 0;
+}
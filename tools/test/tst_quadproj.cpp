@@ -0,0 +1,158 @@
+/**
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @license GPLv2
+ *
+ * compares the single-pass and fixed-size quadric projections in ellipse.h
+ * and fixedmat.h with the previous outer-product version
+ */
+
+// gcc -I../.. -I/usr/include/lapacke -o tst_quadproj tst_quadproj.cpp ../../tlibs/math/linalg2.cpp ../../tlibs/log/log.cpp -lstdc++ -lm -llapacke -llapack -std=c++11
+
+#include "tools/res/ellipse.h"
+#include "tools/res/fixedmat.h"
+
+#include "tlibs/math/linalg.h"
+#include "tlibs/math/rand.h"
+
+#include <iostream>
+#include <cmath>
+
+using namespace tl;
+
+typedef double t_real;
+typedef ublas::matrix<t_real> t_mat;
+typedef ublas::vector<t_real> t_vec;
+
+static const t_real g_dEps = 1e-9;
+static int g_iFailed = 0;
+
+
+/**
+ * previous implementation: M - b b^T / m_ii with b the averaged row and column i,
+ * then remove row and column i
+ */
+t_mat quadric_proj_ref(const t_mat& mat, std::size_t iIdx)
+{
+	if(float_equal<t_real>(mat(iIdx, iIdx), 0.))
+		return remove_elems(mat, iIdx);
+
+	t_vec b = 0.5*(get_column(mat, iIdx) + get_row(mat, iIdx));
+	t_mat m = mat;
+	m -= 1./mat(iIdx, iIdx) * outer<t_vec, t_mat>(b, b);
+	return remove_elems(m, iIdx);
+}
+
+t_vec quadric_proj_ref(const t_vec& vec, const t_mat& mat, std::size_t iIdx)
+{
+	if(float_equal<t_real>(mat(iIdx, iIdx), 0.))
+		return remove_elem(vec, iIdx);
+
+	t_vec b = 0.5*(get_column(mat, iIdx) + get_row(mat, iIdx));
+	t_vec vecProj = vec;
+	vecProj -= vec[iIdx] / mat(iIdx, iIdx) * b;
+	return remove_elem(vecProj, iIdx);
+}
+
+
+template<class t_cont>
+t_real max_diff(const t_cont& a, const t_cont& b)
+{
+	if(a.size() != b.size())
+		return 1.;
+
+	t_real dDiff = 0.;
+	auto iterB = b.data().begin();
+	for(auto iterA = a.data().begin(); iterA != a.data().end(); ++iterA, ++iterB)
+		dDiff = std::max(dDiff, std::abs(*iterA - *iterB));
+	return dDiff;
+}
+
+void check(const char* pcWhat, std::size_t iIdx, t_real dDiff)
+{
+	const bool bOk = dDiff < g_dEps;
+	if(!bOk) ++g_iFailed;
+	std::cout << (bOk ? "  ok    " : "  FAIL  ") << pcWhat << " " << iIdx << ": " << dDiff << std::endl;
+}
+
+
+/**
+ * all projection variants along every axis of a 4x4 quadric
+ */
+void tst_proj(const t_mat_fix<t_real, 4>& M, const t_vec_fix<t_real, 4>& v)
+{
+	const t_mat matM = M;
+	const t_vec vecV = v;
+
+	for(std::size_t iIdx=0; iIdx<4; ++iIdx)
+	{
+		const t_mat matRef = quadric_proj_ref(matM, iIdx);
+		const t_vec vecRef = quadric_proj_ref(vecV, matM, iIdx);
+
+		check("ublas matrix", iIdx, max_diff(quadric_proj(matM, iIdx), matRef));
+		check("fixed matrix", iIdx, max_diff(t_mat(fix_quadric_proj<t_real, 4>(M, iIdx)), matRef));
+		check("fixed matrix overload", iIdx, max_diff(t_mat(quadric_proj(M, iIdx)), matRef));
+
+		check("ublas vector", iIdx, max_diff(quadric_proj(vecV, matM, iIdx), vecRef));
+		check("fixed vector", iIdx, max_diff(t_vec(fix_quadric_proj<t_real, 4>(v, M, iIdx)), vecRef));
+		check("fixed vector overload", iIdx, max_diff(t_vec(quadric_proj(v, M, iIdx)), vecRef));
+	}
+
+	// successive projections down to one dimension, as in calc_vanadium_fwhm
+	const t_mat matRef = quadric_proj_ref(quadric_proj_ref(quadric_proj_ref(matM, 0), 0), 0);
+	const t_mat_fix<t_real, 1> M1 = quadric_proj(quadric_proj(quadric_proj(M, 0), 0), 0);
+	check("chained fixed matrix", 0, max_diff(t_mat(M1), matRef));
+
+	const t_real dFwhmRef = get_SIGMA2FWHM<t_real>() / std::sqrt(std::abs(matRef(0,0)));
+	const t_real dFwhm = calc_vanadium_fwhm<t_real>(matM, vecV, 0., ublas::zero_vector<t_real>(4));
+	check("vanadium fwhm", 0, std::abs(dFwhm - dFwhmRef));
+}
+
+
+int main()
+{
+	init_rand();
+
+	// typical resolution matrix in (Qpara, Qperp, Qup, E) coordinates
+	const t_real dReso[4][4] =
+	{
+		{ 5.305e+02, -3.311e+01,  0.000e+00, -1.237e+02 },
+		{-3.311e+01,  1.527e+03,  0.000e+00,  1.963e+02 },
+		{ 0.000e+00,  0.000e+00,  4.892e+02,  0.000e+00 },
+		{-1.237e+02,  1.963e+02,  0.000e+00,  8.571e+01 },
+	};
+
+	t_mat_fix<t_real, 4> M;
+	t_vec_fix<t_real, 4> v;
+	for(std::size_t i=0; i<4; ++i)
+	{
+		for(std::size_t j=0; j<4; ++j)
+			M(i,j) = dReso[i][j];
+		v[i] = t_real(i+1);
+	}
+
+	std::cout << "resolution matrix" << std::endl;
+	tst_proj(M, v);
+
+	// random, non-symmetric matrices to test the row/column averaging
+	for(int iRun=0; iRun<5; ++iRun)
+	{
+		for(std::size_t i=0; i<4; ++i)
+		{
+			for(std::size_t j=0; j<4; ++j)
+				M(i,j) = rand_real<t_real>(-1., 1.);
+			M(i,i) += 4.;
+			v[i] = rand_real<t_real>(-1., 1.);
+		}
+
+		std::cout << "random matrix " << iRun << std::endl;
+		tst_proj(M, v);
+	}
+
+	// vanishing diagonal element -> slice instead of project
+	M(2,2) = 0.;
+	std::cout << "slice" << std::endl;
+	tst_proj(M, v);
+
+	std::cout << (g_iFailed ? "FAILED: " : "all ok, failed: ") << g_iFailed << std::endl;
+	return g_iFailed ? -1 : 0;
+}
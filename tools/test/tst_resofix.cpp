@@ -0,0 +1,281 @@
+/**
+ * @author Tobias Weber <tobias.weber@tum.de>
+ * @license GPLv2
+ *
+ * compares the fixed-size matrix cn, pop and eck calculations with the
+ * previous ublas versions in reso_old.cpp for a few instrument configurations
+ */
+
+// gcc -I../.. -I/usr/include/lapacke -o tst_resofix tst_resofix.cpp reso_old.cpp ../res/cn.cpp ../res/pop.cpp ../res/eck.cpp ../res/r0.cpp ../../tlibs/math/linalg2.cpp ../../tlibs/log/log.cpp -lstdc++ -lm -llapacke -llapack -lpthread -std=c++11
+
+#include "tools/res/cn.h"
+#include "tools/res/pop.h"
+#include "tools/res/eck.h"
+#include "tools/res/fixedmat.h"
+#include "tools/res/ellipse.h"
+
+#include "tlibs/math/linalg.h"
+#include "tlibs/math/rand.h"
+
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+using namespace tl;
+
+typedef t_real_reso t_real;
+typedef ublas::matrix<t_real> t_mat;
+typedef ublas::vector<t_real> t_vec;
+
+extern ResoResults calc_cn_old(const CNParams& cn);
+extern ResoResults calc_pop_old(const PopParams& pop);
+extern ResoResults calc_eck_old(const EckParams& eck);
+
+static const auto angs = get_one_angstrom<t_real>();
+static const auto rads = get_one_radian<t_real>();
+static const auto meV = get_one_meV<t_real>();
+static const auto cm = get_one_centimeter<t_real>();
+
+static const t_real g_dEps = 1e-8;
+static int g_iFailed = 0;
+
+
+/**
+ * largest element-wise deviation relative to the largest element
+ */
+template<class t_cont>
+t_real rel_diff(const t_cont& a, const t_cont& b)
+{
+	t_real dMax = 0., dDiff = 0.;
+	auto iterB = b.data().begin();
+	for(auto iterA = a.data().begin(); iterA != a.data().end(); ++iterA, ++iterB)
+	{
+		dMax = std::max(dMax, std::abs(*iterA));
+		dDiff = std::max(dDiff, std::abs(*iterA - *iterB));
+	}
+	return dMax > 0. ? dDiff/dMax : dDiff;
+}
+
+t_real rel_diff(t_real a, t_real b)
+{
+	const t_real dMax = std::max(std::abs(a), std::abs(b));
+	return dMax > 0. ? std::abs(a-b)/dMax : 0.;
+}
+
+void check(const char* pcWhat, t_real dDiff)
+{
+	const bool bOk = dDiff < g_dEps;
+	if(!bOk) ++g_iFailed;
+	std::cout << (bOk ? "  ok    " : "  FAIL  ") << pcWhat << ": " << dDiff << std::endl;
+}
+
+void check_res(const ResoResults& resNew, const ResoResults& resOld)
+{
+	if(!resNew.bOk || !resOld.bOk)
+	{
+		std::cout << "  FAIL  calculation: " << resNew.strErr << " / " << resOld.strErr << std::endl;
+		++g_iFailed;
+		return;
+	}
+
+	check("reso", rel_diff(resNew.reso, resOld.reso));
+	check("reso_v", rel_diff(resNew.reso_v, resOld.reso_v));
+	check("reso_s", rel_diff(resNew.reso_s, resOld.reso_s));
+	check("Q_avg", rel_diff(resNew.Q_avg, resOld.Q_avg));
+	check("R0", rel_diff(resNew.dR0, resOld.dR0));
+	check("resvol", rel_diff(resNew.dResVol, resOld.dResVol));
+}
+
+
+/**
+ * instrument configuration, kinematics are set by set_pos
+ */
+void set_instr(EckParams& eck, t_real dMosaic, t_real dColl, t_real dSense)
+{
+	eck.mono_d = 3.355 * angs;
+	eck.ana_d = 3.355 * angs;
+	eck.mono_mosaic = eck.mono_mosaic_v = d2r(dMosaic/60.) * rads;
+	eck.ana_mosaic = eck.ana_mosaic_v = d2r(dMosaic/60.) * rads;
+	eck.sample_mosaic = d2r(dMosaic/60.) * rads;
+	eck.dmono_sense = dSense;
+	eck.dana_sense = dSense;
+	eck.dsample_sense = -dSense;
+
+	for(int i=0; i<3; ++i)
+	{
+		eck.sample_lattice[i] = 5. * angs;
+		eck.sample_angles[i] = 0.5*get_pi<t_real>() * rads;
+	}
+
+	eck.coll_h_pre_mono = eck.coll_v_pre_mono = d2r(dColl/60.) * rads;
+	eck.coll_h_pre_sample = eck.coll_v_pre_sample = d2r(dColl/60.) * rads;
+	eck.coll_h_post_sample = eck.coll_v_post_sample = d2r(dColl/60.) * rads;
+	eck.coll_h_post_ana = eck.coll_v_post_ana = d2r(dColl/60.) * rads;
+
+	eck.dmono_refl = eck.dana_effic = 1.;
+
+	eck.mono_w = 15.*cm; eck.mono_h = 15.*cm; eck.mono_thick = 0.2*cm;
+	eck.mono_curvh = eck.mono_curvv = 100.*cm;
+	eck.bMonoIsCurvedH = eck.bMonoIsCurvedV = 1;
+	eck.bMonoIsOptimallyCurvedH = eck.bMonoIsOptimallyCurvedV = 1;
+	eck.mono_numtiles_h = eck.mono_numtiles_v = 1;
+
+	eck.ana_w = 15.*cm; eck.ana_h = 15.*cm; eck.ana_thick = 0.2*cm;
+	eck.ana_curvh = eck.ana_curvv = 100.*cm;
+	eck.bAnaIsCurvedH = eck.bAnaIsCurvedV = 1;
+	eck.bAnaIsOptimallyCurvedH = eck.bAnaIsOptimallyCurvedV = 1;
+	eck.ana_numtiles_h = eck.ana_numtiles_v = 1;
+
+	eck.sample_w_q = eck.sample_w_perpq = 1.*cm; eck.sample_h = 1.*cm;
+	eck.src_w = 6.*cm; eck.src_h = 12.*cm;
+	eck.det_w = 2.5*cm; eck.det_h = 5.*cm;
+	eck.guide_div_h = eck.guide_div_v = d2r(15./60.) * rads;
+
+	eck.dist_src_mono = 200.*cm;
+	eck.dist_mono_sample = 150.*cm;
+	eck.dist_sample_ana = 100.*cm;
+	eck.dist_ana_det = 50.*cm;
+
+	eck.pos_x = eck.pos_y = eck.pos_z = 0.*cm;
+	eck.flags = CALC_R0 | CALC_RESVOL | CALC_KI3 | CALC_KF3 | CALC_KFKI | CALC_GENERAL_R0;
+}
+
+
+/**
+ * kinematics as in TASReso::SetHKLE
+ */
+void set_pos(EckParams& eck, t_real dKi, t_real dKf, t_real dQ)
+{
+	eck.ki = dKi / angs;
+	eck.kf = dKf / angs;
+	eck.Q = dQ / angs;
+	eck.E = k2E(eck.ki) - k2E(eck.kf);
+
+	eck.thetam = units::abs(get_mono_twotheta(eck.ki, eck.mono_d, 1)*t_real(0.5));
+	eck.thetaa = units::abs(get_mono_twotheta(eck.kf, eck.ana_d, 1)*t_real(0.5));
+	eck.twotheta = units::abs(get_sample_twotheta(eck.ki, eck.kf, eck.Q, 1));
+	eck.angle_ki_Q = get_angle_ki_Q(eck.ki, eck.kf, eck.Q, 1);
+	eck.angle_kf_Q = get_angle_kf_Q(eck.ki, eck.kf, eck.Q, 1);
+}
+
+
+void tst_reso()
+{
+	struct Instr { t_real dMosaic, dColl, dSense; };
+	struct Pos { t_real dKi, dKf, dQ; };
+
+	const std::vector<Instr> vecInstr = { {30., 60., -1.}, {45., 30., 1.}, {20., 120., -1.} };
+	const std::vector<Pos> vecPos = { {1.4, 1.4, 1.5}, {2.662, 2.662, 2.}, {2.2, 1.55, 1.8}, {1.55, 1.8, 1.2} };
+
+	for(const Instr& instr : vecInstr)
+	{
+		EckParams eck;
+		set_instr(eck, instr.dMosaic, instr.dColl, instr.dSense);
+
+		std::vector<ResoScanPoint> vecPts;
+		std::vector<ResoResults> vecOldCN, vecOldPop, vecOldEck;
+
+		for(const Pos& pos : vecPos)
+		{
+			set_pos(eck, pos.dKi, pos.dKf, pos.dQ);
+			std::cout << "mosaic = " << instr.dMosaic << ", coll = " << instr.dColl
+				<< ", sense = " << instr.dSense << ", ki = " << pos.dKi
+				<< ", kf = " << pos.dKf << ", Q = " << pos.dQ << std::endl;
+
+			vecOldCN.push_back(calc_cn_old(eck));
+			vecOldPop.push_back(calc_pop_old(eck));
+			vecOldEck.push_back(calc_eck_old(eck));
+
+			std::cout << " cn" << std::endl;
+			check_res(calc_cn(eck), vecOldCN.back());
+			std::cout << " pop" << std::endl;
+			check_res(calc_pop(eck), vecOldPop.back());
+			std::cout << " eck" << std::endl;
+			check_res(calc_eck(eck), vecOldEck.back());
+
+			ResoScanPoint pt = get_scan_point(eck);
+			pt.pos_x = eck.pos_x; pt.pos_y = eck.pos_y; pt.pos_z = eck.pos_z;
+			vecPts.push_back(pt);
+		}
+
+		// the whole scan at once
+		std::vector<ResoResults> vecCN, vecPop, vecEck;
+		calc_cn_batch(eck, vecPts, vecCN);
+		calc_pop_batch(eck, vecPts, vecPop);
+		calc_eck_batch(eck, vecPts, vecEck);
+
+		for(std::size_t iPt=0; iPt<vecPts.size(); ++iPt)
+		{
+			std::cout << " batch, point " << iPt << std::endl;
+			check_res(vecCN[iPt], vecOldCN[iPt]);
+			check_res(vecPop[iPt], vecOldPop[iPt]);
+			check_res(vecEck[iPt], vecOldEck[iPt]);
+		}
+		std::cout << std::endl;
+	}
+}
+
+
+/**
+ * random symmetric positive definite matrix
+ */
+template<std::size_t N>
+t_mat_fix<t_real, N> rand_spd()
+{
+	t_mat_fix<t_real, N> A;
+	for(std::size_t i=0; i<N; ++i)
+		for(std::size_t j=0; j<N; ++j)
+			A(i,j) = rand_real<t_real>(-1., 1.);
+
+	t_mat_fix<t_real, N> M = fix_transform<t_real, N, N>(fix_unit_matrix<t_real, N>(), A);
+	for(std::size_t i=0; i<N; ++i)
+		M(i,i) += t_real(N);
+	return M;
+}
+
+
+void tst_fixmat()
+{
+	std::cout << "fixed-size matrix functions" << std::endl;
+
+	for(int iRun=0; iRun<10; ++iRun)
+	{
+		const t_mat_fix<t_real, 6> M = rand_spd<6>();
+		const t_mat_fix<t_real, 6> A = rand_spd<6>();
+		const t_mat matM = M, matA = A;
+
+		t_mat_fix<t_real, 6> Minv;
+		t_mat matMinv;
+		const bool bOk = fix_inverse<t_real, 6>(M, Minv);
+		const bool bOkRef = inverse(matM, matMinv);
+		check("inverse ok", bOk == bOkRef ? 0. : 1.);
+		check("inverse", rel_diff(t_mat(Minv), matMinv));
+
+		check("determinant", rel_diff(fix_determinant<t_real, 6>(M), determinant(matM)));
+		check("transform", rel_diff(t_mat(fix_transform<t_real, 6, 6>(M, A)), t_mat(transform(matM, matA, 1))));
+		check("transform_inv", rel_diff(t_mat(fix_transform_inv<t_real, 6, 6>(M, A)), t_mat(transform_inv(matM, matA, 1))));
+
+		for(std::size_t iIdx=0; iIdx<6; ++iIdx)
+			check("quadric_proj", rel_diff(t_mat(fix_quadric_proj<t_real, 6>(M, iIdx)), quadric_proj(matM, iIdx)));
+	}
+
+	// singular matrix
+	t_mat_fix<t_real, 6> M = rand_spd<6>(), Minv;
+	for(std::size_t i=0; i<6; ++i)
+		M(5,i) = M(4,i);
+	check("singular inverse", fix_inverse<t_real, 6>(M, Minv) ? 1. : 0.);
+	check("singular determinant", std::abs(fix_determinant<t_real, 6>(M)));
+	std::cout << std::endl;
+}
+
+
+int main()
+{
+	init_rand();
+
+	tst_fixmat();
+	tst_reso();
+
+	std::cout << (g_iFailed ? "FAILED: " : "all ok, failed: ") << g_iFailed << std::endl;
+	return g_iFailed ? -1 : 0;
+}